@@ -0,0 +1,230 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __ANCS_APP_CACHE_H__
+#define __ANCS_APP_CACHE_H__
+
+#include <stdint.h>
+#include <string.h>
+
+/*
+    Least recently used cache mapping app identifiers to display names.
+
+    Entries are packed back to back in a SIZE byte buffer, most recently used
+    first: identifier length, name length, identifier, name. Looking up an
+    entry moves it to the front and inserting evicts from the back until the
+    new entry fits, so memory use never exceeds SIZE bytes.
+*/
+template <uint16_t SIZE>
+class ANCSAppCache
+{
+public:
+    ANCSAppCache()
+        :   used(0),
+            hits(0),
+            misses(0)
+    {}
+
+    /*
+        Copy the display name for identifier into buffer. Returns the length
+        of the cached name, or -1 if the identifier is not in the cache. The
+        name is truncated to bufferLength but never NUL-terminated.
+    */
+    int16_t lookup(const char* identifier, uint8_t* buffer, uint16_t bufferLength)
+    {
+        uint16_t offset = find(identifier);
+
+        if (offset == used)
+        {
+            misses++;
+            return -1;
+        }
+
+        hits++;
+
+        // move entry to the front
+        uint16_t entryLength = 2 + storage[offset] + storage[offset + 1];
+        rotate(0, offset, offset + entryLength);
+
+        uint8_t nameLength = storage[1];
+
+        if (buffer)
+        {
+            memcpy(buffer, &storage[2 + storage[0]], (nameLength < bufferLength) ? nameLength : bufferLength);
+        }
+
+        return nameLength;
+    }
+
+    /*
+        Length of the cached name, or -1, without touching the LRU order.
+    */
+    int16_t peek(const char* identifier) const
+    {
+        uint16_t offset = find(identifier);
+
+        return (offset == used) ? -1 : storage[offset + 1];
+    }
+
+    /*
+        Add or replace the display name for identifier. Names that do not
+        fit in the cache are truncated.
+    */
+    void insert(const char* identifier, const uint8_t* name, uint16_t nameLength)
+    {
+        size_t identifierLength = strlen(identifier);
+
+        if ((identifierLength > 0xFF) || (2 + identifierLength > SIZE))
+        {
+            return;
+        }
+
+        remove(identifier);
+
+        if (nameLength > SIZE - 2 - identifierLength)
+        {
+            nameLength = SIZE - 2 - identifierLength;
+        }
+
+        if (nameLength > 0xFF)
+        {
+            nameLength = 0xFF;
+        }
+
+        uint16_t entryLength = 2 + identifierLength + nameLength;
+
+        // evict least recently used entries
+        while (used + entryLength > SIZE)
+        {
+            used = findLast();
+        }
+
+        memmove(&storage[entryLength], storage, used);
+
+        storage[0] = identifierLength;
+        storage[1] = nameLength;
+        memcpy(&storage[2], identifier, identifierLength);
+        memcpy(&storage[2 + identifierLength], name, nameLength);
+
+        used += entryLength;
+    }
+
+    void remove(const char* identifier)
+    {
+        uint16_t offset = find(identifier);
+
+        if (offset < used)
+        {
+            uint16_t entryLength = 2 + storage[offset] + storage[offset + 1];
+
+            memmove(&storage[offset], &storage[offset + entryLength], used - offset - entryLength);
+            used -= entryLength;
+        }
+    }
+
+    void clear()
+    {
+        used = 0;
+    }
+
+    uint16_t getUsed() const
+    {
+        return used;
+    }
+
+    uint32_t getHits() const
+    {
+        return hits;
+    }
+
+    uint32_t getMisses() const
+    {
+        return misses;
+    }
+
+private:
+    /*
+        Offset of the entry for identifier, or used if there is none.
+    */
+    uint16_t find(const char* identifier) const
+    {
+        size_t identifierLength = strlen(identifier);
+        uint16_t offset = 0;
+
+        while (offset < used)
+        {
+            if ((storage[offset] == identifierLength) &&
+                (memcmp(&storage[offset + 2], identifier, identifierLength) == 0))
+            {
+                break;
+            }
+
+            offset += 2 + storage[offset] + storage[offset + 1];
+        }
+
+        return offset;
+    }
+
+    /*
+        Offset of the least recently used entry.
+    */
+    uint16_t findLast() const
+    {
+        uint16_t offset = 0;
+        uint16_t last = 0;
+
+        while (offset < used)
+        {
+            last = offset;
+            offset += 2 + storage[offset] + storage[offset + 1];
+        }
+
+        return last;
+    }
+
+    /*
+        Swap the ranges [begin, middle) and [middle, end) in place.
+    */
+    void rotate(uint16_t begin, uint16_t middle, uint16_t end)
+    {
+        reverse(begin, middle);
+        reverse(middle, end);
+        reverse(begin, end);
+    }
+
+    void reverse(uint16_t begin, uint16_t end)
+    {
+        while ((begin + 1) < end)
+        {
+            end--;
+
+            uint8_t temp = storage[begin];
+            storage[begin] = storage[end];
+            storage[end] = temp;
+
+            begin++;
+        }
+    }
+
+private:
+    uint8_t storage[SIZE];
+    uint16_t used;
+
+    uint32_t hits;
+    uint32_t misses;
+};
+
+#endif // __ANCS_APP_CACHE_H__
@@ -0,0 +1,286 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __ANCS_ATTRIBUTE_DECODER_H__
+#define __ANCS_ATTRIBUTE_DECODER_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+    Decodes notification attribute values while they are received, so
+    that no second pass over the buffer is needed.
+
+    Message Size is a decimal string and becomes an integer. Date is
+    "yyyyMMdd'T'HHmmSS" and becomes seconds since 1970-01-01 00:00:00;
+    ANCS sends local time without a zone, so the result is local time as
+    well. Every other attribute is UTF-8 text, and its length is trimmed
+    to the end of the last complete character, as a maximum length in the
+    request can cut a character in half. Text is also cut before a byte
+    that breaks the encoding, e.g. a lead byte without its continuation
+    bytes.
+
+    Values are fed in order with update(), in pieces of any size.
+*/
+class ANCSAttributeDecoder
+{
+public:
+    typedef enum {
+        TypeText    = 0,
+        TypeInteger = 1,
+        TypeDate    = 2
+    } type_t;
+
+    ANCSAttributeDecoder()
+        :   type(TypeText),
+            valid(false),
+            position(0),
+            limit(0),
+            value(0),
+            textLength(0),
+            continuation(0)
+    {}
+
+    /*
+        Start an attribute of length bytes. Text beyond limit, e.g. past the
+        end of a shorter buffer, is not considered.
+    */
+    void start(uint8_t attributeID, uint16_t length, uint16_t _limit)
+    {
+        type = (attributeID == AttributeIDMessageSize) ? TypeInteger
+             : (attributeID == AttributeIDDate)        ? TypeDate
+             : TypeText;
+
+        valid = (type == TypeText) || (length > 0);
+        position = 0;
+        limit = (_limit < length) ? _limit : length;
+        value = 0;
+        textLength = 0;
+        continuation = 0;
+
+        for (uint8_t index = 0; index < DateFields; index++)
+        {
+            fields[index] = 0;
+        }
+    }
+
+    void update(const uint8_t* data, uint16_t length)
+    {
+        if (type == TypeText)
+        {
+            updateText(data, length);
+        }
+        else if (type == TypeInteger)
+        {
+            updateInteger(data, length);
+        }
+        else
+        {
+            updateDate(data, length);
+        }
+    }
+
+    type_t getType() const
+    {
+        return type;
+    }
+
+    /*
+        False if a Message Size or Date did not have the expected format,
+        or if text is not well formed UTF-8.
+    */
+    bool isValid() const
+    {
+        if (type == TypeDate)
+        {
+            return valid && (position == DateLength) && validDate();
+        }
+
+        return valid;
+    }
+
+    /*
+        Message Size, or Date in seconds since 1970. Zero for text and
+        invalid values.
+    */
+    uint32_t getValue() const
+    {
+        if (!isValid())
+        {
+            return 0;
+        }
+
+        if (type == TypeDate)
+        {
+            return toEpoch(fields[0], fields[1], fields[2], fields[3], fields[4], fields[5]);
+        }
+
+        return value;
+    }
+
+    /*
+        Bytes of text up to the end of the last complete UTF-8 character
+        before the first malformed one.
+    */
+    uint16_t getTextLength() const
+    {
+        return textLength;
+    }
+
+    /*
+        Seconds since 1970-01-01 00:00:00 for a date from 1970 to 2105.
+    */
+    static uint32_t toEpoch(uint16_t year, uint8_t month, uint8_t day,
+                            uint8_t hour, uint8_t minute, uint8_t second)
+    {
+        // days from civil, with the year starting in March
+        uint32_t shifted = (month <= 2) ? year - 1 : year;
+        uint32_t era = shifted / 400;
+        uint32_t yearOfEra = shifted - era * 400;
+        uint32_t dayOfYear = (153 * ((month > 2) ? month - 3 : month + 9) + 2) / 5 + day - 1;
+        uint32_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+        uint32_t days = era * 146097 + dayOfEra - 719468;
+
+        return days * 86400 + hour * 3600 + minute * 60 + second;
+    }
+
+private:
+    enum {
+        AttributeIDMessageSize  = 4,
+        AttributeIDDate         = 5,
+        DateLength              = 15,
+        DateSeparator           = 8,
+        DateFields              = 6
+    };
+
+    void updateText(const uint8_t* data, uint16_t length)
+    {
+        for (uint16_t index = 0; (index < length) && (position < limit) && valid; index++, position++)
+        {
+            uint8_t byte = data[index];
+            bool continuationByte = ((byte & 0xC0) == 0x80);
+
+            // an unfinished character, a stray continuation byte, or a byte
+            // that cannot start a character ends the text
+            if ((continuation > 0) != continuationByte)
+            {
+                valid = false;
+                continue;
+            }
+
+            if (continuation)
+            {
+                if (--continuation == 0)
+                {
+                    textLength = position + 1;
+                }
+
+                continue;
+            }
+
+            continuation = (byte < 0x80)           ? 0
+                         : ((byte & 0xE0) == 0xC0) ? 1
+                         : ((byte & 0xF0) == 0xE0) ? 2
+                         : ((byte & 0xF8) == 0xF0) ? 3
+                         : 0xFF;
+
+            if (continuation == 0xFF)
+            {
+                valid = false;
+            }
+            else if (continuation == 0)
+            {
+                textLength = position + 1;
+            }
+        }
+    }
+
+    void updateInteger(const uint8_t* data, uint16_t length)
+    {
+        for (uint16_t index = 0; (index < length) && valid; index++)
+        {
+            uint8_t digit = data[index] - '0';
+
+            if ((digit > 9) || (value > (0xFFFFFFFFUL - digit) / 10))
+            {
+                valid = false;
+            }
+            else
+            {
+                value = value * 10 + digit;
+            }
+        }
+    }
+
+    void updateDate(const uint8_t* data, uint16_t length)
+    {
+        for (uint16_t index = 0; (index < length) && valid; index++, position++)
+        {
+            if (position == DateSeparator)
+            {
+                valid = (data[index] == 'T');
+                continue;
+            }
+
+            uint8_t digit = data[index] - '0';
+
+            if ((digit > 9) || (position >= DateLength))
+            {
+                valid = false;
+                continue;
+            }
+
+            // yyyy MM dd T HH mm SS
+            uint8_t field = (position < 4)  ? 0
+                          : (position < 6)  ? 1
+                          : (position < 8)  ? 2
+                          : (position < 11) ? 3
+                          : (position < 13) ? 4
+                          : 5;
+
+            fields[field] = fields[field] * 10 + digit;
+        }
+    }
+
+    bool validDate() const
+    {
+        return (fields[0] >= 1970) && (fields[0] <= 2105)
+            && (fields[1] >= 1) && (fields[1] <= 12)
+            && (fields[2] >= 1) && (fields[2] <= daysInMonth(fields[0], fields[1]))
+            && (fields[3] < 24) && (fields[4] < 60) && (fields[5] <= 60);
+    }
+
+    static uint8_t daysInMonth(uint16_t year, uint16_t month)
+    {
+        static const uint8_t days[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+
+        bool leap = ((year % 4) == 0) && (((year % 100) != 0) || ((year % 400) == 0));
+
+        return ((month == 2) && leap) ? 29 : days[month - 1];
+    }
+
+private:
+    type_t type;
+    bool valid;
+    uint16_t position;
+    uint16_t limit;
+    uint32_t value;
+    uint16_t textLength;
+    uint8_t continuation;
+    uint16_t fields[DateFields];
+};
+
+#endif // __ANCS_ATTRIBUTE_DECODER_H__
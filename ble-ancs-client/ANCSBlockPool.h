@@ -0,0 +1,235 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __ANCS_BLOCK_POOL_H__
+#define __ANCS_BLOCK_POOL_H__
+
+#include "core-util/SharedPointer.h"
+
+#include "mbed-block/BlockStatic.h"
+
+using namespace mbed::util;
+
+/*
+    Fixed pool of equally sized blocks.
+
+    Blocks are handed out as SharedPointer<BlockStatic> and return to the
+    pool when the last SharedPointer is destroyed. Both the block objects
+    and their data live inside the pool, so the pool must outlive every
+    block taken from it. The pool also holds BLOCKS block objects for
+    wrapping memory owned by the caller.
+
+    Only the reference count of each SharedPointer, one word allocated by
+    core-util, still comes from the heap.
+*/
+template <uint8_t BLOCKS, uint16_t BLOCK_SIZE>
+class ANCSBlockPool
+{
+public:
+    ANCSBlockPool()
+        :   inUse(0),
+            highWaterMark(0),
+            failures(0)
+    {
+        for (uint8_t index = 0; index < BLOCKS; index++)
+        {
+            used[index] = false;
+            wrapped[index] = false;
+        }
+    }
+
+    /*
+        Get block with room for length bytes, truncated to BLOCK_SIZE.
+        Returns an empty SharedPointer when the pool is exhausted.
+    */
+    SharedPointer<BlockStatic> allocate(uint16_t length)
+    {
+        for (uint8_t index = 0; index < BLOCKS; index++)
+        {
+            if (!used[index])
+            {
+                used[index] = true;
+
+                inUse++;
+                if (inUse > highWaterMark)
+                {
+                    highWaterMark = inUse;
+                }
+
+                PooledBlock* block = new (objects[index].bytes) PooledBlock(this, index);
+                block->setLength((length < BLOCK_SIZE) ? length : BLOCK_SIZE);
+
+                return SharedPointer<BlockStatic>(block);
+            }
+        }
+
+        failures++;
+
+        return SharedPointer<BlockStatic>();
+    }
+
+    /*
+        Block object over size bytes of caller memory. Returns an empty
+        SharedPointer when every wrapper is in use.
+    */
+    SharedPointer<BlockStatic> wrap(uint8_t* data, uint16_t size)
+    {
+        for (uint8_t index = 0; index < BLOCKS; index++)
+        {
+            if (!wrapped[index])
+            {
+                wrapped[index] = true;
+
+                WrappedBlock* block = new (wrappers[index].bytes) WrappedBlock(this, index, data, size);
+
+                return SharedPointer<BlockStatic>(block);
+            }
+        }
+
+        failures++;
+
+        return SharedPointer<BlockStatic>();
+    }
+
+    /*
+        Check that count blocks are free. A refusal counts as a failure.
+    */
+    bool isAvailable(uint8_t count)
+    {
+        if (BLOCKS - inUse < count)
+        {
+            failures++;
+            return false;
+        }
+
+        return true;
+    }
+
+    uint8_t getBlocks() const
+    {
+        return BLOCKS;
+    }
+
+    uint8_t getInUse() const
+    {
+        return inUse;
+    }
+
+    uint8_t getHighWaterMark() const
+    {
+        return highWaterMark;
+    }
+
+    uint16_t getFailures() const
+    {
+        return failures;
+    }
+
+private:
+    class PooledBlock : public BlockStatic
+    {
+    public:
+        PooledBlock(ANCSBlockPool* _pool, uint8_t _index)
+            :   BlockStatic(_pool->storage[_index], BLOCK_SIZE),
+                pool(_pool),
+                index(_index)
+        {}
+
+        virtual ~PooledBlock()
+        {
+            pool->release(index);
+        }
+
+        // object memory belongs to the pool
+        static void* operator new(size_t, void* place)
+        {
+            return place;
+        }
+
+        static void operator delete(void*)
+        {
+        }
+
+        static void operator delete(void*, void*)
+        {
+        }
+
+    private:
+        ANCSBlockPool* pool;
+        uint8_t index;
+    };
+
+    class WrappedBlock : public BlockStatic
+    {
+    public:
+        WrappedBlock(ANCSBlockPool* _pool, uint8_t _index, uint8_t* data, uint16_t size)
+            :   BlockStatic(data, size),
+                pool(_pool),
+                index(_index)
+        {}
+
+        virtual ~WrappedBlock()
+        {
+            pool->wrapped[index] = false;
+        }
+
+        static void* operator new(size_t, void* place)
+        {
+            return place;
+        }
+
+        static void operator delete(void*)
+        {
+        }
+
+        static void operator delete(void*, void*)
+        {
+        }
+
+    private:
+        ANCSBlockPool* pool;
+        uint8_t index;
+    };
+
+    void release(uint8_t index)
+    {
+        used[index] = false;
+        inUse--;
+    }
+
+private:
+    union {
+        uint8_t bytes[sizeof(PooledBlock)];
+        uint32_t alignment;
+        void* pointerAlignment;
+    } objects[BLOCKS];
+
+    union {
+        uint8_t bytes[sizeof(WrappedBlock)];
+        uint32_t alignment;
+        void* pointerAlignment;
+    } wrappers[BLOCKS];
+
+    uint8_t storage[BLOCKS][BLOCK_SIZE];
+    bool used[BLOCKS];
+    bool wrapped[BLOCKS];
+
+    uint8_t inUse;
+    uint8_t highWaterMark;
+    uint16_t failures;
+};
+
+#endif // __ANCS_BLOCK_POOL_H__
@@ -0,0 +1,318 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __ANCS_CBOR_EXPORT_H__
+#define __ANCS_CBOR_EXPORT_H__
+
+#include <stdint.h>
+#include <string.h>
+
+#include "cborg/Cbor.h"
+#include "core-util/FunctionPointer.h"
+
+#include "ble-ancs-client/ANCSAttributeDecoder.h"
+
+/*
+    Encodes a notification response as one CBOR map while it is received
+    and passes the encoding to a sink in chunks:
+
+        {
+            0: notification UID,
+            1: category ID,             (when known)
+            2: event flags,             (when known)
+            3: { attribute ID: value, ... }
+        }
+
+    Attributes appear in the order received. Message Size is an integer
+    and Date the seconds since 1970 in local time; either is null if it is
+    malformed. Other attributes are text strings of indefinite length, one
+    chunk per fragment, cut after the last complete UTF-8 character so that
+    every chunk is valid on its own. The start of an unfinished character,
+    at most three bytes, waits for the next fragment; it is dropped at the
+    end of a value cut short by a maximum length.
+
+    Text is passed to the sink as a view into the received fragment, and
+    only the CBOR framing is encoded into a small scratch buffer, so memory
+    use does not depend on the length of the notification.
+*/
+class ANCSCborExport
+{
+public:
+    typedef enum {
+        ChunkData       = 0,    // more chunks follow
+        ChunkEnd        = 1,    // last chunk of the map
+        ChunkAborted    = 2     // the response failed; discard the map
+    } chunk_state_t;
+
+    typedef struct {
+        uint32_t notificationUID;
+        const uint8_t* data;    // only valid until the sink returns
+        uint16_t length;
+        uint8_t state;          // chunk_state_t
+    } Chunk_t;
+
+    enum {
+        CategoryUnknown = 0xFF
+    };
+
+    ANCSCborExport()
+        :   active(false),
+            notificationUID(0),
+            remaining(0),
+            attributeID(0),
+            attributeLength(0),
+            received(0),
+            sent(0),
+            carryLength(0)
+    {}
+
+    void setSink(mbed::util::FunctionPointer1<void, const Chunk_t*> _sink)
+    {
+        sink = _sink;
+    }
+
+    bool hasSink() const
+    {
+        return sink;
+    }
+
+    /*
+        True between begin() and the end of the map.
+    */
+    bool isActive() const
+    {
+        return active;
+    }
+
+    /*
+        Start the map of a response with the given number of attributes.
+        Category and flags are left out if categoryID is CategoryUnknown.
+    */
+    void begin(uint32_t uid, uint8_t categoryID, uint8_t eventFlags, uint8_t attributes)
+    {
+        bool known = (categoryID != CategoryUnknown);
+
+        Cbore encoder(scratch, sizeof(scratch));
+        encoder.map(known ? 4 : 2).key(0);
+
+        uint8_t length = encoder.getLength();
+        length += head(scratch + length, MajorUnsigned, uid);
+
+        Cbore rest(scratch + length, sizeof(scratch) - length);
+
+        if (known)
+        {
+            rest.key(1).value(categoryID)
+                .key(2).value(eventFlags);
+        }
+
+        rest.key(3).map(attributes);
+        length += rest.getLength();
+
+        active = (attributes > 0);
+        notificationUID = uid;
+        remaining = attributes;
+
+        emit(scratch, length, active ? ChunkData : ChunkEnd);
+    }
+
+    void attributeStarted(uint8_t _attributeID, uint16_t length)
+    {
+        attributeID = _attributeID;
+        attributeLength = length;
+        received = 0;
+        sent = 0;
+        carryLength = 0;
+
+        decoder.start(attributeID, length, length);
+
+        // numbers are only written once complete
+        if (decoder.getType() == ANCSAttributeDecoder::TypeText)
+        {
+            Cbore encoder(scratch, sizeof(scratch));
+            encoder.key(attributeID);
+
+            uint8_t header = encoder.getLength();
+            scratch[header++] = (length > 0) ? TextIndefinite : TextEmpty;
+
+            emit(scratch, header, ChunkData);
+        }
+    }
+
+    void attributeData(const uint8_t* data, uint16_t length)
+    {
+        decoder.update(data, length);
+
+        if (decoder.getType() == ANCSAttributeDecoder::TypeText)
+        {
+            // carry holds the bytes from sent up to the start of data
+            uint16_t end = decoder.getTextLength();
+            uint16_t fromCarry = ((end < received) ? end : received) - sent;
+            uint16_t fromData = (end > received) ? end - received : 0;
+
+            if ((fromCarry + fromData) > 0)
+            {
+                uint8_t header = head(scratch, MajorText, fromCarry + fromData);
+
+                memcpy(&scratch[header], carry, fromCarry);
+
+                emit(scratch, header + fromCarry, ChunkData);
+                emit(data, fromData, ChunkData);
+
+                sent = end;
+            }
+
+            // keep the start of an unfinished character
+            uint8_t kept = carryLength - fromCarry;
+            uint16_t tail = length - fromData;
+
+            memmove(carry, &carry[fromCarry], kept);
+
+            if ((kept + tail) <= sizeof(carry))
+            {
+                memcpy(&carry[kept], &data[fromData], tail);
+                carryLength = kept + tail;
+            }
+        }
+
+        received += length;
+    }
+
+    void attributeCompleted()
+    {
+        uint8_t length = 0;
+
+        if (decoder.getType() != ANCSAttributeDecoder::TypeText)
+        {
+            Cbore encoder(scratch, sizeof(scratch));
+            encoder.key(attributeID);
+
+            length = encoder.getLength();
+
+            if (decoder.isValid())
+            {
+                length += head(scratch + length, MajorUnsigned, decoder.getValue());
+            }
+            else
+            {
+                scratch[length++] = SimpleNull;
+            }
+        }
+        else if (attributeLength > 0)
+        {
+            scratch[length++] = Break;
+        }
+
+        remaining--;
+        active = (remaining > 0);
+
+        emit(scratch, length, active ? ChunkData : ChunkEnd);
+    }
+
+    /*
+        Tell the sink that the map will not be completed.
+    */
+    void abort()
+    {
+        if (active)
+        {
+            active = false;
+            emit(NULL, 0, ChunkAborted);
+        }
+    }
+
+private:
+    enum {
+        MajorUnsigned   = 0,
+        MajorText       = 3,
+        TextEmpty       = 0x60,
+        TextIndefinite  = 0x7F,
+        SimpleNull      = 0xF6,
+        Break           = 0xFF,
+        ScratchLength   = 16,
+        CarryLength     = 3
+    };
+
+    /*
+        Type and argument of a data item. Cbore only encodes signed 32-bit
+        integers and whole strings, so UIDs, numbers, and the heads of text
+        chunks are written here.
+    */
+    static uint8_t head(uint8_t* buffer, uint8_t majorType, uint32_t value)
+    {
+        majorType <<= 5;
+
+        if (value < 24)
+        {
+            buffer[0] = majorType | value;
+            return 1;
+        }
+
+        if (value <= 0xFF)
+        {
+            buffer[0] = majorType | 24;
+            buffer[1] = value;
+            return 2;
+        }
+
+        if (value <= 0xFFFF)
+        {
+            buffer[0] = majorType | 25;
+            buffer[1] = value >> 8;
+            buffer[2] = value;
+            return 3;
+        }
+
+        buffer[0] = majorType | 26;
+        buffer[1] = value >> 24;
+        buffer[2] = value >> 16;
+        buffer[3] = value >> 8;
+        buffer[4] = value;
+        return 5;
+    }
+
+    void emit(const uint8_t* data, uint16_t length, uint8_t state)
+    {
+        if (((length == 0) && (state == ChunkData)) || !sink)
+        {
+            return;
+        }
+
+        Chunk_t chunk;
+        chunk.notificationUID = notificationUID;
+        chunk.data = data;
+        chunk.length = length;
+        chunk.state = state;
+
+        sink.call(&chunk);
+    }
+
+private:
+    mbed::util::FunctionPointer1<void, const Chunk_t*> sink;
+    ANCSAttributeDecoder decoder;
+    bool active;
+    uint32_t notificationUID;
+    uint8_t remaining;          // attributes not yet completed
+    uint8_t attributeID;
+    uint16_t attributeLength;
+    uint16_t received;          // bytes of the current value
+    uint16_t sent;              // bytes of the current value passed to the sink
+    uint8_t carry[CarryLength];
+    uint8_t carryLength;
+    uint8_t scratch[ScratchLength];
+};
+
+#endif // __ANCS_CBOR_EXPORT_H__
@@ -14,6 +14,9 @@
  * limitations under the License.
  */
 
+#ifndef __ANCS_CLIENT_H__
+#define __ANCS_CLIENT_H__
+
 #include "mbed-drivers/mbed.h"
 
 #include "ble/BLE.h"
@@ -24,14 +27,235 @@
 
 #include "mbed-block/BlockDynamic.h"
 
+#include "ble-ancs-client/ANCSBlockPool.h"
+#include "ble-ancs-client/ANCSCodec.h"
+#include "ble-ancs-client/ANCSAppCache.h"
+#include "ble-ancs-client/ANCSAttributeDecoder.h"
+#include "ble-ancs-client/ANCSCborExport.h"
+#include "ble-ancs-client/ANCSHandleCache.h"
+#include "ble-ancs-client/ANCSNotificationStore.h"
+#include "ble-ancs-client/ANCSRefreshCache.h"
+#include "ble-ancs-client/ANCSResponseParser.h"
+#include "ble-ancs-client/ANCSTraceRecorder.h"
+
 using namespace mbed::util;
 
+/*
+    Attribute buffers are taken from a fixed pool owned by the client instead
+    of the heap when ANCS_CLIENT_POOL_BLOCKS is non-zero, and so are the
+    block objects around caller buffers, up to ANCS_CLIENT_POOL_BLOCKS of
+    them. Attributes longer than ANCS_CLIENT_POOL_BLOCK_SIZE are truncated.
+    The heap is then only used for the SharedPointer reference counts, one
+    word per block handed out and at most 2 * ANCS_CLIENT_POOL_BLOCKS.
+
+    A queued request reserves a block for each attribute it collects in
+    the pool, and is refused with BLE_ERROR_NO_MEM when they are taken.
+    To keep requests pipelined, size the pool for the attributes per
+    request times the requests in flight, e.g. 6 for two requests of
+    Title, Subtitle, and Message.
+*/
+#ifndef ANCS_CLIENT_POOL_BLOCKS
+#define ANCS_CLIENT_POOL_BLOCKS 0
+#endif
+
+#ifndef ANCS_CLIENT_POOL_BLOCK_SIZE
+#define ANCS_CLIENT_POOL_BLOCK_SIZE 128
+#endif
+
+/*
+    Maximum number of Control Point commands queued or awaiting a response.
+*/
+#ifndef ANCS_CLIENT_QUEUE_SIZE
+#define ANCS_CLIENT_QUEUE_SIZE 4
+#endif
+
+/*
+    Largest Control Point command. Get App Attributes commands carry the full
+    app identifier, and bundle identifiers such as com.apple.mobilephone are
+    longer than the 17 bytes left at the default ATT_MTU, so the default fits
+    one of ANCS_CLIENT_APP_IDENTIFIER_LENGTH. iOS raises the MTU on its own;
+    until it has, the stack refuses longer writes and the request fails.
+*/
+#ifndef ANCS_CLIENT_CONTROL_POINT_MAX_LENGTH
+#define ANCS_CLIENT_CONTROL_POINT_MAX_LENGTH (ANCS_CLIENT_APP_IDENTIFIER_LENGTH + 3)
+#endif
+
+/*
+    Longest app identifier that can be requested, excluding the terminator.
+*/
+#ifndef ANCS_CLIENT_APP_IDENTIFIER_LENGTH
+#define ANCS_CLIENT_APP_IDENTIFIER_LENGTH 32
+#endif
+
+/*
+    Notification attributes that can be requested, bit n for attribute ID n.
+    Requests for other attributes are refused with BLE_ERROR_INVALID_PARAM.
+*/
+#ifndef ANCS_CLIENT_ATTRIBUTE_MASK
+#define ANCS_CLIENT_ATTRIBUTE_MASK 0xFF
+#endif
+
+/*
+    Largest max length sent for Title, Subtitle, and Message; the phone
+    truncates longer values before sending them.
+*/
+#ifndef ANCS_CLIENT_ATTRIBUTE_MAX_LENGTH
+#define ANCS_CLIENT_ATTRIBUTE_MAX_LENGTH 0xFFFF
+#endif
+
+/*
+    App display names are cached in ANCS_CLIENT_APP_CACHE_SIZE bytes; 0,
+    the default, disables the cache. When ANCS_CLIENT_APP_CACHE_PERSIST
+    is set the cache is kept when the same bonded peer reconnects.
+*/
+#ifndef ANCS_CLIENT_APP_CACHE_SIZE
+#define ANCS_CLIENT_APP_CACHE_SIZE 0
+#endif
+
+#ifndef ANCS_CLIENT_APP_CACHE_PERSIST
+#define ANCS_CLIENT_APP_CACHE_PERSIST 1
+#endif
+
+/*
+    GATT handles are remembered for the last ANCS_CLIENT_HANDLE_CACHE_SIZE
+    bonded phones, shared by all clients; 0, the default, disables the
+    cache. A cached phone that reconnects skips service and characteristic
+    discovery; the three characteristic declarations are read back
+    instead. Each entry takes 26 bytes.
+*/
+#ifndef ANCS_CLIENT_HANDLE_CACHE_SIZE
+#define ANCS_CLIENT_HANDLE_CACHE_SIZE 0
+#endif
+
+/*
+    Service and characteristic discovery are retried up to
+    ANCS_CLIENT_DISCOVERY_RETRIES times. The delay before a retry starts at
+    ANCS_CLIENT_DISCOVERY_DELAY_MS and doubles up to
+    ANCS_CLIENT_DISCOVERY_DELAY_MAX_MS, with random jitter.
+*/
+#ifndef ANCS_CLIENT_DISCOVERY_RETRIES
+#define ANCS_CLIENT_DISCOVERY_RETRIES 3
+#endif
+
+#ifndef ANCS_CLIENT_DISCOVERY_DELAY_MS
+#define ANCS_CLIENT_DISCOVERY_DELAY_MS 100
+#endif
+
+#ifndef ANCS_CLIENT_DISCOVERY_DELAY_MAX_MS
+#define ANCS_CLIENT_DISCOVERY_DELAY_MAX_MS 2000
+#endif
+
+/*
+    Connection parameters offered by ANCSClient::FastConnectionParams, used
+    while attribute requests are pending, and ANCSClient::IdleConnectionParams.
+    Intervals are in units of 1.25 ms and the supervision timeout in units of
+    10 ms. The defaults meet Apple's accessory design guidelines.
+*/
+#ifndef ANCS_CLIENT_FAST_INTERVAL_MIN
+#define ANCS_CLIENT_FAST_INTERVAL_MIN 12
+#endif
+
+#ifndef ANCS_CLIENT_FAST_INTERVAL_MAX
+#define ANCS_CLIENT_FAST_INTERVAL_MAX 24
+#endif
+
+#ifndef ANCS_CLIENT_IDLE_INTERVAL_MIN
+#define ANCS_CLIENT_IDLE_INTERVAL_MIN 240
+#endif
+
+#ifndef ANCS_CLIENT_IDLE_INTERVAL_MAX
+#define ANCS_CLIENT_IDLE_INTERVAL_MAX 264
+#endif
+
+#ifndef ANCS_CLIENT_IDLE_SLAVE_LATENCY
+#define ANCS_CLIENT_IDLE_SLAVE_LATENCY 4
+#endif
+
+#ifndef ANCS_CLIENT_SUPERVISION_TIMEOUT
+#define ANCS_CLIENT_SUPERVISION_TIMEOUT 600
+#endif
+
+/*
+    Time without pending requests before the idle parameters are requested.
+*/
+#ifndef ANCS_CLIENT_IDLE_DELAY_MS
+#define ANCS_CLIENT_IDLE_DELAY_MS 2000
+#endif
+
+/*
+    Time the oldest outstanding request may go without a write response or
+    Data Source packet before it is failed with RequestStatusTimeout. The
+    BLE API 2.x does not report ATT errors, so this is the only sign that
+    the phone rejected a command.
+*/
+#ifndef ANCS_CLIENT_REQUEST_TIMEOUT_MS
+#define ANCS_CLIENT_REQUEST_TIMEOUT_MS 2000
+#endif
+
+/*
+    Number of notifications mirrored locally; 0 disables the store. Each
+    entry takes 8 bytes.
+*/
+#ifndef ANCS_CLIENT_STORE_SIZE
+#define ANCS_CLIENT_STORE_SIZE 0
+#endif
+
+/*
+    Notifications whose Message Size and Date are remembered for
+    refreshNotificationAttributes; 0, the default, disables incremental
+    refresh. Each entry takes 12 bytes.
+*/
+#ifndef ANCS_CLIENT_REFRESH_CACHE_SIZE
+#define ANCS_CLIENT_REFRESH_CACHE_SIZE 0
+#endif
+
+/*
+    Prefetches held back while the request queue is full.
+*/
+#ifndef ANCS_CLIENT_PREFETCH_BACKLOG
+#define ANCS_CLIENT_PREFETCH_BACKLOG 8
+#endif
+
+/*
+    Low priority requests written to the Control Point before their
+    responses have arrived. The phone answers in order, so this is how many
+    responses a higher priority request can have to wait for.
+*/
+#ifndef ANCS_CLIENT_LOW_PRIORITY_IN_FLIGHT
+#define ANCS_CLIENT_LOW_PRIORITY_IN_FLIGHT 1
+#endif
+
+/*
+    Notification Source events collected into one batch when coalescing.
+*/
+#ifndef ANCS_CLIENT_COALESCE_SIZE
+#define ANCS_CLIENT_COALESCE_SIZE 16
+#endif
+
+/*
+    Connection setup and request timestamps and event counters, read with
+    getStatistics. Compiled out by default, in which case the query API
+    reports zeros.
+*/
+#ifndef ANCS_CLIENT_INSTRUMENTATION
+#define ANCS_CLIENT_INSTRUMENTATION 0
+#endif
+
+/*
+    Bytes of the ring buffer that records HVX payloads, Control Point
+    writes, and link events of each client, for replay with test/replay.
+    0 compiles the recorder out.
+*/
+#ifndef ANCS_CLIENT_TRACE_SIZE
+#define ANCS_CLIENT_TRACE_SIZE 0
+#endif
+
 namespace ANCS
 {
     const UUID UUID("7905F431-B5CE-4E99-A40F-4B1E122D00D0");
 }
 
-class ANCSClient
+class ANCSClient : private ANCSResponseListener
 {
 public:
     typedef enum {
@@ -95,17 +319,246 @@ public:
         uint8_t categoryID;
         uint8_t categoryCount;
         uint32_t notificationUID;
+        Gap::Handle_t connectionHandle;
     } Notification_t;
 
+    typedef struct {
+        const Notification_t* notifications;
+        uint8_t count;
+        uint8_t received;   // events received before coalescing
+        Gap::Handle_t connectionHandle;
+    } NotificationBatch_t;
+
+    typedef struct {
+        notification_attribute_id_t attributeID;
+        uint16_t maxLength; // only sent for Title, Subtitle, and Message
+        uint8_t* buffer;    // optional; at least maxLength bytes, filled in place
+    } AttributeRequest_t;
+
+    typedef struct {
+        uint32_t notificationUID;
+        uint8_t attributeID;
+        SharedPointer<BlockStatic> data;
+        Gap::Handle_t connectionHandle;
+    } Attribute_t;
+
+    typedef struct {
+        uint32_t notificationUID;
+        uint8_t attributeID;
+        uint16_t attributeLength;
+        uint16_t offset;
+        const uint8_t* data;
+        uint16_t length;
+    } AttributeFragment_t;
+
+    typedef struct {
+        uint32_t notificationUID;
+        uint8_t attributeID;
+        uint8_t type;       // ANCSAttributeDecoder::type_t
+        bool valid;         // Message Size, Date, or UTF-8 text was well formed
+        uint32_t value;     // Message Size, or Date in seconds since 1970 (local time)
+        uint16_t length;    // text up to the last complete UTF-8 character
+        SharedPointer<BlockStatic> data; // text only
+        Gap::Handle_t connectionHandle;
+    } DecodedAttribute_t;
+
+    // CBOR encoding of a notification, see ANCSCborExport
+    typedef ANCSCborExport::Chunk_t ExportChunk_t;
+
+    typedef struct {
+        char appIdentifier[ANCS_CLIENT_APP_IDENTIFIER_LENGTH + 1];
+        uint8_t attributeID;
+        SharedPointer<BlockStatic> data;
+        Gap::Handle_t connectionHandle;
+    } AppAttribute_t;
+
+    typedef enum {
+        RequestStatusSuccess      = 0,
+        RequestStatusWriteFailed  = 1, // Control Point write could not be sent
+        RequestStatusDisconnected = 2,
+        RequestStatusMismatch     = 3, // response did not match the request
+        RequestStatusTimeout      = 4, // no progress for the request timeout
+        RequestStatusUnchanged    = 5, // refresh found nothing new; no attributes fetched
+        RequestStatusSent         = 6, // action written; the phone's outcome is unknown
+
+        // ANCS errors; BLE API 2.x reports no ATT status, so never delivered there
+        RequestStatusUnknownCommand   = 0xA0,
+        RequestStatusInvalidCommand   = 0xA1,
+        RequestStatusInvalidParameter = 0xA2,
+        RequestStatusActionFailed     = 0xA3
+    } request_status_t;
+
+    typedef struct {
+        uint32_t notificationUID; // zero for Get App Attributes
+        uint8_t status;
+        uint8_t attributesReceived;
+        uint8_t commandID;
+        Gap::Handle_t connectionHandle;
+        uint32_t durationTicks;   // Control Point write to completion; 0 if never sent
+    } RequestComplete_t;
+
+    enum {
+        PolicyCategoryAny = 0xFF
+    };
+
+    /*
+        Order in which queued requests are written to the Control Point.
+        Prefetches get the priority of their notification, see getPriority.
+    */
+    typedef enum {
+        PriorityLow     = 0,
+        PriorityNormal  = 1,
+        PriorityHigh    = 2
+    } priority_t;
+
+    /*
+        Rule for fetching attributes of new notifications automatically. A
+        rule matches when the category is equal (or the rule uses
+        PolicyCategoryAny) and (eventFlags & flagsMask) == flagsValue.
+    */
+    typedef struct {
+        uint8_t categoryID;
+        uint8_t flagsMask;
+        uint8_t flagsValue;
+        const AttributeRequest_t* attributes; // NULL to fetch nothing
+        uint8_t count;
+    } FetchPolicy_t;
+
+    typedef enum {
+        DiscoveryStageNone            = 0,
+        DiscoveryStageService         = 1,
+        DiscoveryStageCharacteristics = 2,
+        DiscoveryStageDescriptors     = 3
+    } discovery_stage_t;
+
+    typedef struct {
+        uint8_t stage;      // discovery_stage_t that failed
+        uint8_t attempts;
+        Gap::Handle_t connectionHandle;
+    } DiscoveryFailure_t;
+
+    typedef struct {
+        uint8_t blocks;
+        uint8_t inUse;
+        uint8_t highWaterMark;
+        uint16_t failures;
+    } PoolStatistics_t;
+
+    typedef struct {
+        uint32_t probes;        // Message Size and Date fetched
+        uint32_t fetches;       // full fetches after a change or for an unknown notification
+        uint32_t skipped;       // full fetches avoided
+        uint32_t probeBytes;    // Data Source bytes of all probes
+        uint32_t bytesSaved;    // last full fetch minus probe, for each skipped fetch
+    } RefreshStatistics_t;
+
+    typedef enum {
+        LinkModeDefault = 0,    // parameters chosen by the phone
+        LinkModeFast    = 1,
+        LinkModeIdle    = 2
+    } link_mode_t;
+
+    typedef struct {
+        uint8_t mode;                               // link_mode_t last requested
+        Gap::ConnectionParams_t connectionParams;   // at connection, then as last requested
+        uint16_t updateRequests;
+        uint16_t updateFailures;                    // requests the stack refused
+        uint16_t maxPayload;                        // largest Data Source notification; ATT MTU - 3
+        uint16_t transfers;                         // attribute requests completed successfully, not counting probes
+        uint32_t transferBytes;                     // Data Source bytes received
+        uint32_t lastTransferTicks;
+        uint32_t maxTransferTicks;
+        uint32_t totalTransferTicks;
+        uint32_t fastTicks;                         // time spent with fast parameters requested
+    } LinkStatistics_t;
+
+    typedef enum {
+        SetupStageServiceFound          = 0,
+        SetupStageLinkSecured           = 1,
+        SetupStageCharacteristicsFound  = 2,    // from discovery or the handle cache
+        SetupStageSubscribed            = 3,    // both subscriptions confirmed
+        SetupStageCount                 = 4
+    } setup_stage_t;
+
+    typedef enum {
+        RequestStageFirstFragment       = 0,    // Control Point write to first Data Source packet
+        RequestStageLastFragment        = 1,    // first to last Data Source packet
+        RequestStageDispatched          = 2,    // last packet to completion callback posted
+        RequestStageCount               = 3
+    } request_stage_t;
+
+    typedef struct {
+        uint32_t count;
+        uint32_t lastTicks;
+        uint32_t maxTicks;
+        uint32_t totalTicks;
+    } StageTiming_t;
+
+    typedef struct {
+        uint8_t setupReached;                           // bit n for setup_stage_t n
+        uint32_t setupTicks[SetupStageCount];           // since the connection
+        StageTiming_t requestStages[RequestStageCount]; // successful attribute requests
+        uint32_t bytesReceived;                         // Notification Source and Data Source
+        uint32_t fragments;                             // Data Source packets
+        uint32_t notifications;                         // Notification Source events
+        uint32_t silentEvents;
+        uint32_t droppedEvents;                         // Notification Source packets too short
+        uint32_t droppedResponses;                      // Data Source responses not matching a request
+        uint32_t retries;                               // discovery and subscription retries
+        uint32_t allocationFailures;                    // attribute buffers and pool reservations
+    } Statistics_t;
+
+    enum {
+        // longest getStatisticsSnapshot encoding
+        StatisticsSnapshotLength = 144
+    };
+
+    /*
+        Defaults for setConnectionParams, from the ANCS_CLIENT_*_INTERVAL
+        configuration.
+    */
+    static const Gap::ConnectionParams_t FastConnectionParams;
+    static const Gap::ConnectionParams_t IdleConnectionParams;
+
+    /*
+        Each client serves one connection. Construct one client per phone
+        that should be served at the same time; clients register themselves
+        with the ANCSDispatcher, which routes BLE events by connection handle.
+    */
     ANCSClient();
+    virtual ~ANCSClient();
+
+    /*
+        Returns BLE_ERROR_NO_MEM when ANCS_CLIENT_MAX_CONNECTIONS clients
+        were already constructed; this client then gets no BLE events.
+    */
+    ble_error_t init();
+
+    bool isConnected() const
+    {
+        return connected;
+    }
+
+    Gap::Handle_t getConnectionHandle() const
+    {
+        return connectionHandle;
+    }
 
-    void init();
+    /*
+        True once both subscriptions are confirmed by the phone.
+    */
+    bool isReady() const
+    {
+        return (state & (FLAG_NOTIFICATION_CONFIRMED | FLAG_DATA_CONFIRMED)) == (FLAG_NOTIFICATION_CONFIRMED | FLAG_DATA_CONFIRMED);
+    }
 
     void onConnection(const Gap::ConnectionCallbackParams_t* params);
     void onDisconnection(const Gap::DisconnectionCallbackParams_t* params);
 
     /*
-        Register callback for when the ANCS is found.
+        Register callback for when the ANCS is ready: it has been found and
+        the phone has confirmed both the Notification Source and the Data
+        Source subscriptions.
     */
     void registerServiceFoundHandlerTask(FunctionPointer0<void> callback)
     {
@@ -119,6 +572,30 @@ public:
         serviceFoundHandler = callback;
     }
 
+    /*
+        Register callback for when ANCS could not be discovered within the
+        retry budget. The connection is left open.
+    */
+    void registerDiscoveryFailedHandlerTask(FunctionPointer1<void, DiscoveryFailure_t> callback)
+    {
+        discoveryFailedHandler = callback;
+    }
+
+    template <typename T>
+    void registerDiscoveryFailedHandlerTask(T* object, void (T::*member)(DiscoveryFailure_t))
+    {
+        FunctionPointer1<void, DiscoveryFailure_t> callback(object, member);
+        discoveryFailedHandler = callback;
+    }
+
+    /*
+        Set the discovery retry budget and backoff, replacing the
+        ANCS_CLIENT_DISCOVERY_* defaults. Takes effect on the next stage.
+    */
+    void setDiscoveryRetry(uint8_t retries,
+                           uint16_t delayMs = ANCS_CLIENT_DISCOVERY_DELAY_MS,
+                           uint16_t delayMaxMs = ANCS_CLIENT_DISCOVERY_DELAY_MAX_MS);
+
     /*
         Register callback for when notifications are received.
     */
@@ -134,6 +611,40 @@ public:
         notificationHandler = callback;
     }
 
+    /*
+        Register callback for batches of coalesced notification events. The
+        batch is only valid until the callback returns.
+    */
+    void registerNotificationBatchHandler(FunctionPointer1<void, const NotificationBatch_t*> callback)
+    {
+        batchHandler = callback;
+    }
+
+    template <typename T>
+    void registerNotificationBatchHandler(T* object, void (T::*member)(const NotificationBatch_t*))
+    {
+        FunctionPointer1<void, const NotificationBatch_t*> callback(object, member);
+        batchHandler = callback;
+    }
+
+    /*
+        Collect Notification Source events for up to windowMs, or until
+        maxEvents distinct notifications are pending, and deliver them as
+        one batch from a single scheduler callback. Added, Modified, and
+        Removed events for the same UID are collapsed; a notification added
+        and removed within the window is not delivered at all. The batch
+        handler receives the batch, then the notification handler and the
+        fetch policy are applied to each event in it. With deferPreExisting
+        set, pre-existing notifications are placed after live ones. New
+        notifications that arrive while a full batch waits for its callback
+        are delivered on their own, after it.
+
+        A window of 0 disables coalescing (the default).
+    */
+    void setCoalescing(uint16_t windowMs,
+                       uint8_t maxEvents = ANCS_CLIENT_COALESCE_SIZE,
+                       bool deferPreExisting = false);
+
     /*
         Register callback for when data is received.
     */
@@ -149,52 +660,695 @@ public:
         dataHandler = callback;
     }
 
+    /*
+        Register callback for when a notification attribute is received.
+        The callback is called once per attribute, as soon as it is complete.
+    */
+    void registerAttributeHandlerTask(FunctionPointer1<void, Attribute_t> callback)
+    {
+        attributeHandler = callback;
+    }
+
+    template <typename T>
+    void registerAttributeHandlerTask(T* object, void (T::*member)(Attribute_t))
+    {
+        FunctionPointer1<void, Attribute_t> callback(object, member);
+        attributeHandler = callback;
+    }
+
+    /*
+        Register callback for attribute data as it arrives. The callback is
+        called directly from the GATT event with a read-only view into the
+        received packet, which is only valid until the callback returns.
+
+        While this handler is set no attribute buffers are allocated; only
+        attributes requested with a caller buffer are passed to the
+        attribute handler.
+    */
+    void registerAttributeFragmentHandler(FunctionPointer1<void, const AttributeFragment_t*> callback)
+    {
+        fragmentHandler = callback;
+    }
+
+    template <typename T>
+    void registerAttributeFragmentHandler(T* object, void (T::*member)(const AttributeFragment_t*))
+    {
+        FunctionPointer1<void, const AttributeFragment_t*> callback(object, member);
+        fragmentHandler = callback;
+    }
+
+    /*
+        Register callback for decoded notification attributes. Values are
+        decoded while the fragments are parsed: Message Size becomes an
+        integer, Date the seconds since 1970, and text is trimmed to whole
+        UTF-8 characters. Posted before the attribute handler, and also
+        for Message Size and Date while a fragment handler is set. Text is
+        only posted when it is buffered, so not while it is streamed.
+    */
+    void registerDecodedAttributeHandlerTask(FunctionPointer1<void, DecodedAttribute_t> callback)
+    {
+        decodedAttributeHandler = callback;
+    }
+
+    template <typename T>
+    void registerDecodedAttributeHandlerTask(T* object, void (T::*member)(DecodedAttribute_t))
+    {
+        FunctionPointer1<void, DecodedAttribute_t> callback(object, member);
+        decodedAttributeHandler = callback;
+    }
+
+    /*
+        Register a sink for notifications encoded as CBOR, e.g. to forward
+        them over a UART. Each Get Notification Attributes response becomes
+        one map with the UID, category, flags, and attributes, encoded while
+        the fragments are parsed; see ANCSCborExport for the layout. The
+        sink is called directly from the GATT event, and text is a view
+        into the received packet, only valid until the sink returns. The
+        last chunk of a map is marked ChunkEnd, or ChunkAborted if the
+        response failed halfway.
+
+        Category and flags are included for prefetched notifications and
+        those in the notification store. As with the fragment handler, no
+        attribute buffers are allocated while the sink is set.
+    */
+    void registerExportSink(FunctionPointer1<void, const ExportChunk_t*> sink)
+    {
+        exporter.setSink(sink);
+    }
+
+    template <typename T>
+    void registerExportSink(T* object, void (T::*member)(const ExportChunk_t*))
+    {
+        FunctionPointer1<void, const ExportChunk_t*> sink(object, member);
+        exporter.setSink(sink);
+    }
+
+    /*
+        Register callback for when an app attribute is received.
+    */
+    void registerAppAttributeHandlerTask(FunctionPointer1<void, AppAttribute_t> callback)
+    {
+        appAttributeHandler = callback;
+    }
+
+    template <typename T>
+    void registerAppAttributeHandlerTask(T* object, void (T::*member)(AppAttribute_t))
+    {
+        FunctionPointer1<void, AppAttribute_t> callback(object, member);
+        appAttributeHandler = callback;
+    }
+
     /*
         Get notification attribute.
     */
-    void getNotificationAttribute(uint32_t notificationUID, notification_attribute_id_t, uint16_t length = 0);
+    ble_error_t getNotificationAttribute(uint32_t notificationUID, notification_attribute_id_t, uint16_t length = 0);
+
+    /*
+        Get several notification attributes using a single Control Point write.
+        The response is parsed as it arrives and each attribute is passed to
+        the attribute handler (and the data handler) when it is complete.
+        Attributes with a caller buffer are written straight into it without
+        an intermediate copy; the buffer must stay valid until delivered.
+        A caller buffer with a maxLength of zero is refused with
+        BLE_ERROR_INVALID_PARAM.
+
+        Requests are queued and the next command is written as soon as the
+        previous write has completed, without waiting for its response. The
+        optional callback is called when the request completes or fails.
+
+        Returns BLE_ERROR_NO_MEM when the queue is full or the buffer pool
+        cannot hold the response; try again once earlier requests complete.
+        A request needing more pool blocks than ANCS_CLIENT_POOL_BLOCKS could
+        never be sent and is refused with BLE_ERROR_PARAM_OUT_OF_RANGE.
+
+        Requests of higher priority are written before queued ones of lower
+        priority. Only ANCS_CLIENT_LOW_PRIORITY_IN_FLIGHT low priority
+        requests are written ahead of their responses, and they cannot take
+        the last free queue slot.
+    */
+    ble_error_t getNotificationAttributes(uint32_t notificationUID,
+                                          const AttributeRequest_t* attributes,
+                                          uint8_t count,
+                                          FunctionPointer1<void, RequestComplete_t> callback = FunctionPointer1<void, RequestComplete_t>(),
+                                          priority_t priority = PriorityNormal);
+
+    /*
+        Get notification attributes again after a Modified event, but only
+        if the notification has changed. Message Size and Date are fetched
+        first and compared with their values at the last refresh of the
+        same notification; the attributes are then fetched as with
+        getNotificationAttributes, or the callback gets
+        RequestStatusUnchanged and nothing more is sent. The first refresh
+        of a notification always fetches.
+
+        Falls back to getNotificationAttributes when the refresh cache or
+        either attribute is disabled.
+    */
+    ble_error_t refreshNotificationAttributes(uint32_t notificationUID,
+                                              const AttributeRequest_t* attributes,
+                                              uint8_t count,
+                                              FunctionPointer1<void, RequestComplete_t> callback = FunctionPointer1<void, RequestComplete_t>(),
+                                              priority_t priority = PriorityNormal);
+
+    /*
+        Perform the positive or negative action of a notification, e.g.
+        accept or decline a call. The command shares the request queue with
+        attribute requests at high priority, and is written without response
+        when the Control Point allows it. The callback gets RequestStatusSent
+        as soon as the command is sent, or once the phone answers a write
+        with response. The BLE API 2.x write callback carries no ATT status,
+        so the ANCS errors 0xA0 to 0xA3 cannot be delivered and a failed
+        action is not told apart from a performed one. Notifications known
+        to the store must offer the action, or BLE_ERROR_INVALID_PARAM is
+        returned.
+    */
+    ble_error_t performNotificationAction(uint32_t notificationUID,
+                                          action_id_t actionID,
+                                          FunctionPointer1<void, RequestComplete_t> callback = FunctionPointer1<void, RequestComplete_t>());
+
+    /*
+        Replace ANCS_CLIENT_REQUEST_TIMEOUT_MS. Zero disables the timeout.
+    */
+    void setRequestTimeout(uint16_t timeoutMs);
+
+    /*
+        Get attributes for the app with the given NUL-terminated identifier.
+        Attributes are passed to the app attribute handler. Requests share the
+        queue with notification attribute requests.
+    */
+    ble_error_t getAppAttributes(const char* appIdentifier,
+                                 const app_attribute_id_t* attributes,
+                                 uint8_t count,
+                                 FunctionPointer1<void, RequestComplete_t> callback = FunctionPointer1<void, RequestComplete_t>());
+
+    /*
+        Get the display name of an app. Cached names are passed to the app
+        attribute handler without any BLE traffic; otherwise the name is
+        requested from the phone and added to the cache.
+    */
+    ble_error_t getAppDisplayName(const char* appIdentifier,
+                                  FunctionPointer1<void, RequestComplete_t> callback = FunctionPointer1<void, RequestComplete_t>());
+
+    /*
+        Copy a cached display name into buffer, without a terminator. Returns
+        the length of the name, or -1 if it is not cached.
+    */
+    int16_t lookupAppDisplayName(const char* appIdentifier, uint8_t* buffer, uint16_t length);
+
+    void clearAppCache();
+
+    /*
+        Forget the GATT handles of all phones, e.g. when bonds are deleted.
+        Phones using resolvable private addresses are only recognized while
+        their address stays the same.
+    */
+    static void clearHandleCache();
+
+    /*
+        Set the rules for prefetching attributes. For each added notification
+        the first matching rule is applied, and the attributes are passed to
+        the attribute handler as if requested with getNotificationAttributes.
+        Prefetches that do not fit in the request queue are held back and
+        sent as requests complete, highest priority first; when the backlog
+        is full, the newest prefetch of the lowest priority is dropped. The
+        table is not copied and must stay valid; pass NULL to disable
+        prefetching.
+    */
+    void setFetchPolicy(const FetchPolicy_t* policy,
+                        uint8_t count,
+                        FunctionPointer1<void, RequestComplete_t> callback = FunctionPointer1<void, RequestComplete_t>());
+
+    /*
+        Priority of fetching a notification's attributes: high for incoming
+        calls and important notifications, low for pre-existing ones, which
+        arrive in a burst after connecting, and normal otherwise. An
+        incoming call is high priority even when pre-existing.
+    */
+    static priority_t getPriority(const Notification_t& notification);
+
+    /*
+        Number of requests queued or awaiting a response.
+    */
+    uint8_t getPendingRequests() const
+    {
+        return requestCount;
+    }
+
+    /*
+        Look up a notification in the local store, which follows every Added,
+        Modified, and Removed event including silent ones. The eventID is the
+        last event applied and categoryCount is the number of stored
+        notifications in the same category. Returns false if not stored.
+    */
+    bool findNotification(uint32_t notificationUID, Notification_t* notification) const;
+
+    /*
+        Iterate the store by slot, from 0 to getNotificationCapacity() - 1.
+        Returns false for empty slots.
+    */
+    bool getNotificationAt(uint16_t slot, Notification_t* notification) const;
+
+    uint16_t getNotificationCapacity() const;
+    uint16_t getNotificationCount() const;
+    uint16_t getCategoryCount(category_id_t categoryID) const;
+
+    /*
+        Get usage of the attribute buffer pool. All zero when the pool is disabled.
+    */
+    PoolStatistics_t getPoolStatistics() const;
+
+    /*
+        Get the counts of refreshNotificationAttributes. All zero when the
+        refresh cache is disabled.
+    */
+    RefreshStatistics_t getRefreshStatistics() const;
+
+    /*
+        Ask the phone for the fast connection parameters when a request is
+        queued, and for the idle parameters once no requests have been
+        pending for idleDelayMs. The phone may refuse or adjust them. The
+        structures are copied; pass NULL as fast to stop negotiating, or
+        NULL as idle to keep the fast parameters. Disabled by default.
+
+        The BLE API offers no ATT MTU exchange; iOS starts one itself, and
+        the resulting payload size is reported in LinkStatistics_t.
+    */
+    void setConnectionParams(const Gap::ConnectionParams_t* fast,
+                             const Gap::ConnectionParams_t* idle,
+                             uint16_t idleDelayMs = ANCS_CLIENT_IDLE_DELAY_MS);
+
+    /*
+        Get the requested connection parameters and attribute transfer
+        timing. Times are in scheduler ticks.
+    */
+    LinkStatistics_t getLinkStatistics() const;
+    void resetLinkStatistics();
+
+    /*
+        Get the setup timing of the current or last connection and the
+        request timing and event counters since the last reset. Times are
+        in scheduler ticks. All zero when ANCS_CLIENT_INSTRUMENTATION is 0.
+    */
+    Statistics_t getStatistics() const;
+
+    /*
+        Clear the request timing and counters. Setup timing is kept until
+        the next connection.
+    */
+    void resetStatistics();
+
+    /*
+        Encode getStatistics as a CBOR map with integer keys, in the order
+        of the Statistics_t members starting at 0. Stage timings are arrays
+        of count, last, max, and total. Values above 2^31 - 1 are clamped.
+        Returns the length, or 0 if buffer holds fewer than
+        StatisticsSnapshotLength bytes or instrumentation is disabled.
+    */
+    uint32_t getStatisticsSnapshot(uint8_t* buffer, uint32_t length) const;
+
+    /*
+        Copy the recorded trace, oldest record first, in the format of
+        ANCSTraceRecorder. Returns the bytes copied, which are whole records
+        only, or 0 when ANCS_CLIENT_TRACE_SIZE is 0.
+    */
+    uint16_t getTrace(uint8_t* buffer, uint16_t length) const;
+    void clearTrace();
 
     void serviceDiscoveryCallback(const DiscoveredService*);
     void characteristicDiscoveryCallback(const DiscoveredCharacteristic*);
+    void descriptorDiscoveryCallback(const CharacteristicDescriptorDiscovery::DiscoveryCallbackParams_t* params);
+    void descriptorDiscoveryTermination(const CharacteristicDescriptorDiscovery::TerminationCallbackParams_t* params);
     void discoveryTerminationCallback(Gap::Handle_t);
     void hvxCallback(const GattHVXCallbackParams* params);
+    void dataWritten(const GattWriteCallbackParams* params);
+    void dataRead(const GattReadCallbackParams* params);
     void linkSecured(Gap::Handle_t, SecurityManager::SecurityMode_t);
+    void dataSent(unsigned count);
+
+    /*
+        Called when another connection has finished service discovery.
+    */
+    void discoveryIdle();
+
+protected:
+    /*
+        Send command to the Control Point. Without response, dataWritten is
+        not called. Overridden by test harnesses.
+    */
+    virtual ble_error_t writeControlPoint(const uint8_t* payload, uint8_t length, bool withResponse);
+
+    /*
+        Read an attribute from the phone; the value is passed to dataRead.
+        Overridden by test harnesses.
+    */
+    virtual ble_error_t readAttribute(GattAttribute::Handle_t handle);
+
+    /*
+        Find the descriptors of a characteristic; results are passed to
+        descriptorDiscoveryCallback and descriptorDiscoveryTermination.
+        Overridden by test harnesses.
+    */
+    virtual ble_error_t discoverDescriptors(const DiscoveredCharacteristic& characteristic);
+
+    /*
+        Stop descriptor discovery once the CCCD is found. Overridden by test
+        harnesses.
+    */
+    virtual void terminateDescriptorDiscovery(const DiscoveredCharacteristic& characteristic);
+
+    /*
+        Look for the ANCS service, or for its characteristics when
+        characteristics is set. Results are passed through the
+        ANCSDispatcher to serviceDiscoveryCallback or
+        characteristicDiscoveryCallback, and the end of discovery to
+        discoveryTerminationCallback. Overridden by test harnesses.
+    */
+    virtual ble_error_t launchServiceDiscovery(bool characteristics);
+
+    /*
+        Service discovery is shared by all connections. Overridden by test
+        harnesses.
+    */
+    virtual bool isServiceDiscoveryActive();
+    virtual void terminateServiceDiscovery();
+
+    /*
+        Encryption state of the link, and a request to encrypt it; success
+        is reported to linkSecured. Overridden by test harnesses.
+    */
+    virtual SecurityManager::LinkSecurityStatus_t getLinkSecurity();
+    virtual ble_error_t setLinkSecurity(SecurityManager::SecurityMode_t mode);
+
+    /*
+        Whether the phone is in the bond table, so that its handles can be
+        cached. Encryption alone does not mean the keys were stored.
+        Overridden by test harnesses.
+    */
+    virtual bool isBonded();
+
+    /*
+        Write a descriptor with response; the response is passed to
+        dataWritten. Overridden by test harnesses.
+    */
+    virtual ble_error_t writeDescriptor(GattAttribute::Handle_t handle, uint16_t value);
+
+    /*
+        Request new connection parameters from the phone. Overridden by
+        test harnesses.
+    */
+    virtual ble_error_t updateConnectionParams(const Gap::ConnectionParams_t* params);
 
 private:
+    typedef ANCSCodec<ANCS_CLIENT_CONTROL_POINT_MAX_LENGTH,
+                      ANCS_CLIENT_ATTRIBUTE_MASK,
+                      ANCS_CLIENT_ATTRIBUTE_MAX_LENGTH> Codec;
+
+    typedef enum {
+        REQUEST_QUEUED,
+        REQUEST_WRITING,
+        REQUEST_SENT,
+        REQUEST_DONE
+    } request_state_t;
+
+    typedef enum {
+        REFRESH_NONE,
+        REFRESH_PROBE,          // Message Size and Date only
+        REFRESH_FETCH           // attributes after the probe found a change
+    } refresh_t;
+
+    typedef struct {
+        uint8_t attributeID;
+    } AppAttributeRequest_t;
+
+    typedef struct {
+        uint8_t state;
+        uint8_t command;
+        uint8_t count;
+        uint8_t pendingMask;    // one bit per attribute ID not yet received
+        uint8_t received;
+        uint8_t blocksReserved;
+        uint32_t notificationUID;
+        uint8_t actionID;
+        uint8_t priority;
+        uint8_t categoryID;     // for the export, if known
+        uint8_t eventFlags;
+        uint8_t refresh;
+        uint32_t fingerprint;   // of the probe response
+        uint16_t responseBytes;
+        uint32_t sentAt;
+#if ANCS_CLIENT_INSTRUMENTATION
+        uint32_t firstFragmentAt;
+#endif
+        // a request is for either notification or app attributes
+        union {
+            AttributeRequest_t attributes[NotificationAttributeIDNegativeActionLabel + 1];
+            struct {
+                AppAttributeRequest_t attributes[AppAttributeIDDisplayName + 1];
+                char identifier[ANCS_CLIENT_APP_IDENTIFIER_LENGTH + 1];
+            } app;
+        };
+        FunctionPointer1<void, RequestComplete_t> callback;
+    } Request_t;
 
     typedef enum {
         FLAG_NOTIFICATION           = 0x01,
         FLAG_CONTROL                = 0x02,
         FLAG_DATA                   = 0x04,
         FLAG_ENCRYPTION             = 0x08,
-        FLAG_NOTIFICATION_SUBSCRIBE = 0x10,
-        FLAG_DATA_SUBSCRIBE         = 0x20
+        FLAG_NOTIFICATION_SUBSCRIBE = 0x10,     // CCCD write sent
+        FLAG_DATA_SUBSCRIBE         = 0x20,
+        FLAG_SUBSCRIBING            = 0x40,
+        FLAG_DESCRIPTORS            = 0x80,     // CCCD handles known
+        FLAG_NOTIFICATION_CONFIRMED = 0x100,    // CCCD write response received
+        FLAG_DATA_CONFIRMED         = 0x200
     } flags_t;
 
     void secureConnection();
-    void startServiceDiscovery();
-    void startCharacteristicDiscovery();
+    void beginDiscovery(uint8_t stage);
+    void startDiscovery();
+    void retryDiscovery();
+    uint16_t backoffDelay();
+    void scheduleDiscovery(uint16_t delayMs);
+    void discoveryTimeout(uint8_t generation);
+    void descriptorsFound();
     void subscribe();
-    void dataSent(unsigned count);
+    void subscriptionConfirmed(uint16_t flag);
+    void serviceReady();
+    void validateHandles();
+    void readDeclaration();
+    void validationTimeout(Gap::Handle_t handle);
+    void handlesValidated(bool valid);
+
+    ble_error_t requestAttributes(uint32_t notificationUID,
+                                  const AttributeRequest_t* attributes,
+                                  uint8_t count,
+                                  FunctionPointer1<void, RequestComplete_t> callback,
+                                  uint8_t priority,
+                                  uint8_t refresh,
+                                  uint32_t fingerprint,
+                                  uint8_t categoryID,
+                                  uint8_t eventFlags);
+    uint8_t blocksNeeded(const AttributeRequest_t* attributes, uint8_t count) const;
+    void refreshProbed(Request_t* probe);
+    void refreshFetched(const Request_t* request);
+    Request_t* freeRequest(uint8_t priority);
+    ble_error_t queueRequest(Request_t* request);
+    Request_t* promoteRequest();
+    bool mayWrite(const Request_t* request) const;
+    ble_error_t sendRequest(Request_t* request);
+    void sendNextRequest();
+    Request_t* findRequest(uint8_t command, uint32_t notificationUID, const char* appIdentifier);
+    bool matchRequest(uint8_t command, uint32_t notificationUID, const char* appIdentifier);
+    bool sentWithoutResponse(const Request_t* request) const;
+    void completeRequest(Request_t* request, uint8_t status);
+    void failRequests(uint8_t status);
+    void requestActivity();
+    void armRequestTimer(uint32_t delay);
+    void requestTimeout(uint8_t generation);
+    void markStale(const Request_t* request);
+    uint8_t drainStale(uint8_t command, uint32_t notificationUID, const char* appIdentifier);
+    void recordSetupStage(uint8_t stage);
+    void recordRequestStages(const Request_t* request);
+    void traceEvent(uint8_t type, const uint8_t* data, uint16_t length);
+
+    // Data Source responses from the parser
+    virtual bool responseStarted(uint8_t commandID, uint32_t notificationUID, const char* appIdentifier);
+    virtual bool attributeStarted(uint8_t attributeID, uint16_t length);
+    virtual void attributeData(const uint8_t* data, uint16_t length, uint16_t offset);
+    virtual bool attributeCompleted();
+    void appAttributeComplete();
+    bool startsResponse(const uint8_t* data, uint16_t length);
+    void dropResponse();
+    void resetDataSource();
+    void updateStore(const Notification_t& event);
+    void prefetch(const Notification_t& event);
+    void deliverNotification(const Notification_t& event, bool direct);
+    void coalesce(const Notification_t& event);
+    void batchTimeout();
+    void deliverUnbatched(Notification_t event);
+    void flushBatch();
+    void processPrefetch();
+    void requestLinkMode(uint8_t mode);
+    void linkIdleTimeout(uint8_t generation);
+    SharedPointer<BlockStatic> allocateBlock(uint16_t length);
+    SharedPointer<BlockStatic> selectBlock(uint8_t id, uint16_t length);
 
 private:
-    uint8_t state;
+    uint16_t state;
 
+    bool attached;
+    bool connected;
     Gap::Handle_t connectionHandle;
+    uint8_t peerAddrType;
+    uint8_t peerAddr[6];
     FunctionPointer0<void> serviceFoundHandler;
+    FunctionPointer1<void, DiscoveryFailure_t> discoveryFailedHandler;
+
+    // discovery stage in progress and its retry budget
+    uint8_t discoveryStage;
+    bool discoveryRunning;
+    bool discoveryDeferred;
+    uint8_t discoveryRetries;
+    uint16_t discoveryDelay;
+    uint16_t discoveryDelayMax;
+    uint8_t discoveryRetriesLeft;
+    uint8_t discoveryAttempts;
+    uint8_t discoveryGeneration;
+    uint32_t jitter;
+
+    // ANCS characteristics, from discovery or from the handle cache
+    GattAttribute::Handle_t notificationSourceDeclaration;
+    GattAttribute::Handle_t notificationSource;
+    GattAttribute::Handle_t notificationSourceCCCD;
+    GattAttribute::Handle_t controlPointDeclaration;
+    GattAttribute::Handle_t controlPoint;
+    bool controlPointWriteCommand;
+    GattAttribute::Handle_t dataSourceDeclaration;
+    GattAttribute::Handle_t dataSource;
+    GattAttribute::Handle_t dataSourceCCCD;
+
+    // connection parameter negotiation
+    bool linkTuning;
+    bool linkIdle;
+    Gap::ConnectionParams_t fastParams;
+    Gap::ConnectionParams_t idleParams;
+    uint16_t linkIdleDelay;
+    uint8_t linkGeneration;
+    uint32_t fastSince;
+    LinkStatistics_t linkStatistics;
+
+#if ANCS_CLIENT_INSTRUMENTATION
+    uint32_t connectedAt;
+    Statistics_t statistics;
+#endif
+
+#if ANCS_CLIENT_TRACE_SIZE > 0
+    ANCSTraceRecorder<ANCS_CLIENT_TRACE_SIZE> trace;
+    uint32_t traceTime;
+#endif
+
+    // kept for descriptor discovery
+    DiscoveredCharacteristic notificationSourceCharacteristic;
+    DiscoveredCharacteristic dataSourceCharacteristic;
 
-    uint8_t findService;
-    uint8_t findCharacteristics;
-    DiscoveredCharacteristic notificationSource;
-    DiscoveredCharacteristic controlPoint;
-    DiscoveredCharacteristic dataSource;
+#if ANCS_CLIENT_HANDLE_CACHE_SIZE > 0
+    // cached handles being checked against the phone
+    ANCSHandleCache<ANCS_CLIENT_HANDLE_CACHE_SIZE>::Entry_t cachedHandles;
+    bool validatingHandles;
+    uint8_t validationStep;     // declaration being read back
+#endif
 
     FunctionPointer1<void, Notification_t> notificationHandler;
+    FunctionPointer1<void, const NotificationBatch_t*> batchHandler;
 
-    // variables for assembling data fragments
-    uint16_t expectedLength;
-    uint16_t dataLength;
-    uint16_t dataOffset;
-    SharedPointer<BlockStatic> dataPayload;
+    // Notification Source events waiting to be delivered as a batch
+    Notification_t batch[ANCS_CLIENT_COALESCE_SIZE];
+    uint8_t batchCount;
+    uint8_t batchReceived;
+    bool batchPosted;
+    bool batchTimerPending;
+    minar::callback_handle_t batchTimer;
+    uint16_t coalesceWindow;
+    uint8_t coalesceMaxEvents;
+    bool deferPreExisting;
+
+    // ring buffer of requests in the order they are sent; requests not yet
+    // written follow the others, highest priority first
+    Request_t requestQueue[ANCS_CLIENT_QUEUE_SIZE];
+    uint8_t requestHead;
+    uint8_t requestCount;
+    bool writeInProgress;
+
+    // the oldest outstanding request fails when nothing arrives in time
+    uint16_t requestTimeoutMs;
+    uint32_t lastRequestActivity;
+    uint8_t requestGeneration;
+    bool requestTimerPending;
+
+    // requests that timed out before their response started, oldest first;
+    // a late response is skipped instead of being taken for a later request
+    typedef struct {
+        uint8_t command;
+        uint8_t count;          // attributes requested
+        uint32_t key;           // notification UID, or hash of the app identifier
+    } StaleRequest_t;
+
+    StaleRequest_t staleRequests[ANCS_CLIENT_QUEUE_SIZE];
+    uint8_t staleCount;
+
+    // attribute responses spanning several fragments
+    ANCSResponseParser<ANCS_CLIENT_APP_IDENTIFIER_LENGTH> parser;
+    Request_t* parseRequest;
+    SharedPointer<BlockStatic> attributePayload;
     FunctionPointer1<void, SharedPointer<BlockStatic> > dataHandler;
+    FunctionPointer1<void, Attribute_t> attributeHandler;
+    FunctionPointer1<void, const AttributeFragment_t*> fragmentHandler;
+    FunctionPointer1<void, AppAttribute_t> appAttributeHandler;
+    FunctionPointer1<void, DecodedAttribute_t> decodedAttributeHandler;
+    ANCSAttributeDecoder decoder;
+    bool decoding;
+    ANCSCborExport exporter;
+
+#if ANCS_CLIENT_POOL_BLOCKS > 0
+    ANCSBlockPool<ANCS_CLIENT_POOL_BLOCKS, ANCS_CLIENT_POOL_BLOCK_SIZE> pool;
+    uint8_t poolReserved;
+#endif
+
+#if ANCS_CLIENT_APP_CACHE_SIZE > 0
+    ANCSAppCache<ANCS_CLIENT_APP_CACHE_SIZE> appCache;
+
+    // peer the cache was filled from
+    uint8_t appCachePeerType;
+    uint8_t appCachePeer[6];
+    bool appCacheBonded;
+#endif
+
+#if ANCS_CLIENT_STORE_SIZE > 0
+    ANCSNotificationStore<ANCS_CLIENT_STORE_SIZE> store;
+#endif
+
+#if ANCS_CLIENT_REFRESH_CACHE_SIZE > 0
+    ANCSRefreshCache<ANCS_CLIENT_REFRESH_CACHE_SIZE> refreshCache;
+    RefreshStatistics_t refreshStatistics;
+#endif
+
+    // attribute prefetch rules and notifications waiting for queue space
+    typedef struct {
+        uint32_t notificationUID;
+        uint8_t rule;
+        uint8_t priority;
+        uint8_t categoryID;
+        uint8_t eventFlags;
+    } Prefetch_t;
+
+    const FetchPolicy_t* fetchPolicy;
+    uint8_t fetchPolicyCount;
+    FunctionPointer1<void, RequestComplete_t> prefetchCallback;
+
+    // oldest first
+    Prefetch_t prefetchBacklog[ANCS_CLIENT_PREFETCH_BACKLOG];
+    uint8_t prefetchCount;
+    bool prefetchScheduled;
 };
+
+#endif // __ANCS_CLIENT_H__
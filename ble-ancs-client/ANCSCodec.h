@@ -0,0 +1,231 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __ANCS_CODEC_H__
+#define __ANCS_CODEC_H__
+
+#include <stdint.h>
+#include <string.h>
+
+/*
+    Wire format of the Control Point commands and Notification Source
+    events, without any BLE dependencies.
+
+    All limits are template parameters, so checks against them fold into
+    constants and commands that are never called are never instantiated:
+
+    - PAYLOAD_LENGTH: longest command that can be written, ATT_MTU - 3.
+    - ATTRIBUTE_MASK: notification attributes that may be requested, bit n
+      for attribute ID n. Commands asking for other attributes are refused.
+    - MAX_LENGTH: upper bound for the max length parameter of Title,
+      Subtitle, and Message; the phone truncates longer values.
+
+    Attribute lists are arrays of any type with an attributeID member, and
+    events are decoded into any type with the Notification Source fields.
+    Encoders return the command length, or 0 if the command is invalid or
+    does not fit.
+
+    Data Source responses are not decoded here. They arrive split at any
+    byte across notifications, so ANCSResponseParser decodes their header
+    and attributes as a stream instead of from a whole buffer.
+*/
+template <uint8_t PAYLOAD_LENGTH, uint8_t ATTRIBUTE_MASK = 0xFF, uint16_t MAX_LENGTH = 0xFFFF>
+class ANCSCodec
+{
+public:
+    enum {
+        NotificationLength = 8,
+        NotificationAttributeCount = 8,
+        ActionLength = 6
+    };
+
+    static uint32_t readUID(const uint8_t* data)
+    {
+        return ((uint32_t) data[0])
+             | ((uint32_t) data[1] << 8)
+             | ((uint32_t) data[2] << 16)
+             | ((uint32_t) data[3] << 24);
+    }
+
+    static void writeUID(uint8_t* data, uint32_t notificationUID)
+    {
+        data[0] = notificationUID;
+        data[1] = notificationUID >> 8;
+        data[2] = notificationUID >> 16;
+        data[3] = notificationUID >> 24;
+    }
+
+    static bool isEnabled(uint8_t attributeID)
+    {
+        return (attributeID < NotificationAttributeCount) && (ATTRIBUTE_MASK & (1 << attributeID));
+    }
+
+    /*
+        Title, Subtitle, and Message are followed by a 16-bit max length.
+    */
+    static bool hasMaxLength(uint8_t attributeID)
+    {
+        return (attributeID >= ATTRIBUTE_TITLE) && (attributeID <= ATTRIBUTE_MESSAGE);
+    }
+
+    /*
+        Length of the Get Notification Attributes command, or 0 if an
+        attribute is disabled or repeated, or the command does not fit.
+    */
+    template <typename A>
+    static uint8_t notificationAttributesLength(const A* attributes, uint8_t count)
+    {
+        uint16_t length = 1 + 4;
+        uint8_t seen = 0;
+
+        for (uint8_t index = 0; index < count; index++)
+        {
+            uint8_t id = attributes[index].attributeID;
+
+            if (!isEnabled(id) || (seen & (1 << id)))
+            {
+                return 0;
+            }
+
+            seen |= (1 << id);
+            length += (hasMaxLength(id)) ? 3 : 1;
+        }
+
+        return ((count > 0) && (length <= PAYLOAD_LENGTH)) ? length : 0;
+    }
+
+    template <typename A>
+    static uint8_t encodeNotificationAttributes(uint8_t* payload,
+                                                uint32_t notificationUID,
+                                                const A* attributes,
+                                                uint8_t count)
+    {
+        uint8_t length = notificationAttributesLength(attributes, count);
+
+        if (length == 0)
+        {
+            return 0;
+        }
+
+        uint8_t index = 0;
+
+        payload[index++] = COMMAND_GET_NOTIFICATION_ATTRIBUTES;
+        writeUID(&payload[index], notificationUID);
+        index += 4;
+
+        for (uint8_t attribute = 0; attribute < count; attribute++)
+        {
+            uint8_t id = attributes[attribute].attributeID;
+
+            payload[index++] = id;
+
+            if (hasMaxLength(id))
+            {
+                uint16_t maxLength = attributes[attribute].maxLength;
+                maxLength = (maxLength > MAX_LENGTH) ? MAX_LENGTH : maxLength;
+
+                payload[index++] = maxLength;
+                payload[index++] = maxLength >> 8;
+            }
+        }
+
+        return index;
+    }
+
+    /*
+        Length of the Get App Attributes command for an identifier of the
+        given length, or 0 if it does not fit.
+    */
+    static uint8_t appAttributesLength(uint16_t identifierLength, uint8_t count)
+    {
+        // command ID, identifier with terminator, and attribute IDs
+        uint16_t length = 1 + identifierLength + 1 + count;
+
+        return ((identifierLength > 0) && (count > 0) && (length <= PAYLOAD_LENGTH)) ? length : 0;
+    }
+
+    template <typename A>
+    static uint8_t encodeAppAttributes(uint8_t* payload,
+                                       const char* appIdentifier,
+                                       const A* attributes,
+                                       uint8_t count)
+    {
+        uint16_t identifierLength = strlen(appIdentifier);
+        uint8_t length = appAttributesLength(identifierLength, count);
+
+        if (length == 0)
+        {
+            return 0;
+        }
+
+        payload[0] = COMMAND_GET_APP_ATTRIBUTES;
+        memcpy(&payload[1], appIdentifier, identifierLength + 1);
+
+        for (uint8_t attribute = 0; attribute < count; attribute++)
+        {
+            payload[identifierLength + 2 + attribute] = attributes[attribute].attributeID;
+        }
+
+        return length;
+    }
+
+    static uint8_t encodeNotificationAction(uint8_t* payload, uint32_t notificationUID, uint8_t actionID)
+    {
+        if ((PAYLOAD_LENGTH < ActionLength) || (actionID > ACTION_NEGATIVE))
+        {
+            return 0;
+        }
+
+        payload[0] = COMMAND_PERFORM_NOTIFICATION_ACTION;
+        writeUID(&payload[1], notificationUID);
+        payload[5] = actionID;
+
+        return ActionLength;
+    }
+
+    /*
+        Notification Source event. Returns false for packets shorter than an
+        event; longer packets are accepted for future additions.
+    */
+    template <typename N>
+    static bool decodeNotification(const uint8_t* data, uint16_t length, N& event)
+    {
+        if ((data == NULL) || (length < NotificationLength))
+        {
+            return false;
+        }
+
+        event.eventID = data[0];
+        event.eventFlags = data[1];
+        event.categoryID = data[2];
+        event.categoryCount = data[3];
+        event.notificationUID = readUID(&data[4]);
+
+        return true;
+    }
+
+private:
+    enum {
+        COMMAND_GET_NOTIFICATION_ATTRIBUTES = 0,
+        COMMAND_GET_APP_ATTRIBUTES          = 1,
+        COMMAND_PERFORM_NOTIFICATION_ACTION = 2,
+        ATTRIBUTE_TITLE                     = 1,
+        ATTRIBUTE_MESSAGE                   = 3,
+        ACTION_NEGATIVE                     = 1
+    };
+};
+
+#endif // __ANCS_CODEC_H__
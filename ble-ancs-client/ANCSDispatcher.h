@@ -0,0 +1,103 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __ANCS_DISPATCHER_H__
+#define __ANCS_DISPATCHER_H__
+
+#include "ble-ancs-client/ANCSClient.h"
+
+/*
+    Maximum number of ANCSClient sessions, i.e. phones served at once.
+*/
+#ifndef ANCS_CLIENT_MAX_CONNECTIONS
+#define ANCS_CLIENT_MAX_CONNECTIONS 4
+#endif
+
+/*
+    Routes BLE events to ANCSClient sessions.
+
+    Every ANCSClient attaches itself when constructed. A new peripheral
+    connection is given to the first session that is not connected, and
+    from then on GATT client, security, and disconnection events are passed
+    to the session owning the connection handle. Each session keeps its own
+    discovery, request, and parser state, so one session is needed per
+    phone.
+
+    The BLE API only supports one service discovery at a time. Sessions
+    that find discovery busy are retried when it terminates.
+*/
+class ANCSDispatcher
+{
+public:
+    /*
+        Register BLE callbacks. Called by ANCSClient::init; only the first
+        call has any effect.
+    */
+    static void init();
+
+    /*
+        Returns false when ANCS_CLIENT_MAX_CONNECTIONS sessions are already
+        attached. ANCSClient::init reports the failure.
+    */
+    static bool attach(ANCSClient* client);
+    static void detach(ANCSClient* client);
+
+    /*
+        Session owning the connection, or NULL.
+    */
+    static ANCSClient* find(Gap::Handle_t connectionHandle);
+
+    /*
+        Iterate attached sessions, from 0 to ANCS_CLIENT_MAX_CONNECTIONS - 1.
+        Returns NULL for unused slots.
+    */
+    static ANCSClient* getSession(uint8_t index);
+
+    /*
+        Shared callback registry: set the same handlers on every attached
+        session. Events carry the connection handle of their session.
+    */
+    static void registerNotificationHandlerTask(FunctionPointer1<void, ANCSClient::Notification_t> callback);
+    static void registerAttributeHandlerTask(FunctionPointer1<void, ANCSClient::Attribute_t> callback);
+    static void registerDecodedAttributeHandlerTask(FunctionPointer1<void, ANCSClient::DecodedAttribute_t> callback);
+    static void registerAppAttributeHandlerTask(FunctionPointer1<void, ANCSClient::AppAttribute_t> callback);
+    static void registerNotificationBatchHandler(FunctionPointer1<void, const ANCSClient::NotificationBatch_t*> callback);
+    static void setFetchPolicy(const ANCSClient::FetchPolicy_t* policy,
+                               uint8_t count,
+                               FunctionPointer1<void, ANCSClient::RequestComplete_t> callback = FunctionPointer1<void, ANCSClient::RequestComplete_t>());
+
+    /*
+        Remember which session launched the current service discovery;
+        discovered services do not carry a connection handle.
+    */
+    static void setDiscoveringSession(ANCSClient* client);
+
+    /*
+        BLE event entry points.
+    */
+    static void onConnection(const Gap::ConnectionCallbackParams_t* params);
+    static void onDisconnection(const Gap::DisconnectionCallbackParams_t* params);
+    static void serviceDiscoveryCallback(const DiscoveredService* service);
+    static void characteristicDiscoveryCallback(const DiscoveredCharacteristic* characteristicP);
+    static void discoveryTerminationCallback(Gap::Handle_t handle);
+    static void hvxCallback(const GattHVXCallbackParams* params);
+    static void dataWritten(const GattWriteCallbackParams* params);
+    static void dataRead(const GattReadCallbackParams* params);
+    static void dataSent(unsigned count);
+    static void linkSecured(Gap::Handle_t handle, SecurityManager::SecurityMode_t mode);
+};
+
+#endif // __ANCS_DISPATCHER_H__
@@ -0,0 +1,165 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __ANCS_HANDLE_CACHE_H__
+#define __ANCS_HANDLE_CACHE_H__
+
+#include <stdint.h>
+#include <string.h>
+
+/*
+    Least recently used table of ANCS GATT handles, keyed by peer address.
+
+    The handles of a bonded phone do not change between connections unless
+    its GATT database changes, so remembering them lets a reconnection skip
+    service and characteristic discovery. Entries are kept most recently
+    used first; inserting into a full table drops the last entry.
+*/
+template <uint8_t SIZE>
+class ANCSHandleCache
+{
+public:
+    typedef struct {
+        uint8_t peerAddrType;
+        uint8_t peerAddr[6];
+        uint16_t notificationSourceDeclaration; // declarations are read back to validate the entry
+        uint16_t notificationSource;
+        uint16_t notificationSourceCCCD;
+        uint16_t controlPointDeclaration;
+        uint16_t controlPoint;
+        uint8_t controlPointWriteCommand;       // write without response allowed
+        uint16_t dataSourceDeclaration;
+        uint16_t dataSource;
+        uint16_t dataSourceCCCD;
+    } Entry_t;
+
+    ANCSHandleCache()
+        :   used(0),
+            hits(0),
+            misses(0)
+    {}
+
+    /*
+        Copy the handles for the peer into entry and make it the most
+        recently used. Returns false if the peer is not cached.
+    */
+    bool lookup(uint8_t peerAddrType, const uint8_t* peerAddr, Entry_t* entry)
+    {
+        uint8_t index = find(peerAddrType, peerAddr);
+
+        if (index == used)
+        {
+            misses++;
+            return false;
+        }
+
+        hits++;
+        moveToFront(index);
+
+        if (entry)
+        {
+            *entry = entries[0];
+        }
+
+        return true;
+    }
+
+    /*
+        Add or replace the handles for entry.peerAddr.
+    */
+    void insert(const Entry_t& entry)
+    {
+        uint8_t index = find(entry.peerAddrType, entry.peerAddr);
+
+        if (index == used)
+        {
+            // drop the least recently used entry when full
+            index = (used < SIZE) ? used++ : SIZE - 1;
+        }
+
+        entries[index] = entry;
+        moveToFront(index);
+    }
+
+    void remove(uint8_t peerAddrType, const uint8_t* peerAddr)
+    {
+        uint8_t index = find(peerAddrType, peerAddr);
+
+        if (index < used)
+        {
+            memmove(&entries[index], &entries[index + 1], (used - index - 1) * sizeof(Entry_t));
+            used--;
+        }
+    }
+
+    void clear()
+    {
+        used = 0;
+    }
+
+    uint8_t getUsed() const
+    {
+        return used;
+    }
+
+    uint32_t getHits() const
+    {
+        return hits;
+    }
+
+    uint32_t getMisses() const
+    {
+        return misses;
+    }
+
+private:
+    /*
+        Index of the entry for the peer, or used if there is none.
+    */
+    uint8_t find(uint8_t peerAddrType, const uint8_t* peerAddr) const
+    {
+        uint8_t index = 0;
+
+        while ((index < used) &&
+               ((entries[index].peerAddrType != peerAddrType) ||
+                (memcmp(entries[index].peerAddr, peerAddr, sizeof(entries[index].peerAddr)) != 0)))
+        {
+            index++;
+        }
+
+        return index;
+    }
+
+    void moveToFront(uint8_t index)
+    {
+        if (index > 0)
+        {
+            Entry_t entry = entries[index];
+
+            memmove(&entries[1], &entries[0], index * sizeof(Entry_t));
+            entries[0] = entry;
+        }
+    }
+
+private:
+    Entry_t entries[SIZE];
+    uint8_t used;
+
+    uint32_t hits;
+    uint32_t misses;
+};
+
+#endif // __ANCS_HANDLE_CACHE_H__
@@ -0,0 +1,227 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __ANCS_NOTIFICATION_STORE_H__
+#define __ANCS_NOTIFICATION_STORE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+    Fixed capacity table of the notifications currently on the phone, keyed
+    by notification UID.
+
+    Open addressing with linear probing. Removal shifts the following entries
+    back instead of leaving tombstones, so lookups stay short no matter how
+    many notifications come and go. Entries are iterated by slot.
+*/
+template <uint16_t CAPACITY>
+class ANCSNotificationStore
+{
+public:
+    static const uint8_t CATEGORIES = 12;
+
+    typedef struct {
+        uint32_t notificationUID;
+        uint8_t eventID;    // last event applied
+        uint8_t eventFlags;
+        uint8_t categoryID;
+    } Entry_t;
+
+    ANCSNotificationStore()
+    {
+        clear();
+    }
+
+    /*
+        Apply an Added or Modified event. Returns false if the store is full.
+    */
+    bool update(uint32_t notificationUID, uint8_t eventID, uint8_t eventFlags, uint8_t categoryID)
+    {
+        int32_t found = find(notificationUID);
+        uint16_t slot;
+
+        if (found >= 0)
+        {
+            slot = found;
+            countCategory(entries[slot].categoryID, -1);
+        }
+        else if (count < CAPACITY)
+        {
+            slot = home(notificationUID);
+
+            while (isOccupied(slot))
+            {
+                slot = (slot + 1) % CAPACITY;
+            }
+
+            occupied[slot / 8] |= (1 << (slot % 8));
+            count++;
+        }
+        else
+        {
+            overflows++;
+            return false;
+        }
+
+        entries[slot].notificationUID = notificationUID;
+        entries[slot].eventID = eventID;
+        entries[slot].eventFlags = eventFlags;
+        entries[slot].categoryID = categoryID;
+        countCategory(categoryID, 1);
+
+        return true;
+    }
+
+    /*
+        Apply a Removed event.
+    */
+    void remove(uint32_t notificationUID)
+    {
+        int32_t found = find(notificationUID);
+
+        if (found < 0)
+        {
+            return;
+        }
+
+        uint16_t slot = found;
+
+        countCategory(entries[slot].categoryID, -1);
+        count--;
+
+        // shift back entries that would become unreachable
+        uint16_t next = slot;
+
+        for (uint16_t probe = 1; probe < CAPACITY; probe++)
+        {
+            next = (next + 1) % CAPACITY;
+
+            if (!isOccupied(next))
+            {
+                break;
+            }
+
+            uint16_t target = home(entries[next].notificationUID);
+
+            // leave entries whose home lies cyclically in (slot, next]
+            bool reachable = (slot <= next) ? ((slot < target) && (target <= next))
+                                            : ((slot < target) || (target <= next));
+
+            if (!reachable)
+            {
+                entries[slot] = entries[next];
+                slot = next;
+            }
+        }
+
+        occupied[slot / 8] &= ~(1 << (slot % 8));
+    }
+
+    /*
+        Slot holding notificationUID, or -1.
+    */
+    int32_t find(uint32_t notificationUID) const
+    {
+        uint16_t slot = home(notificationUID);
+
+        for (uint16_t probe = 0; (probe < CAPACITY) && isOccupied(slot); probe++)
+        {
+            if (entries[slot].notificationUID == notificationUID)
+            {
+                return slot;
+            }
+
+            slot = (slot + 1) % CAPACITY;
+        }
+
+        return -1;
+    }
+
+    /*
+        Entry in slot, or NULL if the slot is empty.
+    */
+    const Entry_t* at(uint16_t slot) const
+    {
+        return ((slot < CAPACITY) && isOccupied(slot)) ? &entries[slot] : NULL;
+    }
+
+    void clear()
+    {
+        for (uint16_t index = 0; index < sizeof(occupied); index++)
+        {
+            occupied[index] = 0;
+        }
+
+        for (uint8_t index = 0; index < CATEGORIES; index++)
+        {
+            categoryCounts[index] = 0;
+        }
+
+        count = 0;
+        overflows = 0;
+    }
+
+    uint16_t getCapacity() const
+    {
+        return CAPACITY;
+    }
+
+    uint16_t getCount() const
+    {
+        return count;
+    }
+
+    uint16_t getCategoryCount(uint8_t categoryID) const
+    {
+        return (categoryID < CATEGORIES) ? categoryCounts[categoryID] : 0;
+    }
+
+    uint16_t getOverflows() const
+    {
+        return overflows;
+    }
+
+private:
+    static uint16_t home(uint32_t notificationUID)
+    {
+        // UIDs are usually sequential; spread them over the table
+        return (uint32_t)(notificationUID * 2654435761UL) % CAPACITY;
+    }
+
+    bool isOccupied(uint16_t slot) const
+    {
+        return occupied[slot / 8] & (1 << (slot % 8));
+    }
+
+    void countCategory(uint8_t categoryID, int8_t delta)
+    {
+        if (categoryID < CATEGORIES)
+        {
+            categoryCounts[categoryID] += delta;
+        }
+    }
+
+private:
+    Entry_t entries[CAPACITY];
+    uint8_t occupied[(CAPACITY + 7) / 8];
+
+    uint16_t categoryCounts[CATEGORIES];
+    uint16_t count;
+    uint16_t overflows;
+};
+
+#endif // __ANCS_NOTIFICATION_STORE_H__
@@ -0,0 +1,156 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __ANCS_REFRESH_CACHE_H__
+#define __ANCS_REFRESH_CACHE_H__
+
+#include <stdint.h>
+#include <string.h>
+
+/*
+    Least recently used table of notification fingerprints, keyed by
+    notification UID.
+
+    A fingerprint is a hash of the Message Size and Date attributes, which
+    are a few bytes each and change whenever the text of a notification
+    does. Comparing it with the fingerprint from the last full fetch tells
+    whether the large attributes need to be fetched again. The length of
+    that fetch is kept to report the bytes a skipped fetch saved.
+*/
+template <uint8_t SIZE>
+class ANCSRefreshCache
+{
+public:
+    typedef struct {
+        uint32_t notificationUID;
+        uint32_t fingerprint;
+        uint16_t responseBytes;     // Data Source bytes of the last full fetch
+    } Entry_t;
+
+    static const uint32_t FingerprintSeed = 2166136261UL;
+
+    ANCSRefreshCache()
+        :   used(0)
+    {}
+
+    /*
+        FNV-1a, continued from hash. Start with FingerprintSeed.
+    */
+    static uint32_t fingerprint(uint32_t hash, const uint8_t* data, uint16_t length)
+    {
+        for (uint16_t index = 0; index < length; index++)
+        {
+            hash ^= data[index];
+            hash *= 16777619UL;
+        }
+
+        return hash;
+    }
+
+    /*
+        Copy the entry for the notification into entry and make it the most
+        recently used. Returns false if the notification is not cached.
+    */
+    bool lookup(uint32_t notificationUID, Entry_t* entry)
+    {
+        uint8_t index = find(notificationUID);
+
+        if (index == used)
+        {
+            return false;
+        }
+
+        moveToFront(index);
+
+        if (entry)
+        {
+            *entry = entries[0];
+        }
+
+        return true;
+    }
+
+    /*
+        Add or replace the entry for entry.notificationUID.
+    */
+    void insert(const Entry_t& entry)
+    {
+        uint8_t index = find(entry.notificationUID);
+
+        if (index == used)
+        {
+            // drop the least recently used entry when full
+            index = (used < SIZE) ? used++ : SIZE - 1;
+        }
+
+        entries[index] = entry;
+        moveToFront(index);
+    }
+
+    void remove(uint32_t notificationUID)
+    {
+        uint8_t index = find(notificationUID);
+
+        if (index < used)
+        {
+            memmove(&entries[index], &entries[index + 1], (used - index - 1) * sizeof(Entry_t));
+            used--;
+        }
+    }
+
+    void clear()
+    {
+        used = 0;
+    }
+
+    uint8_t getUsed() const
+    {
+        return used;
+    }
+
+private:
+    /*
+        Index of the entry for the notification, or used if there is none.
+    */
+    uint8_t find(uint32_t notificationUID) const
+    {
+        uint8_t index = 0;
+
+        while ((index < used) && (entries[index].notificationUID != notificationUID))
+        {
+            index++;
+        }
+
+        return index;
+    }
+
+    void moveToFront(uint8_t index)
+    {
+        if (index > 0)
+        {
+            Entry_t entry = entries[index];
+
+            memmove(&entries[1], &entries[0], index * sizeof(Entry_t));
+            entries[0] = entry;
+        }
+    }
+
+private:
+    Entry_t entries[SIZE];
+    uint8_t used;
+};
+
+#endif // __ANCS_REFRESH_CACHE_H__
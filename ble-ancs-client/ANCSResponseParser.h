@@ -0,0 +1,449 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __ANCS_RESPONSE_PARSER_H__
+#define __ANCS_RESPONSE_PARSER_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+    Receives the pieces of Data Source responses from ANCSResponseParser.
+    Returning false from responseStarted or attributeStarted drops the rest
+    of the response; see ANCSResponseParser::setAttributeCount.
+*/
+class ANCSResponseListener
+{
+public:
+    /*
+        Header complete. appIdentifier is the NUL-terminated identifier of
+        a Get App Attributes response and NULL otherwise.
+    */
+    virtual bool responseStarted(uint8_t commandID, uint32_t notificationUID, const char* appIdentifier) = 0;
+
+    virtual bool attributeStarted(uint8_t attributeID, uint16_t length) = 0;
+
+    /*
+        Part of the current attribute value, starting at offset. Never
+        extends past the length passed to attributeStarted.
+    */
+    virtual void attributeData(const uint8_t* data, uint16_t length, uint16_t offset) = 0;
+
+    /*
+        Return true if the response has more attributes.
+    */
+    virtual bool attributeCompleted() = 0;
+
+protected:
+    ~ANCSResponseListener() {}
+};
+
+/*
+    Reassembles Data Source responses from notification fragments.
+
+    Responses are a header (command ID, then a notification UID or a
+    NUL-terminated app identifier) followed by attributes (ID, 16-bit
+    length, value). Fragment boundaries can fall anywhere, so the stream is
+    parsed byte by byte and values are passed on as they arrive; nothing is
+    allocated or copied except an app identifier of at most
+    IDENTIFIER_LENGTH characters. Which attributes a response holds is up to
+    the listener, which knows the request.
+
+    Responses carry no attribute count, so only the listener knows where a
+    response ends. If it tells the parser with setAttributeCount, responses
+    it refuses or stops following are skipped by their declared attribute
+    lengths, and their remaining fragments are not taken for new responses.
+    Malformed input (unknown command, identifier too long) and responses
+    refused without a count drop the rest of the fragment, and parsing
+    restarts at the next one.
+*/
+template <uint8_t IDENTIFIER_LENGTH>
+class ANCSResponseParser
+{
+public:
+    typedef enum {
+        CommandIDGetNotificationAttributes = 0,
+        CommandIDGetAppAttributes          = 1
+    } command_id_t;
+
+    typedef struct {
+        uint32_t responses;     // headers accepted by the listener
+        uint32_t attributes;    // attributes completed
+        uint32_t rejected;      // responses dropped or skipped
+        uint32_t skipped;       // attributes skipped by their declared length
+    } Statistics_t;
+
+    ANCSResponseParser(ANCSResponseListener* _listener)
+        :   listener(_listener),
+            skipping(false),
+            attributesLeft(0)
+    {
+        reset();
+        resetStatistics();
+    }
+
+    void parse(const uint8_t* data, uint16_t length)
+    {
+        uint16_t index = 0;
+
+        if (data == NULL)
+        {
+            return;
+        }
+
+        while (index < length)
+        {
+            switch (state)
+            {
+                case STATE_COMMAND_ID:
+                    commandID = data[index++];
+                    notificationUID = 0;
+                    headerIndex = 0;
+
+                    if (commandID == CommandIDGetNotificationAttributes)
+                    {
+                        state = STATE_NOTIFICATION_UID;
+                    }
+                    else if (commandID == CommandIDGetAppAttributes)
+                    {
+                        state = STATE_APP_IDENTIFIER;
+                    }
+                    else
+                    {
+                        reject();
+                        return;
+                    }
+                    break;
+
+                case STATE_NOTIFICATION_UID:
+                    notificationUID |= ((uint32_t) data[index++]) << (8 * headerIndex);
+                    headerIndex++;
+
+                    if (headerIndex == sizeof(uint32_t))
+                    {
+                        if (!startResponse(NULL))
+                        {
+                            return;
+                        }
+                    }
+                    break;
+
+                case STATE_APP_IDENTIFIER:
+                {
+                    char character = data[index++];
+
+                    if (character != '\0')
+                    {
+                        // keep counting past the buffer; the identifier is refused at the end
+                        if (headerIndex < IDENTIFIER_LENGTH)
+                        {
+                            appIdentifier[headerIndex] = character;
+                        }
+
+                        if (headerIndex <= IDENTIFIER_LENGTH)
+                        {
+                            headerIndex++;
+                        }
+                    }
+                    else if (headerIndex > IDENTIFIER_LENGTH)
+                    {
+                        reject();
+                        return;
+                    }
+                    else
+                    {
+                        appIdentifier[headerIndex] = '\0';
+
+                        if (!startResponse(appIdentifier))
+                        {
+                            return;
+                        }
+                    }
+                }
+                    break;
+
+                case STATE_ATTRIBUTE_ID:
+                    attributeID = data[index++];
+                    state = STATE_ATTRIBUTE_LENGTH_LOW;
+                    break;
+
+                case STATE_ATTRIBUTE_LENGTH_LOW:
+                    attributeLength = data[index++];
+                    state = STATE_ATTRIBUTE_LENGTH_HIGH;
+                    break;
+
+                case STATE_ATTRIBUTE_LENGTH_HIGH:
+                    attributeLength |= ((uint16_t) data[index++]) << 8;
+                    attributeOffset = 0;
+
+                    if (!skipping)
+                    {
+                        // the listener may reset the parser
+                        uint8_t identifier = attributeID;
+                        uint16_t declared = attributeLength;
+                        uint8_t left = attributesLeft;
+
+                        if (!listener->attributeStarted(identifier, declared))
+                        {
+                            if (!skip(left))
+                            {
+                                return;
+                            }
+
+                            attributeID = identifier;
+                            attributeLength = declared;
+                            attributeOffset = 0;
+                        }
+                    }
+
+                    state = STATE_ATTRIBUTE_DATA;
+
+                    if (attributeLength == 0)
+                    {
+                        completeAttribute();
+                    }
+                    break;
+
+                case STATE_ATTRIBUTE_DATA:
+                {
+                    uint16_t chunk = length - index;
+
+                    if (chunk > attributeLength - attributeOffset)
+                    {
+                        chunk = attributeLength - attributeOffset;
+                    }
+
+                    if (!skipping)
+                    {
+                        listener->attributeData(&data[index], chunk, attributeOffset);
+                    }
+
+                    index += chunk;
+                    attributeOffset += chunk;
+
+                    if (attributeOffset == attributeLength)
+                    {
+                        completeAttribute();
+                    }
+                }
+                    break;
+
+                default:
+                    reject();
+                    return;
+            }
+        }
+    }
+
+    /*
+        Attributes in the response being started, for the listener to call
+        from responseStarted. Zero, the default, means unknown.
+    */
+    void setAttributeCount(uint8_t count)
+    {
+        attributesLeft = count;
+    }
+
+    /*
+        Stop passing the response in progress to the listener. With a known
+        attribute count the rest of it is skipped; otherwise the parser is
+        reset, and the next fragment is taken for a new response.
+    */
+    void skipResponse()
+    {
+        if (isIdle() || skipping)
+        {
+            return;
+        }
+
+        // the header is incomplete or the end cannot be found
+        if ((attributesLeft == 0) || (state < STATE_ATTRIBUTE_ID))
+        {
+            reject();
+            return;
+        }
+
+        statistics.rejected++;
+        skipping = true;
+    }
+
+    /*
+        Forget the response in progress; the next byte is a command ID.
+    */
+    void reset()
+    {
+        state = STATE_COMMAND_ID;
+        skipping = false;
+        attributesLeft = 0;
+        commandID = 0;
+        notificationUID = 0;
+        headerIndex = 0;
+        appIdentifier[0] = '\0';
+        attributeID = 0;
+        attributeLength = 0;
+        attributeOffset = 0;
+    }
+
+    bool isIdle() const
+    {
+        return (state == STATE_COMMAND_ID);
+    }
+
+    bool isSkipping() const
+    {
+        return skipping;
+    }
+
+    uint8_t getCommandID() const
+    {
+        return commandID;
+    }
+
+    uint32_t getNotificationUID() const
+    {
+        return notificationUID;
+    }
+
+    const char* getAppIdentifier() const
+    {
+        return appIdentifier;
+    }
+
+    uint8_t getAttributeID() const
+    {
+        return attributeID;
+    }
+
+    uint16_t getAttributeLength() const
+    {
+        return attributeLength;
+    }
+
+    const Statistics_t& getStatistics() const
+    {
+        return statistics;
+    }
+
+    void resetStatistics()
+    {
+        statistics.responses = 0;
+        statistics.attributes = 0;
+        statistics.rejected = 0;
+        statistics.skipped = 0;
+    }
+
+private:
+    bool startResponse(const char* identifier)
+    {
+        attributesLeft = 0;
+
+        if (!listener->responseStarted(commandID, notificationUID, identifier))
+        {
+            return skip(attributesLeft);
+        }
+
+        statistics.responses++;
+        state = STATE_ATTRIBUTE_ID;
+
+        return true;
+    }
+
+    /*
+        Skip the rest of a refused response, the current attribute included,
+        given the attributes left in it. Returns false when the count is
+        unknown and the rest of the fragment has to be dropped instead.
+    */
+    bool skip(uint8_t left)
+    {
+        reject();
+
+        if (left == 0)
+        {
+            return false;
+        }
+
+        state = STATE_ATTRIBUTE_ID;
+        skipping = true;
+        attributesLeft = left;
+
+        return true;
+    }
+
+    void completeAttribute()
+    {
+        if (attributesLeft > 0)
+        {
+            attributesLeft--;
+        }
+
+        if (skipping)
+        {
+            statistics.skipped++;
+
+            if (attributesLeft > 0)
+            {
+                state = STATE_ATTRIBUTE_ID;
+            }
+            else
+            {
+                reset();
+            }
+
+            return;
+        }
+
+        statistics.attributes++;
+
+        // the listener may have reset the parser; only continue if not
+        bool more = listener->attributeCompleted();
+
+        state = (more && (state == STATE_ATTRIBUTE_DATA)) ? STATE_ATTRIBUTE_ID : STATE_COMMAND_ID;
+    }
+
+    void reject()
+    {
+        statistics.rejected++;
+        reset();
+    }
+
+private:
+    enum {
+        STATE_COMMAND_ID,
+        STATE_NOTIFICATION_UID,
+        STATE_APP_IDENTIFIER,
+        STATE_ATTRIBUTE_ID,
+        STATE_ATTRIBUTE_LENGTH_LOW,
+        STATE_ATTRIBUTE_LENGTH_HIGH,
+        STATE_ATTRIBUTE_DATA
+    };
+
+    ANCSResponseListener* listener;
+
+    uint8_t state;
+    bool skipping;
+    uint8_t attributesLeft;     // in the current response, 0 if unknown
+    uint8_t commandID;
+    uint32_t notificationUID;
+    uint16_t headerIndex;
+    char appIdentifier[IDENTIFIER_LENGTH + 1];
+    uint8_t attributeID;
+    uint16_t attributeLength;
+    uint16_t attributeOffset;
+
+    Statistics_t statistics;
+};
+
+#endif // __ANCS_RESPONSE_PARSER_H__
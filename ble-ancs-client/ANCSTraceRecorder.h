@@ -0,0 +1,176 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __ANCS_TRACE_RECORDER_H__
+#define __ANCS_TRACE_RECORDER_H__
+
+#include <stdint.h>
+#include <string.h>
+
+/*
+    Ring buffer of the packets and link events seen by a client, for
+    reproducing problems found in the field. Records use the trace format
+    of test/simulation, so a trace copied from a device can be replayed
+    on the host with test/replay:
+
+        [delay ms, 16-bit little endian][type][length, 16-bit little endian][data ...]
+
+    The delay is the time since the previous record, clamped to 65535.
+    When the buffer is full the oldest records are dropped whole, and
+    the delay of the first remaining record refers to a dropped one.
+    Records longer than the buffer are dropped.
+*/
+template <uint16_t SIZE>
+class ANCSTraceRecorder
+{
+public:
+    typedef enum {
+        RecordNotificationSource = 0,   // HVX payload
+        RecordDataSource         = 1,   // HVX payload
+        RecordConnect            = 3,   // peer address type, then the address
+        RecordDisconnect         = 4,   // disconnection reason
+        RecordWrite              = 12,  // Control Point payload
+        RecordSecured            = 13   // security mode
+    } record_type_t;
+
+    enum {
+        HeaderLength = 5
+    };
+
+    ANCSTraceRecorder()
+        :   tail(0),
+            used(0),
+            dropped(0)
+    {}
+
+    /*
+        Append a record, dropping the oldest ones to make room.
+    */
+    void record(uint8_t type, const uint8_t* data, uint16_t length, uint32_t delayMs)
+    {
+        if ((uint32_t) HeaderLength + length > SIZE)
+        {
+            dropped++;
+            return;
+        }
+
+        while (SIZE - used < HeaderLength + length)
+        {
+            uint16_t oldest = recordLength(tail);
+
+            tail = (tail + oldest) % SIZE;
+            used -= oldest;
+            dropped++;
+        }
+
+        uint16_t delay = (delayMs > 0xFFFF) ? 0xFFFF : delayMs;
+        uint8_t header[HeaderLength] = { (uint8_t) delay, (uint8_t) (delay >> 8), type,
+                                         (uint8_t) length, (uint8_t) (length >> 8) };
+
+        put(header, HeaderLength);
+
+        if (length > 0)
+        {
+            put(data, length);
+        }
+    }
+
+    /*
+        Copy the trace, oldest record first. Only whole records are copied.
+        Returns the number of bytes copied.
+    */
+    uint16_t copy(uint8_t* destination, uint16_t maxLength) const
+    {
+        uint16_t length = 0;
+
+        while (length < used)
+        {
+            uint16_t record = recordLength((tail + length) % SIZE);
+
+            if (length + record > maxLength)
+            {
+                break;
+            }
+
+            length += record;
+        }
+
+        uint16_t first = SIZE - tail;
+
+        if (first > length)
+        {
+            first = length;
+        }
+
+        memcpy(destination, &buffer[tail], first);
+        memcpy(&destination[first], buffer, length - first);
+
+        return length;
+    }
+
+    uint16_t getLength() const
+    {
+        return used;
+    }
+
+    /*
+        Records not kept, because they were overwritten or did not fit.
+    */
+    uint32_t getDropped() const
+    {
+        return dropped;
+    }
+
+    void clear()
+    {
+        tail = 0;
+        used = 0;
+        dropped = 0;
+    }
+
+private:
+    /*
+        Header and data length of the record starting at offset.
+    */
+    uint16_t recordLength(uint16_t offset) const
+    {
+        return HeaderLength + (buffer[(offset + 3) % SIZE] | (buffer[(offset + 4) % SIZE] << 8));
+    }
+
+    void put(const uint8_t* data, uint16_t length)
+    {
+        uint16_t head = (tail + used) % SIZE;
+        uint16_t first = SIZE - head;
+
+        if (first > length)
+        {
+            first = length;
+        }
+
+        memcpy(&buffer[head], data, first);
+        memcpy(buffer, &data[first], length - first);
+
+        used += length;
+    }
+
+private:
+    uint8_t buffer[SIZE];
+    uint16_t tail;
+    uint16_t used;
+    uint32_t dropped;
+};
+
+#endif // __ANCS_TRACE_RECORDER_H__
@@ -15,6 +15,11 @@
  */
 
 #include "ble-ancs-client/ANCSClient.h"
+#include "ble-ancs-client/ANCSDispatcher.h"
+
+#if ANCS_CLIENT_INSTRUMENTATION
+#include "cborg/Cbor.h"
+#endif
 
 // control debug output
 #if 0
@@ -24,451 +29,3257 @@
 #define DEBUGOUT(...) /* nothing */
 #endif // DEBUGOUT
 
-#define MAX_DISCOVERY_RETRY 3
-#define RETRY_DELAY_MS 1000
+// instrumentation counters, compiled out with ANCS_CLIENT_INSTRUMENTATION
+#if ANCS_CLIENT_INSTRUMENTATION
+#define COUNT(counter, amount) { statistics.counter += (amount); }
+#else
+#define COUNT(counter, amount) /* nothing */
+#endif
+
+#define HANDLE_VALIDATION_TIMEOUT_MS 1000
+
+// bond table entries searched for the peer before its handles are cached
+#define BOND_TABLE_SIZE 8
+
+/*
+    Attributes fetched to tell whether a notification has changed.
+*/
+static const ANCSClient::AttributeRequest_t RefreshProbe[] = {
+    { ANCSClient::NotificationAttributeIDMessageSize, 0, NULL },
+    { ANCSClient::NotificationAttributeIDDate,        0, NULL }
+};
+
+/*
+    Characteristic UUIDs, most significant byte first.
+*/
+static const uint8_t NotificationSourceUUID[16] = {
+    0x9F, 0xBF, 0x12, 0x0D, 0x63, 0x01, 0x42, 0xD9,
+    0x8C, 0x58, 0x25, 0xE6, 0x99, 0xA2, 0x1D, 0xBD
+};
+
+static const uint8_t ControlPointUUID[16] = {
+    0x69, 0xD1, 0xD8, 0xF3, 0x45, 0xE1, 0x49, 0xA8,
+    0x98, 0x21, 0x9B, 0xBD, 0xFD, 0xAA, 0xD9, 0xD9
+};
+
+static const uint8_t DataSourceUUID[16] = {
+    0x22, 0xEA, 0xC6, 0xE9, 0x24, 0xD6, 0x4B, 0xB5,
+    0xBE, 0x44, 0xB3, 0x6A, 0xCE, 0x7C, 0x7B, 0xFB
+};
+
+#if ANCS_CLIENT_HANDLE_CACHE_SIZE > 0
+/*
+    Shared by all clients, since a phone can reconnect to any of them.
+*/
+static ANCSHandleCache<ANCS_CLIENT_HANDLE_CACHE_SIZE> handleCache;
+#endif
+
+const Gap::ConnectionParams_t ANCSClient::FastConnectionParams = {
+    ANCS_CLIENT_FAST_INTERVAL_MIN,
+    ANCS_CLIENT_FAST_INTERVAL_MAX,
+    0,
+    ANCS_CLIENT_SUPERVISION_TIMEOUT
+};
+
+const Gap::ConnectionParams_t ANCSClient::IdleConnectionParams = {
+    ANCS_CLIENT_IDLE_INTERVAL_MIN,
+    ANCS_CLIENT_IDLE_INTERVAL_MAX,
+    ANCS_CLIENT_IDLE_SLAVE_LATENCY,
+    ANCS_CLIENT_SUPERVISION_TIMEOUT
+};
 
-/*****************************************************************************/
-/* C to C++                                                                  */
-/*****************************************************************************/
+ANCSClient::ANCSClient()
+    :   state(0),
+        attached(false),
+        connected(false),
+        connectionHandle(0),
+        peerAddrType(0),
+        discoveryStage(DiscoveryStageNone),
+        discoveryRunning(false),
+        discoveryDeferred(false),
+        discoveryRetries(ANCS_CLIENT_DISCOVERY_RETRIES),
+        discoveryDelay(ANCS_CLIENT_DISCOVERY_DELAY_MS),
+        discoveryDelayMax(ANCS_CLIENT_DISCOVERY_DELAY_MAX_MS),
+        discoveryRetriesLeft(0),
+        discoveryAttempts(0),
+        discoveryGeneration(0),
+        jitter(1),
+        notificationSourceDeclaration(0),
+        notificationSource(0),
+        notificationSourceCCCD(0),
+        controlPointDeclaration(0),
+        controlPoint(0),
+        controlPointWriteCommand(false),
+        dataSourceDeclaration(0),
+        dataSource(0),
+        dataSourceCCCD(0),
+        linkTuning(false),
+        linkIdle(false),
+        linkIdleDelay(ANCS_CLIENT_IDLE_DELAY_MS),
+        linkGeneration(0),
+        fastSince(0),
+#if ANCS_CLIENT_INSTRUMENTATION
+        connectedAt(0),
+#endif
+#if ANCS_CLIENT_TRACE_SIZE > 0
+        traceTime(0),
+#endif
+#if ANCS_CLIENT_HANDLE_CACHE_SIZE > 0
+        validatingHandles(false),
+        validationStep(0),
+#endif
+        batchCount(0),
+        batchReceived(0),
+        batchPosted(false),
+        batchTimerPending(false),
+        batchTimer(NULL),
+        coalesceWindow(0),
+        coalesceMaxEvents(ANCS_CLIENT_COALESCE_SIZE),
+        deferPreExisting(false),
+        requestHead(0),
+        requestCount(0),
+        writeInProgress(false),
+        requestTimeoutMs(ANCS_CLIENT_REQUEST_TIMEOUT_MS),
+        lastRequestActivity(0),
+        requestGeneration(0),
+        requestTimerPending(false),
+        staleCount(0),
+        parser(this),
+        parseRequest(NULL),
+        decoding(false),
+#if ANCS_CLIENT_POOL_BLOCKS > 0
+        poolReserved(0),
+#endif
+#if ANCS_CLIENT_APP_CACHE_SIZE > 0
+        appCachePeerType(0),
+        appCacheBonded(false),
+#endif
+        fetchPolicy(NULL),
+        fetchPolicyCount(0),
+        prefetchCount(0),
+        prefetchScheduled(false)
+{
+    memset(&linkStatistics, 0, sizeof(linkStatistics));
 
-static ANCSClient* ancsBridge = NULL;
+#if ANCS_CLIENT_REFRESH_CACHE_SIZE > 0
+    memset(&refreshStatistics, 0, sizeof(refreshStatistics));
+#endif
 
-static void bridgeServiceDiscoveryCallback(const DiscoveredService* service)
+#if ANCS_CLIENT_INSTRUMENTATION
+    memset(&statistics, 0, sizeof(statistics));
+#endif
+
+    attached = ANCSDispatcher::attach(this);
+}
+
+ANCSClient::~ANCSClient()
 {
-    if (ancsBridge)
-    {
-        ancsBridge->serviceDiscoveryCallback(service);
-    }
+    ANCSDispatcher::detach(this);
 }
 
-static void bridgeCharacteristicDiscoveryCallback(const DiscoveredCharacteristic* characteristicP)
+ble_error_t ANCSClient::init()
 {
-    if (ancsBridge)
-    {
-        ancsBridge->characteristicDiscoveryCallback(characteristicP);
-    }
+    // BLE events are routed to this client by the dispatcher
+    ANCSDispatcher::init();
+
+    return (attached) ? BLE_ERROR_NONE : BLE_ERROR_NO_MEM;
 }
 
-static void bridgeDiscoveryTerminationCallback(Gap::Handle_t handle)
+ble_error_t ANCSClient::getNotificationAttribute(uint32_t notificationUID,
+                                                 notification_attribute_id_t id,
+                                                 uint16_t length)
 {
-    if (ancsBridge)
-    {
-        ancsBridge->discoveryTerminationCallback(handle);
-    }
+    AttributeRequest_t request = { id, length, NULL };
+
+    return getNotificationAttributes(notificationUID, &request, 1);
 }
 
-static void bridgeHvxCallback(const GattHVXCallbackParams* params)
+ble_error_t ANCSClient::getNotificationAttributes(uint32_t notificationUID,
+                                                  const AttributeRequest_t* attributes,
+                                                  uint8_t count,
+                                                  FunctionPointer1<void, RequestComplete_t> callback,
+                                                  priority_t priority)
 {
-    if (ancsBridge)
-    {
-        ancsBridge->hvxCallback(params);
-    }
+    return requestAttributes(notificationUID, attributes, count, callback, priority, REFRESH_NONE, 0,
+                             ANCSCborExport::CategoryUnknown, 0);
 }
 
-static void bridgeLinkSecured(Gap::Handle_t handle, SecurityManager::SecurityMode_t mode)
+ble_error_t ANCSClient::refreshNotificationAttributes(uint32_t notificationUID,
+                                                      const AttributeRequest_t* attributes,
+                                                      uint8_t count,
+                                                      FunctionPointer1<void, RequestComplete_t> callback,
+                                                      priority_t priority)
 {
-    if (ancsBridge)
+#if ANCS_CLIENT_REFRESH_CACHE_SIZE > 0
+    if (Codec::isEnabled(NotificationAttributeIDMessageSize) && Codec::isEnabled(NotificationAttributeIDDate))
     {
-        ancsBridge->linkSecured(handle, mode);
+        return requestAttributes(notificationUID, attributes, count, callback, priority, REFRESH_PROBE, 0,
+                                 ANCSCborExport::CategoryUnknown, 0);
     }
-}
-
-/*****************************************************************************/
+#endif
 
-ANCSClient::ANCSClient()
-    :   state(0),
-        connectionHandle(0),
-        findService(0),
-        findCharacteristics(0),
-        expectedLength(0),
-        dataLength(0)
-{
-    // store object
-    ancsBridge = this;
+    return requestAttributes(notificationUID, attributes, count, callback, priority, REFRESH_NONE, 0,
+                             ANCSCborExport::CategoryUnknown, 0);
 }
 
-void ANCSClient::init()
+/*
+    Validate and queue a Get Notification Attributes request. A probe keeps
+    the attributes and reserves the buffers for the fetch that may follow,
+    but only asks for Message Size and Date.
+*/
+ble_error_t ANCSClient::requestAttributes(uint32_t notificationUID,
+                                          const AttributeRequest_t* attributes,
+                                          uint8_t count,
+                                          FunctionPointer1<void, RequestComplete_t> callback,
+                                          uint8_t priority,
+                                          uint8_t refresh,
+                                          uint32_t fingerprint,
+                                          uint8_t categoryID,
+                                          uint8_t eventFlags)
 {
-    BLE& ble = BLE::Instance();
+    uint8_t pendingMask = 0;
 
-    // register callbacks
-    ble.gap().onConnection(this, &ANCSClient::onConnection);
-    ble.gap().onDisconnection(this, &ANCSClient::onDisconnection);
-    ble.gattClient().onHVX(bridgeHvxCallback);
-    ble.gattServer().onDataSent(this, &ANCSClient::dataSent);
+    if ((count == 0) || (count > NotificationAttributeIDNegativeActionLabel + 1))
+    {
+        return BLE_ERROR_PARAM_OUT_OF_RANGE;
+    }
 
-    ble.gattClient()
-       .onServiceDiscoveryTermination(bridgeDiscoveryTerminationCallback);
+    // validate request before queueing it
+    for (uint8_t index = 0; index < count; index++)
+    {
+        notification_attribute_id_t id = attributes[index].attributeID;
 
-    // security
-    ble.securityManager().init();
-    ble.securityManager().onLinkSecured(bridgeLinkSecured);
-}
+        if (!Codec::isEnabled(id) || (pendingMask & (1 << id)))
+        {
+            return BLE_ERROR_INVALID_PARAM;
+        }
 
-void ANCSClient::getNotificationAttribute(uint32_t notificationUID,
-                                          notification_attribute_id_t id,
-                                          uint16_t length)
-{
-    uint8_t payload[8];
-    uint8_t payloadLength;
+        // a buffer that cannot hold a byte would only cost a wrapper
+        if (attributes[index].buffer && (attributes[index].maxLength == 0))
+        {
+            return BLE_ERROR_INVALID_PARAM;
+        }
 
-    // construct notification attribute request
-    payload[0] = CommandIDGetNotificationAttributes;
-    payload[1] = notificationUID;
-    payload[2] = notificationUID >> 8;
-    payload[3] = notificationUID >> 16;
-    payload[4] = notificationUID >> 24;
-    payload[5] = id;
+        pendingMask |= (1 << id);
+    }
 
-    if ((id == NotificationAttributeIDTitle) ||
-        (id == NotificationAttributeIDSubtitle) ||
-        (id == NotificationAttributeIDMessage))
+    if (Codec::notificationAttributesLength(attributes, count) == 0)
     {
-        payload[6] = length;
-        payload[7] = length >> 8;
-
-        payloadLength = 8;
+        DEBUGOUT("ancs: request too long\r\n");
+        return BLE_ERROR_PARAM_OUT_OF_RANGE;
     }
-    else
+
+#if ANCS_CLIENT_POOL_BLOCKS > 0
+    // not even an empty pool could hold the response
+    if (blocksNeeded(attributes, count) > ANCS_CLIENT_POOL_BLOCKS)
     {
-        payloadLength = 6;
+        DEBUGOUT("ancs: request larger than pool\r\n");
+        return BLE_ERROR_PARAM_OUT_OF_RANGE;
     }
+#endif
 
-    // allocate space to store response
-    dataLength = 0;
-    dataPayload = SharedPointer<BlockStatic>(new BlockDynamic(length));
+    Request_t* request = freeRequest(priority);
 
-    // send request
-    BLE::Instance().gattClient().write(GattClient::GATT_OP_WRITE_REQ,
-                                       connectionHandle,
-                                       controlPoint.getValueHandle(),
-                                       payloadLength,
-                                       payload);
-}
+    if (request == NULL)
+    {
+        return BLE_ERROR_NO_MEM;
+    }
 
-/*****************************************************************************/
-/* BLE maintainance                                                          */
-/*****************************************************************************/
+    // the store knows the category of notifications requested directly
+    Notification_t notification;
 
-void ANCSClient::onConnection(const Gap::ConnectionCallbackParams_t* params)
-{
-    // connected as peripheral to a central
-    if (params->role == Gap::PERIPHERAL)
+    if ((categoryID == ANCSCborExport::CategoryUnknown) && findNotification(notificationUID, &notification))
     {
-        connectionHandle = params->handle;
+        categoryID = notification.categoryID;
+        eventFlags = notification.eventFlags;
+    }
+
+    request->command = CommandIDGetNotificationAttributes;
+    request->priority = priority;
+    request->categoryID = categoryID;
+    request->eventFlags = eventFlags;
+    request->count = count;
+    request->pendingMask = pendingMask;
+    request->received = 0;
+    request->blocksReserved = blocksNeeded(attributes, count);
+    request->notificationUID = notificationUID;
+    request->refresh = refresh;
+    request->fingerprint = fingerprint;
+    request->responseBytes = 0;
+    request->callback = callback;
+
+    if (refresh == REFRESH_PROBE)
+    {
+        request->pendingMask = (1 << NotificationAttributeIDMessageSize) | (1 << NotificationAttributeIDDate);
+        request->fingerprint = ANCSRefreshCache<1>::FingerprintSeed;
+    }
 
-        minar::Scheduler::postCallback(this, &ANCSClient::startServiceDiscovery);
+    for (uint8_t index = 0; index < count; index++)
+    {
+        request->attributes[index] = attributes[index];
     }
+
+    return queueRequest(request);
 }
 
-void ANCSClient::startServiceDiscovery()
+ble_error_t ANCSClient::performNotificationAction(uint32_t notificationUID,
+                                                  action_id_t actionID,
+                                                  FunctionPointer1<void, RequestComplete_t> callback)
 {
-    DEBUGOUT("ancs: service discovery begin\r\n");
+    if (actionID > ActionIDNegative)
+    {
+        return BLE_ERROR_INVALID_PARAM;
+    }
 
-    BLE& ble = BLE::Instance();
+#if ANCS_CLIENT_STORE_SIZE > 0
+    // save the round trip when the notification does not offer the action
+    Notification_t notification;
 
-    if (ble.gattClient().isServiceDiscoveryActive() == false)
+    if (findNotification(notificationUID, &notification))
     {
-        ble.gattClient()
-           .launchServiceDiscovery(connectionHandle,
-                                   bridgeServiceDiscoveryCallback,
-                                   NULL,
-                                   ANCS::UUID);
+        uint8_t flag = (actionID == ActionIDPositive) ? EventFlagPositiveAction : EventFlagNegativeAction;
+
+        if (!(notification.eventFlags & flag))
+        {
+            return BLE_ERROR_INVALID_PARAM;
+        }
     }
-    else
+#endif
+
+    Request_t* request = freeRequest(PriorityHigh);
+
+    if (request == NULL)
     {
-        findService = MAX_DISCOVERY_RETRY;
+        return BLE_ERROR_NO_MEM;
     }
+
+    request->command = CommandIDPerformNotificationAction;
+    request->priority = PriorityHigh;
+    request->count = 0;
+    request->pendingMask = 0;
+    request->received = 0;
+    request->blocksReserved = 0;
+    request->notificationUID = notificationUID;
+    request->actionID = actionID;
+    request->refresh = REFRESH_NONE;
+    request->callback = callback;
+
+    return queueRequest(request);
 }
 
-void ANCSClient::serviceDiscoveryCallback(const DiscoveredService*)
+ble_error_t ANCSClient::getAppAttributes(const char* appIdentifier,
+                                         const app_attribute_id_t* attributes,
+                                         uint8_t count,
+                                         FunctionPointer1<void, RequestComplete_t> callback)
 {
-    DEBUGOUT("ancs: found service\r\n");
+    uint8_t pendingMask = 0;
 
-    // terminate discovery
-    findService = 0;
-    BLE::Instance().gattClient().terminateServiceDiscovery();
+    if ((appIdentifier == NULL) || (count == 0) || (count > AppAttributeIDDisplayName + 1))
+    {
+        return BLE_ERROR_PARAM_OUT_OF_RANGE;
+    }
 
-    // secure connection so we can access characteristics
-    minar::Scheduler::postCallback(this, &ANCSClient::secureConnection);
-}
+    size_t identifierLength = strlen(appIdentifier);
 
-void ANCSClient::secureConnection()
-{
-    BLE& ble = BLE::Instance();
+    if ((identifierLength == 0) || (identifierLength > ANCS_CLIENT_APP_IDENTIFIER_LENGTH))
+    {
+        return BLE_ERROR_INVALID_PARAM;
+    }
 
-    // get current link status
-    SecurityManager::LinkSecurityStatus_t securityStatus = SecurityManager::NOT_ENCRYPTED;
-    ble.securityManager().getLinkSecurity(connectionHandle, &securityStatus);
+    if (Codec::appAttributesLength(identifierLength, count) == 0)
+    {
+        DEBUGOUT("ancs: request too long\r\n");
+        return BLE_ERROR_PARAM_OUT_OF_RANGE;
+    }
+
+    for (uint8_t index = 0; index < count; index++)
+    {
+        if ((attributes[index] > AppAttributeIDDisplayName) || (pendingMask & (1 << attributes[index])))
+        {
+            return BLE_ERROR_INVALID_PARAM;
+        }
 
-    // do discovery when connection is encrypted
-    findCharacteristics = MAX_DISCOVERY_RETRY;
+        pendingMask |= (1 << attributes[index]);
+    }
 
-    // authenticate if link is not encrypted
-    if (securityStatus == SecurityManager::NOT_ENCRYPTED)
+#if ANCS_CLIENT_POOL_BLOCKS > 0
+    // every app attribute is collected in a pool block
+    if (count > ANCS_CLIENT_POOL_BLOCKS)
     {
-        ble.securityManager().setLinkSecurity(connectionHandle, SecurityManager::SECURITY_MODE_ENCRYPTION_NO_MITM);
+        DEBUGOUT("ancs: request larger than pool\r\n");
+        return BLE_ERROR_PARAM_OUT_OF_RANGE;
     }
-    else
+#endif
+
+    Request_t* request = freeRequest(PriorityNormal);
+
+    if (request == NULL)
     {
-        DEBUGOUT("ancs: link already encrypted\r\n");
+        return BLE_ERROR_NO_MEM;
+    }
+
+    request->command = CommandIDGetAppAttributes;
+    request->priority = PriorityNormal;
+    request->count = count;
+    request->pendingMask = pendingMask;
+    request->received = 0;
+    request->blocksReserved = count;
+    request->notificationUID = 0;
+    request->refresh = REFRESH_NONE;
+    request->callback = callback;
 
-        minar::Scheduler::postCallback(this, &ANCSClient::startCharacteristicDiscovery);
+    memcpy(request->app.identifier, appIdentifier, identifierLength + 1);
+
+    for (uint8_t index = 0; index < count; index++)
+    {
+        request->app.attributes[index].attributeID = attributes[index];
     }
+
+    return queueRequest(request);
 }
 
-void ANCSClient::linkSecured(Gap::Handle_t, SecurityManager::SecurityMode_t mode)
+ble_error_t ANCSClient::getAppDisplayName(const char* appIdentifier,
+                                          FunctionPointer1<void, RequestComplete_t> callback)
 {
-    (void) mode;
+#if ANCS_CLIENT_APP_CACHE_SIZE > 0
+    int16_t length = (appIdentifier) ? appCache.peek(appIdentifier) : -1;
 
-    state |= FLAG_ENCRYPTION;
+    if (length >= 0)
+    {
+        SharedPointer<BlockStatic> block = allocateBlock(length);
 
-    DEBUGOUT("ancs: link secured: %02X\r\n", mode);
+        // serve from the cache unless there is no buffer for the name
+        if (block.get())
+        {
+            appCache.lookup(appIdentifier, block->getData(), block->getLength());
 
-    if (findCharacteristics)
-    {
-        minar::Scheduler::postCallback(this, &ANCSClient::startCharacteristicDiscovery);
+            if (appAttributeHandler)
+            {
+                AppAttribute_t attribute;
+                strncpy(attribute.appIdentifier, appIdentifier, ANCS_CLIENT_APP_IDENTIFIER_LENGTH);
+                attribute.appIdentifier[ANCS_CLIENT_APP_IDENTIFIER_LENGTH] = '\0';
+                attribute.attributeID = AppAttributeIDDisplayName;
+                attribute.data = block;
+                attribute.connectionHandle = connectionHandle;
+
+                minar::Scheduler::postCallback(appAttributeHandler.bind(attribute));
+            }
+
+            if (callback)
+            {
+                RequestComplete_t complete;
+                complete.notificationUID = 0;
+                complete.status = RequestStatusSuccess;
+                complete.attributesReceived = 1;
+                complete.commandID = CommandIDGetAppAttributes;
+                complete.connectionHandle = connectionHandle;
+                complete.durationTicks = 0;
+
+                minar::Scheduler::postCallback(callback.bind(complete));
+            }
+
+            return BLE_ERROR_NONE;
+        }
     }
+#endif
+
+    const app_attribute_id_t displayName = AppAttributeIDDisplayName;
+
+    return getAppAttributes(appIdentifier, &displayName, 1, callback);
 }
 
-void ANCSClient::startCharacteristicDiscovery()
+int16_t ANCSClient::lookupAppDisplayName(const char* appIdentifier, uint8_t* buffer, uint16_t length)
 {
-    DEBUGOUT("ancs: characteristic discovery begin\r\n");
+#if ANCS_CLIENT_APP_CACHE_SIZE > 0
+    return appCache.lookup(appIdentifier, buffer, length);
+#else
+    (void) appIdentifier;
+    (void) buffer;
+    (void) length;
 
-    BLE& ble = BLE::Instance();
+    return -1;
+#endif
+}
 
-    if (ble.gattClient().isServiceDiscoveryActive() == false)
-    {
-        ble.gattClient()
-           .launchServiceDiscovery(connectionHandle,
-                                   NULL,
-                                   bridgeCharacteristicDiscoveryCallback,
-                                   ANCS::UUID);
-    }
-    else
-    {
-        findCharacteristics = MAX_DISCOVERY_RETRY;
-    }
+void ANCSClient::clearAppCache()
+{
+#if ANCS_CLIENT_APP_CACHE_SIZE > 0
+    appCache.clear();
+#endif
 }
 
-void ANCSClient::characteristicDiscoveryCallback(const DiscoveredCharacteristic* characteristicP)
+void ANCSClient::setFetchPolicy(const FetchPolicy_t* policy,
+                               uint8_t count,
+                               FunctionPointer1<void, RequestComplete_t> callback)
 {
-    DEBUGOUT("ancs: discovered characteristic\r\n");
-    DEBUGOUT("ancs: uuid: %04X %02X %02X\r\n", characteristicP->getUUID().getShortUUID(),
-                                               characteristicP->getValueHandle(),
-                                               *((uint8_t*)&(characteristicP->getProperties())));
+    fetchPolicy = policy;
+    fetchPolicyCount = (policy) ? count : 0;
+    prefetchCallback = callback;
 
-    uint16_t uuid = characteristicP->getUUID().getShortUUID();
+    // held back prefetches refer to the old rules
+    prefetchCount = 0;
+}
 
-    if (uuid == 0x120D)
+void ANCSClient::setCoalescing(uint16_t windowMs, uint8_t maxEvents, bool _deferPreExisting)
+{
+    // deliver what was collected under the old settings
+    if (coalesceWindow && (windowMs == 0))
     {
-        notificationSource = *characteristicP;
-        state |= FLAG_NOTIFICATION;
-
-        DEBUGOUT("ancs: notification source: %02X\r\n", state);
+        flushBatch();
     }
-    else if (uuid == 0xD8F3)
+
+    coalesceWindow = windowMs;
+    coalesceMaxEvents = ((maxEvents == 0) || (maxEvents > ANCS_CLIENT_COALESCE_SIZE)) ? ANCS_CLIENT_COALESCE_SIZE : maxEvents;
+    deferPreExisting = _deferPreExisting;
+}
+
+/*
+    Pass a Notification Source event on to the application. Events are
+    posted one by one unless they are delivered from a batch callback.
+*/
+void ANCSClient::deliverNotification(const Notification_t& event, bool direct)
+{
+    if (event.eventID == EventIDNotificationAdded)
     {
-        controlPoint = *characteristicP;
-        state |= FLAG_CONTROL;
+        prefetch(event);
+    }
 
-        DEBUGOUT("ancs: control point: %02X\r\n", state);
+    // only process newly added notifications that are not silent
+    if (notificationHandler &&
+        (event.eventID == EventIDNotificationAdded) &&
+        !(event.eventFlags & EventFlagSilent))
+    {
+        if (direct)
+        {
+            notificationHandler.call(event);
+        }
+        else
+        {
+            minar::Scheduler::postCallback(notificationHandler.bind(event));
+        }
     }
-    else if (uuid == 0xC6E9)
+}
+
+/*
+    Merge event into the pending batch.
+*/
+void ANCSClient::coalesce(const Notification_t& event)
+{
+    for (uint8_t index = 0; index < batchCount; index++)
     {
-        dataSource = *characteristicP;
-        state |= FLAG_DATA;
+        if (batch[index].notificationUID == event.notificationUID)
+        {
+            batchReceived++;
 
-        DEBUGOUT("ancs: data source: %02X\r\n", state);
+            if ((event.eventID == EventIDNotificationRemoved) &&
+                (batch[index].eventID == EventIDNotificationAdded))
+            {
+                // never seen by the application; drop it
+                batchCount--;
+                memmove(&batch[index], &batch[index + 1], (batchCount - index) * sizeof(Notification_t));
+            }
+            else if (event.eventID == EventIDNotificationModified)
+            {
+                // a pending Added event stays Added with the latest flags and category
+                uint8_t eventID = batch[index].eventID;
+
+                batch[index] = event;
+
+                if (eventID == EventIDNotificationAdded)
+                {
+                    batch[index].eventID = EventIDNotificationAdded;
+                }
+            }
+            else
+            {
+                batch[index] = event;
+            }
+
+            return;
+        }
     }
 
-    if (state == (FLAG_NOTIFICATION | FLAG_CONTROL | FLAG_DATA | FLAG_ENCRYPTION))
+    // out of room before the posted batch callback has run; the event
+    // follows the batch from its own callback so that the order is kept
+    if (batchCount == ANCS_CLIENT_COALESCE_SIZE)
     {
-        DEBUGOUT("ancs: subscribe\r\n");
+        FunctionPointer1<void, Notification_t> callback(this, &ANCSClient::deliverUnbatched);
+        minar::Scheduler::postCallback(callback.bind(event));
+        return;
+    }
 
-        findCharacteristics = 0;
-        BLE::Instance().gattClient().terminateServiceDiscovery();
+    batchReceived++;
+    batch[batchCount++] = event;
 
-        minar::Scheduler::postCallback(this, &ANCSClient::subscribe);
+    // a single timer bounds how long any event waits
+    if (!batchTimerPending)
+    {
+        batchTimerPending = true;
 
-        // signal service found
-        if (serviceFoundHandler)
-        {
-            minar::Scheduler::postCallback(serviceFoundHandler);
-        }
+        batchTimer = minar::Scheduler::postCallback(this, &ANCSClient::batchTimeout)
+                        .delay(minar::milliseconds(coalesceWindow))
+                        .getHandle();
+    }
+
+    if ((batchCount >= coalesceMaxEvents) && !batchPosted)
+    {
+        batchPosted = true;
+        minar::Scheduler::postCallback(this, &ANCSClient::flushBatch);
     }
 }
 
-void ANCSClient::subscribe()
+void ANCSClient::batchTimeout()
 {
-    /* Note: Yuckiness alert! The following needs to be encapsulated in a neat API.
-     * It isn't clear whether we should provide a DiscoveredCharacteristic::enableNoticiation() or
-     * DiscoveredCharacteristic::discoverDescriptors() followed by DiscoveredDescriptor::write(...). */
-    const uint16_t value = BLE_HVX_NOTIFICATION;
+    batchTimerPending = false;
+    flushBatch();
+}
 
-    ble_error_t result = BLE_ERROR_NONE;
+void ANCSClient::deliverUnbatched(Notification_t event)
+{
+    deliverNotification(event, true);
+}
 
-    if (!(state & FLAG_DATA_SUBSCRIBE))
-    {
-        result = BLE::Instance().gattClient().write(GattClient::GATT_OP_WRITE_CMD,
-                                                    connectionHandle,
-                                                    dataSource.getValueHandle() + 1, /* HACK Alert. We're assuming that CCCD descriptor immediately follows the value attribute. */
-                                                    sizeof(uint16_t),                          /* HACK Alert! size should be made into a BLE_API constant. */
-                                                    reinterpret_cast<const uint8_t *>(&value));
+void ANCSClient::flushBatch()
+{
+    batchPosted = false;
 
-        if (result == BLE_ERROR_NONE)
-        {
-            DEBUGOUT("ancs: data subscribe sent\r\n");
+    // the window restarts with the next event
+    if (batchTimerPending)
+    {
+        batchTimerPending = false;
+        minar::Scheduler::cancelCallback(batchTimer);
+    }
 
-            state |= FLAG_DATA_SUBSCRIBE;
-        }
+    if (batchCount == 0)
+    {
+        return;
     }
 
-    if (!(state & FLAG_NOTIFICATION_SUBSCRIBE))
+    // stable partition: live notifications first
+    if (deferPreExisting)
     {
-        result = BLE::Instance().gattClient().write(GattClient::GATT_OP_WRITE_CMD,
-                                                    connectionHandle,
-                                                    notificationSource.getValueHandle() + 1, /* HACK Alert. We're assuming that CCCD descriptor immediately follows the value attribute. */
-                                                    sizeof(uint16_t),                          /* HACK Alert! size should be made into a BLE_API constant. */
-                                                    reinterpret_cast<const uint8_t *>(&value));
+        uint8_t live = 0;
 
-        if (result == BLE_ERROR_NONE)
+        for (uint8_t index = 0; index < batchCount; index++)
         {
-            DEBUGOUT("ancs: notification subscribe sent\r\n");
+            if (!(batch[index].eventFlags & EventFlagPreExisting))
+            {
+                Notification_t event = batch[index];
 
-            state |= FLAG_NOTIFICATION_SUBSCRIBE;
+                memmove(&batch[live + 1], &batch[live], (index - live) * sizeof(Notification_t));
+                batch[live++] = event;
+            }
         }
     }
-}
 
-void ANCSClient::discoveryTerminationCallback(Gap::Handle_t handle)
-{
-    if (handle == connectionHandle)
+    if (batchHandler)
     {
-        if (findService)
-        {
-            // decrement retry counter and post callback
-            findService--;
+        NotificationBatch_t notificationBatch;
+        notificationBatch.notifications = batch;
+        notificationBatch.count = batchCount;
+        notificationBatch.received = batchReceived;
+        notificationBatch.connectionHandle = connectionHandle;
 
-            minar::Scheduler::postCallback(this, &ANCSClient::startServiceDiscovery)
-                .delay(minar::milliseconds(RETRY_DELAY_MS));
-        }
-        else if (findCharacteristics)
-        {
-            // decrement retry counter and post callback
-            findCharacteristics--;
+        batchHandler.call(&notificationBatch);
+    }
 
-            minar::Scheduler::postCallback(this, &ANCSClient::startCharacteristicDiscovery)
-                .delay(minar::milliseconds(RETRY_DELAY_MS));
-        }
-        else
-        {
-            DEBUGOUT("ancs: discovery done\r\n");
-        }
+    for (uint8_t index = 0; index < batchCount; index++)
+    {
+        deliverNotification(batch[index], true);
     }
+
+    batchCount = 0;
+    batchReceived = 0;
 }
 
-void ANCSClient::onDisconnection(const Gap::DisconnectionCallbackParams_t* params)
+ANCSClient::priority_t ANCSClient::getPriority(const Notification_t& notification)
 {
-    if (params->handle == connectionHandle)
+    if ((notification.categoryID == CategoryIDIncomingCall) ||
+        ((notification.eventFlags & (EventFlagImportant | EventFlagPreExisting)) == EventFlagImportant))
     {
-        DEBUGOUT("ancs: disconnected: reset\r\n");
+        return PriorityHigh;
+    }
 
-        connectionHandle = 0;
-        findService = 0;
-        findCharacteristics = 0;
-        state = 0;
+    if (notification.eventFlags & EventFlagPreExisting)
+    {
+        return PriorityLow;
     }
-}
 
-/*****************************************************************************/
-/* Event handlers                                                            */
-/*****************************************************************************/
+    return PriorityNormal;
+}
 
-void ANCSClient::hvxCallback(const GattHVXCallbackParams* params)
+/*
+    Apply the first rule matching the new notification.
+*/
+void ANCSClient::prefetch(const Notification_t& event)
 {
-    // check that the message belongs to this connection and characteristic
-    if ((params->connHandle == connectionHandle) &&
-        (params->handle == notificationSource.getValueHandle()) &&
-        (notificationHandler))
+    for (uint8_t rule = 0; rule < fetchPolicyCount; rule++)
     {
-        // parse data to notification event
-        Notification_t event;
-        event.eventID = params->data[0];
-        event.eventFlags = params->data[1];
-        event.categoryID = params->data[2];
-        event.categoryCount = params->data[3];
+        const FetchPolicy_t& policy = fetchPolicy[rule];
+
+        if (((policy.categoryID == PolicyCategoryAny) || (policy.categoryID == event.categoryID)) &&
+            ((event.eventFlags & policy.flagsMask) == policy.flagsValue))
+        {
+            if ((policy.attributes == NULL) || (policy.count == 0))
+            {
+                return;
+            }
+
+            uint8_t priority = getPriority(event);
 
-        uint32_t uid = params->data[7];
-        uid = uid << 8 | params->data[6];
-        uid = uid << 8 | params->data[5];
-        uid = uid << 8 | params->data[4];
+            // make room by dropping the newest prefetch of lower priority
+            if (prefetchCount == ANCS_CLIENT_PREFETCH_BACKLOG)
+            {
+                uint8_t victim = prefetchCount;
+
+                for (uint8_t index = 0; index < prefetchCount; index++)
+                {
+                    if (prefetchBacklog[index].priority < priority)
+                    {
+                        if ((victim == prefetchCount) ||
+                            (prefetchBacklog[index].priority <= prefetchBacklog[victim].priority))
+                        {
+                            victim = index;
+                        }
+                    }
+                }
+
+                if (victim == prefetchCount)
+                {
+                    DEBUGOUT("ancs: prefetch dropped: %lu\r\n", event.notificationUID);
+                    return;
+                }
+
+                DEBUGOUT("ancs: prefetch dropped: %lu\r\n", prefetchBacklog[victim].notificationUID);
+
+                prefetchCount--;
+                memmove(&prefetchBacklog[victim],
+                        &prefetchBacklog[victim + 1],
+                        (prefetchCount - victim) * sizeof(Prefetch_t));
+            }
 
-        event.notificationUID = uid;
+            Prefetch_t& pending = prefetchBacklog[prefetchCount];
+            pending.notificationUID = event.notificationUID;
+            pending.rule = rule;
+            pending.priority = priority;
+            pending.categoryID = event.categoryID;
+            pending.eventFlags = event.eventFlags;
+            prefetchCount++;
 
-        // only process newly added notifications that are not silent
-        if ((event.eventID == ANCSClient::EventIDNotificationAdded) &&
-            !(event.eventFlags & ANCSClient::EventFlagSilent))
-        {
-            minar::Scheduler::postCallback(notificationHandler.bind(event));
+            processPrefetch();
+            return;
         }
     }
-    else if ((params->connHandle == connectionHandle) && (params->handle == dataSource.getValueHandle()))
-    {
-        // dataLength is zero when receiving first fragment
-        if (dataLength == 0)
-        {
-            // uint8_t commandID;
-            uint32_t notificationUID;
-            // uint8_t attributeID;
-
-            // commandID = params->data[0];
-            notificationUID = params->data[4];
-            notificationUID = notificationUID << 8 | params->data[3];
-            notificationUID = notificationUID << 16 | params->data[2];
-            notificationUID = notificationUID << 24 | params->data[1];
-            // attributeID = params->data[5];
+}
 
-            dataLength = params->data[7];
-            dataLength = dataLength << 8 | params->data[6];
+/*
+    Move held back prefetches into the request queue until it is full,
+    highest priority first and oldest first within a priority.
+*/
+void ANCSClient::processPrefetch()
+{
+    prefetchScheduled = false;
 
-            // copy remaining data into newly created buffer
-            dataPayload->memcpy(0, &(params->data[8]), params->len - 8);
+    while (prefetchCount > 0)
+    {
+        uint8_t next = 0;
 
-            dataOffset = params->len - 8;
+        for (uint8_t index = 1; index < prefetchCount; index++)
+        {
+            if (prefetchBacklog[index].priority > prefetchBacklog[next].priority)
+            {
+                next = index;
+            }
         }
-        else
+
+        Prefetch_t pending = prefetchBacklog[next];
+        const FetchPolicy_t& policy = fetchPolicy[pending.rule];
+        ble_error_t result = BLE_ERROR_NONE;
+
+#if ANCS_CLIENT_STORE_SIZE > 0
+        // skip notifications removed while waiting
+        if (store.find(pending.notificationUID) >= 0)
+#endif
         {
-            // copy fragment into buffer and update offset
-            dataPayload->memcpy(dataOffset, params->data, params->len);
+            result = requestAttributes(pending.notificationUID,
+                                       policy.attributes,
+                                       policy.count,
+                                       prefetchCallback,
+                                       pending.priority,
+                                       REFRESH_NONE,
+                                       0,
+                                       pending.categoryID,
+                                       pending.eventFlags);
+        }
 
-            dataOffset += params->len;
+        // try again when a request completes
+        if (result == BLE_ERROR_NO_MEM)
+        {
+            break;
         }
 
-        // signal upper layer when all fragments have been received
-        if (dataOffset >= dataLength)
+        if (result != BLE_ERROR_NONE)
         {
-            dataPayload->setLength(dataLength);
+            DEBUGOUT("ancs: prefetch failed: %lu %d\r\n", pending.notificationUID, result);
+        }
 
-            // if callback handler is set, pass sharedpointer buffer to it
-            if (dataHandler)
-            {
-                minar::Scheduler::postCallback(dataHandler.bind(dataPayload));
-            }
+        prefetchCount--;
+        memmove(&prefetchBacklog[next],
+                &prefetchBacklog[next + 1],
+                (prefetchCount - next) * sizeof(Prefetch_t));
+    }
+}
 
-            // clear shared pointer; this frees the dynamic block
-            dataPayload = SharedPointer<BlockStatic>();
-        }
+/*
+    Next free slot at the end of the queue, or NULL if the queue is full.
+    The last slot is kept for requests that must not wait for low priority
+    ones.
+*/
+ANCSClient::Request_t* ANCSClient::freeRequest(uint8_t priority)
+{
+    uint8_t reserved = ((priority == PriorityLow) && (ANCS_CLIENT_QUEUE_SIZE > 1)) ? 1 : 0;
+
+    if (requestCount + reserved >= ANCS_CLIENT_QUEUE_SIZE)
+    {
+        DEBUGOUT("ancs: queue full\r\n");
+        return NULL;
     }
+
+    return &requestQueue[(requestHead + requestCount) % ANCS_CLIENT_QUEUE_SIZE];
+}
+
+/*
+    Add the request in the free slot to the queue, ahead of queued requests
+    of lower priority, and send it right away if the Control Point is idle
+    and nothing is queued before it.
+*/
+ble_error_t ANCSClient::queueRequest(Request_t* request)
+{
+    request->state = REQUEST_QUEUED;
+
+#if ANCS_CLIENT_POOL_BLOCKS > 0
+    // refuse request rather than run out of buffers halfway through the response
+    if (!pool.isAvailable(poolReserved + request->blocksReserved))
+    {
+        DEBUGOUT("ancs: pool exhausted\r\n");
+        COUNT(allocationFailures, 1);
+        return BLE_ERROR_NO_MEM;
+    }
+#else
+    request->blocksReserved = 0;
+#endif
+
+    requestCount++;
+    request = promoteRequest();
+
+    // no write in progress means only held back requests are waiting
+    uint8_t slot = request - requestQueue;
+    uint8_t previous = (slot + ANCS_CLIENT_QUEUE_SIZE - 1) % ANCS_CLIENT_QUEUE_SIZE;
+    bool first = (slot == requestHead) || (requestQueue[previous].state != REQUEST_QUEUED);
+
+    if (!writeInProgress && first && mayWrite(request))
+    {
+        ble_error_t result = sendRequest(request);
+
+        if (result != BLE_ERROR_NONE)
+        {
+            // requests behind it were not written either; restore their order
+            while (slot != (requestHead + requestCount - 1) % ANCS_CLIENT_QUEUE_SIZE)
+            {
+                uint8_t next = (slot + 1) % ANCS_CLIENT_QUEUE_SIZE;
+                Request_t swap = requestQueue[slot];
+
+                requestQueue[slot] = requestQueue[next];
+                requestQueue[next] = swap;
+                slot = next;
+            }
+
+            requestCount--;
+            return result;
+        }
+    }
+
+#if ANCS_CLIENT_POOL_BLOCKS > 0
+    poolReserved += request->blocksReserved;
+#endif
+
+    // speed up the link for the response; cancels a pending idle request
+    linkGeneration++;
+    requestLinkMode(LinkModeFast);
+
+    if (sentWithoutResponse(request))
+    {
+        completeRequest(request, RequestStatusSent);
+    }
+
+    return BLE_ERROR_NONE;
+}
+
+/*
+    Move the request in the last slot ahead of queued requests of lower
+    priority. Only requests not yet written move, so the order of the
+    responses still follows the queue. Returns its new slot.
+*/
+ANCSClient::Request_t* ANCSClient::promoteRequest()
+{
+    uint8_t slot = (requestHead + requestCount - 1) % ANCS_CLIENT_QUEUE_SIZE;
+
+    while (slot != requestHead)
+    {
+        uint8_t previous = (slot + ANCS_CLIENT_QUEUE_SIZE - 1) % ANCS_CLIENT_QUEUE_SIZE;
+
+        if ((requestQueue[previous].state != REQUEST_QUEUED) ||
+            (requestQueue[previous].priority >= requestQueue[slot].priority))
+        {
+            break;
+        }
+
+        Request_t swap = requestQueue[slot];
+
+        requestQueue[slot] = requestQueue[previous];
+        requestQueue[previous] = swap;
+        slot = previous;
+    }
+
+    return &requestQueue[slot];
+}
+
+/*
+    Low priority requests are held back while enough of them are waiting
+    for their responses, so that requests queued later are not stuck
+    behind a burst of them.
+*/
+bool ANCSClient::mayWrite(const Request_t* request) const
+{
+    if (request->priority != PriorityLow)
+    {
+        return true;
+    }
+
+    uint8_t inFlight = 0;
+
+    for (uint8_t index = 0; index < requestCount; index++)
+    {
+        const Request_t* other = &requestQueue[(requestHead + index) % ANCS_CLIENT_QUEUE_SIZE];
+
+        if ((other->priority == PriorityLow) &&
+            ((other->state == REQUEST_WRITING) || (other->state == REQUEST_SENT)))
+        {
+            inFlight++;
+        }
+    }
+
+    return (inFlight < ANCS_CLIENT_LOW_PRIORITY_IN_FLIGHT);
+}
+
+ble_error_t ANCSClient::sendRequest(Request_t* request)
+{
+    uint8_t payload[ANCS_CLIENT_CONTROL_POINT_MAX_LENGTH];
+    uint8_t payloadLength;
+    bool withResponse = true;
+
+    if (request->command == CommandIDPerformNotificationAction)
+    {
+        payloadLength = Codec::encodeNotificationAction(payload, request->notificationUID, request->actionID);
+
+        // no response to wait for, so skip the write response if allowed
+        withResponse = !controlPointWriteCommand;
+    }
+    else if (request->command == CommandIDGetAppAttributes)
+    {
+        payloadLength = Codec::encodeAppAttributes(payload, request->app.identifier, request->app.attributes, request->count);
+    }
+    else if (request->refresh == REFRESH_PROBE)
+    {
+        payloadLength = Codec::encodeNotificationAttributes(payload, request->notificationUID, RefreshProbe, 2);
+    }
+    else
+    {
+        payloadLength = Codec::encodeNotificationAttributes(payload, request->notificationUID, request->attributes, request->count);
+    }
+
+    // requests are validated when queued
+    if (payloadLength == 0)
+    {
+        return BLE_ERROR_PARAM_OUT_OF_RANGE;
+    }
+
+    traceEvent(ANCSTraceRecorder<1>::RecordWrite, payload, payloadLength);
+
+    ble_error_t result = writeControlPoint(payload, payloadLength, withResponse);
+
+    if (result == BLE_ERROR_NONE)
+    {
+        request->sentAt = minar::platform::getTime();
+        requestActivity();
+
+        if (withResponse)
+        {
+            request->state = REQUEST_WRITING;
+            writeInProgress = true;
+        }
+        else
+        {
+            // completed by the caller once the request is in the queue
+            request->state = REQUEST_SENT;
+        }
+    }
+
+    return result;
+}
+
+/*
+    Actions written without response are done as soon as they are sent;
+    whether the phone performed them is not known.
+*/
+bool ANCSClient::sentWithoutResponse(const Request_t* request) const
+{
+    return (request->command == CommandIDPerformNotificationAction) && (request->state == REQUEST_SENT);
+}
+
+ble_error_t ANCSClient::writeControlPoint(const uint8_t* payload, uint8_t length, bool withResponse)
+{
+    return BLE::Instance().gattClient().write((withResponse) ? GattClient::GATT_OP_WRITE_REQ : GattClient::GATT_OP_WRITE_CMD,
+                                              connectionHandle,
+                                              controlPoint,
+                                              length,
+                                              payload);
+}
+
+/*
+    Write the first queued request. Requests that cannot be written are
+    failed so that the ones behind them are not held up.
+*/
+void ANCSClient::sendNextRequest()
+{
+    uint8_t index = 0;
+
+    while ((index < requestCount) && !writeInProgress)
+    {
+        Request_t* request = &requestQueue[(requestHead + index) % ANCS_CLIENT_QUEUE_SIZE];
+
+        if (request->state == REQUEST_QUEUED)
+        {
+            // the rest are of the same or lower priority
+            if (!mayWrite(request))
+            {
+                break;
+            }
+
+            bool sent = (sendRequest(request) == BLE_ERROR_NONE);
+
+            if (!sent || sentWithoutResponse(request))
+            {
+                completeRequest(request, (sent) ? RequestStatusSent : RequestStatusWriteFailed);
+
+                // completing can remove requests from the front; start over
+                index = 0;
+                continue;
+            }
+        }
+
+        index++;
+    }
+}
+
+/*
+    Find the oldest sent request matching the response header.
+*/
+ANCSClient::Request_t* ANCSClient::findRequest(uint8_t command, uint32_t notificationUID, const char* appIdentifier)
+{
+    for (uint8_t index = 0; index < requestCount; index++)
+    {
+        Request_t* request = &requestQueue[(requestHead + index) % ANCS_CLIENT_QUEUE_SIZE];
+
+        if (((request->state != REQUEST_WRITING) && (request->state != REQUEST_SENT)) ||
+            (request->command != command))
+        {
+            continue;
+        }
+
+        if (request->command == CommandIDGetAppAttributes)
+        {
+            if (appIdentifier && (strcmp(request->app.identifier, appIdentifier) == 0))
+            {
+                return request;
+            }
+        }
+        else if (request->notificationUID == notificationUID)
+        {
+            return request;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+    Select the request the response belongs to and start parsing attributes.
+*/
+bool ANCSClient::matchRequest(uint8_t command, uint32_t notificationUID, const char* appIdentifier)
+{
+    parseRequest = findRequest(command, notificationUID, appIdentifier);
+
+    if (parseRequest == NULL)
+    {
+        DEBUGOUT("ancs: no request for response\r\n");
+        return false;
+    }
+
+#if ANCS_CLIENT_INSTRUMENTATION
+    parseRequest->firstFragmentAt = lastRequestActivity;
+#endif
+
+    // responses arrive in order; older requests were skipped. Actions have
+    // no response and slots do not move as requests complete.
+    Request_t* older = &requestQueue[requestHead];
+
+    while (older != parseRequest)
+    {
+        if ((older->state != REQUEST_DONE) && (older->command != CommandIDPerformNotificationAction))
+        {
+            completeRequest(older, RequestStatusMismatch);
+        }
+
+        older = &requestQueue[((older - requestQueue) + 1) % ANCS_CLIENT_QUEUE_SIZE];
+    }
+
+    return true;
+}
+
+void ANCSClient::completeRequest(Request_t* request, uint8_t status)
+{
+    uint32_t duration = 0;
+
+    if (request->state != REQUEST_QUEUED)
+    {
+        duration = (minar::platform::getTime() - request->sentAt) & minar::platform::Time_Mask;
+    }
+
+    // probes only decide whether the attributes are fetched
+    if ((status == RequestStatusSuccess) &&
+        (request->command != CommandIDPerformNotificationAction) &&
+        (request->refresh != REFRESH_PROBE))
+    {
+        linkStatistics.transfers++;
+        linkStatistics.lastTransferTicks = duration;
+        linkStatistics.totalTransferTicks += duration;
+
+        if (duration > linkStatistics.maxTransferTicks)
+        {
+            linkStatistics.maxTransferTicks = duration;
+        }
+
+        recordRequestStages(request);
+    }
+
+    if (request->callback)
+    {
+        RequestComplete_t complete;
+        complete.notificationUID = request->notificationUID;
+        complete.status = status;
+        complete.attributesReceived = request->received;
+        complete.commandID = request->command;
+        complete.connectionHandle = connectionHandle;
+        complete.durationTicks = duration;
+
+        minar::Scheduler::postCallback(request->callback.bind(complete));
+    }
+
+#if ANCS_CLIENT_POOL_BLOCKS > 0
+    // return unused reservations
+    poolReserved -= request->blocksReserved;
+#endif
+    request->blocksReserved = 0;
+    request->state = REQUEST_DONE;
+
+    // a failed request gets no more data; skip the rest of its response
+    if ((request == parseRequest) && (status != RequestStatusSuccess))
+    {
+        dropResponse();
+        parser.skipResponse();
+    }
+
+    // remove completed requests from the front of the queue
+    while ((requestCount > 0) && (requestQueue[requestHead].state == REQUEST_DONE))
+    {
+        requestHead = (requestHead + 1) % ANCS_CLIENT_QUEUE_SIZE;
+        requestCount--;
+    }
+
+    // slow the link down again unless more requests follow soon
+    if ((requestCount == 0) && linkTuning && linkIdle && connected)
+    {
+        FunctionPointer1<void, uint8_t> timeout(this, &ANCSClient::linkIdleTimeout);
+
+        minar::Scheduler::postCallback(timeout.bind(++linkGeneration))
+            .delay(minar::milliseconds(linkIdleDelay));
+    }
+
+    // queue has room for held back prefetches
+    if ((prefetchCount > 0) && !prefetchScheduled)
+    {
+        prefetchScheduled = true;
+        minar::Scheduler::postCallback(this, &ANCSClient::processPrefetch);
+    }
+}
+
+void ANCSClient::failRequests(uint8_t status)
+{
+    while (requestCount > 0)
+    {
+        completeRequest(&requestQueue[requestHead], status);
+    }
+
+    writeInProgress = false;
+}
+
+void ANCSClient::setRequestTimeout(uint16_t timeoutMs)
+{
+    requestTimeoutMs = timeoutMs;
+}
+
+/*
+    Write responses and Data Source packets show that the phone is still
+    answering. Only the time is recorded here; the timer rearms itself.
+*/
+void ANCSClient::requestActivity()
+{
+    lastRequestActivity = minar::platform::getTime();
+
+    if (requestTimeoutMs && !requestTimerPending)
+    {
+        armRequestTimer(minar::milliseconds(requestTimeoutMs));
+    }
+}
+
+void ANCSClient::armRequestTimer(uint32_t delay)
+{
+    FunctionPointer1<void, uint8_t> timeout(this, &ANCSClient::requestTimeout);
+
+    requestTimerPending = true;
+    minar::Scheduler::postCallback(timeout.bind(requestGeneration))
+        .delay(delay);
+}
+
+/*
+    Fail the oldest outstanding request when the phone has been silent for
+    the whole timeout. Responses arrive in order, so this is the request
+    being parsed, if any. Its partial response is dropped so that the next
+    response is not taken for a continuation, and the queue moves on.
+*/
+void ANCSClient::requestTimeout(uint8_t generation)
+{
+    if (generation != requestGeneration)
+    {
+        return;
+    }
+
+    requestTimerPending = false;
+
+    Request_t* request = NULL;
+
+    for (uint8_t index = 0; (index < requestCount) && (request == NULL); index++)
+    {
+        Request_t* candidate = &requestQueue[(requestHead + index) % ANCS_CLIENT_QUEUE_SIZE];
+
+        if ((candidate->state == REQUEST_WRITING) || (candidate->state == REQUEST_SENT))
+        {
+            request = candidate;
+        }
+    }
+
+    if ((request == NULL) || !requestTimeoutMs)
+    {
+        return;
+    }
+
+    uint32_t timeout = minar::milliseconds(requestTimeoutMs);
+    uint32_t elapsed = (minar::platform::getTime() - lastRequestActivity) & minar::platform::Time_Mask;
+
+    if (elapsed < timeout)
+    {
+        armRequestTimer(timeout - elapsed);
+        return;
+    }
+
+    DEBUGOUT("ancs: request timeout: %lu\r\n", request->notificationUID);
+
+    if (request->state == REQUEST_WRITING)
+    {
+        writeInProgress = false;
+    }
+
+    if (parseRequest && (parseRequest != request))
+    {
+        resetDataSource();
+    }
+
+    // a response that has not started yet may still come
+    if (request != parseRequest)
+    {
+        markStale(request);
+    }
+
+    completeRequest(request, RequestStatusTimeout);
+
+    // requests behind it get a full timeout of their own
+    if (requestCount > 0)
+    {
+        requestActivity();
+    }
+
+    sendNextRequest();
+}
+
+/*
+    Responses carry no request ID, and a timed out notification may be
+    requested again. Its late response comes first, as the phone answers in
+    order, and is skipped by the attribute count of the request it answers.
+*/
+static uint32_t staleKey(uint8_t command, uint32_t notificationUID, const char* appIdentifier)
+{
+    if (command == ANCSClient::CommandIDGetAppAttributes)
+    {
+        return ANCSRefreshCache<1>::fingerprint(ANCSRefreshCache<1>::FingerprintSeed,
+                                                (const uint8_t*) appIdentifier,
+                                                (uint16_t) ((appIdentifier) ? strlen(appIdentifier) : 0));
+    }
+
+    return notificationUID;
+}
+
+static uint8_t attributeCount(uint8_t mask)
+{
+    uint8_t count = 0;
+
+    for (; mask; mask &= mask - 1)
+    {
+        count++;
+    }
+
+    return count;
+}
+
+void ANCSClient::markStale(const Request_t* request)
+{
+    // actions have no response
+    if (request->command == CommandIDPerformNotificationAction)
+    {
+        return;
+    }
+
+    // the oldest is the least likely to still be answered
+    if (staleCount == ANCS_CLIENT_QUEUE_SIZE)
+    {
+        memmove(&staleRequests[0], &staleRequests[1], (ANCS_CLIENT_QUEUE_SIZE - 1) * sizeof(StaleRequest_t));
+        staleCount--;
+    }
+
+    StaleRequest_t* stale = &staleRequests[staleCount++];
+    stale->command = request->command;
+    stale->count = attributeCount(request->pendingMask);
+    stale->key = staleKey(request->command, request->notificationUID,
+                          (request->command == CommandIDGetAppAttributes) ? request->app.identifier : NULL);
+}
+
+/*
+    Attribute count of the timed out request the response answers, or 0.
+    Stale requests older than it will not be answered any more.
+*/
+uint8_t ANCSClient::drainStale(uint8_t command, uint32_t notificationUID, const char* appIdentifier)
+{
+    uint32_t key = staleKey(command, notificationUID, appIdentifier);
+
+    for (uint8_t index = 0; index < staleCount; index++)
+    {
+        if ((staleRequests[index].command == command) && (staleRequests[index].key == key))
+        {
+            uint8_t count = staleRequests[index].count;
+
+            staleCount -= index + 1;
+            memmove(&staleRequests[0], &staleRequests[index + 1], staleCount * sizeof(StaleRequest_t));
+
+            return count;
+        }
+    }
+
+    return 0;
+}
+
+void ANCSClient::setConnectionParams(const Gap::ConnectionParams_t* fast,
+                                     const Gap::ConnectionParams_t* idle,
+                                     uint16_t idleDelayMs)
+{
+    linkTuning = (fast != NULL);
+    linkIdle = (idle != NULL);
+    linkIdleDelay = idleDelayMs;
+    linkGeneration++;
+
+    if (fast)
+    {
+        fastParams = *fast;
+    }
+
+    if (idle)
+    {
+        idleParams = *idle;
+    }
+}
+
+/*
+    Ask the phone for the parameters of the given mode. Requests are only
+    sent when the mode changes; iOS rejects frequent updates.
+*/
+void ANCSClient::requestLinkMode(uint8_t mode)
+{
+    if (!linkTuning || !connected || (linkStatistics.mode == mode))
+    {
+        return;
+    }
+
+    const Gap::ConnectionParams_t* params = (mode == LinkModeFast) ? &fastParams : &idleParams;
+
+    linkStatistics.updateRequests++;
+
+    if (updateConnectionParams(params) != BLE_ERROR_NONE)
+    {
+        DEBUGOUT("ancs: connection parameters refused\r\n");
+
+        linkStatistics.updateFailures++;
+        return;
+    }
+
+    DEBUGOUT("ancs: link mode: %u\r\n", mode);
+
+    minar::platform::tick_t now = minar::platform::getTime();
+
+    if (mode == LinkModeFast)
+    {
+        fastSince = now;
+    }
+    else if (linkStatistics.mode == LinkModeFast)
+    {
+        linkStatistics.fastTicks += (now - fastSince) & minar::platform::Time_Mask;
+    }
+
+    linkStatistics.mode = mode;
+    linkStatistics.connectionParams = *params;
+}
+
+void ANCSClient::linkIdleTimeout(uint8_t generation)
+{
+    // ignore timers superseded by new requests
+    if ((generation == linkGeneration) && (requestCount == 0))
+    {
+        requestLinkMode(LinkModeIdle);
+    }
+}
+
+ble_error_t ANCSClient::updateConnectionParams(const Gap::ConnectionParams_t* params)
+{
+    return BLE::Instance().gap().updateConnectionParams(connectionHandle, params);
+}
+
+ANCSClient::LinkStatistics_t ANCSClient::getLinkStatistics() const
+{
+    LinkStatistics_t statistics = linkStatistics;
+
+    // include the time since the fast parameters were last requested
+    if (statistics.mode == LinkModeFast)
+    {
+        statistics.fastTicks += (minar::platform::getTime() - fastSince) & minar::platform::Time_Mask;
+    }
+
+    return statistics;
+}
+
+void ANCSClient::resetLinkStatistics()
+{
+    Gap::ConnectionParams_t params = linkStatistics.connectionParams;
+    uint8_t mode = linkStatistics.mode;
+
+    memset(&linkStatistics, 0, sizeof(linkStatistics));
+
+    // keep describing the current link
+    linkStatistics.mode = mode;
+    linkStatistics.connectionParams = params;
+    fastSince = minar::platform::getTime();
+}
+
+ANCSClient::PoolStatistics_t ANCSClient::getPoolStatistics() const
+{
+    PoolStatistics_t statistics = { 0, 0, 0, 0 };
+
+#if ANCS_CLIENT_POOL_BLOCKS > 0
+    statistics.blocks = pool.getBlocks();
+    statistics.inUse = pool.getInUse();
+    statistics.highWaterMark = pool.getHighWaterMark();
+    statistics.failures = pool.getFailures();
+#endif
+
+    return statistics;
+}
+
+ANCSClient::RefreshStatistics_t ANCSClient::getRefreshStatistics() const
+{
+#if ANCS_CLIENT_REFRESH_CACHE_SIZE > 0
+    return refreshStatistics;
+#else
+    RefreshStatistics_t statistics = { 0, 0, 0, 0, 0 };
+
+    return statistics;
+#endif
+}
+
+ANCSClient::Statistics_t ANCSClient::getStatistics() const
+{
+#if ANCS_CLIENT_INSTRUMENTATION
+    Statistics_t result = statistics;
+
+    // the parser counts the responses it drops
+    result.droppedResponses = parser.getStatistics().rejected;
+#else
+    Statistics_t result;
+
+    memset(&result, 0, sizeof(result));
+#endif
+
+    return result;
+}
+
+void ANCSClient::resetStatistics()
+{
+#if ANCS_CLIENT_INSTRUMENTATION
+    uint8_t setupReached = statistics.setupReached;
+    uint32_t setupTicks[SetupStageCount];
+
+    memcpy(setupTicks, statistics.setupTicks, sizeof(setupTicks));
+    memset(&statistics, 0, sizeof(statistics));
+
+    // keep describing the current connection
+    statistics.setupReached = setupReached;
+    memcpy(statistics.setupTicks, setupTicks, sizeof(setupTicks));
+#endif
+
+    parser.resetStatistics();
+}
+
+#if ANCS_CLIENT_INSTRUMENTATION
+static int32_t snapshotValue(uint32_t value)
+{
+    return (value > 0x7FFFFFFF) ? 0x7FFFFFFF : (int32_t) value;
+}
+#endif
+
+uint32_t ANCSClient::getStatisticsSnapshot(uint8_t* buffer, uint32_t length) const
+{
+#if ANCS_CLIENT_INSTRUMENTATION
+    if ((buffer == NULL) || (length < StatisticsSnapshotLength))
+    {
+        return 0;
+    }
+
+    Statistics_t current = getStatistics();
+    Cbore encoder(buffer, length);
+
+    encoder.map(12)
+           .key(0).value(current.setupReached)
+           .key(1).array(SetupStageCount);
+
+    for (uint8_t stage = 0; stage < SetupStageCount; stage++)
+    {
+        encoder.item(snapshotValue(current.setupTicks[stage]));
+    }
+
+    encoder.key(2).array(RequestStageCount);
+
+    for (uint8_t stage = 0; stage < RequestStageCount; stage++)
+    {
+        const StageTiming_t& timing = current.requestStages[stage];
+
+        encoder.array(4)
+               .item(snapshotValue(timing.count))
+               .item(snapshotValue(timing.lastTicks))
+               .item(snapshotValue(timing.maxTicks))
+               .item(snapshotValue(timing.totalTicks));
+    }
+
+    encoder.key(3).value(snapshotValue(current.bytesReceived))
+           .key(4).value(snapshotValue(current.fragments))
+           .key(5).value(snapshotValue(current.notifications))
+           .key(6).value(snapshotValue(current.silentEvents))
+           .key(7).value(snapshotValue(current.droppedEvents))
+           .key(8).value(snapshotValue(current.droppedResponses))
+           .key(9).value(snapshotValue(current.retries))
+           .key(10).value(snapshotValue(current.allocationFailures));
+
+    return encoder.getLength();
+#else
+    (void) buffer;
+    (void) length;
+
+    return 0;
+#endif
+}
+
+/*
+    Ticks from the connection to the first time each setup stage is
+    reached. Reconnections and retries do not move a stage already reached.
+*/
+void ANCSClient::recordSetupStage(uint8_t stage)
+{
+#if ANCS_CLIENT_INSTRUMENTATION
+    if (!connected || (statistics.setupReached & (1 << stage)))
+    {
+        return;
+    }
+
+    statistics.setupReached |= (1 << stage);
+    statistics.setupTicks[stage] = (minar::platform::getTime() - connectedAt) & minar::platform::Time_Mask;
+#else
+    (void) stage;
+#endif
+}
+
+/*
+    Split a successful attribute request at its first and last Data Source
+    packet. The last packet is the one being parsed, so lastRequestActivity
+    holds its arrival time.
+*/
+void ANCSClient::recordRequestStages(const Request_t* request)
+{
+#if ANCS_CLIENT_INSTRUMENTATION
+    uint32_t now = minar::platform::getTime();
+    uint32_t ticks[RequestStageCount];
+
+    ticks[RequestStageFirstFragment] = (request->firstFragmentAt - request->sentAt) & minar::platform::Time_Mask;
+    ticks[RequestStageLastFragment] = (lastRequestActivity - request->firstFragmentAt) & minar::platform::Time_Mask;
+    ticks[RequestStageDispatched] = (now - lastRequestActivity) & minar::platform::Time_Mask;
+
+    for (uint8_t stage = 0; stage < RequestStageCount; stage++)
+    {
+        StageTiming_t& timing = statistics.requestStages[stage];
+
+        timing.count++;
+        timing.lastTicks = ticks[stage];
+        timing.totalTicks += ticks[stage];
+
+        if (ticks[stage] > timing.maxTicks)
+        {
+            timing.maxTicks = ticks[stage];
+        }
+    }
+#else
+    (void) request;
+#endif
+}
+
+uint16_t ANCSClient::getTrace(uint8_t* buffer, uint16_t length) const
+{
+#if ANCS_CLIENT_TRACE_SIZE > 0
+    return trace.copy(buffer, length);
+#else
+    (void) buffer;
+    (void) length;
+
+    return 0;
+#endif
+}
+
+void ANCSClient::clearTrace()
+{
+#if ANCS_CLIENT_TRACE_SIZE > 0
+    trace.clear();
+#endif
+}
+
+/*
+    Append to the trace with the milliseconds since the previous record.
+*/
+void ANCSClient::traceEvent(uint8_t type, const uint8_t* data, uint16_t length)
+{
+#if ANCS_CLIENT_TRACE_SIZE > 0
+    uint32_t now = minar::platform::getTime();
+    uint32_t elapsed = (now - traceTime) & minar::platform::Time_Mask;
+    uint32_t tick = minar::milliseconds(1);
+
+    traceTime = now;
+    trace.record(type, data, length, (tick > 0) ? elapsed / tick : elapsed);
+#else
+    (void) type;
+    (void) data;
+    (void) length;
+#endif
+}
+
+bool ANCSClient::findNotification(uint32_t notificationUID, Notification_t* notification) const
+{
+#if ANCS_CLIENT_STORE_SIZE > 0
+    int32_t slot = store.find(notificationUID);
+
+    return (slot >= 0) && getNotificationAt(slot, notification);
+#else
+    (void) notificationUID;
+    (void) notification;
+
+    return false;
+#endif
+}
+
+bool ANCSClient::getNotificationAt(uint16_t slot, Notification_t* notification) const
+{
+#if ANCS_CLIENT_STORE_SIZE > 0
+    const ANCSNotificationStore<ANCS_CLIENT_STORE_SIZE>::Entry_t* entry = store.at(slot);
+
+    if (entry == NULL)
+    {
+        return false;
+    }
+
+    if (notification)
+    {
+        notification->eventID = entry->eventID;
+        notification->eventFlags = entry->eventFlags;
+        notification->categoryID = entry->categoryID;
+        notification->categoryCount = store.getCategoryCount(entry->categoryID);
+        notification->notificationUID = entry->notificationUID;
+        notification->connectionHandle = connectionHandle;
+    }
+
+    return true;
+#else
+    (void) slot;
+    (void) notification;
+
+    return false;
+#endif
+}
+
+uint16_t ANCSClient::getNotificationCapacity() const
+{
+#if ANCS_CLIENT_STORE_SIZE > 0
+    return store.getCapacity();
+#else
+    return 0;
+#endif
+}
+
+uint16_t ANCSClient::getNotificationCount() const
+{
+#if ANCS_CLIENT_STORE_SIZE > 0
+    return store.getCount();
+#else
+    return 0;
+#endif
+}
+
+uint16_t ANCSClient::getCategoryCount(category_id_t categoryID) const
+{
+#if ANCS_CLIENT_STORE_SIZE > 0
+    return store.getCategoryCount(categoryID);
+#else
+    (void) categoryID;
+
+    return 0;
+#endif
+}
+
+void ANCSClient::updateStore(const Notification_t& event)
+{
+#if ANCS_CLIENT_STORE_SIZE > 0
+    if (event.eventID == EventIDNotificationRemoved)
+    {
+        store.remove(event.notificationUID);
+    }
+    else if (!store.update(event.notificationUID, event.eventID, event.eventFlags, event.categoryID))
+    {
+        DEBUGOUT("ancs: store full\r\n");
+    }
+#else
+    (void) event;
+#endif
+}
+
+/*****************************************************************************/
+/* BLE maintainance                                                          */
+/*****************************************************************************/
+
+/*
+    A characteristic that notifies must have a CCCD. If the value is
+    followed by a single attribute before the next characteristic, that
+    attribute is the CCCD and descriptor discovery can be skipped.
+    Returns 0 when descriptors have to be discovered.
+*/
+static GattAttribute::Handle_t impliedCCCD(const DiscoveredCharacteristic* characteristicP)
+{
+    if (characteristicP->getLastHandle() == characteristicP->getValueHandle() + 1)
+    {
+        return characteristicP->getLastHandle();
+    }
+
+    return 0;
+}
+
+void ANCSClient::onConnection(const Gap::ConnectionCallbackParams_t* params)
+{
+    // connected as peripheral to a central
+    if (params->role == Gap::PERIPHERAL)
+    {
+        connected = true;
+        connectionHandle = params->handle;
+
+        uint8_t peer[7] = { (uint8_t) params->peerAddrType };
+        memcpy(&peer[1], params->peerAddr, 6);
+        traceEvent(ANCSTraceRecorder<1>::RecordConnect, peer, sizeof(peer));
+
+        linkStatistics.mode = LinkModeDefault;
+
+#if ANCS_CLIENT_INSTRUMENTATION
+        connectedAt = minar::platform::getTime();
+        statistics.setupReached = 0;
+        memset(statistics.setupTicks, 0, sizeof(statistics.setupTicks));
+#endif
+
+        if (params->connectionParams)
+        {
+            linkStatistics.connectionParams = *params->connectionParams;
+        }
+        peerAddrType = params->peerAddrType;
+        memcpy(peerAddr, params->peerAddr, sizeof(peerAddr));
+
+        // seed retry jitter so that phones connecting together spread out
+        jitter ^= ((uint32_t) peerAddr[0] << 24) | ((uint32_t) peerAddr[1] << 16) | connectionHandle;
+        jitter ^= minar::platform::getTime();
+
+        if (jitter == 0)
+        {
+            jitter = 1;
+        }
+
+#if ANCS_CLIENT_APP_CACHE_SIZE > 0
+        // names are only trusted from the bonded peer that provided them
+        if (!ANCS_CLIENT_APP_CACHE_PERSIST ||
+            !appCacheBonded ||
+            (appCachePeerType != params->peerAddrType) ||
+            (memcmp(appCachePeer, params->peerAddr, sizeof(appCachePeer)) != 0))
+        {
+            appCache.clear();
+        }
+
+        appCachePeerType = params->peerAddrType;
+        memcpy(appCachePeer, params->peerAddr, sizeof(appCachePeer));
+        appCacheBonded = false;
+#endif
+
+#if ANCS_CLIENT_HANDLE_CACHE_SIZE > 0
+        // known phone: check the cached handles instead of discovering them
+        if (handleCache.lookup(peerAddrType, peerAddr, &cachedHandles))
+        {
+            DEBUGOUT("ancs: handles cached\r\n");
+
+            validatingHandles = true;
+
+            minar::Scheduler::postCallback(this, &ANCSClient::validateHandles);
+            minar::Scheduler::postCallback(this, &ANCSClient::secureConnection);
+            return;
+        }
+#endif
+
+        beginDiscovery(DiscoveryStageService);
+        minar::Scheduler::postCallback(this, &ANCSClient::startDiscovery);
+    }
+}
+
+void ANCSClient::setDiscoveryRetry(uint8_t retries, uint16_t delayMs, uint16_t delayMaxMs)
+{
+    discoveryRetries = retries;
+    discoveryDelay = (delayMs) ? delayMs : 1;
+    discoveryDelayMax = (delayMaxMs > discoveryDelay) ? delayMaxMs : discoveryDelay;
+}
+
+void ANCSClient::beginDiscovery(uint8_t stage)
+{
+    discoveryStage = stage;
+    discoveryRetriesLeft = discoveryRetries;
+    discoveryAttempts = 0;
+}
+
+void ANCSClient::startDiscovery()
+{
+    if (!connected || (discoveryStage == DiscoveryStageNone) || discoveryRunning)
+    {
+        return;
+    }
+
+    // a pending retry timer is superseded by this attempt
+    discoveryGeneration++;
+
+    if (discoveryStage == DiscoveryStageDescriptors)
+    {
+        // descriptor discovery is per characteristic; other connections
+        // discovering services do not get in the way
+        discoveryAttempts++;
+
+        ble_error_t result = (notificationSourceCCCD) ? discoverDescriptors(dataSourceCharacteristic)
+                                                      : discoverDescriptors(notificationSourceCharacteristic);
+
+        if (result == BLE_ERROR_NONE)
+        {
+            discoveryRunning = true;
+        }
+        else
+        {
+            retryDiscovery();
+        }
+    }
+    else if (isServiceDiscoveryActive() == false)
+    {
+        DEBUGOUT("ancs: discovery begin: %u\r\n", discoveryStage);
+
+        // discovered services carry no connection handle
+        ANCSDispatcher::setDiscoveringSession(this);
+
+        discoveryAttempts++;
+
+        ble_error_t result = launchServiceDiscovery(discoveryStage == DiscoveryStageCharacteristics);
+
+        if (result == BLE_ERROR_NONE)
+        {
+            discoveryRunning = true;
+        }
+        else
+        {
+            retryDiscovery();
+        }
+    }
+    else
+    {
+        // another connection is discovering; start when it is done, or
+        // after a backoff in case its termination is never seen
+        discoveryDeferred = true;
+        scheduleDiscovery(backoffDelay());
+    }
+}
+
+/*
+    Retry the current stage after a backoff, or give up when the budget is
+    spent. Delays double from discoveryDelay up to discoveryDelayMax, and a
+    random part keeps connections from retrying in lockstep.
+*/
+void ANCSClient::retryDiscovery()
+{
+    if (discoveryRetriesLeft == 0)
+    {
+        DEBUGOUT("ancs: discovery failed: %u\r\n", discoveryStage);
+
+        if (discoveryFailedHandler)
+        {
+            DiscoveryFailure_t failure;
+            failure.connectionHandle = connectionHandle;
+            failure.stage = discoveryStage;
+            failure.attempts = discoveryAttempts;
+
+            minar::Scheduler::postCallback(discoveryFailedHandler.bind(failure));
+        }
+
+        discoveryStage = DiscoveryStageNone;
+        return;
+    }
+
+    discoveryRetriesLeft--;
+    COUNT(retries, 1);
+    scheduleDiscovery(backoffDelay());
+}
+
+uint16_t ANCSClient::backoffDelay()
+{
+    uint32_t delay = discoveryDelay;
+
+    for (uint8_t attempt = 1; (attempt < discoveryAttempts) && (delay < discoveryDelayMax); attempt++)
+    {
+        delay <<= 1;
+    }
+
+    if (delay > discoveryDelayMax)
+    {
+        delay = discoveryDelayMax;
+    }
+
+    // xorshift; wait between half and all of the delay
+    jitter ^= jitter << 13;
+    jitter ^= jitter >> 17;
+    jitter ^= jitter << 5;
+
+    return (delay / 2) + (jitter % ((delay / 2) + 1));
+}
+
+void ANCSClient::scheduleDiscovery(uint16_t delayMs)
+{
+    FunctionPointer1<void, uint8_t> retry(this, &ANCSClient::discoveryTimeout);
+
+    minar::Scheduler::postCallback(retry.bind(discoveryGeneration))
+        .delay(minar::milliseconds(delayMs));
+}
+
+void ANCSClient::discoveryTimeout(uint8_t generation)
+{
+    // ignore timers superseded by a later start or by disconnection
+    if (generation == discoveryGeneration)
+    {
+        discoveryDeferred = false;
+        startDiscovery();
+    }
+}
+
+void ANCSClient::serviceDiscoveryCallback(const DiscoveredService*)
+{
+    DEBUGOUT("ancs: found service\r\n");
+
+    recordSetupStage(SetupStageServiceFound);
+
+    // terminate discovery
+    discoveryStage = DiscoveryStageNone;
+    discoveryRunning = false;
+    terminateServiceDiscovery();
+
+    // secure connection so we can access characteristics
+    minar::Scheduler::postCallback(this, &ANCSClient::secureConnection);
+}
+
+void ANCSClient::secureConnection()
+{
+    // get current link status
+    SecurityManager::LinkSecurityStatus_t securityStatus = getLinkSecurity();
+
+    // do discovery when connection is encrypted, unless the handles are known
+    bool discover = ((state & (FLAG_NOTIFICATION | FLAG_CONTROL | FLAG_DATA)) != (FLAG_NOTIFICATION | FLAG_CONTROL | FLAG_DATA));
+
+#if ANCS_CLIENT_HANDLE_CACHE_SIZE > 0
+    discover = discover && !validatingHandles;
+#endif
+
+    if (discover && (discoveryStage != DiscoveryStageCharacteristics))
+    {
+        beginDiscovery(DiscoveryStageCharacteristics);
+    }
+
+    // authenticate if link is not encrypted
+    if (securityStatus == SecurityManager::NOT_ENCRYPTED)
+    {
+        setLinkSecurity(SecurityManager::SECURITY_MODE_ENCRYPTION_NO_MITM);
+    }
+    else
+    {
+        DEBUGOUT("ancs: link already encrypted\r\n");
+
+        state |= FLAG_ENCRYPTION;
+        recordSetupStage(SetupStageLinkSecured);
+
+#if ANCS_CLIENT_APP_CACHE_SIZE > 0
+        appCacheBonded = true;
+#endif
+
+        if (discoveryStage == DiscoveryStageCharacteristics)
+        {
+            minar::Scheduler::postCallback(this, &ANCSClient::startDiscovery);
+        }
+
+        serviceReady();
+    }
+}
+
+void ANCSClient::linkSecured(Gap::Handle_t, SecurityManager::SecurityMode_t mode)
+{
+    uint8_t traced = mode;
+    traceEvent(ANCSTraceRecorder<1>::RecordSecured, &traced, 1);
+
+    state |= FLAG_ENCRYPTION;
+    recordSetupStage(SetupStageLinkSecured);
+
+#if ANCS_CLIENT_APP_CACHE_SIZE > 0
+    // ANCS requires pairing and the security manager bonds by default
+    appCacheBonded = true;
+#endif
+
+    DEBUGOUT("ancs: link secured: %02X\r\n", mode);
+
+    if (discoveryStage == DiscoveryStageCharacteristics)
+    {
+        minar::Scheduler::postCallback(this, &ANCSClient::startDiscovery);
+    }
+
+    // cached handles may already have been validated
+    serviceReady();
+}
+
+void ANCSClient::characteristicDiscoveryCallback(const DiscoveredCharacteristic* characteristicP)
+{
+    DEBUGOUT("ancs: discovered characteristic\r\n");
+    DEBUGOUT("ancs: uuid: %04X %02X %02X\r\n", characteristicP->getUUID().getShortUUID(),
+                                               characteristicP->getValueHandle(),
+                                               *((uint8_t*)&(characteristicP->getProperties())));
+
+    uint16_t uuid = characteristicP->getUUID().getShortUUID();
+
+    if (uuid == 0x120D)
+    {
+        notificationSourceCharacteristic = *characteristicP;
+        notificationSourceDeclaration = characteristicP->getDeclHandle();
+        notificationSource = characteristicP->getValueHandle();
+        notificationSourceCCCD = impliedCCCD(characteristicP);
+        state |= FLAG_NOTIFICATION;
+
+        DEBUGOUT("ancs: notification source: %02X\r\n", state);
+    }
+    else if (uuid == 0xD8F3)
+    {
+        controlPointDeclaration = characteristicP->getDeclHandle();
+        controlPoint = characteristicP->getValueHandle();
+        controlPointWriteCommand = characteristicP->getProperties().writeWoResp();
+        state |= FLAG_CONTROL;
+
+        DEBUGOUT("ancs: control point: %02X\r\n", state);
+    }
+    else if (uuid == 0xC6E9)
+    {
+        dataSourceCharacteristic = *characteristicP;
+        dataSourceDeclaration = characteristicP->getDeclHandle();
+        dataSource = characteristicP->getValueHandle();
+        dataSourceCCCD = impliedCCCD(characteristicP);
+        state |= FLAG_DATA;
+
+        DEBUGOUT("ancs: data source: %02X\r\n", state);
+    }
+
+    if (state == (FLAG_NOTIFICATION | FLAG_CONTROL | FLAG_DATA | FLAG_ENCRYPTION))
+    {
+        recordSetupStage(SetupStageCharacteristicsFound);
+
+        discoveryRunning = false;
+        terminateServiceDiscovery();
+
+        if (notificationSourceCCCD && dataSourceCCCD)
+        {
+            descriptorsFound();
+        }
+        else
+        {
+            beginDiscovery(DiscoveryStageDescriptors);
+            minar::Scheduler::postCallback(this, &ANCSClient::startDiscovery);
+        }
+    }
+}
+
+void ANCSClient::descriptorDiscoveryCallback(const CharacteristicDescriptorDiscovery::DiscoveryCallbackParams_t* params)
+{
+    if ((params->characteristic.getConnectionHandle() != connectionHandle) ||
+        (params->descriptor.getUUID().getShortUUID() != GattCharacteristic::BLE_UUID_DESCRIPTOR_CLIENT_CHAR_CONFIG))
+    {
+        return;
+    }
+
+    DEBUGOUT("ancs: cccd: %04X\r\n", params->descriptor.getAttributeHandle());
+
+    if (params->characteristic.getValueHandle() == notificationSource)
+    {
+        notificationSourceCCCD = params->descriptor.getAttributeHandle();
+    }
+    else if (params->characteristic.getValueHandle() == dataSource)
+    {
+        dataSourceCCCD = params->descriptor.getAttributeHandle();
+    }
+
+    // a characteristic has only one CCCD; no need to look further
+    terminateDescriptorDiscovery(params->characteristic);
+}
+
+void ANCSClient::descriptorDiscoveryTermination(const CharacteristicDescriptorDiscovery::TerminationCallbackParams_t* params)
+{
+    if ((params->characteristic.getConnectionHandle() != connectionHandle) ||
+        (discoveryStage != DiscoveryStageDescriptors) ||
+        !discoveryRunning)
+    {
+        return;
+    }
+
+    discoveryRunning = false;
+
+    bool found = (params->characteristic.getValueHandle() == notificationSource) ? (notificationSourceCCCD != 0)
+                                                                                 : (dataSourceCCCD != 0);
+
+    if (notificationSourceCCCD && dataSourceCCCD)
+    {
+        descriptorsFound();
+    }
+    else if (found)
+    {
+        // other characteristic next, with a budget of its own
+        beginDiscovery(DiscoveryStageDescriptors);
+        minar::Scheduler::postCallback(this, &ANCSClient::startDiscovery);
+    }
+    else
+    {
+        retryDiscovery();
+    }
+}
+
+void ANCSClient::descriptorsFound()
+{
+    discoveryStage = DiscoveryStageNone;
+    state |= FLAG_DESCRIPTORS;
+
+    serviceReady();
+}
+
+/*
+    Subscribe once the link is encrypted and all characteristics and CCCDs
+    are known, either from discovery or from the handle cache.
+*/
+void ANCSClient::serviceReady()
+{
+    if (state != (FLAG_NOTIFICATION | FLAG_CONTROL | FLAG_DATA | FLAG_ENCRYPTION | FLAG_DESCRIPTORS))
+    {
+        return;
+    }
+
+    DEBUGOUT("ancs: subscribe\r\n");
+
+    state |= FLAG_SUBSCRIBING;
+
+#if ANCS_CLIENT_HANDLE_CACHE_SIZE > 0
+    // an encrypted link may have been paired without storing a bond
+    if (isBonded())
+    {
+        ANCSHandleCache<ANCS_CLIENT_HANDLE_CACHE_SIZE>::Entry_t entry;
+        entry.peerAddrType = peerAddrType;
+        memcpy(entry.peerAddr, peerAddr, sizeof(entry.peerAddr));
+        entry.notificationSourceDeclaration = notificationSourceDeclaration;
+        entry.notificationSource = notificationSource;
+        entry.notificationSourceCCCD = notificationSourceCCCD;
+        entry.controlPointDeclaration = controlPointDeclaration;
+        entry.controlPoint = controlPoint;
+        entry.controlPointWriteCommand = controlPointWriteCommand;
+        entry.dataSourceDeclaration = dataSourceDeclaration;
+        entry.dataSource = dataSource;
+        entry.dataSourceCCCD = dataSourceCCCD;
+
+        handleCache.insert(entry);
+    }
+#endif
+
+    minar::Scheduler::postCallback(this, &ANCSClient::subscribe);
+}
+
+/*
+    Both CCCDs are written with response, back to back. Data Source goes
+    first so that it is subscribed before the first notification can
+    trigger a request. Stacks allowing only one outstanding ATT request
+    reject the second write; it is sent when the first is confirmed.
+*/
+void ANCSClient::subscribe()
+{
+    if (!(state & FLAG_SUBSCRIBING))
+    {
+        return;
+    }
+
+    if (!(state & FLAG_DATA_SUBSCRIBE) &&
+        (writeDescriptor(dataSourceCCCD, BLE_HVX_NOTIFICATION) == BLE_ERROR_NONE))
+    {
+        DEBUGOUT("ancs: data subscribe sent\r\n");
+
+        state |= FLAG_DATA_SUBSCRIBE;
+    }
+
+    if (!(state & FLAG_NOTIFICATION_SUBSCRIBE) &&
+        (writeDescriptor(notificationSourceCCCD, BLE_HVX_NOTIFICATION) == BLE_ERROR_NONE))
+    {
+        DEBUGOUT("ancs: notification subscribe sent\r\n");
+
+        state |= FLAG_NOTIFICATION_SUBSCRIBE;
+    }
+}
+
+void ANCSClient::subscriptionConfirmed(uint16_t flag)
+{
+    if (state & flag)
+    {
+        return;
+    }
+
+    state |= flag;
+
+    // a write rejected while the other was outstanding can go now
+    subscribe();
+
+    if (isReady())
+    {
+        DEBUGOUT("ancs: ready\r\n");
+
+        recordSetupStage(SetupStageSubscribed);
+
+        if (serviceFoundHandler)
+        {
+            minar::Scheduler::postCallback(serviceFoundHandler);
+        }
+    }
+}
+
+ble_error_t ANCSClient::writeDescriptor(GattAttribute::Handle_t handle, uint16_t value)
+{
+    const uint8_t payload[2] = { (uint8_t) value, (uint8_t) (value >> 8) };
+
+    return BLE::Instance().gattClient().write(GattClient::GATT_OP_WRITE_REQ,
+                                              connectionHandle,
+                                              handle,
+                                              sizeof(payload),
+                                              payload);
+}
+
+ble_error_t ANCSClient::discoverDescriptors(const DiscoveredCharacteristic& characteristic)
+{
+    return characteristic.discoverDescriptors(CharacteristicDescriptorDiscovery::DiscoveryCallback_t(this, &ANCSClient::descriptorDiscoveryCallback),
+                                              CharacteristicDescriptorDiscovery::TerminationCallback_t(this, &ANCSClient::descriptorDiscoveryTermination));
+}
+
+void ANCSClient::terminateDescriptorDiscovery(const DiscoveredCharacteristic& characteristic)
+{
+    BLE::Instance().gattClient().terminateCharacteristicDescriptorDiscovery(characteristic);
+}
+
+ble_error_t ANCSClient::launchServiceDiscovery(bool characteristics)
+{
+    if (characteristics)
+    {
+        return BLE::Instance().gattClient()
+                              .launchServiceDiscovery(connectionHandle,
+                                                      NULL,
+                                                      ANCSDispatcher::characteristicDiscoveryCallback,
+                                                      ANCS::UUID);
+    }
+
+    return BLE::Instance().gattClient()
+                          .launchServiceDiscovery(connectionHandle,
+                                                  ANCSDispatcher::serviceDiscoveryCallback,
+                                                  NULL,
+                                                  ANCS::UUID);
+}
+
+bool ANCSClient::isServiceDiscoveryActive()
+{
+    return BLE::Instance().gattClient().isServiceDiscoveryActive();
+}
+
+void ANCSClient::terminateServiceDiscovery()
+{
+    BLE::Instance().gattClient().terminateServiceDiscovery();
+}
+
+SecurityManager::LinkSecurityStatus_t ANCSClient::getLinkSecurity()
+{
+    SecurityManager::LinkSecurityStatus_t securityStatus = SecurityManager::NOT_ENCRYPTED;
+    BLE::Instance().securityManager().getLinkSecurity(connectionHandle, &securityStatus);
+
+    return securityStatus;
+}
+
+ble_error_t ANCSClient::setLinkSecurity(SecurityManager::SecurityMode_t mode)
+{
+    return BLE::Instance().securityManager().setLinkSecurity(connectionHandle, mode);
+}
+
+/*
+    Peers using resolvable private addresses are only found if the stack
+    lists them under that address; otherwise they are treated as unbonded.
+*/
+bool ANCSClient::isBonded()
+{
+    BLEProtocol::Address_t addresses[BOND_TABLE_SIZE];
+    Gap::Whitelist_t bonds;
+    bonds.addresses = addresses;
+    bonds.size = 0;
+    bonds.capacity = BOND_TABLE_SIZE;
+
+    if (BLE::Instance().securityManager().getAddressesFromBondTable(bonds) != BLE_ERROR_NONE)
+    {
+        return false;
+    }
+
+    for (uint8_t index = 0; index < bonds.size; index++)
+    {
+        if ((addresses[index].type == peerAddrType) &&
+            (memcmp(addresses[index].address, peerAddr, sizeof(peerAddr)) == 0))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+#if ANCS_CLIENT_HANDLE_CACHE_SIZE > 0
+/*
+    Cached declaration read back at each validation step, with the value
+    handle and UUID it must hold.
+*/
+static GattAttribute::Handle_t cachedDeclaration(const ANCSHandleCache<ANCS_CLIENT_HANDLE_CACHE_SIZE>::Entry_t& entry,
+                                                 uint8_t step,
+                                                 GattAttribute::Handle_t* value,
+                                                 const uint8_t** uuid)
+{
+    switch (step)
+    {
+        case 0:
+            *value = entry.notificationSource;
+            *uuid = NotificationSourceUUID;
+            return entry.notificationSourceDeclaration;
+
+        case 1:
+            *value = entry.controlPoint;
+            *uuid = ControlPointUUID;
+            return entry.controlPointDeclaration;
+
+        default:
+            *value = entry.dataSource;
+            *uuid = DataSourceUUID;
+            return entry.dataSourceDeclaration;
+    }
+}
+#endif
+
+/*
+    Reads of the Notification Source, Control Point, and Data Source
+    declarations confirm that the cached handles still match the phone's
+    GATT database. Each declaration holds the properties, the value handle,
+    and the characteristic UUID.
+*/
+void ANCSClient::validateHandles()
+{
+#if ANCS_CLIENT_HANDLE_CACHE_SIZE > 0
+    if (!validatingHandles)
+    {
+        return;
+    }
+
+    validationStep = 0;
+
+    // the read responses may never come if the handles are no longer valid
+    FunctionPointer1<void, Gap::Handle_t> timeout(this, &ANCSClient::validationTimeout);
+
+    minar::Scheduler::postCallback(timeout.bind(connectionHandle))
+        .delay(minar::milliseconds(HANDLE_VALIDATION_TIMEOUT_MS));
+
+    readDeclaration();
+#endif
+}
+
+void ANCSClient::readDeclaration()
+{
+#if ANCS_CLIENT_HANDLE_CACHE_SIZE > 0
+    GattAttribute::Handle_t value;
+    const uint8_t* uuid;
+
+    if (readAttribute(cachedDeclaration(cachedHandles, validationStep, &value, &uuid)) != BLE_ERROR_NONE)
+    {
+        handlesValidated(false);
+    }
+#endif
+}
+
+void ANCSClient::validationTimeout(Gap::Handle_t handle)
+{
+#if ANCS_CLIENT_HANDLE_CACHE_SIZE > 0
+    if (connected && (handle == connectionHandle) && validatingHandles)
+    {
+        DEBUGOUT("ancs: handle validation timeout\r\n");
+
+        handlesValidated(false);
+    }
+#else
+    (void) handle;
+#endif
+}
+
+void ANCSClient::dataRead(const GattReadCallbackParams* params)
+{
+#if ANCS_CLIENT_HANDLE_CACHE_SIZE > 0
+    GattAttribute::Handle_t value;
+    const uint8_t* uuid;
+
+    if ((params->connHandle == connectionHandle) &&
+        validatingHandles &&
+        (params->handle == cachedDeclaration(cachedHandles, validationStep, &value, &uuid)))
+    {
+        // properties, value handle, 128-bit UUID in little endian order
+        bool valid = (params->len == 19) &&
+                     ((params->data[1] | (params->data[2] << 8)) == value);
+
+        for (uint8_t index = 0; valid && (index < 16); index++)
+        {
+            valid = (params->data[3 + index] == uuid[15 - index]);
+        }
+
+        if (valid && (++validationStep < 3))
+        {
+            readDeclaration();
+            return;
+        }
+
+        handlesValidated(valid);
+    }
+#else
+    (void) params;
+#endif
+}
+
+void ANCSClient::handlesValidated(bool valid)
+{
+#if ANCS_CLIENT_HANDLE_CACHE_SIZE > 0
+    validatingHandles = false;
+
+    if (valid)
+    {
+        DEBUGOUT("ancs: cached handles valid\r\n");
+
+        notificationSourceDeclaration = cachedHandles.notificationSourceDeclaration;
+        notificationSource = cachedHandles.notificationSource;
+        notificationSourceCCCD = cachedHandles.notificationSourceCCCD;
+        controlPointDeclaration = cachedHandles.controlPointDeclaration;
+        controlPoint = cachedHandles.controlPoint;
+        controlPointWriteCommand = cachedHandles.controlPointWriteCommand;
+        dataSourceDeclaration = cachedHandles.dataSourceDeclaration;
+        dataSource = cachedHandles.dataSource;
+        dataSourceCCCD = cachedHandles.dataSourceCCCD;
+        state |= FLAG_NOTIFICATION | FLAG_CONTROL | FLAG_DATA | FLAG_DESCRIPTORS;
+
+        // the cached handles stand in for both discoveries
+        recordSetupStage(SetupStageServiceFound);
+        recordSetupStage(SetupStageCharacteristicsFound);
+
+        serviceReady();
+    }
+    else
+    {
+        DEBUGOUT("ancs: cached handles stale\r\n");
+
+        // GATT database has changed; discover from scratch once encrypted
+        handleCache.remove(peerAddrType, peerAddr);
+        beginDiscovery(DiscoveryStageCharacteristics);
+
+        if (state & FLAG_ENCRYPTION)
+        {
+            minar::Scheduler::postCallback(this, &ANCSClient::startDiscovery);
+        }
+    }
+#else
+    (void) valid;
+#endif
+}
+
+ble_error_t ANCSClient::readAttribute(GattAttribute::Handle_t handle)
+{
+    return BLE::Instance().gattClient().read(connectionHandle, handle, 0);
+}
+
+void ANCSClient::clearHandleCache()
+{
+#if ANCS_CLIENT_HANDLE_CACHE_SIZE > 0
+    handleCache.clear();
+#endif
+}
+
+void ANCSClient::discoveryTerminationCallback(Gap::Handle_t handle)
+{
+    // descriptor discovery reports its own termination
+    if ((handle == connectionHandle) && discoveryRunning && (discoveryStage != DiscoveryStageDescriptors))
+    {
+        discoveryRunning = false;
+
+        // discovery ended without finding everything
+        if (discoveryStage != DiscoveryStageNone)
+        {
+            retryDiscovery();
+        }
+        else
+        {
+            DEBUGOUT("ancs: discovery done\r\n");
+        }
+    }
+}
+
+void ANCSClient::discoveryIdle()
+{
+    // start right away instead of waiting for the backoff timer
+    if (discoveryDeferred)
+    {
+        discoveryDeferred = false;
+
+        minar::Scheduler::postCallback(this, &ANCSClient::startDiscovery);
+    }
+}
+
+void ANCSClient::onDisconnection(const Gap::DisconnectionCallbackParams_t* params)
+{
+    if (params->handle == connectionHandle)
+    {
+        DEBUGOUT("ancs: disconnected: reset\r\n");
+
+        uint8_t reason = params->reason;
+        traceEvent(ANCSTraceRecorder<1>::RecordDisconnect, &reason, 1);
+
+        connected = false;
+        connectionHandle = 0;
+        discoveryStage = DiscoveryStageNone;
+        discoveryRunning = false;
+        discoveryDeferred = false;
+        discoveryGeneration++;
+        state = 0;
+
+        notificationSourceDeclaration = 0;
+        notificationSource = 0;
+        notificationSourceCCCD = 0;
+        controlPointDeclaration = 0;
+        controlPoint = 0;
+        dataSourceDeclaration = 0;
+        dataSource = 0;
+        dataSourceCCCD = 0;
+        notificationSourceCharacteristic = DiscoveredCharacteristic();
+        dataSourceCharacteristic = DiscoveredCharacteristic();
+
+        // account for fast time up to the disconnection
+        linkStatistics = getLinkStatistics();
+        linkStatistics.mode = LinkModeDefault;
+        linkGeneration++;
+
+        requestGeneration++;
+        requestTimerPending = false;
+
+#if ANCS_CLIENT_HANDLE_CACHE_SIZE > 0
+        validatingHandles = false;
+#endif
+
+        resetDataSource();
+        staleCount = 0;
+
+        prefetchCount = 0;
+        failRequests(RequestStatusDisconnected);
+
+        // pending events are replayed as pre-existing on reconnection
+        batchCount = 0;
+        batchReceived = 0;
+
+#if ANCS_CLIENT_STORE_SIZE > 0
+        // the phone sends every notification again as pre-existing on reconnection
+        store.clear();
+#endif
+
+#if ANCS_CLIENT_REFRESH_CACHE_SIZE > 0
+        // UIDs are only valid for one connection
+        refreshCache.clear();
+#endif
+    }
+}
+
+/*****************************************************************************/
+/* Event handlers                                                            */
+/*****************************************************************************/
+
+void ANCSClient::hvxCallback(const GattHVXCallbackParams* params)
+{
+    // check that the message belongs to this connection and characteristic
+    if ((params->connHandle == connectionHandle) &&
+        (params->handle == notificationSource))
+    {
+        Notification_t event;
+
+        traceEvent(ANCSTraceRecorder<1>::RecordNotificationSource, params->data, params->len);
+
+        COUNT(bytesReceived, params->len);
+
+        // anything shorter than an event is not one
+        if (!Codec::decodeNotification(params->data, params->len, event))
+        {
+            DEBUGOUT("ancs: short notification: %u\r\n", params->len);
+            COUNT(droppedEvents, 1);
+            return;
+        }
+
+        COUNT(notifications, 1);
+        COUNT(silentEvents, (event.eventFlags & EventFlagSilent) ? 1 : 0);
+
+        event.connectionHandle = connectionHandle;
+
+        // mirror every event, including the ones not passed on
+        updateStore(event);
+
+#if ANCS_CLIENT_REFRESH_CACHE_SIZE > 0
+        if (event.eventID == EventIDNotificationRemoved)
+        {
+            refreshCache.remove(event.notificationUID);
+        }
+#endif
+
+        if (coalesceWindow)
+        {
+            coalesce(event);
+        }
+        else
+        {
+            deliverNotification(event, false);
+        }
+    }
+    else if ((params->connHandle == connectionHandle) && (params->handle == dataSource))
+    {
+        traceEvent(ANCSTraceRecorder<1>::RecordDataSource, params->data, params->len);
+
+        linkStatistics.transferBytes += params->len;
+        COUNT(bytesReceived, params->len);
+        COUNT(fragments, 1);
+
+        if (params->len > linkStatistics.maxPayload)
+        {
+            linkStatistics.maxPayload = params->len;
+        }
+
+        lastRequestActivity = minar::platform::getTime();
+
+        if (parser.isSkipping() && startsResponse(params->data, params->len))
+        {
+            parser.reset();
+        }
+
+        parser.parse(params->data, params->len);
+    }
+}
+
+void ANCSClient::dataWritten(const GattWriteCallbackParams* params)
+{
+    // Control Point write has completed; the next command can be sent
+    if ((params->connHandle == connectionHandle) &&
+        (params->handle == controlPoint) &&
+        writeInProgress)
+    {
+        for (uint8_t index = 0; index < requestCount; index++)
+        {
+            Request_t* request = &requestQueue[(requestHead + index) % ANCS_CLIENT_QUEUE_SIZE];
+
+            if (request->state == REQUEST_WRITING)
+            {
+                request->state = REQUEST_SENT;
+                lastRequestActivity = minar::platform::getTime();
+
+                // actions have no Data Source response, and the write
+                // response carries no ATT status on BLE API 2.x
+                if (request->command == CommandIDPerformNotificationAction)
+                {
+                    completeRequest(request, RequestStatusSent);
+                }
+            }
+        }
+
+        writeInProgress = false;
+        sendNextRequest();
+    }
+    else if ((params->connHandle == connectionHandle) &&
+             (params->handle == dataSourceCCCD) &&
+             (state & FLAG_DATA_SUBSCRIBE))
+    {
+        subscriptionConfirmed(FLAG_DATA_CONFIRMED);
+    }
+    else if ((params->connHandle == connectionHandle) &&
+             (params->handle == notificationSourceCCCD) &&
+             (state & FLAG_NOTIFICATION_SUBSCRIBE))
+    {
+        subscriptionConfirmed(FLAG_NOTIFICATION_CONFIRMED);
+    }
+}
+
+/*
+    Data Source responses are reassembled by the parser, which knows the
+    framing only. Responses are matched to requests here, by command ID,
+    notification UID or app identifier, and attribute ID.
+*/
+bool ANCSClient::responseStarted(uint8_t commandID, uint32_t notificationUID, const char* appIdentifier)
+{
+    uint8_t staleAttributes = (staleCount > 0) ? drainStale(commandID, notificationUID, appIdentifier) : 0;
+
+    if (staleAttributes > 0)
+    {
+        DEBUGOUT("ancs: late response: %lu\r\n", notificationUID);
+
+        parser.setAttributeCount(staleAttributes);
+        return false;
+    }
+
+    if (!matchRequest(commandID, notificationUID, appIdentifier))
+    {
+        return false;
+    }
+
+    // a later request is answered; older late responses will not come
+    staleCount = 0;
+
+    // lets the parser skip the rest if the response is abandoned
+    parser.setAttributeCount(attributeCount(parseRequest->pendingMask));
+
+    // probes are only compared, not exported
+    if (exporter.hasSink() &&
+        (commandID == CommandIDGetNotificationAttributes) &&
+        (parseRequest->refresh != REFRESH_PROBE))
+    {
+        exporter.begin(notificationUID, parseRequest->categoryID, parseRequest->eventFlags, parseRequest->count);
+    }
+
+    return true;
+}
+
+bool ANCSClient::attributeStarted(uint8_t attributeID, uint16_t length)
+{
+    // only the attributes still pending for the request are accepted
+    if ((parseRequest == NULL) ||
+        (attributeID > NotificationAttributeIDNegativeActionLabel) ||
+        !(parseRequest->pendingMask & (1 << attributeID)))
+    {
+        DEBUGOUT("ancs: unexpected attribute: %02X\r\n", attributeID);
+
+        Request_t* request = parseRequest;
+
+        // the parser skips the rest of the response
+        dropResponse();
+
+        if (request)
+        {
+            completeRequest(request, RequestStatusMismatch);
+        }
+
+        return false;
+    }
+
+    parseRequest->responseBytes += 3 + length;
+
+    // probe values are only hashed; ID and length keep values apart
+    if (parseRequest->refresh == REFRESH_PROBE)
+    {
+        uint8_t header[3] = { attributeID, (uint8_t) length, (uint8_t) (length >> 8) };
+
+        parseRequest->fingerprint = ANCSRefreshCache<1>::fingerprint(parseRequest->fingerprint, header, sizeof(header));
+        return true;
+    }
+
+    // allocate space for the entire attribute
+    attributePayload = selectBlock(attributeID, length);
+
+    // decode while parsing, only as far as the value is buffered
+    decoding = decodedAttributeHandler && (parseRequest->command == CommandIDGetNotificationAttributes);
+
+    if (decoding)
+    {
+        decoder.start(attributeID, length, attributePayload.get() ? attributePayload->getLength() : length);
+
+        // text is only posted with its buffer, not while it is streamed
+        decoding = (decoder.getType() != ANCSAttributeDecoder::TypeText) || attributePayload.get();
+    }
+
+    if (exporter.isActive())
+    {
+        exporter.attributeStarted(attributeID, length);
+    }
+
+    if ((length == 0) && fragmentHandler && (parseRequest->command == CommandIDGetNotificationAttributes))
+    {
+        AttributeFragment_t fragment;
+        fragment.notificationUID = parser.getNotificationUID();
+        fragment.attributeID = attributeID;
+        fragment.attributeLength = 0;
+        fragment.offset = 0;
+        fragment.data = NULL;
+        fragment.length = 0;
+
+        fragmentHandler.call(&fragment);
+    }
+
+    return true;
+}
+
+void ANCSClient::attributeData(const uint8_t* data, uint16_t length, uint16_t offset)
+{
+    if (parseRequest->refresh == REFRESH_PROBE)
+    {
+        parseRequest->fingerprint = ANCSRefreshCache<1>::fingerprint(parseRequest->fingerprint, data, length);
+        return;
+    }
+
+    // store what fits; pooled and caller blocks can be shorter than the attribute
+    if (attributePayload.get() && (offset < attributePayload->getLength()))
+    {
+        uint16_t store = attributePayload->getLength() - offset;
+
+        if (store > length)
+        {
+            store = length;
+        }
+
+        attributePayload->memcpy(offset, data, store);
+    }
+
+    if (decoding)
+    {
+        decoder.update(data, length);
+    }
+
+    if (exporter.isActive())
+    {
+        exporter.attributeData(data, length);
+    }
+
+    // pass view into the received packet without copying
+    if (fragmentHandler && (parseRequest->command == CommandIDGetNotificationAttributes))
+    {
+        AttributeFragment_t fragment;
+        fragment.notificationUID = parser.getNotificationUID();
+        fragment.attributeID = parser.getAttributeID();
+        fragment.attributeLength = parser.getAttributeLength();
+        fragment.offset = offset;
+        fragment.data = data;
+        fragment.length = length;
+
+        fragmentHandler.call(&fragment);
+    }
+}
+
+bool ANCSClient::attributeCompleted()
+{
+    uint8_t attributeID = parser.getAttributeID();
+
+    if (decoding)
+    {
+        DecodedAttribute_t decoded;
+        decoded.notificationUID = parser.getNotificationUID();
+        decoded.attributeID = attributeID;
+        decoded.type = decoder.getType();
+        decoded.valid = decoder.isValid();
+        decoded.value = decoder.getValue();
+        decoded.length = decoder.getTextLength();
+        decoded.connectionHandle = connectionHandle;
+
+        if (decoded.type == ANCSAttributeDecoder::TypeText)
+        {
+            decoded.data = attributePayload;
+        }
+
+        decoding = false;
+        minar::Scheduler::postCallback(decodedAttributeHandler.bind(decoded));
+    }
+
+    if (exporter.isActive())
+    {
+        exporter.attributeCompleted();
+    }
+
+    if (parseRequest->command == CommandIDGetAppAttributes)
+    {
+        appAttributeComplete();
+    }
+    // nothing to deliver if the attribute was streamed or no buffer could be allocated
+    else if (attributePayload.get() == NULL)
+    {
+        DEBUGOUT("ancs: attribute not buffered\r\n");
+    }
+    else
+    {
+        // if callback handlers are set, pass sharedpointer buffer to them
+        if (dataHandler)
+        {
+            minar::Scheduler::postCallback(dataHandler.bind(attributePayload));
+        }
+
+        if (attributeHandler)
+        {
+            Attribute_t attribute;
+            attribute.notificationUID = parser.getNotificationUID();
+            attribute.attributeID = attributeID;
+            attribute.data = attributePayload;
+            attribute.connectionHandle = connectionHandle;
+
+            minar::Scheduler::postCallback(attributeHandler.bind(attribute));
+        }
+
+        // clear shared pointer; the block is freed when the handlers are done
+        attributePayload = SharedPointer<BlockStatic>();
+    }
+
+    parseRequest->pendingMask &= ~(1 << attributeID);
+    parseRequest->received++;
+
+    if (parseRequest->pendingMask)
+    {
+        return true;
+    }
+
+    Request_t* request = parseRequest;
+
+    resetDataSource();
+
+    if (request->refresh == REFRESH_PROBE)
+    {
+        refreshProbed(request);
+    }
+    else
+    {
+        if (request->refresh == REFRESH_FETCH)
+        {
+            refreshFetched(request);
+        }
+
+        completeRequest(request, RequestStatusSuccess);
+    }
+
+    // a low priority request may have been held back for this response
+    sendNextRequest();
+
+    return false;
+}
+
+/*
+    Attributes of a request that are collected in pool blocks.
+*/
+uint8_t ANCSClient::blocksNeeded(const AttributeRequest_t* attributes, uint8_t count) const
+{
+    uint8_t blocks = 0;
+
+    for (uint8_t index = 0; index < count; index++)
+    {
+        if ((attributes[index].buffer == NULL) && !fragmentHandler && !exporter.hasSink())
+        {
+            blocks++;
+        }
+    }
+
+    return blocks;
+}
+
+/*
+    Compare the probe with the last full fetch of the notification. If it
+    has changed, the probe becomes the full request in the same slot and
+    with the same buffers, so the fetch cannot be refused for want of
+    room, and is queued again behind the requests already written.
+*/
+void ANCSClient::refreshProbed(Request_t* probe)
+{
+#if ANCS_CLIENT_REFRESH_CACHE_SIZE > 0
+    ANCSRefreshCache<ANCS_CLIENT_REFRESH_CACHE_SIZE>::Entry_t entry;
+
+    refreshStatistics.probes++;
+    refreshStatistics.probeBytes += probe->responseBytes;
+
+    if (refreshCache.lookup(probe->notificationUID, &entry) && (entry.fingerprint == probe->fingerprint))
+    {
+        DEBUGOUT("ancs: refresh unchanged: %lu\r\n", probe->notificationUID);
+
+        refreshStatistics.skipped++;
+
+        if (entry.responseBytes > probe->responseBytes)
+        {
+            refreshStatistics.bytesSaved += entry.responseBytes - probe->responseBytes;
+        }
+
+        probe->received = 0;
+        completeRequest(probe, RequestStatusUnchanged);
+        return;
+    }
+
+    // the buffers reserved with the probe are kept
+    probe->state = REQUEST_QUEUED;
+    probe->refresh = REFRESH_FETCH;
+    probe->pendingMask = 0;
+    probe->received = 0;
+    probe->responseBytes = 0;
+
+    for (uint8_t index = 0; index < probe->count; index++)
+    {
+        probe->pendingMask |= (1 << probe->attributes[index].attributeID);
+    }
+
+    // move to the end of the queue, then ahead of lower priority requests
+    uint8_t slot = probe - requestQueue;
+
+    while (slot != (requestHead + requestCount - 1) % ANCS_CLIENT_QUEUE_SIZE)
+    {
+        uint8_t next = (slot + 1) % ANCS_CLIENT_QUEUE_SIZE;
+        Request_t swap = requestQueue[slot];
+
+        requestQueue[slot] = requestQueue[next];
+        requestQueue[next] = swap;
+        slot = next;
+    }
+
+    promoteRequest();
+#else
+    // probes are only sent with the refresh cache
+    completeRequest(probe, RequestStatusSuccess);
+#endif
+}
+
+/*
+    Remember the probe behind a successful full fetch.
+*/
+void ANCSClient::refreshFetched(const Request_t* request)
+{
+#if ANCS_CLIENT_REFRESH_CACHE_SIZE > 0
+    ANCSRefreshCache<ANCS_CLIENT_REFRESH_CACHE_SIZE>::Entry_t entry;
+    entry.notificationUID = request->notificationUID;
+    entry.fingerprint = request->fingerprint;
+    entry.responseBytes = request->responseBytes;
+
+    refreshStatistics.fetches++;
+    refreshCache.insert(entry);
+#else
+    (void) request;
+#endif
+}
+
+void ANCSClient::appAttributeComplete()
+{
+#if ANCS_CLIENT_APP_CACHE_SIZE > 0
+    if ((parser.getAttributeID() == AppAttributeIDDisplayName) && attributePayload.get())
+    {
+        appCache.insert(parser.getAppIdentifier(), attributePayload->getData(), attributePayload->getLength());
+    }
+#endif
+
+    if (appAttributeHandler && attributePayload.get())
+    {
+        AppAttribute_t attribute;
+        memcpy(attribute.appIdentifier, parser.getAppIdentifier(), sizeof(attribute.appIdentifier));
+        attribute.attributeID = parser.getAttributeID();
+        attribute.data = attributePayload;
+        attribute.connectionHandle = connectionHandle;
+
+        minar::Scheduler::postCallback(appAttributeHandler.bind(attribute));
+    }
+
+    attributePayload = SharedPointer<BlockStatic>();
+}
+
+SharedPointer<BlockStatic> ANCSClient::allocateBlock(uint16_t length)
+{
+#if ANCS_CLIENT_POOL_BLOCKS > 0
+    SharedPointer<BlockStatic> block = pool.allocate(length);
+#else
+    SharedPointer<BlockStatic> block(new BlockDynamic(length));
+#endif
+
+    COUNT(allocationFailures, (block.get()) ? 0 : 1);
+
+    return block;
+}
+
+/*
+    Caller buffers take precedence. Otherwise allocate a buffer, unless the
+    application consumes attributes through the fragment handler or
+    the export sink.
+*/
+SharedPointer<BlockStatic> ANCSClient::selectBlock(uint8_t id, uint16_t length)
+{
+    uint8_t callerAttributes = (parseRequest->command == CommandIDGetNotificationAttributes) ? parseRequest->count : 0;
+
+    for (uint8_t index = 0; index < callerAttributes; index++)
+    {
+        const AttributeRequest_t& attribute = parseRequest->attributes[index];
+
+        if ((attribute.attributeID == id) && attribute.buffer)
+        {
+#if ANCS_CLIENT_POOL_BLOCKS > 0
+            SharedPointer<BlockStatic> block = pool.wrap(attribute.buffer, attribute.maxLength);
+
+            COUNT(allocationFailures, (block.get()) ? 0 : 1);
+#else
+            SharedPointer<BlockStatic> block(new BlockStatic(attribute.buffer, attribute.maxLength));
+#endif
+
+            if (block.get())
+            {
+                block->setLength((length < attribute.maxLength) ? length : attribute.maxLength);
+            }
+
+            return block;
+        }
+    }
+
+    if ((fragmentHandler || exporter.hasSink()) && (parseRequest->command == CommandIDGetNotificationAttributes))
+    {
+        return SharedPointer<BlockStatic>();
+    }
+
+#if ANCS_CLIENT_POOL_BLOCKS > 0
+    // block was reserved when the request was queued
+    if (parseRequest->blocksReserved > 0)
+    {
+        parseRequest->blocksReserved--;
+        poolReserved--;
+    }
+#endif
+
+    return allocateBlock(length);
+}
+
+/*
+    The phone may abandon a response that is being skipped. A fragment that
+    begins with the header of an outstanding request starts a new response
+    instead of continuing the skipped one.
+*/
+bool ANCSClient::startsResponse(const uint8_t* data, uint16_t length)
+{
+    if ((data == NULL) || (length < 2))
+    {
+        return false;
+    }
+
+    if ((data[0] == CommandIDGetNotificationAttributes) && (length >= 5))
+    {
+        uint32_t notificationUID = data[1]
+                                 | (data[2] << 8)
+                                 | (data[3] << 16)
+                                 | ((uint32_t) data[4] << 24);
+
+        return (findRequest(CommandIDGetNotificationAttributes, notificationUID, NULL) != NULL);
+    }
+
+    if ((data[0] == CommandIDGetAppAttributes) && memchr(&data[1], '\0', length - 1))
+    {
+        return (findRequest(CommandIDGetAppAttributes, 0, (const char*) &data[1]) != NULL);
+    }
+
+    return false;
+}
+
+/*
+    Stop following the response being parsed; the parser is left as is.
+*/
+void ANCSClient::dropResponse()
+{
+    parseRequest = NULL;
+    attributePayload = SharedPointer<BlockStatic>();
+    decoding = false;
+    exporter.abort();
+}
+
+void ANCSClient::resetDataSource()
+{
+    dropResponse();
+    parser.reset();
 }
 
 void ANCSClient::dataSent(unsigned count)
 {
     (void) count;
 
-    if ((state == (FLAG_NOTIFICATION | FLAG_CONTROL | FLAG_DATA | FLAG_ENCRYPTION))
+    // retry CCCD writes that found the transmit buffers full
+    if ((state & FLAG_SUBSCRIBING)
        && (!(state & FLAG_NOTIFICATION_SUBSCRIBE) || !(state & FLAG_DATA_SUBSCRIBE)))
     {
+        COUNT(retries, 1);
         subscribe();
     }
 }
@@ -0,0 +1,314 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ble-ancs-client/ANCSDispatcher.h"
+
+// control debug output
+#if 0
+#include <stdio.h>
+#define DEBUGOUT(...) { printf(__VA_ARGS__); }
+#else
+#define DEBUGOUT(...) /* nothing */
+#endif // DEBUGOUT
+
+/*
+    Plain pointers only, so that sessions constructed as globals can attach
+    before any other static initialization has run.
+*/
+static ANCSClient* sessions[ANCS_CLIENT_MAX_CONNECTIONS] = { NULL };
+static ANCSClient* discoveringSession = NULL;
+static bool initialized = false;
+
+void ANCSDispatcher::init()
+{
+    if (initialized)
+    {
+        return;
+    }
+
+    initialized = true;
+
+    BLE& ble = BLE::Instance();
+
+    // register callbacks
+    ble.gap().onConnection(ANCSDispatcher::onConnection);
+    ble.gap().onDisconnection(ANCSDispatcher::onDisconnection);
+    ble.gattClient().onHVX(ANCSDispatcher::hvxCallback);
+    ble.gattClient().onDataWritten(ANCSDispatcher::dataWritten);
+    ble.gattClient().onDataRead(ANCSDispatcher::dataRead);
+    ble.gattServer().onDataSent(ANCSDispatcher::dataSent);
+
+    ble.gattClient()
+       .onServiceDiscoveryTermination(ANCSDispatcher::discoveryTerminationCallback);
+
+    // security
+    ble.securityManager().init();
+    ble.securityManager().onLinkSecured(ANCSDispatcher::linkSecured);
+}
+
+bool ANCSDispatcher::attach(ANCSClient* client)
+{
+    for (uint8_t index = 0; index < ANCS_CLIENT_MAX_CONNECTIONS; index++)
+    {
+        if (sessions[index] == NULL)
+        {
+            sessions[index] = client;
+            return true;
+        }
+    }
+
+    DEBUGOUT("ancs: no room for session\r\n");
+
+    return false;
+}
+
+void ANCSDispatcher::detach(ANCSClient* client)
+{
+    for (uint8_t index = 0; index < ANCS_CLIENT_MAX_CONNECTIONS; index++)
+    {
+        if (sessions[index] == client)
+        {
+            sessions[index] = NULL;
+        }
+    }
+
+    if (discoveringSession == client)
+    {
+        discoveringSession = NULL;
+    }
+}
+
+ANCSClient* ANCSDispatcher::find(Gap::Handle_t connectionHandle)
+{
+    for (uint8_t index = 0; index < ANCS_CLIENT_MAX_CONNECTIONS; index++)
+    {
+        if (sessions[index] &&
+            sessions[index]->isConnected() &&
+            (sessions[index]->getConnectionHandle() == connectionHandle))
+        {
+            return sessions[index];
+        }
+    }
+
+    return NULL;
+}
+
+ANCSClient* ANCSDispatcher::getSession(uint8_t index)
+{
+    return (index < ANCS_CLIENT_MAX_CONNECTIONS) ? sessions[index] : NULL;
+}
+
+void ANCSDispatcher::registerNotificationHandlerTask(FunctionPointer1<void, ANCSClient::Notification_t> callback)
+{
+    for (uint8_t index = 0; index < ANCS_CLIENT_MAX_CONNECTIONS; index++)
+    {
+        if (sessions[index])
+        {
+            sessions[index]->registerNotificationHandlerTask(callback);
+        }
+    }
+}
+
+void ANCSDispatcher::registerAttributeHandlerTask(FunctionPointer1<void, ANCSClient::Attribute_t> callback)
+{
+    for (uint8_t index = 0; index < ANCS_CLIENT_MAX_CONNECTIONS; index++)
+    {
+        if (sessions[index])
+        {
+            sessions[index]->registerAttributeHandlerTask(callback);
+        }
+    }
+}
+
+void ANCSDispatcher::registerDecodedAttributeHandlerTask(FunctionPointer1<void, ANCSClient::DecodedAttribute_t> callback)
+{
+    for (uint8_t index = 0; index < ANCS_CLIENT_MAX_CONNECTIONS; index++)
+    {
+        if (sessions[index])
+        {
+            sessions[index]->registerDecodedAttributeHandlerTask(callback);
+        }
+    }
+}
+
+void ANCSDispatcher::registerAppAttributeHandlerTask(FunctionPointer1<void, ANCSClient::AppAttribute_t> callback)
+{
+    for (uint8_t index = 0; index < ANCS_CLIENT_MAX_CONNECTIONS; index++)
+    {
+        if (sessions[index])
+        {
+            sessions[index]->registerAppAttributeHandlerTask(callback);
+        }
+    }
+}
+
+void ANCSDispatcher::registerNotificationBatchHandler(FunctionPointer1<void, const ANCSClient::NotificationBatch_t*> callback)
+{
+    for (uint8_t index = 0; index < ANCS_CLIENT_MAX_CONNECTIONS; index++)
+    {
+        if (sessions[index])
+        {
+            sessions[index]->registerNotificationBatchHandler(callback);
+        }
+    }
+}
+
+void ANCSDispatcher::setFetchPolicy(const ANCSClient::FetchPolicy_t* policy,
+                                    uint8_t count,
+                                    FunctionPointer1<void, ANCSClient::RequestComplete_t> callback)
+{
+    for (uint8_t index = 0; index < ANCS_CLIENT_MAX_CONNECTIONS; index++)
+    {
+        if (sessions[index])
+        {
+            sessions[index]->setFetchPolicy(policy, count, callback);
+        }
+    }
+}
+
+void ANCSDispatcher::setDiscoveringSession(ANCSClient* client)
+{
+    discoveringSession = client;
+}
+
+/*****************************************************************************/
+/* BLE events                                                                */
+/*****************************************************************************/
+
+void ANCSDispatcher::onConnection(const Gap::ConnectionCallbackParams_t* params)
+{
+    // phones connect as central; give the link to the first idle session
+    if (params->role == Gap::PERIPHERAL)
+    {
+        for (uint8_t index = 0; index < ANCS_CLIENT_MAX_CONNECTIONS; index++)
+        {
+            if (sessions[index] && !sessions[index]->isConnected())
+            {
+                sessions[index]->onConnection(params);
+                return;
+            }
+        }
+
+        DEBUGOUT("ancs: no idle session for %04X\r\n", params->handle);
+    }
+}
+
+void ANCSDispatcher::onDisconnection(const Gap::DisconnectionCallbackParams_t* params)
+{
+    ANCSClient* client = find(params->handle);
+
+    if (client)
+    {
+        if (discoveringSession == client)
+        {
+            discoveringSession = NULL;
+        }
+
+        client->onDisconnection(params);
+    }
+}
+
+void ANCSDispatcher::serviceDiscoveryCallback(const DiscoveredService* service)
+{
+    if (discoveringSession)
+    {
+        discoveringSession->serviceDiscoveryCallback(service);
+    }
+}
+
+void ANCSDispatcher::characteristicDiscoveryCallback(const DiscoveredCharacteristic* characteristicP)
+{
+    ANCSClient* client = find(characteristicP->getConnectionHandle());
+
+    if (client)
+    {
+        client->characteristicDiscoveryCallback(characteristicP);
+    }
+}
+
+void ANCSDispatcher::discoveryTerminationCallback(Gap::Handle_t handle)
+{
+    ANCSClient* client = find(handle);
+
+    discoveringSession = NULL;
+
+    if (client)
+    {
+        client->discoveryTerminationCallback(handle);
+    }
+
+    // discovery is free again for sessions that found it busy, including
+    // one that deferred its own next stage
+    for (uint8_t index = 0; index < ANCS_CLIENT_MAX_CONNECTIONS; index++)
+    {
+        if (sessions[index] && sessions[index]->isConnected())
+        {
+            sessions[index]->discoveryIdle();
+        }
+    }
+}
+
+void ANCSDispatcher::hvxCallback(const GattHVXCallbackParams* params)
+{
+    ANCSClient* client = find(params->connHandle);
+
+    if (client)
+    {
+        client->hvxCallback(params);
+    }
+}
+
+void ANCSDispatcher::dataWritten(const GattWriteCallbackParams* params)
+{
+    ANCSClient* client = find(params->connHandle);
+
+    if (client)
+    {
+        client->dataWritten(params);
+    }
+}
+
+void ANCSDispatcher::dataRead(const GattReadCallbackParams* params)
+{
+    ANCSClient* client = find(params->connHandle);
+
+    if (client)
+    {
+        client->dataRead(params);
+    }
+}
+
+void ANCSDispatcher::dataSent(unsigned count)
+{
+    // transmit buffers are shared by all connections
+    for (uint8_t index = 0; index < ANCS_CLIENT_MAX_CONNECTIONS; index++)
+    {
+        if (sessions[index] && sessions[index]->isConnected())
+        {
+            sessions[index]->dataSent(count);
+        }
+    }
+}
+
+void ANCSDispatcher::linkSecured(Gap::Handle_t handle, SecurityManager::SecurityMode_t mode)
+{
+    ANCSClient* client = find(handle);
+
+    if (client)
+    {
+        client->linkSecured(handle, mode);
+    }
+}
@@ -0,0 +1,719 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+    Throughput and latency benchmark for the notification/attribute pipeline.
+
+    Synthetic Notification Source bursts and multi-fragment Data Source
+    responses are fed into ANCSClient through the simulated connection, one
+    packet per scheduler callback. Results are printed as one JSON object
+    per line so they can be collected and compared between releases:
+
+    - events_per_second: packets processed per second
+    - latency_ticks_*: request sent to last attribute dispatched, in
+      ticks_per_second units
+    - heap_peak_bytes: peak heap allocated while the pipeline ran
+    - pool_high_water_mark: most attribute buffers in use when the pool
+      is enabled with ANCS_CLIENT_POOL_BLOCKS
+    - callbacks_per_notification_x1000: scheduler callbacks posted by the
+      client per notification or response, times 1000
+    - batches: notification batches delivered when the burst is coalesced
+    - peers: phones the burst is spread over, one ANCSClient session each
+    - latency_ticks_*_high/normal/low: notification received to its
+      prefetch completed, by priority, while pre-existing notifications,
+      new ones, and incoming calls arrive together and the phone answers
+      the Control Point commands in order
+*/
+
+#include "mbed-drivers/mbed.h"
+#include "mbed-drivers/test_env.h"
+#include "ble/BLE.h"
+
+#include "ble-ancs-client/ANCSClient.h"
+#include "ble-ancs-client/ANCSDispatcher.h"
+
+#include "../simulation/NotificationProvider.h"
+#include "../simulation/SimulatedConnection.h"
+
+#include <stdlib.h>
+#include <new>
+
+#if defined(TARGET_LIKE_X86_LINUX_NATIVE)
+#include <time.h>
+#endif
+
+using namespace simulation;
+
+/*****************************************************************************/
+/* Configuration                                                             */
+/*****************************************************************************/
+
+#define NOTIFICATION_EVENTS     2000
+#define DATA_RESPONSES          100
+#define TRACE_BUFFER_SIZE       512
+#define COALESCE_WINDOW_MS      10
+#define BENCHMARK_PEERS         3
+#define PRIORITY_EVENTS         32
+#define PRIORITY_MTU            185
+
+#define MESSAGE "The quick brown fox jumps over the lazy dog, twice."
+
+static const uint16_t mtuList[] = { 23, 185, 247 };
+
+static const Attribute_t attributes[] = {
+    { ANCSClient::NotificationAttributeIDTitle,    "Alice" },
+    { ANCSClient::NotificationAttributeIDSubtitle, "Re: lunch" },
+    { ANCSClient::NotificationAttributeIDMessage,  MESSAGE MESSAGE MESSAGE MESSAGE }
+};
+
+static const ANCSClient::AttributeRequest_t attributeRequest[] = {
+    { ANCSClient::NotificationAttributeIDTitle,    255, NULL },
+    { ANCSClient::NotificationAttributeIDSubtitle, 255, NULL },
+    { ANCSClient::NotificationAttributeIDMessage,  255, NULL }
+};
+
+static uint8_t titleBuffer[32];
+static uint8_t subtitleBuffer[32];
+static uint8_t messageBuffer[255];
+
+static const ANCSClient::AttributeRequest_t callerBufferRequest[] = {
+    { ANCSClient::NotificationAttributeIDTitle,    sizeof(titleBuffer),    titleBuffer },
+    { ANCSClient::NotificationAttributeIDSubtitle, sizeof(subtitleBuffer), subtitleBuffer },
+    { ANCSClient::NotificationAttributeIDMessage,  sizeof(messageBuffer),  messageBuffer }
+};
+
+/*
+    Each MTU is run with client allocated buffers and with caller buffers.
+*/
+static const ANCSClient::AttributeRequest_t* requestList[] = {
+    attributeRequest,
+    callerBufferRequest
+};
+
+static const char* deliveryList[] = {
+    "buffered",
+    "caller_buffer"
+};
+
+/*****************************************************************************/
+/* Heap accounting                                                           */
+/*****************************************************************************/
+
+/*
+    Every allocation is prefixed with its size so that the amount of live
+    heap, and its peak, can be tracked across the benchmark phases.
+*/
+static uint32_t heapCurrent = 0;
+static uint32_t heapPeak = 0;
+
+static const size_t HEAP_HEADER = 8;
+
+void* operator new(size_t size)
+{
+    uint8_t* block = (uint8_t*) malloc(size + HEAP_HEADER);
+
+    if (block == NULL)
+    {
+        return NULL;
+    }
+
+    *((size_t*) block) = size;
+
+    heapCurrent += size;
+    if (heapCurrent > heapPeak)
+    {
+        heapPeak = heapCurrent;
+    }
+
+    return block + HEAP_HEADER;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* pointer)
+{
+    if (pointer)
+    {
+        uint8_t* block = ((uint8_t*) pointer) - HEAP_HEADER;
+
+        heapCurrent -= *((size_t*) block);
+
+        free(block);
+    }
+}
+
+void operator delete[](void* pointer)
+{
+    operator delete(pointer);
+}
+
+/*****************************************************************************/
+/* Variables used by the benchmark                                           */
+/*****************************************************************************/
+
+BLE ble;
+SimulatedClient ancs;
+SimulatedClient extraSessions[BENCHMARK_PEERS - 1];
+
+static SimulatedConnection connections[BENCHMARK_PEERS] = {
+    SimulatedConnection(SIM_CONNECTION_HANDLE),
+    SimulatedConnection(SIM_CONNECTION_HANDLE + 1),
+    SimulatedConnection(SIM_CONNECTION_HANDLE + 2)
+};
+
+static SimulatedConnection& connection = connections[0];
+static uint8_t activePeers = 1;
+
+static uint8_t traceBuffer[TRACE_BUFFER_SIZE];
+static TraceReader reader(NULL, 0);
+
+static uint32_t iteration = 0;
+static uint8_t mtuIndex = 0;
+static uint8_t deliveryIndex = 0;
+
+static minar::platform::tick_t startTime;
+static minar::platform::tick_t requestTime;
+
+static uint32_t callbacks = 0;
+static uint32_t batches = 0;
+static uint32_t fragments = 0;
+static bool coalescing = false;
+static bool prefetching = false;
+static minar::platform::tick_t burstTicks;
+static uint32_t latencyMin;
+static uint32_t latencyMax;
+static uint32_t latencySum;
+
+static void runNotificationBurst();
+static void reportNotificationBurst();
+static void runDataSource();
+static void runPriority();
+static void runResponse();
+static void replayFragment();
+
+/*
+    On the device the scheduler clock times the pipeline. The host build
+    runs the scheduler in simulated time, which only moves for delayed
+    callbacks, so the monotonic clock is read instead, in microseconds.
+*/
+#if defined(TARGET_LIKE_X86_LINUX_NATIVE)
+static const uint32_t TICKS_PER_SECOND = 1000000;
+
+static minar::platform::tick_t now()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (minar::platform::tick_t) ((time.tv_sec * 1000000ULL) + (time.tv_nsec / 1000));
+}
+
+static minar::platform::tick_t elapsed(minar::platform::tick_t since)
+{
+    return now() - since;
+}
+#else
+static const uint32_t TICKS_PER_SECOND = minar::milliseconds(1000);
+
+static minar::platform::tick_t now()
+{
+    return minar::platform::getTime();
+}
+
+static minar::platform::tick_t elapsed(minar::platform::tick_t since)
+{
+    return (now() - since) & minar::platform::Time_Mask;
+}
+#endif
+
+static uint32_t perSecond(uint32_t count, minar::platform::tick_t ticks)
+{
+    uint64_t ticksPerSecond = TICKS_PER_SECOND;
+
+    return (ticks) ? (uint32_t) ((count * ticksPerSecond) / ticks) : 0;
+}
+
+static void resetHeapPeak()
+{
+    heapPeak = heapCurrent;
+}
+
+/*****************************************************************************/
+/* Client callbacks                                                          */
+/*****************************************************************************/
+
+void onNotificationTask(ANCSClient::Notification_t event)
+{
+    (void) event;
+
+    callbacks++;
+}
+
+void onNotificationBatch(const ANCSClient::NotificationBatch_t* batch)
+{
+    (void) batch;
+
+    batches++;
+}
+
+void onAttributeTask(ANCSClient::Attribute_t attribute)
+{
+    callbacks++;
+
+    // message is the last attribute in each response; prefetches are timed by their callback
+    if ((attribute.attributeID == ANCSClient::NotificationAttributeIDMessage) && !prefetching)
+    {
+        uint32_t latency = elapsed(requestTime);
+
+        latencySum += latency;
+
+        if (latency < latencyMin)
+        {
+            latencyMin = latency;
+        }
+
+        if (latency > latencyMax)
+        {
+            latencyMax = latency;
+        }
+
+        iteration++;
+        minar::Scheduler::postCallback(runResponse);
+    }
+}
+
+/*****************************************************************************/
+/* Notification Source burst                                                 */
+/*****************************************************************************/
+
+static void feedNotification()
+{
+    if (iteration < NOTIFICATION_EVENTS)
+    {
+        uint8_t packet[8];
+        uint32_t uid = iteration;
+
+        packet[0] = ANCSClient::EventIDNotificationAdded;
+        packet[1] = (iteration & 0x01) ? ANCSClient::EventFlagImportant : 0;
+        packet[2] = ANCSClient::CategoryIDSocial;
+        packet[3] = iteration;
+        packet[4] = uid;
+        packet[5] = uid >> 8;
+        packet[6] = uid >> 16;
+        packet[7] = uid >> 24;
+
+        // spread the burst over the connected phones
+        connections[iteration % activePeers].notificationSource(packet, sizeof(packet));
+
+        iteration++;
+        minar::Scheduler::postCallback(feedNotification);
+    }
+    else
+    {
+        burstTicks = elapsed(startTime);
+
+        // let the last batch be delivered
+        minar::Scheduler::postCallback(reportNotificationBurst)
+            .delay(minar::milliseconds((coalescing) ? COALESCE_WINDOW_MS + 1 : 0));
+    }
+}
+
+static void reportNotificationBurst()
+{
+    printf("{\"benchmark\":\"notification_source\","
+           "\"coalescing\":%u,"
+           "\"peers\":%u,"
+           "\"events\":%u,"
+           "\"ticks\":%lu,"
+           "\"ticks_per_second\":%lu,"
+           "\"events_per_second\":%lu,"
+           "\"heap_peak_bytes\":%lu,"
+           "\"batches\":%lu,"
+           "\"callbacks_per_notification_x1000\":%lu}\r\n",
+           coalescing,
+           activePeers,
+           NOTIFICATION_EVENTS,
+           (unsigned long) burstTicks,
+           (unsigned long) TICKS_PER_SECOND,
+           (unsigned long) perSecond(NOTIFICATION_EVENTS, burstTicks),
+           (unsigned long) heapPeak,
+           (unsigned long) batches,
+           (unsigned long) ((callbacks * 1000) / NOTIFICATION_EVENTS));
+
+    if (!coalescing && (activePeers == 1))
+    {
+        // same burst again, collected into batches
+        coalescing = true;
+        ancs.setCoalescing(COALESCE_WINDOW_MS);
+
+        minar::Scheduler::postCallback(runNotificationBurst);
+    }
+    else if (coalescing)
+    {
+        // same burst again, spread over several phones
+        coalescing = false;
+        ancs.setCoalescing(0);
+
+        for (uint8_t peer = 1; peer < BENCHMARK_PEERS; peer++)
+        {
+            connections[peer].connect();
+        }
+
+        activePeers = BENCHMARK_PEERS;
+
+        minar::Scheduler::postCallback(runNotificationBurst);
+    }
+    else
+    {
+        for (uint8_t peer = 1; peer < BENCHMARK_PEERS; peer++)
+        {
+            connections[peer].disconnect();
+        }
+
+        activePeers = 1;
+
+        minar::Scheduler::postCallback(runDataSource);
+    }
+}
+
+static void runNotificationBurst()
+{
+    iteration = 0;
+    callbacks = 0;
+    batches = 0;
+    resetHeapPeak();
+
+    startTime = now();
+    minar::Scheduler::postCallback(feedNotification);
+}
+
+/*****************************************************************************/
+/* Data Source responses                                                     */
+/*****************************************************************************/
+
+static void replayFragment()
+{
+    Record_t record;
+
+    if (reader.next(record))
+    {
+        if (record.type == RecordDataSource)
+        {
+            connection.dataSource(record.data, record.length);
+            fragments++;
+        }
+
+        minar::Scheduler::postCallback(replayFragment);
+    }
+}
+
+static void runResponse()
+{
+    if (iteration < DATA_RESPONSES)
+    {
+        uint32_t uid = iteration;
+
+        requestTime = now();
+
+        ancs.getNotificationAttributes(uid,
+                                       requestList[deliveryIndex],
+                                       sizeof(attributeRequest) / sizeof(ANCSClient::AttributeRequest_t));
+
+        NotificationProvider provider(traceBuffer, sizeof(traceBuffer));
+        provider.setMTU(mtuList[mtuIndex]);
+        provider.setInterval(0);
+        provider.response(uid, attributes, sizeof(attributes) / sizeof(Attribute_t));
+
+        reader = TraceReader(provider.getTrace(), provider.getTraceLength());
+
+        minar::Scheduler::postCallback(replayFragment);
+    }
+    else
+    {
+        minar::platform::tick_t ticks = elapsed(startTime);
+
+        printf("{\"benchmark\":\"data_source\","
+               "\"delivery\":\"%s\","
+               "\"mtu\":%u,"
+               "\"responses\":%u,"
+               "\"fragments\":%lu,"
+               "\"ticks\":%lu,"
+               "\"ticks_per_second\":%lu,"
+               "\"events_per_second\":%lu,"
+               "\"latency_ticks_min\":%lu,"
+               "\"latency_ticks_max\":%lu,"
+               "\"latency_ticks_mean\":%lu,"
+               "\"heap_peak_bytes\":%lu,"
+               "\"pool_high_water_mark\":%u,"
+               "\"callbacks_per_notification_x1000\":%lu}\r\n",
+               deliveryList[deliveryIndex],
+               mtuList[mtuIndex],
+               DATA_RESPONSES,
+               (unsigned long) fragments,
+               (unsigned long) ticks,
+               (unsigned long) TICKS_PER_SECOND,
+               (unsigned long) perSecond(fragments, ticks),
+               (unsigned long) latencyMin,
+               (unsigned long) latencyMax,
+               (unsigned long) (latencySum / DATA_RESPONSES),
+               (unsigned long) heapPeak,
+               ancs.getPoolStatistics().highWaterMark,
+               (unsigned long) ((callbacks * 1000) / DATA_RESPONSES));
+
+        deliveryIndex++;
+
+        if (deliveryIndex >= sizeof(deliveryList) / sizeof(const char*))
+        {
+            deliveryIndex = 0;
+            mtuIndex++;
+        }
+
+        minar::Scheduler::postCallback(runDataSource);
+    }
+}
+
+static void runDataSource()
+{
+    if (mtuIndex >= sizeof(mtuList) / sizeof(uint16_t))
+    {
+        minar::Scheduler::postCallback(runPriority);
+        return;
+    }
+
+    iteration = 0;
+    callbacks = 0;
+    fragments = 0;
+    latencyMin = 0xFFFFFFFF;
+    latencyMax = 0;
+    latencySum = 0;
+    resetHeapPeak();
+
+    startTime = now();
+    minar::Scheduler::postCallback(runResponse);
+}
+
+/*****************************************************************************/
+/* Prefetch priority                                                         */
+/*****************************************************************************/
+
+/*
+    Every eighth notification is an incoming call and every fourth a new
+    email; the rest are pre-existing, as after connecting.
+*/
+static const ANCSClient::FetchPolicy_t priorityPolicy[] = {
+    { ANCSClient::PolicyCategoryAny, 0, 0, attributeRequest, sizeof(attributeRequest) / sizeof(ANCSClient::AttributeRequest_t) }
+};
+
+static const char* priorityNames[] = {
+    "low",
+    "normal",
+    "high"
+};
+
+static minar::platform::tick_t receivedAt[PRIORITY_EVENTS];
+static uint8_t priorities[PRIORITY_EVENTS];
+static uint32_t priorityCount[ANCSClient::PriorityHigh + 1];
+static uint32_t priorityMax[ANCSClient::PriorityHigh + 1];
+static uint32_t prioritySum[ANCSClient::PriorityHigh + 1];
+static uint32_t prefetched = 0;
+static bool answering = false;
+
+void onPrefetchComplete(ANCSClient::RequestComplete_t complete)
+{
+    if ((complete.status == ANCSClient::RequestStatusSuccess) && (complete.notificationUID < PRIORITY_EVENTS))
+    {
+        uint8_t priority = priorities[complete.notificationUID];
+        uint32_t latency = elapsed(receivedAt[complete.notificationUID]);
+
+        priorityCount[priority]++;
+        prioritySum[priority] += latency;
+
+        if (latency > priorityMax[priority])
+        {
+            priorityMax[priority] = latency;
+        }
+
+        prefetched++;
+    }
+}
+
+static void reportPriority()
+{
+    printf("{\"benchmark\":\"priority\","
+           "\"mtu\":%u,"
+           "\"notifications\":%u,"
+           "\"prefetched\":%lu,"
+           "\"ticks_per_second\":%lu",
+           PRIORITY_MTU,
+           PRIORITY_EVENTS,
+           (unsigned long) prefetched,
+           (unsigned long) TICKS_PER_SECOND);
+
+    for (uint8_t priority = ANCSClient::PriorityHigh + 1; priority-- > 0; )
+    {
+        printf(",\"count_%s\":%lu,"
+               "\"latency_ticks_max_%s\":%lu,"
+               "\"latency_ticks_mean_%s\":%lu",
+               priorityNames[priority],
+               (unsigned long) priorityCount[priority],
+               priorityNames[priority],
+               (unsigned long) priorityMax[priority],
+               priorityNames[priority],
+               (unsigned long) ((priorityCount[priority]) ? prioritySum[priority] / priorityCount[priority] : 0));
+    }
+
+    printf("}\r\n");
+
+    ancs.setFetchPolicy(NULL, 0);
+    connection.disconnect();
+
+    MBED_HOSTTEST_RESULT(true);
+}
+
+/*
+    One notification and one Data Source packet per scheduler callback.
+*/
+static void stepPriority()
+{
+    if (iteration < PRIORITY_EVENTS)
+    {
+        uint8_t packet[8];
+        uint32_t uid = iteration;
+
+        packet[0] = ANCSClient::EventIDNotificationAdded;
+        packet[1] = ANCSClient::EventFlagPreExisting;
+        packet[2] = ANCSClient::CategoryIDSocial;
+        packet[3] = iteration;
+        packet[4] = uid;
+        packet[5] = uid >> 8;
+        packet[6] = uid >> 16;
+        packet[7] = uid >> 24;
+
+        if ((iteration % 8) == 5)
+        {
+            packet[1] = 0;
+            packet[2] = ANCSClient::CategoryIDIncomingCall;
+        }
+        else if ((iteration % 4) == 2)
+        {
+            packet[1] = 0;
+            packet[2] = ANCSClient::CategoryIDEmail;
+        }
+
+        ANCSClient::Notification_t event = { packet[0], packet[1], packet[2], packet[3], uid, connection.getHandle() };
+
+        priorities[uid] = ANCSClient::getPriority(event);
+        receivedAt[uid] = now();
+        connection.notificationSource(packet, sizeof(packet));
+
+        iteration++;
+    }
+
+    // answer the commands in the order they were written
+    uint32_t uid;
+
+    if (!answering && ancs.nextWrittenUID(uid))
+    {
+        NotificationProvider provider(traceBuffer, sizeof(traceBuffer));
+        provider.setMTU(PRIORITY_MTU);
+        provider.setInterval(0);
+        provider.response(uid, attributes, sizeof(attributes) / sizeof(Attribute_t));
+
+        reader = TraceReader(provider.getTrace(), provider.getTraceLength());
+        answering = true;
+    }
+
+    if (answering)
+    {
+        Record_t record;
+
+        if (!reader.next(record))
+        {
+            answering = false;
+        }
+        else if (record.type == RecordDataSource)
+        {
+            connection.dataSource(record.data, record.length);
+        }
+    }
+
+    if ((iteration < PRIORITY_EVENTS) || answering || (ancs.getPendingRequests() > 0))
+    {
+        minar::Scheduler::postCallback(stepPriority);
+    }
+    else
+    {
+        minar::Scheduler::postCallback(reportPriority);
+    }
+}
+
+static void runPriority()
+{
+    uint32_t uid;
+
+    prefetching = true;
+    iteration = 0;
+    prefetched = 0;
+    answering = false;
+
+    // commands of the earlier phases were answered from the trace
+    while (ancs.nextWrittenUID(uid))
+    {
+    }
+
+    for (uint8_t priority = 0; priority <= ANCSClient::PriorityHigh; priority++)
+    {
+        priorityCount[priority] = 0;
+        priorityMax[priority] = 0;
+        prioritySum[priority] = 0;
+    }
+
+    ancs.setFetchPolicy(priorityPolicy,
+                        sizeof(priorityPolicy) / sizeof(ANCSClient::FetchPolicy_t),
+                        onPrefetchComplete);
+
+    minar::Scheduler::postCallback(stepPriority);
+}
+
+/*****************************************************************************/
+/* main                                                                      */
+/*****************************************************************************/
+
+void bleInitDone(BLE::InitializationCompleteCallbackContext* context)
+{
+    (void) context;
+
+    ancs.init();
+    ANCSDispatcher::registerNotificationHandlerTask(onNotificationTask);
+    ANCSDispatcher::registerAttributeHandlerTask(onAttributeTask);
+    ANCSDispatcher::registerNotificationBatchHandler(onNotificationBatch);
+
+    connection.connect();
+
+    minar::Scheduler::postCallback(runNotificationBurst);
+}
+
+void app_start(int, char *[])
+{
+    MBED_HOSTTEST_TIMEOUT(60);
+    MBED_HOSTTEST_SELECT(default_auto);
+    MBED_HOSTTEST_DESCRIPTION(ANCS client benchmark);
+    MBED_HOSTTEST_START("ANCS_BENCHMARK");
+
+    ble.init(bleInitDone);
+}
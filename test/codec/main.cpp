@@ -0,0 +1,273 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+    Unit test and micro benchmark for ANCSCodec.
+
+    Every command is checked against byte vectors taken from the ANCS
+    specification, for the default configuration and for a restricted one
+    that only enables Title and Message. The encoders and the decoder are
+    then run in a loop and the ticks per million calls are printed as one
+    JSON object per line, like test/benchmark.
+*/
+
+#include "mbed-drivers/mbed.h"
+#include "mbed-drivers/test_env.h"
+
+#include "ble-ancs-client/ANCSCodec.h"
+
+#if defined(TARGET_LIKE_X86_LINUX_NATIVE)
+#include <time.h>
+#endif
+
+#define BENCHMARK_CALLS         100000
+
+typedef struct {
+    uint8_t attributeID;
+    uint16_t maxLength;
+} Attribute_t;
+
+typedef struct {
+    uint8_t eventID;
+    uint8_t eventFlags;
+    uint8_t categoryID;
+    uint8_t categoryCount;
+    uint32_t notificationUID;
+} Notification_t;
+
+typedef ANCSCodec<20> DefaultCodec;
+
+// Title and Message only, max lengths clamped to 64
+typedef ANCSCodec<20, (1 << 1) | (1 << 3), 64> SmallCodec;
+
+static const Attribute_t titleSubtitleMessage[] = {
+    { 1, 255 },
+    { 2, 0x0140 },
+    { 3, 255 }
+};
+
+static const Attribute_t titleDate[] = {
+    { 1, 255 },
+    { 5, 0 }
+};
+
+static const Attribute_t titleTwice[] = {
+    { 1, 255 },
+    { 1, 255 }
+};
+
+static const Attribute_t displayName[] = {
+    { 0, 0 }
+};
+
+static bool passed = true;
+
+static void check(bool condition, const char* name)
+{
+    if (!condition)
+    {
+        printf("codec: %s: FAIL\r\n", name);
+        passed = false;
+    }
+}
+
+static bool equal(const uint8_t* payload, uint8_t length, const uint8_t* expected, uint8_t expectedLength)
+{
+    return (length == expectedLength) && (memcmp(payload, expected, length) == 0);
+}
+
+static void testEncode()
+{
+    uint8_t payload[20];
+    uint8_t length;
+
+    const uint8_t notificationAttributes[] = {
+        0x00, 0x78, 0x56, 0x34, 0x12,
+        0x01, 0xFF, 0x00,
+        0x02, 0x40, 0x01,
+        0x03, 0xFF, 0x00
+    };
+
+    length = DefaultCodec::encodeNotificationAttributes(payload, 0x12345678, titleSubtitleMessage, 3);
+    check(equal(payload, length, notificationAttributes, sizeof(notificationAttributes)), "notification attributes");
+
+    const uint8_t titleAndDate[] = {
+        0x00, 0x01, 0x00, 0x00, 0x00,
+        0x01, 0xFF, 0x00,
+        0x05
+    };
+
+    length = DefaultCodec::encodeNotificationAttributes(payload, 1, titleDate, 2);
+    check(equal(payload, length, titleAndDate, sizeof(titleAndDate)), "attribute without max length");
+
+    check(DefaultCodec::encodeNotificationAttributes(payload, 1, titleTwice, 2) == 0, "repeated attribute");
+    check(DefaultCodec::encodeNotificationAttributes(payload, 1, titleSubtitleMessage, 0) == 0, "no attributes");
+
+    const uint8_t appAttributes[] = {
+        0x01, 'c', 'o', 'm', '.', 'a', 'p', 'p', 'l', 'e', '.', 'm', 'a', 'i', 'l', 0x00,
+        0x00
+    };
+
+    length = DefaultCodec::encodeAppAttributes(payload, "com.apple.mail", displayName, 1);
+    check(equal(payload, length, appAttributes, sizeof(appAttributes)), "app attributes");
+
+    check(DefaultCodec::encodeAppAttributes(payload, "com.apple.mobilemail", displayName, 1) == 0, "app identifier too long");
+    check(DefaultCodec::encodeAppAttributes(payload, "", displayName, 1) == 0, "empty app identifier");
+
+    const uint8_t action[] = {
+        0x02, 0x04, 0x03, 0x02, 0x01, 0x01
+    };
+
+    length = DefaultCodec::encodeNotificationAction(payload, 0x01020304, 1);
+    check(equal(payload, length, action, sizeof(action)), "notification action");
+    check(DefaultCodec::encodeNotificationAction(payload, 1, 2) == 0, "unknown action");
+}
+
+static void testRestricted()
+{
+    uint8_t payload[20];
+    uint8_t length;
+
+    check(SmallCodec::isEnabled(1) && SmallCodec::isEnabled(3), "enabled attributes");
+    check(!SmallCodec::isEnabled(2) && !SmallCodec::isEnabled(5) && !SmallCodec::isEnabled(8), "disabled attributes");
+
+    check(SmallCodec::encodeNotificationAttributes(payload, 1, titleSubtitleMessage, 3) == 0, "disabled attribute refused");
+    check(SmallCodec::encodeNotificationAttributes(payload, 1, titleDate, 2) == 0, "disabled attribute refused");
+
+    const uint8_t clamped[] = {
+        0x00, 0x01, 0x00, 0x00, 0x00,
+        0x01, 0x40, 0x00
+    };
+
+    length = SmallCodec::encodeNotificationAttributes(payload, 1, titleDate, 1);
+    check(equal(payload, length, clamped, sizeof(clamped)), "max length clamped");
+}
+
+static void testDecode()
+{
+    const uint8_t event[] = {
+        0x00, 0x18, 0x01, 0x02, 0x78, 0x56, 0x34, 0x12
+    };
+
+    Notification_t notification;
+
+    check(DefaultCodec::decodeNotification(event, sizeof(event), notification), "notification decoded");
+    check((notification.eventID == 0) &&
+          (notification.eventFlags == 0x18) &&
+          (notification.categoryID == 1) &&
+          (notification.categoryCount == 2) &&
+          (notification.notificationUID == 0x12345678), "notification fields");
+
+    check(!DefaultCodec::decodeNotification(event, sizeof(event) - 1, notification), "short notification");
+    check(!DefaultCodec::decodeNotification(NULL, sizeof(event), notification), "missing notification");
+}
+
+/*****************************************************************************/
+/* Benchmark                                                                 */
+/*****************************************************************************/
+
+static volatile uint32_t sink = 0;
+
+/*
+    On the host the scheduler runs in simulated time, so the monotonic clock
+    is read instead, in microseconds.
+*/
+#if defined(TARGET_LIKE_X86_LINUX_NATIVE)
+static const uint32_t TICKS_PER_SECOND = 1000000;
+
+static minar::platform::tick_t now()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (minar::platform::tick_t) ((time.tv_sec * 1000000ULL) + (time.tv_nsec / 1000));
+}
+#else
+static const uint32_t TICKS_PER_SECOND = minar::milliseconds(1000);
+
+static minar::platform::tick_t now()
+{
+    return minar::platform::getTime();
+}
+#endif
+
+static void report(const char* name, uint32_t ticks)
+{
+    printf("{\"codec\":\"%s\",\"calls\":%u,\"ticks\":%lu,\"ticks_per_second\":%lu,\"ticks_per_million_calls\":%lu}\r\n",
+           name,
+           BENCHMARK_CALLS,
+           (unsigned long) ticks,
+           (unsigned long) TICKS_PER_SECOND,
+           (unsigned long) (((uint64_t) ticks * 1000000) / BENCHMARK_CALLS));
+}
+
+static void runBenchmark()
+{
+    uint8_t payload[20];
+    Notification_t notification;
+    uint8_t event[8] = { 0x00, 0x18, 0x01, 0x02, 0x00, 0x00, 0x00, 0x00 };
+    uint32_t start;
+
+    start = now();
+
+    for (uint32_t call = 0; call < BENCHMARK_CALLS; call++)
+    {
+        sink += DefaultCodec::encodeNotificationAttributes(payload, call, titleSubtitleMessage, 3);
+    }
+
+    report("encode_notification_attributes", (now() - start) & minar::platform::Time_Mask);
+
+    start = now();
+
+    for (uint32_t call = 0; call < BENCHMARK_CALLS; call++)
+    {
+        sink += DefaultCodec::encodeNotificationAction(payload, call, call & 0x01);
+    }
+
+    report("encode_notification_action", (now() - start) & minar::platform::Time_Mask);
+
+    start = now();
+
+    for (uint32_t call = 0; call < BENCHMARK_CALLS; call++)
+    {
+        event[4] = call;
+        DefaultCodec::decodeNotification(event, sizeof(event), notification);
+        sink += notification.notificationUID;
+    }
+
+    report("decode_notification", (now() - start) & minar::platform::Time_Mask);
+}
+
+static void runTests()
+{
+    testEncode();
+    testRestricted();
+    testDecode();
+
+    runBenchmark();
+
+    MBED_HOSTTEST_RESULT(passed);
+}
+
+void app_start(int, char *[])
+{
+    MBED_HOSTTEST_TIMEOUT(20);
+    MBED_HOSTTEST_SELECT(default_auto);
+    MBED_HOSTTEST_DESCRIPTION(ANCS codec);
+    MBED_HOSTTEST_START("ANCS_CODEC");
+
+    minar::Scheduler::postCallback(runTests);
+}
@@ -0,0 +1,207 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+    Unit test for ANCSAttributeDecoder.
+
+    Every value is decoded whole and split at every position, as fragment
+    boundaries can fall anywhere. Dates are checked against reference
+    epochs, and text against characters of each UTF-8 length cut at every
+    byte.
+*/
+
+#include "mbed-drivers/mbed.h"
+#include "mbed-drivers/test_env.h"
+
+#include "ble-ancs-client/ANCSAttributeDecoder.h"
+
+#define ATTRIBUTE_TITLE         1
+#define ATTRIBUTE_MESSAGE_SIZE  4
+#define ATTRIBUTE_DATE          5
+
+static bool passed = true;
+
+static void check(bool condition, const char* name)
+{
+    if (!condition)
+    {
+        printf("decoder: %s: FAIL\r\n", name);
+        passed = false;
+    }
+}
+
+/*
+    Decode value whole and in two pieces split at every position. Returns
+    false if the results differ.
+*/
+static bool decode(ANCSAttributeDecoder& decoder, uint8_t attributeID, const char* value, uint16_t limit = 0xFFFF)
+{
+    const uint8_t* data = (const uint8_t*) value;
+    uint16_t length = strlen(value);
+
+    decoder.start(attributeID, length, limit);
+    decoder.update(data, length);
+
+    bool valid = decoder.isValid();
+    uint32_t result = decoder.getValue();
+    uint16_t textLength = decoder.getTextLength();
+
+    for (uint16_t split = 0; split <= length; split++)
+    {
+        decoder.start(attributeID, length, limit);
+        decoder.update(data, split);
+        decoder.update(data + split, length - split);
+
+        if ((decoder.isValid() != valid) ||
+            (decoder.getValue() != result) ||
+            (decoder.getTextLength() != textLength))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void testInteger()
+{
+    ANCSAttributeDecoder decoder;
+
+    check(decode(decoder, ATTRIBUTE_MESSAGE_SIZE, "51"), "size split");
+    check(decoder.getType() == ANCSAttributeDecoder::TypeInteger, "size type");
+    check(decoder.isValid() && (decoder.getValue() == 51), "size");
+
+    decode(decoder, ATTRIBUTE_MESSAGE_SIZE, "4294967295");
+    check(decoder.isValid() && (decoder.getValue() == 4294967295UL), "largest size");
+
+    decode(decoder, ATTRIBUTE_MESSAGE_SIZE, "4294967296");
+    check(!decoder.isValid(), "size overflow");
+
+    decode(decoder, ATTRIBUTE_MESSAGE_SIZE, "5x");
+    check(!decoder.isValid() && (decoder.getValue() == 0), "size not a number");
+
+    decode(decoder, ATTRIBUTE_MESSAGE_SIZE, "");
+    check(!decoder.isValid(), "empty size");
+}
+
+static void testDate()
+{
+    ANCSAttributeDecoder decoder;
+
+    check(decode(decoder, ATTRIBUTE_DATE, "20261016T101500"), "date split");
+    check(decoder.getType() == ANCSAttributeDecoder::TypeDate, "date type");
+    check(decoder.isValid() && (decoder.getValue() == 1792145700UL), "date");
+
+    decode(decoder, ATTRIBUTE_DATE, "19700101T000000");
+    check(decoder.isValid() && (decoder.getValue() == 0), "epoch");
+
+    decode(decoder, ATTRIBUTE_DATE, "20000229T120000");
+    check(decoder.isValid() && (decoder.getValue() == 951825600UL), "leap day");
+
+    decode(decoder, ATTRIBUTE_DATE, "20000301T000000");
+    check(decoder.isValid() && (decoder.getValue() == 951868800UL), "after leap day");
+
+    decode(decoder, ATTRIBUTE_DATE, "21051231T235959");
+    check(decoder.isValid() && (decoder.getValue() == 4291747199UL), "last date");
+
+    decode(decoder, ATTRIBUTE_DATE, "21060101T000000");
+    check(!decoder.isValid(), "date out of range");
+
+    decode(decoder, ATTRIBUTE_DATE, "20261316T101500");
+    check(!decoder.isValid() && (decoder.getValue() == 0), "month out of range");
+
+    decode(decoder, ATTRIBUTE_DATE, "20260231T101500");
+    check(!decoder.isValid(), "day out of range");
+
+    decode(decoder, ATTRIBUTE_DATE, "21000229T000000");
+    check(!decoder.isValid(), "century without leap day");
+
+    decode(decoder, ATTRIBUTE_DATE, "20261016 101500");
+    check(!decoder.isValid(), "missing separator");
+
+    decode(decoder, ATTRIBUTE_DATE, "20261016T1015");
+    check(!decoder.isValid(), "short date");
+
+    decode(decoder, ATTRIBUTE_DATE, "20261016T1015000");
+    check(!decoder.isValid(), "long date");
+}
+
+static void testText()
+{
+    ANCSAttributeDecoder decoder;
+
+    // e acute, euro sign, and an emoji: two, three, and four bytes
+    const char* text = "Caf\xC3\xA9 \xE2\x82\xAC \xF0\x9F\x98\x80";
+    const uint8_t ends[] = { 1, 2, 3, 5, 6, 9, 10, 14 };
+    uint16_t length = strlen(text);
+
+    check(decode(decoder, ATTRIBUTE_TITLE, text), "text split");
+    check(decoder.getType() == ANCSAttributeDecoder::TypeText, "text type");
+    check(decoder.isValid() && (decoder.getTextLength() == length), "whole text");
+
+    // cut by a maximum length at every byte
+    for (uint16_t cut = 0; cut <= length; cut++)
+    {
+        char truncated[16];
+        uint16_t expected = 0;
+
+        memcpy(truncated, text, cut);
+        truncated[cut] = '\0';
+
+        for (uint8_t index = 0; (index < sizeof(ends)) && (ends[index] <= cut); index++)
+        {
+            expected = ends[index];
+        }
+
+        check(decode(decoder, ATTRIBUTE_TITLE, truncated) && (decoder.getTextLength() == expected), "truncated text");
+    }
+
+    // same cut by a shorter buffer
+    decode(decoder, ATTRIBUTE_TITLE, text, 4);
+    check(decoder.getTextLength() == 3, "text limit");
+
+    // malformed text ends before the first broken character
+    check(decode(decoder, ATTRIBUTE_TITLE, "a\x80" "b") && !decoder.isValid(), "stray continuation split");
+    check(decoder.getTextLength() == 1, "stray continuation");
+
+    check(decode(decoder, ATTRIBUTE_TITLE, "ab\xC3" "c\xC3\xA9") && !decoder.isValid(), "unfinished character split");
+    check(decoder.getTextLength() == 2, "unfinished character");
+
+    decode(decoder, ATTRIBUTE_TITLE, "a\xF8\x80");
+    check(!decoder.isValid() && (decoder.getTextLength() == 1), "invalid lead byte");
+
+    decode(decoder, ATTRIBUTE_TITLE, "");
+    check(decoder.isValid() && (decoder.getTextLength() == 0), "empty text");
+}
+
+static void runTests()
+{
+    testInteger();
+    testDate();
+    testText();
+
+    MBED_HOSTTEST_RESULT(passed);
+}
+
+void app_start(int, char *[])
+{
+    MBED_HOSTTEST_TIMEOUT(20);
+    MBED_HOSTTEST_SELECT(default_auto);
+    MBED_HOSTTEST_DESCRIPTION(ANCS attribute decoder);
+    MBED_HOSTTEST_START("ANCS_DECODER");
+
+    minar::Scheduler::postCallback(runTests);
+}
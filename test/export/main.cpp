@@ -0,0 +1,250 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+    Unit test for ANCSCborExport.
+
+    A notification is encoded whole and compared with a reference map.
+    Text is then split at every position, as fragment boundaries can fall
+    anywhere, and every text chunk must hold whole UTF-8 characters.
+*/
+
+#include "mbed-drivers/mbed.h"
+#include "mbed-drivers/test_env.h"
+
+#include "ble-ancs-client/ANCSCborExport.h"
+
+#define ATTRIBUTE_TITLE         1
+#define ATTRIBUTE_MESSAGE       3
+#define ATTRIBUTE_MESSAGE_SIZE  4
+#define ATTRIBUTE_DATE          5
+
+static bool passed = true;
+
+static void check(bool condition, const char* name)
+{
+    if (!condition)
+    {
+        printf("export: %s: FAIL\r\n", name);
+        passed = false;
+    }
+}
+
+/*****************************************************************************/
+/* Sink                                                                      */
+/*****************************************************************************/
+
+static uint8_t output[128];
+static uint16_t outputLength = 0;
+static uint8_t lastState = 0xFF;
+static uint8_t terminalChunks = 0;
+
+static void collect(const ANCSCborExport::Chunk_t* chunk)
+{
+    if ((chunk->length > 0) && (outputLength + chunk->length <= sizeof(output)))
+    {
+        memcpy(&output[outputLength], chunk->data, chunk->length);
+    }
+
+    outputLength += chunk->length;
+    lastState = chunk->state;
+
+    if (chunk->state != ANCSCborExport::ChunkData)
+    {
+        terminalChunks++;
+    }
+}
+
+static void resetOutput()
+{
+    outputLength = 0;
+    lastState = 0xFF;
+    terminalChunks = 0;
+}
+
+static void feed(ANCSCborExport& exporter, uint8_t attributeID, const char* value, uint16_t split)
+{
+    const uint8_t* data = (const uint8_t*) value;
+    uint16_t length = strlen(value);
+
+    exporter.attributeStarted(attributeID, length);
+
+    if (split > 0)
+    {
+        exporter.attributeData(data, split);
+    }
+
+    if (split < length)
+    {
+        exporter.attributeData(data + split, length - split);
+    }
+
+    exporter.attributeCompleted();
+}
+
+/*
+    Concatenate the chunks of the indefinite length text at output[start].
+    Returns false if the framing is wrong or a chunk has a partial character.
+*/
+static bool readText(uint16_t start, char* text, uint16_t* end)
+{
+    ANCSAttributeDecoder decoder;
+    uint16_t index = start;
+    uint16_t textLength = 0;
+
+    if (output[index++] != 0x7F)
+    {
+        return false;
+    }
+
+    while ((index < outputLength) && (output[index] != 0xFF))
+    {
+        uint8_t head = output[index++];
+        uint16_t length = head & 0x1F;
+
+        if ((head & 0xE0) != 0x60)
+        {
+            return false;
+        }
+
+        if (length == 24)
+        {
+            length = output[index++];
+        }
+
+        decoder.start(ATTRIBUTE_TITLE, length, length);
+        decoder.update(&output[index], length);
+
+        if ((length == 0) || ((output[index] & 0xC0) == 0x80) || (decoder.getTextLength() != length))
+        {
+            return false;
+        }
+
+        memcpy(&text[textLength], &output[index], length);
+        textLength += length;
+        index += length;
+    }
+
+    text[textLength] = '\0';
+    *end = index + 1;
+
+    return (index < outputLength);
+}
+
+/*****************************************************************************/
+/* Tests                                                                     */
+/*****************************************************************************/
+
+static void testNotification()
+{
+    ANCSCborExport exporter;
+    exporter.setSink(collect);
+
+    // {0: 0x12345678, 1: 6, 2: 0x10, 3: {1: "Hi", 4: 51, 5: 1792145700}}
+    static const uint8_t expected[] = {
+        0xA4, 0x00, 0x1A, 0x12, 0x34, 0x56, 0x78, 0x01, 0x06, 0x02, 0x10, 0x03, 0xA3,
+        0x01, 0x7F, 0x62, 'H', 'i', 0xFF,
+        0x04, 0x18, 0x33,
+        0x05, 0x1A, 0x6A, 0xD1, 0xF9, 0x24
+    };
+
+    resetOutput();
+    exporter.begin(0x12345678, 6, 0x10, 3);
+    feed(exporter, ATTRIBUTE_TITLE, "Hi", 0);
+    feed(exporter, ATTRIBUTE_MESSAGE_SIZE, "51", 1);
+    feed(exporter, ATTRIBUTE_DATE, "20261016T101500", 9);
+
+    check((outputLength == sizeof(expected)) && (memcmp(output, expected, sizeof(expected)) == 0), "notification");
+    check((lastState == ANCSCborExport::ChunkEnd) && (terminalChunks == 1) && !exporter.isActive(), "end");
+
+    // {0: 7, 3: {3: "", 4: null}}
+    static const uint8_t unknown[] = { 0xA2, 0x00, 0x07, 0x03, 0xA2, 0x03, 0x60, 0x04, 0xF6 };
+
+    resetOutput();
+    exporter.begin(7, ANCSCborExport::CategoryUnknown, 0, 2);
+    feed(exporter, ATTRIBUTE_MESSAGE, "", 0);
+    feed(exporter, ATTRIBUTE_MESSAGE_SIZE, "5x", 0);
+
+    check((outputLength == sizeof(unknown)) && (memcmp(output, unknown, sizeof(unknown)) == 0), "unknown category");
+    check(lastState == ANCSCborExport::ChunkEnd, "empty text end");
+
+    // a failed response ends with a single abort
+    resetOutput();
+    exporter.begin(8, 4, 0, 2);
+    feed(exporter, ATTRIBUTE_TITLE, "Hi", 1);
+    exporter.abort();
+    exporter.abort();
+
+    check((lastState == ANCSCborExport::ChunkAborted) && (terminalChunks == 1), "abort");
+}
+
+static void testText()
+{
+    ANCSCborExport exporter;
+    exporter.setSink(collect);
+
+    // e acute, euro sign, and an emoji: two, three, and four bytes
+    const char* text = "Caf\xC3\xA9 \xE2\x82\xAC \xF0\x9F\x98\x80";
+    uint16_t length = strlen(text);
+
+    for (uint16_t split = 0; split <= length; split++)
+    {
+        char received[32];
+        uint16_t end = 0;
+
+        resetOutput();
+        exporter.begin(9, ANCSCborExport::CategoryUnknown, 0, 1);
+        feed(exporter, ATTRIBUTE_TITLE, text, split);
+
+        // map head, UID, attributes, title key
+        check(readText(6, received, &end) && (strcmp(received, text) == 0) && (end == outputLength), "split text");
+    }
+
+    // cut by a maximum length inside the emoji
+    for (uint16_t cut = length - 3; cut < length; cut++)
+    {
+        char truncated[32];
+        char received[32];
+        uint16_t end = 0;
+
+        memcpy(truncated, text, cut);
+        truncated[cut] = '\0';
+
+        resetOutput();
+        exporter.begin(9, ANCSCborExport::CategoryUnknown, 0, 1);
+        feed(exporter, ATTRIBUTE_TITLE, truncated, cut - 1);
+
+        check(readText(6, received, &end) && (strlen(received) == (size_t) (length - 4)), "truncated text");
+    }
+}
+
+static void runTests()
+{
+    testNotification();
+    testText();
+
+    MBED_HOSTTEST_RESULT(passed);
+}
+
+void app_start(int, char *[])
+{
+    MBED_HOSTTEST_TIMEOUT(20);
+    MBED_HOSTTEST_SELECT(default_auto);
+    MBED_HOSTTEST_DESCRIPTION(ANCS CBOR export);
+    MBED_HOSTTEST_START("ANCS_EXPORT");
+
+    minar::Scheduler::postCallback(runTests);
+}
@@ -0,0 +1,403 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+    Fuzz target for the Data Source reassembler.
+
+    The input is split into fragments and fed to ANCSResponseParser, with a
+    listener that checks every callback against the framing: values stay
+    within the announced attribute length, offsets are contiguous, and
+    identifiers are terminated and short enough. The listener refuses some
+    responses and attributes and abandons some between fragments, driven by
+    the input, and announces an attribute count for some responses, so that
+    both the skipping and the recovery paths are covered. Any violation
+    aborts.
+
+    The parser only depends on the C library, so the target builds on the
+    host with libFuzzer:
+
+        clang++ -g -O1 -fsanitize=fuzzer,address,undefined -DANCS_FUZZ_LIBFUZZER \
+                -I. test/fuzz/main.cpp -o ancs-fuzz
+
+    AFL can drive the same function through its libFuzzer driver. Without
+    ANCS_FUZZ_LIBFUZZER this file is a regular test that runs generated
+    inputs, well-formed responses with random mutations, and reports the
+    fragments parsed per second.
+*/
+
+#include "ble-ancs-client/ANCSResponseParser.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(TARGET_LIKE_X86_LINUX_NATIVE)
+#include <time.h>
+#endif
+
+#define IDENTIFIER_LENGTH       32
+
+typedef ANCSResponseParser<IDENTIFIER_LENGTH> Parser;
+
+class CheckingListener : public ANCSResponseListener
+{
+public:
+    CheckingListener()
+        :   parser(NULL),
+            random(0),
+            inResponse(false),
+            inAttribute(false),
+            attributeLength(0),
+            received(0)
+    {}
+
+    /*
+        Seed for the accept and refuse decisions.
+    */
+    void setSeed(uint8_t seed)
+    {
+        random = seed;
+        inResponse = false;
+        inAttribute = false;
+    }
+
+    void setParser(Parser* _parser)
+    {
+        parser = _parser;
+    }
+
+    /*
+        Decide whether to stop following the response in progress.
+    */
+    bool abandon()
+    {
+        if (accept())
+        {
+            return false;
+        }
+
+        inResponse = false;
+        inAttribute = false;
+
+        return true;
+    }
+
+    virtual bool responseStarted(uint8_t commandID, uint32_t notificationUID, const char* appIdentifier)
+    {
+        (void) notificationUID;
+
+        check(!inAttribute);
+
+        if (commandID == Parser::CommandIDGetAppAttributes)
+        {
+            check(appIdentifier != NULL);
+            check(memchr(appIdentifier, '\0', IDENTIFIER_LENGTH + 1) != NULL);
+        }
+        else
+        {
+            check(commandID == Parser::CommandIDGetNotificationAttributes);
+            check(appIdentifier == NULL);
+        }
+
+        // 0 leaves the count unknown
+        parser->setAttributeCount(next() % 8);
+
+        inResponse = accept();
+
+        return inResponse;
+    }
+
+    virtual bool attributeStarted(uint8_t attributeID, uint16_t length)
+    {
+        (void) attributeID;
+
+        check(inResponse && !inAttribute);
+
+        attributeLength = length;
+        received = 0;
+        inAttribute = accept();
+        inResponse = inAttribute;
+
+        return inAttribute;
+    }
+
+    virtual void attributeData(const uint8_t* data, uint16_t length, uint16_t offset)
+    {
+        check(inAttribute);
+        check(data != NULL);
+        check(length > 0);
+        check(offset == received);
+        check(length <= attributeLength - received);
+
+        // touch every byte so that out of bounds views are caught
+        volatile uint8_t sum = 0;
+
+        for (uint16_t index = 0; index < length; index++)
+        {
+            sum += data[index];
+        }
+
+        received += length;
+    }
+
+    virtual bool attributeCompleted()
+    {
+        check(inAttribute);
+        check(received == attributeLength);
+
+        inAttribute = false;
+        inResponse = accept();
+
+        return inResponse;
+    }
+
+private:
+    uint16_t next()
+    {
+        random = random * 1103515245 + 12345;
+
+        return random >> 16;
+    }
+
+    bool accept()
+    {
+        // refuse one in eight
+        return (next() & 0x07) != 0;
+    }
+
+    static void check(bool condition)
+    {
+        if (!condition)
+        {
+            abort();
+        }
+    }
+
+private:
+    Parser* parser;
+    uint32_t random;
+    bool inResponse;
+    bool inAttribute;
+    uint16_t attributeLength;
+    uint16_t received;
+};
+
+static CheckingListener listener;
+static Parser parser(&listener);
+static uint32_t fragments = 0;
+
+/*
+    First byte: fragment size (1 to 256) and listener seed. The rest is the
+    Data Source stream.
+*/
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    if (size < 1)
+    {
+        return 0;
+    }
+
+    uint16_t fragmentMax = (uint16_t) data[0] + 1;
+
+    parser.reset();
+    listener.setParser(&parser);
+    listener.setSeed(data[0]);
+
+    for (size_t offset = 1; offset < size; offset += fragmentMax)
+    {
+        size_t length = size - offset;
+        length = (length > fragmentMax) ? fragmentMax : length;
+
+        if (listener.abandon())
+        {
+            parser.skipResponse();
+        }
+
+        parser.parse(&data[offset], (uint16_t) length);
+        fragments++;
+    }
+
+    return 0;
+}
+
+#ifndef ANCS_FUZZ_LIBFUZZER
+
+#include "mbed-drivers/mbed.h"
+#include "mbed-drivers/test_env.h"
+
+#define FUZZ_INPUTS             20000
+#define FUZZ_INPUT_LENGTH       512
+
+static uint32_t seed = 1;
+
+static uint8_t nextRandom()
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 16;
+}
+
+/*
+    Well-formed Get Notification Attributes or Get App Attributes response
+    with random attributes, preceded by the fragment size byte.
+*/
+static size_t generate(uint8_t* buffer, size_t size)
+{
+    size_t length = 0;
+
+    buffer[length++] = nextRandom();
+
+    if (nextRandom() & 0x01)
+    {
+        buffer[length++] = Parser::CommandIDGetNotificationAttributes;
+
+        for (uint8_t index = 0; index < 4; index++)
+        {
+            buffer[length++] = nextRandom();
+        }
+    }
+    else
+    {
+        uint8_t identifierLength = nextRandom() % (IDENTIFIER_LENGTH + 8);
+
+        buffer[length++] = Parser::CommandIDGetAppAttributes;
+
+        for (uint8_t index = 0; index < identifierLength; index++)
+        {
+            buffer[length++] = 'a' + (nextRandom() % 26);
+        }
+
+        buffer[length++] = '\0';
+    }
+
+    uint8_t attributes = nextRandom() % 8;
+
+    for (uint8_t attribute = 0; attribute < attributes; attribute++)
+    {
+        uint16_t valueLength = nextRandom();
+
+        if (length + 3 + valueLength > size)
+        {
+            break;
+        }
+
+        buffer[length++] = nextRandom() % 8;
+        buffer[length++] = valueLength;
+        buffer[length++] = valueLength >> 8;
+
+        for (uint16_t index = 0; index < valueLength; index++)
+        {
+            buffer[length++] = nextRandom();
+        }
+    }
+
+    return length;
+}
+
+/*
+    On the host the scheduler runs in simulated time, so the monotonic clock
+    is read instead, in microseconds.
+*/
+#if defined(TARGET_LIKE_X86_LINUX_NATIVE)
+static const uint32_t TICKS_PER_SECOND = 1000000;
+
+static minar::platform::tick_t now()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (minar::platform::tick_t) ((time.tv_sec * 1000000ULL) + (time.tv_nsec / 1000));
+}
+#else
+static const uint32_t TICKS_PER_SECOND = minar::milliseconds(1000);
+
+static minar::platform::tick_t now()
+{
+    return minar::platform::getTime();
+}
+#endif
+
+static void runFuzz()
+{
+    uint8_t buffer[FUZZ_INPUT_LENGTH];
+    uint32_t start = now();
+
+    for (uint32_t input = 0; input < FUZZ_INPUTS; input++)
+    {
+        size_t length = generate(buffer, sizeof(buffer));
+
+        // flip, truncate, or extend a quarter of the inputs
+        switch (nextRandom() & 0x07)
+        {
+            case 0:
+                if (length > 1)
+                {
+                    buffer[1 + (nextRandom() % (length - 1))] ^= 1 << (nextRandom() % 8);
+                }
+                break;
+
+            case 1:
+                length = 1 + (nextRandom() % length);
+                break;
+
+            case 2:
+                while (length < sizeof(buffer) / 2)
+                {
+                    buffer[length++] = nextRandom();
+                }
+                break;
+
+            default:
+                break;
+        }
+
+        LLVMFuzzerTestOneInput(buffer, length);
+    }
+
+    uint32_t ticks = (now() - start) & minar::platform::Time_Mask;
+    const Parser::Statistics_t& statistics = parser.getStatistics();
+
+    printf("{\"fuzz\":\"data_source\","
+           "\"inputs\":%u,"
+           "\"fragments\":%lu,"
+           "\"ticks\":%lu,"
+           "\"fragments_per_second\":%lu,"
+           "\"responses\":%lu,"
+           "\"attributes\":%lu,"
+           "\"rejected\":%lu,"
+           "\"skipped\":%lu}\r\n",
+           FUZZ_INPUTS,
+           (unsigned long) fragments,
+           (unsigned long) ticks,
+           (unsigned long) ((ticks) ? ((uint64_t) fragments * TICKS_PER_SECOND) / ticks : 0),
+           (unsigned long) statistics.responses,
+           (unsigned long) statistics.attributes,
+           (unsigned long) statistics.rejected,
+           (unsigned long) statistics.skipped);
+
+    // violations abort before this point
+    MBED_HOSTTEST_RESULT(true);
+}
+
+void app_start(int, char *[])
+{
+    MBED_HOSTTEST_TIMEOUT(60);
+    MBED_HOSTTEST_SELECT(default_auto);
+    MBED_HOSTTEST_DESCRIPTION(ANCS response parser fuzz);
+    MBED_HOSTTEST_START("ANCS_FUZZ");
+
+    minar::Scheduler::postCallback(runFuzz);
+}
+
+#endif // ANCS_FUZZ_LIBFUZZER
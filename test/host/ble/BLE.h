@@ -0,0 +1,375 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __HOST_BLE_H__
+#define __HOST_BLE_H__
+
+/*
+    Host stand-in for the BLE API. Event callbacks can be registered, but
+    there is no radio: the simulation plays the phone by calling the
+    ANCSDispatcher entry points and answers GATT and security operations
+    in the hooks of its ANCSClient. Operations that reach this stand-in
+    anyway print a message and abort; see host.cpp.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "ble/blecommon.h"
+#include "ble/UUID.h"
+#include "ble/DiscoveredCharacteristic.h"
+#include "core-util/FunctionPointer.h"
+
+namespace BLEProtocol
+{
+    struct AddressType
+    {
+        enum Type
+        {
+            PUBLIC = 0,
+            RANDOM_STATIC,
+            RANDOM_PRIVATE_RESOLVABLE,
+            RANDOM_PRIVATE_NON_RESOLVABLE
+        };
+    };
+
+    typedef AddressType::Type AddressType_t;
+
+    static const unsigned ADDR_LEN = 6;
+
+    typedef uint8_t AddressBytes_t[ADDR_LEN];
+
+    struct Address_t
+    {
+        AddressType_t type;
+        AddressBytes_t address;
+    };
+}
+
+class Gap
+{
+public:
+    typedef uint16_t Handle_t;
+    typedef BLEProtocol::AddressType_t AddressType_t;
+    typedef BLEProtocol::AddressBytes_t Address_t;
+
+    enum Role_t
+    {
+        PERIPHERAL = 0x1,
+        CENTRAL    = 0x2
+    };
+
+    enum DisconnectionReason_t
+    {
+        CONNECTION_TIMEOUT                          = 0x08,
+        REMOTE_USER_TERMINATED_CONNECTION           = 0x13,
+        REMOTE_DEV_TERMINATION_DUE_TO_LOW_RESOURCES = 0x14,
+        REMOTE_DEV_TERMINATION_DUE_TO_POWER_OFF     = 0x15,
+        LOCAL_HOST_TERMINATED_CONNECTION            = 0x16,
+        CONN_INTERVAL_UNACCEPTABLE                  = 0x3B
+    };
+
+    struct Whitelist_t
+    {
+        BLEProtocol::Address_t* addresses;
+        uint8_t size;
+        uint8_t capacity;
+    };
+
+    struct ConnectionParams_t
+    {
+        uint16_t minConnectionInterval;
+        uint16_t maxConnectionInterval;
+        uint16_t slaveLatency;
+        uint16_t connectionSupervisionTimeout;
+    };
+
+    struct ConnectionCallbackParams_t
+    {
+        Handle_t handle;
+        Role_t role;
+        AddressType_t peerAddrType;
+        Address_t peerAddr;
+        AddressType_t ownAddrType;
+        Address_t ownAddr;
+        const ConnectionParams_t* connectionParams;
+
+        ConnectionCallbackParams_t(Handle_t _handle,
+                                   Role_t _role,
+                                   AddressType_t _peerAddrType,
+                                   const uint8_t* _peerAddr,
+                                   AddressType_t _ownAddrType,
+                                   const uint8_t* _ownAddr,
+                                   const ConnectionParams_t* _connectionParams)
+            :   handle(_handle),
+                role(_role),
+                peerAddrType(_peerAddrType),
+                ownAddrType(_ownAddrType),
+                connectionParams(_connectionParams)
+        {
+            memcpy(peerAddr, _peerAddr, sizeof(peerAddr));
+            memcpy(ownAddr, _ownAddr, sizeof(ownAddr));
+        }
+    };
+
+    struct DisconnectionCallbackParams_t
+    {
+        Handle_t handle;
+        DisconnectionReason_t reason;
+
+        DisconnectionCallbackParams_t(Handle_t _handle, DisconnectionReason_t _reason)
+            :   handle(_handle),
+                reason(_reason)
+        {}
+    };
+
+    typedef FunctionPointerWithContext<const ConnectionCallbackParams_t*> ConnectionEventCallback_t;
+    typedef FunctionPointerWithContext<const DisconnectionCallbackParams_t*> DisconnectionEventCallback_t;
+
+    void onConnection(const ConnectionEventCallback_t& callback)
+    {
+        connectionCallback = callback;
+    }
+
+    void onDisconnection(const DisconnectionEventCallback_t& callback)
+    {
+        disconnectionCallback = callback;
+    }
+
+    ble_error_t updateConnectionParams(Handle_t handle, const ConnectionParams_t* params);
+    ble_error_t disconnect(Handle_t handle, DisconnectionReason_t reason);
+
+private:
+    ConnectionEventCallback_t connectionCallback;
+    DisconnectionEventCallback_t disconnectionCallback;
+};
+
+class DiscoveredService
+{
+public:
+    DiscoveredService()
+        :   uuid(UUID::ShortUUIDBytes_t(0)),
+            startHandle(GattAttribute::INVALID_HANDLE),
+            endHandle(GattAttribute::INVALID_HANDLE)
+    {}
+
+    const UUID& getUUID() const                     { return uuid; }
+    GattAttribute::Handle_t getStartHandle() const  { return startHandle; }
+    GattAttribute::Handle_t getEndHandle() const    { return endHandle; }
+
+protected:
+    UUID uuid;
+    GattAttribute::Handle_t startHandle;
+    GattAttribute::Handle_t endHandle;
+};
+
+struct GattCharacteristic
+{
+    static const uint16_t BLE_UUID_DESCRIPTOR_CLIENT_CHAR_CONFIG = 0x2902;
+};
+
+struct GattHVXCallbackParams
+{
+    Gap::Handle_t connHandle;
+    GattAttribute::Handle_t handle;
+    HVXType_t type;
+    uint16_t len;
+    const uint8_t* data;
+};
+
+struct GattWriteCallbackParams
+{
+    enum WriteOp_t
+    {
+        OP_INVALID   = 0x00,
+        OP_WRITE_REQ = 0x01,
+        OP_WRITE_CMD = 0x02
+    };
+
+    Gap::Handle_t connHandle;
+    GattAttribute::Handle_t handle;
+    WriteOp_t writeOp;
+    uint16_t offset;
+    uint16_t len;
+    const uint8_t* data;
+};
+
+struct GattReadCallbackParams
+{
+    Gap::Handle_t connHandle;
+    GattAttribute::Handle_t handle;
+    uint16_t offset;
+    uint16_t len;
+    const uint8_t* data;
+};
+
+class GattClient
+{
+public:
+    enum WriteOp_t
+    {
+        GATT_OP_WRITE_REQ = 0x01,
+        GATT_OP_WRITE_CMD = 0x02
+    };
+
+    typedef FunctionPointerWithContext<const DiscoveredService*> ServiceDiscoveryCallback_t;
+    typedef FunctionPointerWithContext<const DiscoveredCharacteristic*> CharacteristicDiscoveryCallback_t;
+    typedef FunctionPointerWithContext<Gap::Handle_t> TerminationCallback_t;
+    typedef FunctionPointerWithContext<const GattHVXCallbackParams*> HVXCallback_t;
+    typedef FunctionPointerWithContext<const GattWriteCallbackParams*> WriteCallback_t;
+    typedef FunctionPointerWithContext<const GattReadCallbackParams*> ReadCallback_t;
+
+    ble_error_t launchServiceDiscovery(Gap::Handle_t connectionHandle,
+                                       ServiceDiscoveryCallback_t sc = NULL,
+                                       CharacteristicDiscoveryCallback_t cc = NULL,
+                                       const UUID& matchingServiceUUID = UUID(UUID::ShortUUIDBytes_t(0xFFFF)),
+                                       const UUID& matchingCharacteristicUUID = UUID(UUID::ShortUUIDBytes_t(0xFFFF)));
+    bool isServiceDiscoveryActive() const;
+    void terminateServiceDiscovery();
+    void terminateCharacteristicDescriptorDiscovery(const DiscoveredCharacteristic& characteristic);
+
+    ble_error_t read(Gap::Handle_t connectionHandle, GattAttribute::Handle_t attributeHandle, uint16_t offset) const;
+    ble_error_t write(WriteOp_t cmd,
+                      Gap::Handle_t connectionHandle,
+                      GattAttribute::Handle_t attributeHandle,
+                      size_t length,
+                      const uint8_t* value) const;
+
+    void onServiceDiscoveryTermination(const TerminationCallback_t& callback) { terminationCallback = callback; }
+    void onHVX(const HVXCallback_t& callback)                                 { hvxCallback = callback; }
+    void onDataWritten(const WriteCallback_t& callback)                       { writeCallback = callback; }
+    void onDataRead(const ReadCallback_t& callback)                           { readCallback = callback; }
+
+private:
+    TerminationCallback_t terminationCallback;
+    HVXCallback_t hvxCallback;
+    WriteCallback_t writeCallback;
+    ReadCallback_t readCallback;
+};
+
+class GattServer
+{
+public:
+    typedef FunctionPointerWithContext<unsigned> DataSentCallback_t;
+
+    void onDataSent(const DataSentCallback_t& callback)
+    {
+        dataSentCallback = callback;
+    }
+
+private:
+    DataSentCallback_t dataSentCallback;
+};
+
+class SecurityManager
+{
+public:
+    enum SecurityMode_t
+    {
+        SECURITY_MODE_NO_ACCESS,
+        SECURITY_MODE_ENCRYPTION_OPEN_LINK,
+        SECURITY_MODE_ENCRYPTION_NO_MITM,
+        SECURITY_MODE_ENCRYPTION_WITH_MITM,
+        SECURITY_MODE_SIGNED_NO_MITM,
+        SECURITY_MODE_SIGNED_WITH_MITM
+    };
+
+    enum LinkSecurityStatus_t
+    {
+        NOT_ENCRYPTED,
+        ENCRYPTION_IN_PROGRESS,
+        ENCRYPTED
+    };
+
+    enum SecurityIOCapabilities_t
+    {
+        IO_CAPS_DISPLAY_ONLY     = 0x00,
+        IO_CAPS_DISPLAY_YESNO    = 0x01,
+        IO_CAPS_KEYBOARD_ONLY    = 0x02,
+        IO_CAPS_NONE             = 0x03,
+        IO_CAPS_KEYBOARD_DISPLAY = 0x04
+    };
+
+    typedef void (*LinkSecuredCallback_t)(Gap::Handle_t handle, SecurityMode_t securityMode);
+
+    SecurityManager()
+        :   linkSecuredCallback(NULL)
+    {}
+
+    ble_error_t init(bool enableBonding = true,
+                     bool requireMITM = true,
+                     SecurityIOCapabilities_t iocaps = IO_CAPS_NONE,
+                     const uint8_t* passkey = NULL)
+    {
+        (void) enableBonding;
+        (void) requireMITM;
+        (void) iocaps;
+        (void) passkey;
+
+        return BLE_ERROR_NONE;
+    }
+
+    ble_error_t getLinkSecurity(Gap::Handle_t connectionHandle, LinkSecurityStatus_t* securityStatus);
+    ble_error_t setLinkSecurity(Gap::Handle_t connectionHandle, SecurityMode_t securityMode);
+    ble_error_t getAddressesFromBondTable(Gap::Whitelist_t& addresses) const;
+
+    void onLinkSecured(LinkSecuredCallback_t callback)
+    {
+        linkSecuredCallback = callback;
+    }
+
+private:
+    LinkSecuredCallback_t linkSecuredCallback;
+};
+
+class BLE
+{
+public:
+    struct InitializationCompleteCallbackContext
+    {
+        BLE& ble;
+        ble_error_t error;
+    };
+
+    typedef void (*InitializationCompleteCallback_t)(InitializationCompleteCallbackContext* context);
+
+    static BLE& Instance();
+
+    /*
+        Initialization completes right away.
+    */
+    ble_error_t init(InitializationCompleteCallback_t callback)
+    {
+        InitializationCompleteCallbackContext context = { *this, BLE_ERROR_NONE };
+        callback(&context);
+
+        return BLE_ERROR_NONE;
+    }
+
+    Gap& gap()                          { return gapInstance; }
+    GattClient& gattClient()            { return gattClientInstance; }
+    GattServer& gattServer()            { return gattServerInstance; }
+    SecurityManager& securityManager()  { return securityManagerInstance; }
+
+private:
+    Gap gapInstance;
+    GattClient gattClientInstance;
+    GattServer gattServerInstance;
+    SecurityManager securityManagerInstance;
+};
+
+#endif // __HOST_BLE_H__
@@ -0,0 +1,90 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __HOST_DISCOVERED_CHARACTERISTIC_H__
+#define __HOST_DISCOVERED_CHARACTERISTIC_H__
+
+/*
+    Host stand-in for ble/DiscoveredCharacteristic.h. Characteristics are
+    filled in by whoever plays the GATT server; discovering descriptors
+    goes through the GATT client, which the host does not have.
+*/
+
+#include <stdint.h>
+
+#include "ble/DiscoveredCharacteristicDescriptor.h"
+
+class DiscoveredCharacteristic
+{
+public:
+    struct Properties_t
+    {
+        uint8_t _broadcast       :1;
+        uint8_t _read            :1;
+        uint8_t _writeWoResp     :1;
+        uint8_t _write           :1;
+        uint8_t _notify          :1;
+        uint8_t _indicate        :1;
+        uint8_t _authSignedWrite :1;
+
+        bool broadcast() const       { return _broadcast; }
+        bool read() const            { return _read; }
+        bool writeWoResp() const     { return _writeWoResp; }
+        bool write() const           { return _write; }
+        bool notify() const          { return _notify; }
+        bool indicate() const        { return _indicate; }
+        bool authSignedWrite() const { return _authSignedWrite; }
+    };
+
+    DiscoveredCharacteristic()
+        :   gattc(NULL),
+            uuid(UUID::ShortUUIDBytes_t(0)),
+            props(),
+            declHandle(GattAttribute::INVALID_HANDLE),
+            valueHandle(GattAttribute::INVALID_HANDLE),
+            lastHandle(GattAttribute::INVALID_HANDLE),
+            connHandle(0)
+    {
+        props._broadcast = 0;
+        props._read = 0;
+        props._writeWoResp = 0;
+        props._write = 0;
+        props._notify = 0;
+        props._indicate = 0;
+        props._authSignedWrite = 0;
+    }
+
+    ble_error_t discoverDescriptors(const CharacteristicDescriptorDiscovery::DiscoveryCallback_t& onCharacteristicDiscovered,
+                                    const CharacteristicDescriptorDiscovery::TerminationCallback_t& onTermination = CharacteristicDescriptorDiscovery::TerminationCallback_t()) const;
+
+    const UUID& getUUID() const                     { return uuid; }
+    const Properties_t& getProperties() const       { return props; }
+    GattAttribute::Handle_t getDeclHandle() const   { return declHandle; }
+    GattAttribute::Handle_t getValueHandle() const  { return valueHandle; }
+    GattAttribute::Handle_t getLastHandle() const   { return lastHandle; }
+    uint16_t getConnectionHandle() const            { return connHandle; }
+
+protected:
+    GattClient* gattc;
+    UUID uuid;
+    Properties_t props;
+    GattAttribute::Handle_t declHandle;
+    GattAttribute::Handle_t valueHandle;
+    GattAttribute::Handle_t lastHandle;
+    uint16_t connHandle;
+};
+
+#endif // __HOST_DISCOVERED_CHARACTERISTIC_H__
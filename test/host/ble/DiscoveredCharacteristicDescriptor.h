@@ -0,0 +1,97 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __HOST_DISCOVERED_CHARACTERISTIC_DESCRIPTOR_H__
+#define __HOST_DISCOVERED_CHARACTERISTIC_DESCRIPTOR_H__
+
+/*
+    Host stand-in for ble/DiscoveredCharacteristicDescriptor.h.
+*/
+
+#include <stdint.h>
+
+#include "ble/UUID.h"
+#include "core-util/FunctionPointer.h"
+
+class GattClient;
+class DiscoveredCharacteristic;
+
+struct GattAttribute
+{
+    typedef uint16_t Handle_t;
+
+    static const Handle_t INVALID_HANDLE = 0x0000;
+};
+
+class DiscoveredCharacteristicDescriptor
+{
+public:
+    DiscoveredCharacteristicDescriptor(GattClient* _client,
+                                       uint16_t _connectionHandle,
+                                       GattAttribute::Handle_t _attributeHandle,
+                                       const UUID& _uuid)
+        :   client(_client),
+            connectionHandle(_connectionHandle),
+            attributeHandle(_attributeHandle),
+            uuid(_uuid)
+    {}
+
+    GattClient* getGattClient() const
+    {
+        return client;
+    }
+
+    uint16_t getConnectionHandle() const
+    {
+        return connectionHandle;
+    }
+
+    GattAttribute::Handle_t getAttributeHandle() const
+    {
+        return attributeHandle;
+    }
+
+    const UUID& getUUID() const
+    {
+        return uuid;
+    }
+
+private:
+    GattClient* client;
+    uint16_t connectionHandle;
+    GattAttribute::Handle_t attributeHandle;
+    UUID uuid;
+};
+
+struct CharacteristicDescriptorDiscovery
+{
+    struct DiscoveryCallbackParams_t
+    {
+        const DiscoveredCharacteristic& characteristic;
+        const DiscoveredCharacteristicDescriptor& descriptor;
+    };
+
+    struct TerminationCallbackParams_t
+    {
+        const DiscoveredCharacteristic& characteristic;
+        ble_error_t status;
+    };
+
+    typedef FunctionPointerWithContext<const DiscoveryCallbackParams_t*> DiscoveryCallback_t;
+    typedef FunctionPointerWithContext<const TerminationCallbackParams_t*> TerminationCallback_t;
+};
+
+#endif // __HOST_DISCOVERED_CHARACTERISTIC_DESCRIPTOR_H__
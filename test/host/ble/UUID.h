@@ -0,0 +1,77 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __HOST_BLE_UUID_H__
+#define __HOST_BLE_UUID_H__
+
+/*
+    Host stand-in for ble/UUID.h. Long UUIDs are kept as text; only short
+    UUIDs are compared by value.
+*/
+
+#include <stdint.h>
+#include <string.h>
+
+#include "ble/blecommon.h"
+
+class UUID
+{
+public:
+    typedef uint16_t ShortUUIDBytes_t;
+
+    static const unsigned LENGTH_OF_LONG_UUID = 16;
+
+    UUID(const char* _longUUID)
+        :   shortUUID(0),
+            longUUID(_longUUID)
+    {}
+
+    UUID(ShortUUIDBytes_t _shortUUID = 0)
+        :   shortUUID(_shortUUID),
+            longUUID(NULL)
+    {}
+
+    ShortUUIDBytes_t getShortUUID() const
+    {
+        return shortUUID;
+    }
+
+    uint8_t getLen() const
+    {
+        return (longUUID) ? LENGTH_OF_LONG_UUID : sizeof(ShortUUIDBytes_t);
+    }
+
+    bool operator==(const UUID& other) const
+    {
+        if (longUUID || other.longUUID)
+        {
+            return longUUID && other.longUUID && (strcmp(longUUID, other.longUUID) == 0);
+        }
+
+        return shortUUID == other.shortUUID;
+    }
+
+    bool operator!=(const UUID& other) const
+    {
+        return !(*this == other);
+    }
+
+private:
+    ShortUUIDBytes_t shortUUID;
+    const char* longUUID;
+};
+
+#endif // __HOST_BLE_UUID_H__
@@ -0,0 +1,47 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __HOST_BLE_COMMON_H__
+#define __HOST_BLE_COMMON_H__
+
+/*
+    Host stand-in for ble/blecommon.h.
+*/
+
+enum ble_error_t
+{
+    BLE_ERROR_NONE                      = 0,
+    BLE_ERROR_BUFFER_OVERFLOW           = 1,
+    BLE_ERROR_NOT_IMPLEMENTED           = 2,
+    BLE_ERROR_PARAM_OUT_OF_RANGE        = 3,
+    BLE_ERROR_INVALID_PARAM             = 4,
+    BLE_STACK_BUSY                      = 5,
+    BLE_ERROR_INVALID_STATE             = 6,
+    BLE_ERROR_NO_MEM                    = 7,
+    BLE_ERROR_OPERATION_NOT_PERMITTED   = 8,
+    BLE_ERROR_INITIALIZATION_INCOMPLETE = 9,
+    BLE_ERROR_ALREADY_INITIALIZED       = 10,
+    BLE_ERROR_UNSPECIFIED               = 11,
+    BLE_ERROR_INTERNAL_STACK_FAILURE    = 12
+};
+
+enum HVXType_t
+{
+    BLE_HVX_NOTIFICATION = 0x01,
+    BLE_HVX_INDICATION   = 0x02
+};
+
+#endif // __HOST_BLE_COMMON_H__
@@ -0,0 +1,130 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __HOST_CBOR_H__
+#define __HOST_CBOR_H__
+
+/*
+    Host stand-in for the cborg encoder (Cbore). Integers, maps and arrays
+    of known size are encoded as in cborg. Nothing is written past the end
+    of the buffer, but getLength keeps counting so truncation shows.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+
+class Cbore
+{
+public:
+    Cbore(uint8_t* _cbor, size_t _maxLength)
+        :   cbor(_cbor),
+            maxLength(_maxLength),
+            length(0)
+    {}
+
+    Cbore& map(uint32_t items)
+    {
+        writeTypeAndValue(TypeMap, items);
+        return *this;
+    }
+
+    Cbore& array(uint32_t items)
+    {
+        writeTypeAndValue(TypeArray, items);
+        return *this;
+    }
+
+    Cbore& key(int32_t unit)
+    {
+        return item(unit);
+    }
+
+    Cbore& value(int32_t unit)
+    {
+        return item(unit);
+    }
+
+    Cbore& item(int32_t unit)
+    {
+        if (unit < 0)
+        {
+            writeTypeAndValue(TypeNegativeInteger, (uint32_t) (-1 - unit));
+        }
+        else
+        {
+            writeTypeAndValue(TypeUnsignedInteger, unit);
+        }
+
+        return *this;
+    }
+
+    uint32_t getLength() const
+    {
+        return length;
+    }
+
+private:
+    enum
+    {
+        TypeUnsignedInteger = 0x00,
+        TypeNegativeInteger = 0x20,
+        TypeArray           = 0x80,
+        TypeMap             = 0xA0
+    };
+
+    void writeTypeAndValue(uint8_t type, uint32_t value)
+    {
+        if (value < 24)
+        {
+            writeByte(type | value);
+        }
+        else if (value <= 0xFF)
+        {
+            writeByte(type | 24);
+            writeByte(value);
+        }
+        else if (value <= 0xFFFF)
+        {
+            writeByte(type | 25);
+            writeByte(value >> 8);
+            writeByte(value);
+        }
+        else
+        {
+            writeByte(type | 26);
+            writeByte(value >> 24);
+            writeByte(value >> 16);
+            writeByte(value >> 8);
+            writeByte(value);
+        }
+    }
+
+    void writeByte(uint8_t byte)
+    {
+        if (length < maxLength)
+        {
+            cbor[length] = byte;
+        }
+
+        length++;
+    }
+
+    uint8_t* cbor;
+    size_t maxLength;
+    uint32_t length;
+};
+
+#endif // __HOST_CBOR_H__
@@ -0,0 +1,289 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __HOST_FUNCTION_POINTER_H__
+#define __HOST_FUNCTION_POINTER_H__
+
+/*
+    Host stand-in for core-util/FunctionPointer.h. Only the parts used by
+    the client and its tests are provided. Targets are kept in small heap
+    objects that are copied with the function pointer.
+*/
+
+#include <stddef.h>
+
+namespace mbed {
+namespace util {
+
+template <typename R>
+class Callable0
+{
+public:
+    virtual ~Callable0() {}
+    virtual R call() = 0;
+    virtual Callable0* clone() const = 0;
+};
+
+template <typename R, typename A1>
+class Callable1
+{
+public:
+    virtual ~Callable1() {}
+    virtual R call(A1 a1) = 0;
+    virtual Callable1* clone() const = 0;
+};
+
+template <typename R>
+class StaticCallable0 : public Callable0<R>
+{
+public:
+    StaticCallable0(R (*_function)()) : function(_function) {}
+    virtual R call() { return function(); }
+    virtual Callable0<R>* clone() const { return new StaticCallable0(*this); }
+
+private:
+    R (*function)();
+};
+
+template <typename R, typename T>
+class MemberCallable0 : public Callable0<R>
+{
+public:
+    MemberCallable0(T* _object, R (T::*_member)()) : object(_object), member(_member) {}
+    virtual R call() { return (object->*member)(); }
+    virtual Callable0<R>* clone() const { return new MemberCallable0(*this); }
+
+private:
+    T* object;
+    R (T::*member)();
+};
+
+template <typename R, typename A1>
+class StaticCallable1 : public Callable1<R, A1>
+{
+public:
+    StaticCallable1(R (*_function)(A1)) : function(_function) {}
+    virtual R call(A1 a1) { return function(a1); }
+    virtual Callable1<R, A1>* clone() const { return new StaticCallable1(*this); }
+
+private:
+    R (*function)(A1);
+};
+
+template <typename R, typename T, typename A1>
+class MemberCallable1 : public Callable1<R, A1>
+{
+public:
+    MemberCallable1(T* _object, R (T::*_member)(A1)) : object(_object), member(_member) {}
+    virtual R call(A1 a1) { return (object->*member)(a1); }
+    virtual Callable1<R, A1>* clone() const { return new MemberCallable1(*this); }
+
+private:
+    T* object;
+    R (T::*member)(A1);
+};
+
+/*
+    Argument stored by bind, without reference or const.
+*/
+template <typename T> struct BoundArgument             { typedef T type; };
+template <typename T> struct BoundArgument<T&>         { typedef T type; };
+template <typename T> struct BoundArgument<const T&>   { typedef T type; };
+
+template <typename R, typename A1>
+class BoundCallable : public Callable0<R>
+{
+public:
+    BoundCallable(const Callable1<R, A1>* _target, const A1& _argument)
+        :   target(_target->clone()),
+            argument(_argument)
+    {}
+
+    BoundCallable(const BoundCallable& other)
+        :   Callable0<R>(),
+            target(other.target->clone()),
+            argument(other.argument)
+    {}
+
+    virtual ~BoundCallable() { delete target; }
+    virtual R call() { return target->call(argument); }
+    virtual Callable0<R>* clone() const { return new BoundCallable(*this); }
+
+private:
+    BoundCallable& operator=(const BoundCallable&);
+
+    Callable1<R, A1>* target;
+    typename BoundArgument<A1>::type argument;
+};
+
+template <typename R>
+class FunctionPointerBind
+{
+public:
+    FunctionPointerBind() : target(NULL) {}
+    explicit FunctionPointerBind(Callable0<R>* _target) : target(_target) {}
+    FunctionPointerBind(const FunctionPointerBind& other) : target((other.target) ? other.target->clone() : NULL) {}
+    ~FunctionPointerBind() { delete target; }
+
+    FunctionPointerBind& operator=(const FunctionPointerBind& other)
+    {
+        if (this != &other)
+        {
+            delete target;
+            target = (other.target) ? other.target->clone() : NULL;
+        }
+
+        return *this;
+    }
+
+    R call() { return target->call(); }
+    R operator()() { return call(); }
+    operator bool() const { return target != NULL; }
+
+private:
+    Callable0<R>* target;
+};
+
+template <typename R>
+class FunctionPointer0
+{
+public:
+    FunctionPointer0(R (*function)() = NULL) : target(NULL) { attach(function); }
+
+    template <typename T>
+    FunctionPointer0(T* object, R (T::*member)()) : target(NULL) { attach(object, member); }
+
+    FunctionPointer0(const FunctionPointer0& other) : target((other.target) ? other.target->clone() : NULL) {}
+    ~FunctionPointer0() { delete target; }
+
+    FunctionPointer0& operator=(const FunctionPointer0& other)
+    {
+        if (this != &other)
+        {
+            delete target;
+            target = (other.target) ? other.target->clone() : NULL;
+        }
+
+        return *this;
+    }
+
+    void attach(R (*function)())
+    {
+        clear();
+        target = (function) ? new StaticCallable0<R>(function) : NULL;
+    }
+
+    template <typename T>
+    void attach(T* object, R (T::*member)())
+    {
+        clear();
+        target = new MemberCallable0<R, T>(object, member);
+    }
+
+    R call() { return target->call(); }
+    R operator()() { return call(); }
+    operator bool() const { return target != NULL; }
+    void clear() { delete target; target = NULL; }
+
+    FunctionPointerBind<R> bind() const
+    {
+        return FunctionPointerBind<R>((target) ? target->clone() : NULL);
+    }
+
+private:
+    Callable0<R>* target;
+};
+
+template <typename R, typename A1>
+class FunctionPointer1
+{
+public:
+    FunctionPointer1(R (*function)(A1) = NULL) : target(NULL) { attach(function); }
+
+    template <typename T>
+    FunctionPointer1(T* object, R (T::*member)(A1)) : target(NULL) { attach(object, member); }
+
+    FunctionPointer1(const FunctionPointer1& other) : target((other.target) ? other.target->clone() : NULL) {}
+    ~FunctionPointer1() { delete target; }
+
+    FunctionPointer1& operator=(const FunctionPointer1& other)
+    {
+        if (this != &other)
+        {
+            delete target;
+            target = (other.target) ? other.target->clone() : NULL;
+        }
+
+        return *this;
+    }
+
+    void attach(R (*function)(A1))
+    {
+        clear();
+        target = (function) ? new StaticCallable1<R, A1>(function) : NULL;
+    }
+
+    template <typename T>
+    void attach(T* object, R (T::*member)(A1))
+    {
+        clear();
+        target = new MemberCallable1<R, T, A1>(object, member);
+    }
+
+    R call(A1 a1) { return target->call(a1); }
+    R operator()(A1 a1) { return call(a1); }
+    operator bool() const { return target != NULL; }
+    void clear() { delete target; target = NULL; }
+
+    FunctionPointerBind<R> bind(const A1& a1) const
+    {
+        return FunctionPointerBind<R>((target) ? new BoundCallable<R, A1>(target, a1) : NULL);
+    }
+
+private:
+    Callable1<R, A1>* target;
+};
+
+} // namespace util
+} // namespace mbed
+
+/*
+    Callback type of the BLE API.
+*/
+template <typename ContextType>
+class FunctionPointerWithContext
+{
+public:
+    FunctionPointerWithContext(void (*function)(ContextType) = NULL) : pointer(function) {}
+
+    template <typename T>
+    FunctionPointerWithContext(T* object, void (T::*member)(ContextType)) : pointer(object, member) {}
+
+    void call(ContextType context)
+    {
+        if (pointer)
+        {
+            pointer.call(context);
+        }
+    }
+
+    operator bool() const { return pointer; }
+
+private:
+    mbed::util::FunctionPointer1<void, ContextType> pointer;
+};
+
+#endif // __HOST_FUNCTION_POINTER_H__
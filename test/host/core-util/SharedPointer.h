@@ -0,0 +1,101 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __HOST_SHARED_POINTER_H__
+#define __HOST_SHARED_POINTER_H__
+
+/*
+    Host stand-in for core-util/SharedPointer.h. As in core-util, the
+    reference count is allocated next to the first owner.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+
+template <class T>
+class SharedPointer
+{
+public:
+    SharedPointer() : pointer(NULL), counter(NULL) {}
+
+    SharedPointer(T* _pointer)
+        :   pointer(_pointer),
+            counter((_pointer) ? new uint32_t(1) : NULL)
+    {}
+
+    SharedPointer(const SharedPointer& other)
+        :   pointer(other.pointer),
+            counter(other.counter)
+    {
+        if (counter)
+        {
+            (*counter)++;
+        }
+    }
+
+    ~SharedPointer()
+    {
+        release();
+    }
+
+    SharedPointer& operator=(const SharedPointer& other)
+    {
+        if (this != &other)
+        {
+            release();
+
+            pointer = other.pointer;
+            counter = other.counter;
+
+            if (counter)
+            {
+                (*counter)++;
+            }
+        }
+
+        return *this;
+    }
+
+    T* get() const { return pointer; }
+    uint32_t use_count() const { return (counter) ? *counter : 0; }
+    T& operator*() const { return *pointer; }
+    T* operator->() const { return pointer; }
+    operator bool() const { return pointer != NULL; }
+
+private:
+    void release()
+    {
+        if (counter && (--(*counter) == 0))
+        {
+            delete pointer;
+            delete counter;
+        }
+
+        pointer = NULL;
+        counter = NULL;
+    }
+
+    T* pointer;
+    uint32_t* counter;
+};
+
+namespace mbed {
+namespace util {
+using ::SharedPointer;
+}
+}
+
+#endif // __HOST_SHARED_POINTER_H__
@@ -0,0 +1,276 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+    Runtime for the host build: the simulated minar scheduler, the
+    operations of the stand-in BLE API, and main.
+
+    The client is meant to do all GATT and security work through its
+    overridable hooks, which the simulation answers. Reaching one of the
+    operations below means a path bypassed its hook, so the program stops
+    with the name of the operation instead of carrying on with a made-up
+    result.
+*/
+
+#include "mbed-drivers/mbed.h"
+#include "ble/BLE.h"
+
+/*****************************************************************************/
+/* Scheduler                                                                 */
+/*****************************************************************************/
+
+namespace minar {
+
+/*
+    Pending callbacks in a list sorted by due time; callbacks posted for the
+    same time stay in posting order.
+*/
+struct CallbackNode
+{
+    CallbackNode* next;
+    platform::tick_t due;
+    mbed::util::FunctionPointerBind<void> callback;
+};
+
+static CallbackNode* pending = NULL;
+static platform::tick_t now = 0;
+static bool stopped = false;
+
+static void unlink(CallbackNode* node)
+{
+    for (CallbackNode** link = &pending; *link; link = &((*link)->next))
+    {
+        if (*link == node)
+        {
+            *link = node->next;
+            return;
+        }
+    }
+}
+
+static bool isPending(const CallbackNode* node)
+{
+    for (const CallbackNode* iterator = pending; iterator; iterator = iterator->next)
+    {
+        if (iterator == node)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void insert(CallbackNode* node)
+{
+    CallbackNode** link = &pending;
+
+    while (*link && ((*link)->due <= node->due))
+    {
+        link = &((*link)->next);
+    }
+
+    node->next = *link;
+    *link = node;
+}
+
+platform::tick_t platform::getTime()
+{
+    return now;
+}
+
+CallbackAdder& CallbackAdder::delay(tick_t delay)
+{
+    // the adder may outlive the callback; only move it while pending
+    if (isPending(node))
+    {
+        unlink(node);
+        node->due = now + delay;
+        insert(node);
+    }
+
+    return *this;
+}
+
+CallbackAdder& CallbackAdder::tolerance(tick_t)
+{
+    return *this;
+}
+
+callback_handle_t CallbackAdder::getHandle()
+{
+    return node;
+}
+
+CallbackAdder Scheduler::postCallback(const mbed::util::FunctionPointerBind<void>& callback)
+{
+    CallbackNode* node = new CallbackNode();
+    node->next = NULL;
+    node->due = now;
+    node->callback = callback;
+
+    insert(node);
+
+    return CallbackAdder(node);
+}
+
+int Scheduler::cancelCallback(callback_handle_t handle)
+{
+    // handles of callbacks that already ran point to freed nodes; they are
+    // only compared, never dereferenced
+    CallbackNode* node = static_cast<CallbackNode*>(handle);
+
+    if (isPending(node))
+    {
+        unlink(node);
+        delete node;
+
+        return 0;
+    }
+
+    return -1;
+}
+
+int Scheduler::start()
+{
+    stopped = false;
+
+    while (pending && !stopped)
+    {
+        CallbackNode* node = pending;
+        pending = node->next;
+
+        if (node->due > now)
+        {
+            now = node->due;
+        }
+
+        node->callback.call();
+        delete node;
+    }
+
+    return 0;
+}
+
+void Scheduler::stop()
+{
+    stopped = true;
+}
+
+} // namespace minar
+
+/*****************************************************************************/
+/* BLE operations                                                            */
+/*****************************************************************************/
+
+static ble_error_t unreachable(const char* operation)
+{
+    printf("host: %s reached the BLE stand-in; override the ANCSClient hook\r\n", operation);
+    fflush(stdout);
+    abort();
+
+    return BLE_ERROR_NOT_IMPLEMENTED;
+}
+
+ble_error_t Gap::updateConnectionParams(Handle_t, const ConnectionParams_t*)
+{
+    return unreachable("Gap::updateConnectionParams");
+}
+
+ble_error_t Gap::disconnect(Handle_t, DisconnectionReason_t)
+{
+    return unreachable("Gap::disconnect");
+}
+
+ble_error_t GattClient::launchServiceDiscovery(Gap::Handle_t,
+                                               ServiceDiscoveryCallback_t,
+                                               CharacteristicDiscoveryCallback_t,
+                                               const UUID&,
+                                               const UUID&)
+{
+    return unreachable("GattClient::launchServiceDiscovery");
+}
+
+bool GattClient::isServiceDiscoveryActive() const
+{
+    unreachable("GattClient::isServiceDiscoveryActive");
+    return false;
+}
+
+void GattClient::terminateServiceDiscovery()
+{
+    unreachable("GattClient::terminateServiceDiscovery");
+}
+
+void GattClient::terminateCharacteristicDescriptorDiscovery(const DiscoveredCharacteristic&)
+{
+    unreachable("GattClient::terminateCharacteristicDescriptorDiscovery");
+}
+
+ble_error_t GattClient::read(Gap::Handle_t, GattAttribute::Handle_t, uint16_t) const
+{
+    return unreachable("GattClient::read");
+}
+
+ble_error_t GattClient::write(WriteOp_t, Gap::Handle_t, GattAttribute::Handle_t, size_t, const uint8_t*) const
+{
+    return unreachable("GattClient::write");
+}
+
+ble_error_t DiscoveredCharacteristic::discoverDescriptors(const CharacteristicDescriptorDiscovery::DiscoveryCallback_t&,
+                                                          const CharacteristicDescriptorDiscovery::TerminationCallback_t&) const
+{
+    return unreachable("DiscoveredCharacteristic::discoverDescriptors");
+}
+
+ble_error_t SecurityManager::getLinkSecurity(Gap::Handle_t, LinkSecurityStatus_t*)
+{
+    return unreachable("SecurityManager::getLinkSecurity");
+}
+
+ble_error_t SecurityManager::setLinkSecurity(Gap::Handle_t, SecurityMode_t)
+{
+    return unreachable("SecurityManager::setLinkSecurity");
+}
+
+ble_error_t SecurityManager::getAddressesFromBondTable(Gap::Whitelist_t&) const
+{
+    return unreachable("SecurityManager::getAddressesFromBondTable");
+}
+
+BLE& BLE::Instance()
+{
+    static BLE instance;
+
+    return instance;
+}
+
+/*****************************************************************************/
+/* main                                                                      */
+/*****************************************************************************/
+
+void app_start(int argc, char* argv[]);
+
+int main(int argc, char* argv[])
+{
+    app_start(argc, argv);
+    minar::Scheduler::start();
+
+    // tests end the program when they report their result
+    printf("host: scheduler ran out of callbacks without a result\r\n");
+
+    return EXIT_FAILURE;
+}
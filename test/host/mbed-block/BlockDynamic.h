@@ -0,0 +1,43 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __HOST_BLOCK_DYNAMIC_H__
+#define __HOST_BLOCK_DYNAMIC_H__
+
+/*
+    Host stand-in for mbed-block/BlockDynamic.h.
+*/
+
+#include "mbed-block/BlockStatic.h"
+
+class BlockDynamic : public BlockStatic
+{
+public:
+    BlockDynamic(uint32_t _length = 0)
+        :   BlockStatic(new uint8_t[(_length) ? _length : 1], _length)
+    {}
+
+    virtual ~BlockDynamic()
+    {
+        delete[] data;
+    }
+
+private:
+    BlockDynamic(const BlockDynamic&);
+    BlockDynamic& operator=(const BlockDynamic&);
+};
+
+#endif // __HOST_BLOCK_DYNAMIC_H__
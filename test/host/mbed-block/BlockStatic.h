@@ -0,0 +1,102 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __HOST_BLOCK_STATIC_H__
+#define __HOST_BLOCK_STATIC_H__
+
+/*
+    Host stand-in for mbed-block/BlockStatic.h. Accesses out of bounds
+    abort instead of corrupting memory.
+*/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+class BlockStatic
+{
+public:
+    BlockStatic(uint8_t* _data = NULL, uint32_t _length = 0)
+        :   data(_data),
+            length(_length),
+            maxLength(_length)
+    {}
+
+    virtual ~BlockStatic()
+    {}
+
+    uint32_t getLength() const
+    {
+        return length;
+    }
+
+    void setLength(uint32_t _length)
+    {
+        if (_length > maxLength)
+        {
+            abort();
+        }
+
+        length = _length;
+    }
+
+    uint32_t getMaxLength() const
+    {
+        return maxLength;
+    }
+
+    uint8_t* getData() const
+    {
+        return data;
+    }
+
+    uint8_t at(uint32_t index) const
+    {
+        if (index >= length)
+        {
+            abort();
+        }
+
+        return data[index];
+    }
+
+    uint8_t& operator[](uint32_t index)
+    {
+        if (index >= length)
+        {
+            abort();
+        }
+
+        return data[index];
+    }
+
+    void memcpy(uint32_t offset, const void* source, uint32_t size)
+    {
+        if ((offset > maxLength) || (size > maxLength - offset))
+        {
+            abort();
+        }
+
+        ::memcpy(data + offset, source, size);
+    }
+
+protected:
+    uint8_t* data;
+    uint32_t length;
+    uint32_t maxLength;
+};
+
+#endif // __HOST_BLOCK_STATIC_H__
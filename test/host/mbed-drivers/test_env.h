@@ -0,0 +1,44 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __HOST_TEST_ENV_H__
+#define __HOST_TEST_ENV_H__
+
+/*
+    Host stand-in for mbed-drivers/test_env.h. The result is printed in the
+    format the mbed host tests look for and ends the program, with a
+    non-zero exit status on failure.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MBED_HOSTTEST_TIMEOUT(TIMEOUT)
+#define MBED_HOSTTEST_SELECT(NAME)
+#define MBED_HOSTTEST_DESCRIPTION(DESCRIPTION)
+#define MBED_HOSTTEST_START(TESTID) printf("{{start}}\r\n")
+
+#define MBED_HOSTTEST_RESULT(RESULT)                                    \
+    do                                                                  \
+    {                                                                   \
+        bool hostTestResult = (RESULT);                                 \
+        printf("{{%s}}\r\n{{end}}\r\n", (hostTestResult) ? "success"    \
+                                                         : "failure");  \
+        fflush(stdout);                                                 \
+        exit((hostTestResult) ? EXIT_SUCCESS : EXIT_FAILURE);           \
+    } while (0)
+
+#endif // __HOST_TEST_ENV_H__
@@ -0,0 +1,104 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __HOST_MINAR_H__
+#define __HOST_MINAR_H__
+
+/*
+    Host stand-in for the minar scheduler. Time is simulated: one tick is a
+    millisecond and the clock only moves when the scheduler skips ahead to
+    the next delayed callback, so runs are deterministic. Callbacks due at
+    the same tick run in the order they were posted.
+*/
+
+#include <stdint.h>
+
+#include "core-util/FunctionPointer.h"
+
+namespace minar {
+
+namespace platform {
+typedef uint32_t tick_t;
+
+const tick_t Time_Mask = 0xFFFFFFFF;
+
+tick_t getTime();
+}
+
+typedef platform::tick_t tick_t;
+typedef void* callback_handle_t;
+
+inline tick_t milliseconds(uint32_t ms)
+{
+    return ms;
+}
+
+inline tick_t ticks(uint32_t ticks)
+{
+    return ticks;
+}
+
+struct CallbackNode;
+
+class CallbackAdder
+{
+public:
+    explicit CallbackAdder(CallbackNode* _node) : node(_node) {}
+
+    CallbackAdder& delay(tick_t delay);
+    CallbackAdder& tolerance(tick_t tolerance);
+    callback_handle_t getHandle();
+
+private:
+    CallbackNode* node;
+};
+
+class Scheduler
+{
+public:
+    static CallbackAdder postCallback(const mbed::util::FunctionPointerBind<void>& callback);
+
+    static CallbackAdder postCallback(const mbed::util::FunctionPointer0<void>& callback)
+    {
+        return postCallback(callback.bind());
+    }
+
+    static CallbackAdder postCallback(void (*function)())
+    {
+        return postCallback(mbed::util::FunctionPointer0<void>(function));
+    }
+
+    template <typename T>
+    static CallbackAdder postCallback(T* object, void (T::*member)())
+    {
+        return postCallback(mbed::util::FunctionPointer0<void>(object, member));
+    }
+
+    /*
+        Returns 0 if the callback was still pending.
+    */
+    static int cancelCallback(callback_handle_t handle);
+
+    /*
+        Run callbacks until none are left or stop is called.
+    */
+    static int start();
+    static void stop();
+};
+
+} // namespace minar
+
+#endif // __HOST_MINAR_H__
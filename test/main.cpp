@@ -21,7 +21,6 @@
 #include "ble-ancs-client/ANCSClient.h"
 
 #include <string>
-#include <queue>
 
 /*****************************************************************************/
 /* Configuration                                                             */
@@ -45,6 +44,7 @@
 #define VERBOSE_DEBUG_OUT 0
 
 #define MAX_RETRIEVE_LENGTH 110
+#define MAX_TITLE_LENGTH 32
 
 /*****************************************************************************/
 /* Variables used by the app                                                 */
@@ -58,10 +58,32 @@ BLE ble;
 Gap::Handle_t connectionHandle;
 
 ANCSClient ancs;
-ANCSClient::notification_attribute_id_t attributeIndex;
-uint32_t notificationID = 0;
 
-std::queue<uint32_t> notificationQueue;
+const ANCSClient::AttributeRequest_t socialRequest[] = {
+    { ANCSClient::NotificationAttributeIDAppIdentifier, 0, NULL },
+    { ANCSClient::NotificationAttributeIDTitle,    MAX_TITLE_LENGTH, NULL }
+};
+
+const ANCSClient::AttributeRequest_t callRequest[] = {
+    { ANCSClient::NotificationAttributeIDTitle,    MAX_TITLE_LENGTH, NULL },
+    { ANCSClient::NotificationAttributeIDMessage,  MAX_RETRIEVE_LENGTH, NULL },
+    { ANCSClient::NotificationAttributeIDDate,     0, NULL }
+};
+
+const ANCSClient::AttributeRequest_t defaultRequest[] = {
+    { ANCSClient::NotificationAttributeIDAppIdentifier, 0, NULL },
+    { ANCSClient::NotificationAttributeIDTitle,    MAX_RETRIEVE_LENGTH, NULL },
+    { ANCSClient::NotificationAttributeIDSubtitle, MAX_RETRIEVE_LENGTH, NULL },
+    { ANCSClient::NotificationAttributeIDMessage,  MAX_RETRIEVE_LENGTH, NULL }
+};
+
+// first matching rule wins
+const ANCSClient::FetchPolicy_t fetchPolicy[] = {
+    { ANCSClient::PolicyCategoryAny,      ANCSClient::EventFlagSilent, ANCSClient::EventFlagSilent, NULL, 0 },
+    { ANCSClient::CategoryIDSocial,       0, 0, socialRequest,  sizeof(socialRequest) / sizeof(ANCSClient::AttributeRequest_t) },
+    { ANCSClient::CategoryIDIncomingCall, 0, 0, callRequest,    sizeof(callRequest) / sizeof(ANCSClient::AttributeRequest_t) },
+    { ANCSClient::PolicyCategoryAny,      0, 0, defaultRequest, sizeof(defaultRequest) / sizeof(ANCSClient::AttributeRequest_t) }
+};
 
 /*****************************************************************************/
 /* Debug                                                                     */
@@ -80,60 +102,56 @@ void periodicCallbackISR(void)
 /* ANCS                                                                      */
 /*****************************************************************************/
 
-void processQueue()
-{
-    DEBUGOUT("ancs: process queue: %d\r\n", notificationQueue.size());
-
-    notificationID = notificationQueue.front();
-
-    attributeIndex = ANCSClient::NotificationAttributeIDTitle;
-    ancs.getNotificationAttribute(notificationID, attributeIndex, MAX_RETRIEVE_LENGTH);
-}
-
 void onNotificationTask(ANCSClient::Notification_t event)
 {
+    // attributes are fetched by the client according to the fetch policy
     DEBUGOUT("ancs: %u %u %u %u %lu\r\n", event.eventID, event.eventFlags, event.categoryID, event.categoryCount, event.notificationUID);
+}
 
-    notificationQueue.push(event.notificationUID);
+void onNotificationAttributeTask(ANCSClient::Attribute_t attribute)
+{
+    SharedPointer<BlockStatic> dataPayload = attribute.data;
 
-    if (notificationQueue.size() == 1)
+    // look up the app name, usually from the cache
+    if (attribute.attributeID == ANCSClient::NotificationAttributeIDAppIdentifier)
     {
-        minar::Scheduler::postCallback(processQueue);
+        char identifier[ANCS_CLIENT_APP_IDENTIFIER_LENGTH + 1] = { 0 };
+
+        if (dataPayload->getLength() <= ANCS_CLIENT_APP_IDENTIFIER_LENGTH)
+        {
+            memcpy(identifier, dataPayload->getData(), dataPayload->getLength());
+
+            // show the identifier if the name cannot be requested
+            if (ancs.getAppDisplayName(identifier) != BLE_ERROR_NONE)
+            {
+                DEBUGOUT("app: %s: %s\r\n", identifier, identifier);
+            }
+        }
     }
-}
 
-void onNotificationAttributeTask(SharedPointer<BlockStatic> dataPayload)
-{
-    DEBUGOUT("data: ");
+    DEBUGOUT("data: %lu %u: ", attribute.notificationUID, attribute.attributeID);
     for (uint8_t idx = 0; idx < dataPayload->getLength(); idx++)
     {
         DEBUGOUT("%c", dataPayload->at(idx));
     }
     DEBUGOUT("\r\n");
+}
 
-    if (attributeIndex == ANCSClient::NotificationAttributeIDTitle)
-    {
-        // get subtitle
-        attributeIndex = ANCSClient::NotificationAttributeIDSubtitle;
-        ancs.getNotificationAttribute(notificationID, attributeIndex, MAX_RETRIEVE_LENGTH);
-    }
-    else if (attributeIndex == ANCSClient::NotificationAttributeIDSubtitle)
+void onAppAttributeTask(ANCSClient::AppAttribute_t attribute)
+{
+    SharedPointer<BlockStatic> dataPayload = attribute.data;
+
+    DEBUGOUT("app: %s: ", attribute.appIdentifier);
+    for (uint8_t idx = 0; idx < dataPayload->getLength(); idx++)
     {
-        // get message
-        attributeIndex = ANCSClient::NotificationAttributeIDMessage;
-        ancs.getNotificationAttribute(notificationID, attributeIndex, MAX_RETRIEVE_LENGTH);
+        DEBUGOUT("%c", dataPayload->at(idx));
     }
-    else if (attributeIndex == ANCSClient::NotificationAttributeIDMessage)
-    {
-        // remove ID from queue
-        notificationQueue.pop();
+    DEBUGOUT("\r\n");
+}
 
-        // process next ID if available
-        if (notificationQueue.size() > 0)
-        {
-            minar::Scheduler::postCallback(processQueue);
-        }
-    }
+void onRequestCompleteTask(ANCSClient::RequestComplete_t complete)
+{
+    DEBUGOUT("ancs: request done: %lu %u %lu\r\n", complete.notificationUID, complete.status, complete.durationTicks);
 }
 
 /*****************************************************************************/
@@ -210,7 +228,14 @@ void bleInitDone(BLE::InitializationCompleteCallbackContext* context)
 
     ancs.init();
     ancs.registerNotificationHandlerTask(onNotificationTask);
-    ancs.registerDataHandlerTask(onNotificationAttributeTask);
+    ancs.registerAttributeHandlerTask(onNotificationAttributeTask);
+    ancs.registerAppAttributeHandlerTask(onAppAttributeTask);
+    ancs.setFetchPolicy(fetchPolicy,
+                        sizeof(fetchPolicy) / sizeof(ANCSClient::FetchPolicy_t),
+                        onRequestCompleteTask);
+
+    // fast link while attributes are fetched, low power otherwise
+    ancs.setConnectionParams(&ANCSClient::FastConnectionParams, &ANCSClient::IdleConnectionParams);
 
     DEBUGOUT("ANCS Client: %s %s\r\n", __DATE__, __TIME__);
 }
@@ -0,0 +1,600 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+    Replays a trace recorded by ANCSClient with ANCS_CLIENT_TRACE_SIZE into
+    a client on the host, with the recorded delays.
+
+    Packets from the phone are passed to the dispatcher as in test/simulation.
+    The client's Control Point writes are turned back into the application
+    requests that caused them, and the writes the client makes in response
+    are compared with the recorded ones. Connections are always replayed as
+    a first pairing; the recorded address and security mode are not used.
+
+    On x86-linux-native a trace file can be given on the command line.
+    Otherwise a scripted session is replayed into a recording client, and
+    its trace is replayed again: callbacks and the trace recorded on the
+    second run must be the same as on the first. The recording part is
+    skipped when the recorder is compiled out.
+
+    Results are printed as one JSON object per run. The tool is built and
+    run with the other host tests by make -C test/host check.
+*/
+
+#include "mbed-drivers/mbed.h"
+#include "mbed-drivers/test_env.h"
+#include "ble/BLE.h"
+
+#include "ble-ancs-client/ANCSClient.h"
+#include "ble-ancs-client/ANCSDispatcher.h"
+
+#include "../simulation/NotificationProvider.h"
+#include "../simulation/SimulatedConnection.h"
+
+#if defined(TARGET_LIKE_X86_LINUX_NATIVE)
+#include <stdio.h>
+#endif
+
+using namespace simulation;
+
+/*****************************************************************************/
+/* Configuration                                                             */
+/*****************************************************************************/
+
+#define TRACE_BUFFER_SIZE       2048
+#define SETTLE_DELAY_MS         100
+#define EXPECTED_WRITES         8
+#define MAX_REQUEST_ATTRIBUTES  8
+
+typedef ANCSCodec<ANCS_CLIENT_CONTROL_POINT_MAX_LENGTH> Codec;
+
+#define MESSAGE "The quick brown fox jumps over the lazy dog, twice."
+
+static const Attribute_t attributes[] = {
+    { ANCSClient::NotificationAttributeIDTitle,    "Alice" },
+    { ANCSClient::NotificationAttributeIDSubtitle, "Re: lunch" },
+    { ANCSClient::NotificationAttributeIDMessage,  MESSAGE }
+};
+
+static const Attribute_t appAttributes[] = {
+    { ANCSClient::AppAttributeIDDisplayName, "Mail" }
+};
+
+static const ANCSClient::AttributeRequest_t attributeRequest[] = {
+    { ANCSClient::NotificationAttributeIDTitle,    32,  NULL },
+    { ANCSClient::NotificationAttributeIDSubtitle, 32,  NULL },
+    { ANCSClient::NotificationAttributeIDMessage,  128, NULL }
+};
+
+#define APP_IDENTIFIER "com.example.mail"
+
+/*
+    Session replayed by the self test: two notifications fetched at the
+    default MTU, an action, and an app name.
+*/
+static void buildSession(NotificationProvider& provider)
+{
+    provider.setMTU(23);
+    provider.setInterval(20);
+
+    provider.connect();
+
+    provider.notification(ANCSClient::EventIDNotificationAdded, 0, ANCSClient::CategoryIDEmail, 1, 1);
+    provider.request(1);
+    provider.response(1, attributes, 3);
+
+    provider.notification(ANCSClient::EventIDNotificationAdded, ANCSClient::EventFlagPositiveAction, ANCSClient::CategoryIDSocial, 1, 2);
+    provider.request(2);
+    provider.response(2, attributes, 3);
+    provider.action(2, ANCSClient::ActionIDPositive);
+
+    provider.appRequest(APP_IDENTIFIER);
+    provider.appResponse(APP_IDENTIFIER, appAttributes, 1);
+
+    provider.disconnect();
+}
+
+/*****************************************************************************/
+/* Client                                                                    */
+/*****************************************************************************/
+
+/*
+    Compares the Control Point writes with the recorded ones, in order.
+*/
+class ReplayClient : public SimulatedClient
+{
+public:
+    ReplayClient()
+        :   SimulatedClient(),
+            checking(false),
+            expectedHead(0),
+            expectedCount(0),
+            mismatches(0)
+    {}
+
+    void setChecking(bool _checking)
+    {
+        checking = _checking;
+        expectedHead = 0;
+        expectedCount = 0;
+        mismatches = 0;
+    }
+
+    void expectWrite(const uint8_t* payload, uint8_t length)
+    {
+        if (!checking)
+        {
+            return;
+        }
+
+        if (expectedCount >= EXPECTED_WRITES)
+        {
+            mismatches++;
+            return;
+        }
+
+        uint8_t slot = (expectedHead + expectedCount) % EXPECTED_WRITES;
+        uint8_t kept = (length > sizeof(expected[slot])) ? sizeof(expected[slot]) : length;
+
+        memcpy(expected[slot], payload, kept);
+        expectedLengths[slot] = length;
+        expectedCount++;
+    }
+
+    /*
+        Writes that differ from the recorded ones, were not recorded, or
+        were recorded but never made.
+    */
+    uint32_t getMismatches() const
+    {
+        return mismatches + expectedCount;
+    }
+
+protected:
+    virtual ble_error_t writeControlPoint(const uint8_t* payload, uint8_t length, bool withResponse)
+    {
+        if (checking)
+        {
+            if (expectedCount == 0)
+            {
+                mismatches++;
+            }
+            else
+            {
+                uint8_t expectedLength = expectedLengths[expectedHead];
+                uint8_t kept = (expectedLength > sizeof(expected[expectedHead])) ? sizeof(expected[expectedHead]) : expectedLength;
+
+                if ((length != expectedLength) || (memcmp(payload, expected[expectedHead], kept) != 0))
+                {
+                    mismatches++;
+                }
+
+                expectedHead = (expectedHead + 1) % EXPECTED_WRITES;
+                expectedCount--;
+            }
+        }
+
+        return SimulatedClient::writeControlPoint(payload, length, withResponse);
+    }
+
+private:
+    bool checking;
+    uint8_t expected[EXPECTED_WRITES][ANCS_CLIENT_CONTROL_POINT_MAX_LENGTH];
+    uint8_t expectedLengths[EXPECTED_WRITES];
+    uint8_t expectedHead;
+    uint8_t expectedCount;
+    uint32_t mismatches;
+};
+
+/*****************************************************************************/
+/* State                                                                     */
+/*****************************************************************************/
+
+typedef enum {
+    PhaseScript,    // scripted session into the recording client
+    PhaseRecorded,  // the trace recorded during PhaseScript
+    PhaseFile       // trace given on the command line
+} phase_t;
+
+typedef struct {
+    uint32_t records;
+    uint32_t hvx;
+    uint32_t hvxBytes;
+    uint32_t writes;
+    uint32_t notifications;
+    uint32_t attributes;
+    uint32_t completes;
+    uint32_t signature;
+    uint32_t start;
+} Result_t;
+
+BLE ble;
+ReplayClient ancs;
+
+static SimulatedConnection connection;
+
+static uint8_t traceBuffer[TRACE_BUFFER_SIZE];
+static uint8_t recordedTrace[TRACE_BUFFER_SIZE];
+static uint8_t rerecordedTrace[TRACE_BUFFER_SIZE];
+static uint16_t traceLength = 0;
+static uint16_t recordedLength = 0;
+
+static TraceReader reader(traceBuffer, 0);
+static Record_t pending;
+static phase_t phase = PhaseScript;
+static Result_t result;
+static uint32_t scriptSignature = 0;
+static bool passed = true;
+
+/*
+    FNV-1a over everything the application is told, so that two runs can
+    be compared without keeping their callbacks.
+*/
+static void sign(const uint8_t* data, uint16_t length)
+{
+    for (uint16_t index = 0; index < length; index++)
+    {
+        result.signature = (result.signature ^ data[index]) * 16777619UL;
+    }
+}
+
+static void signWord(uint32_t value)
+{
+    uint8_t bytes[4] = { (uint8_t) value, (uint8_t) (value >> 8), (uint8_t) (value >> 16), (uint8_t) (value >> 24) };
+
+    sign(bytes, sizeof(bytes));
+}
+
+/*****************************************************************************/
+/* Callbacks                                                                 */
+/*****************************************************************************/
+
+void onNotificationTask(ANCSClient::Notification_t event)
+{
+    result.notifications++;
+
+    signWord('N');
+    signWord(event.notificationUID);
+    signWord(event.eventID | (event.eventFlags << 8) | (event.categoryID << 16) | (event.categoryCount << 24));
+}
+
+void onAttributeTask(ANCSClient::Attribute_t attribute)
+{
+    result.attributes++;
+
+    signWord('A');
+    signWord(attribute.notificationUID);
+    signWord(attribute.attributeID);
+    sign(attribute.data->getData(), attribute.data->getLength());
+}
+
+void onAppAttributeTask(ANCSClient::AppAttribute_t attribute)
+{
+    result.attributes++;
+
+    signWord('P');
+    sign((const uint8_t*) attribute.appIdentifier, strlen(attribute.appIdentifier));
+    signWord(attribute.attributeID);
+    sign(attribute.data->getData(), attribute.data->getLength());
+}
+
+void onRequestCompleteTask(ANCSClient::RequestComplete_t complete)
+{
+    result.completes++;
+
+    signWord('C');
+    signWord(complete.notificationUID);
+    signWord(complete.status);
+}
+
+/*****************************************************************************/
+/* Replay                                                                    */
+/*****************************************************************************/
+
+static void finishReplay();
+static void scheduleRecord();
+
+/*
+    Issue the request that made the client write this command.
+*/
+static void replayWrite(const uint8_t* payload, uint8_t length)
+{
+    ancs.expectWrite(payload, length);
+
+    if ((length >= 5) && (payload[0] == ANCSClient::CommandIDGetNotificationAttributes))
+    {
+        ANCSClient::AttributeRequest_t request[MAX_REQUEST_ATTRIBUTES];
+        uint8_t count = 0;
+        uint8_t index = 5;
+
+        while ((index < length) && (count < MAX_REQUEST_ATTRIBUTES))
+        {
+            uint8_t attributeID = payload[index++];
+
+            request[count].attributeID = (ANCSClient::notification_attribute_id_t) attributeID;
+            request[count].maxLength = 0;
+            request[count].buffer = NULL;
+
+            if (Codec::hasMaxLength(attributeID) && (index + 2 <= length))
+            {
+                request[count].maxLength = payload[index] | (payload[index + 1] << 8);
+                index += 2;
+            }
+
+            count++;
+        }
+
+        ancs.getNotificationAttributes(Codec::readUID(&payload[1]), request, count, onRequestCompleteTask);
+    }
+    else if ((length >= 3) && (payload[0] == ANCSClient::CommandIDGetAppAttributes))
+    {
+        char identifier[ANCS_CLIENT_APP_IDENTIFIER_LENGTH + 1] = { 0 };
+        ANCSClient::app_attribute_id_t request[MAX_REQUEST_ATTRIBUTES];
+        uint8_t identifierLength = 0;
+        uint8_t count = 0;
+
+        while ((1 + identifierLength < length) && payload[1 + identifierLength])
+        {
+            identifierLength++;
+        }
+
+        if (identifierLength <= ANCS_CLIENT_APP_IDENTIFIER_LENGTH)
+        {
+            memcpy(identifier, &payload[1], identifierLength);
+        }
+
+        for (uint8_t index = identifierLength + 2; (index < length) && (count < MAX_REQUEST_ATTRIBUTES); index++)
+        {
+            request[count++] = (ANCSClient::app_attribute_id_t) payload[index];
+        }
+
+        ancs.getAppAttributes(identifier, request, count, onRequestCompleteTask);
+    }
+    else if ((length >= 6) && (payload[0] == ANCSClient::CommandIDPerformNotificationAction))
+    {
+        ancs.performNotificationAction(Codec::readUID(&payload[1]),
+                                       (ANCSClient::action_id_t) payload[5],
+                                       onRequestCompleteTask);
+    }
+}
+
+static void replayRecord()
+{
+    result.records++;
+
+    switch (pending.type)
+    {
+        case RecordNotificationSource:
+        case RecordDataSource:
+            result.hvx++;
+            result.hvxBytes += pending.length;
+
+            if (pending.type == RecordNotificationSource)
+            {
+                connection.notificationSource(pending.data, pending.length);
+            }
+            else
+            {
+                connection.dataSource(pending.data, pending.length);
+            }
+            break;
+
+        case RecordConnect:
+            connection.connect();
+            break;
+
+        case RecordDisconnect:
+            connection.disconnect();
+            break;
+
+        case RecordWrite:
+            result.writes++;
+            replayWrite(pending.data, pending.length);
+            break;
+
+        // only written by the provider script
+        case RecordRequest:
+            ancs.getNotificationAttributes(Codec::readUID(pending.data), attributeRequest, 3, onRequestCompleteTask);
+            break;
+
+        case RecordAction:
+            ancs.performNotificationAction(Codec::readUID(pending.data),
+                                           (ANCSClient::action_id_t) pending.data[4],
+                                           onRequestCompleteTask);
+            break;
+
+        case RecordAppRequest:
+        {
+            char identifier[ANCS_CLIENT_APP_IDENTIFIER_LENGTH + 1] = { 0 };
+
+            if (pending.length <= ANCS_CLIENT_APP_IDENTIFIER_LENGTH)
+            {
+                memcpy(identifier, pending.data, pending.length);
+            }
+
+            ancs.getAppDisplayName(identifier, onRequestCompleteTask);
+        }
+            break;
+
+        // the security mode is not used
+        default:
+            break;
+    }
+
+    scheduleRecord();
+}
+
+static void scheduleRecord()
+{
+    if (reader.next(pending))
+    {
+        minar::Scheduler::postCallback(replayRecord)
+            .delay(minar::milliseconds(pending.delay));
+    }
+    else
+    {
+        // let the client finish posting its callbacks
+        minar::Scheduler::postCallback(finishReplay)
+            .delay(minar::milliseconds(SETTLE_DELAY_MS));
+    }
+}
+
+static void startReplay(phase_t _phase, const uint8_t* trace, uint16_t length)
+{
+    phase = _phase;
+
+    memset(&result, 0, sizeof(result));
+    result.signature = 2166136261UL;
+    result.start = minar::platform::getTime();
+
+    ancs.setChecking(phase != PhaseScript);
+    ancs.clearTrace();
+    ancs.clearAppCache();
+
+    reader = TraceReader(trace, length);
+    scheduleRecord();
+}
+
+static void printResult(const char* name, bool success)
+{
+    uint32_t ticks = (minar::platform::getTime() - result.start) & minar::platform::Time_Mask;
+
+    printf("{\"replay\":\"%s\",\"records\":%lu,\"hvx\":%lu,\"hvx_bytes\":%lu,\"writes\":%lu,\"write_mismatches\":%lu,"
+           "\"notifications\":%lu,\"attributes\":%lu,\"completes\":%lu,\"signature\":\"%08lX\",\"ticks\":%lu,\"ticks_per_second\":%lu,\"result\":\"%s\"}\r\n",
+           name,
+           (unsigned long) result.records,
+           (unsigned long) result.hvx,
+           (unsigned long) result.hvxBytes,
+           (unsigned long) result.writes,
+           (unsigned long) ancs.getMismatches(),
+           (unsigned long) result.notifications,
+           (unsigned long) result.attributes,
+           (unsigned long) result.completes,
+           (unsigned long) result.signature,
+           (unsigned long) ticks,
+           (unsigned long) minar::milliseconds(1000),
+           (success) ? "pass" : "FAIL");
+}
+
+static void finishReplay()
+{
+    // end with the link down, as the next run starts with a new pairing
+    if (ancs.isConnected())
+    {
+        connection.disconnect();
+    }
+
+    if (phase == PhaseScript)
+    {
+        bool success = (result.notifications == 2) && (result.attributes == 7) && (result.completes == 4);
+
+        printResult("script", success);
+        passed = passed && success;
+
+#if ANCS_CLIENT_TRACE_SIZE > 0
+        recordedLength = ancs.getTrace(recordedTrace, sizeof(recordedTrace));
+        scriptSignature = result.signature;
+
+        startReplay(PhaseRecorded, recordedTrace, recordedLength);
+#else
+        printf("replay: recorder compiled out, set ANCS_CLIENT_TRACE_SIZE to replay a recorded trace\r\n");
+        MBED_HOSTTEST_RESULT(passed);
+#endif
+        return;
+    }
+
+    if (phase == PhaseRecorded)
+    {
+        uint16_t length = ancs.getTrace(rerecordedTrace, sizeof(rerecordedTrace));
+
+        // the delay of the first record refers to the previous run
+        bool success = (ancs.getMismatches() == 0)
+                    && (result.signature == scriptSignature)
+                    && (recordedLength > RECORD_HEADER_LENGTH)
+                    && (length == recordedLength)
+                    && (memcmp(&rerecordedTrace[2], &recordedTrace[2], length - 2) == 0);
+
+        printResult("recorded", success);
+        passed = passed && success;
+
+        MBED_HOSTTEST_RESULT(passed);
+        return;
+    }
+
+    printResult("file", ancs.getMismatches() == 0);
+
+    MBED_HOSTTEST_RESULT(ancs.getMismatches() == 0);
+}
+
+/*****************************************************************************/
+/* main                                                                      */
+/*****************************************************************************/
+
+static void runReplay()
+{
+    if (traceLength > 0)
+    {
+        startReplay(PhaseFile, traceBuffer, traceLength);
+        return;
+    }
+
+    NotificationProvider provider(traceBuffer, sizeof(traceBuffer));
+    buildSession(provider);
+
+    startReplay(PhaseScript, provider.getTrace(), provider.getTraceLength());
+}
+
+void bleInitDone(BLE::InitializationCompleteCallbackContext* context)
+{
+    (void) context;
+
+    ancs.init();
+    ANCSDispatcher::registerNotificationHandlerTask(onNotificationTask);
+    ANCSDispatcher::registerAttributeHandlerTask(onAttributeTask);
+    ANCSDispatcher::registerAppAttributeHandlerTask(onAppAttributeTask);
+
+    minar::Scheduler::postCallback(runReplay);
+}
+
+void app_start(int argc, char *argv[])
+{
+    MBED_HOSTTEST_TIMEOUT(20);
+    MBED_HOSTTEST_SELECT(default_auto);
+    MBED_HOSTTEST_DESCRIPTION(ANCS trace replay);
+    MBED_HOSTTEST_START("ANCS_REPLAY");
+
+#if defined(TARGET_LIKE_X86_LINUX_NATIVE)
+    if (argc > 1)
+    {
+        FILE* file = fopen(argv[1], "rb");
+
+        if (file == NULL)
+        {
+            printf("replay: cannot open %s\r\n", argv[1]);
+            MBED_HOSTTEST_RESULT(false);
+            return;
+        }
+
+        traceLength = fread(traceBuffer, 1, sizeof(traceBuffer), file);
+        fclose(file);
+    }
+#else
+    (void) argc;
+    (void) argv;
+#endif
+
+    ble.init(bleInitDone);
+}
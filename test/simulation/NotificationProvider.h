@@ -0,0 +1,599 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __ANCS_NOTIFICATION_PROVIDER_H__
+#define __ANCS_NOTIFICATION_PROVIDER_H__
+
+#include <stdint.h>
+#include <string.h>
+
+/*
+    Scripted stand-in for the ANCS Notification Provider (the iOS device).
+
+    The provider does not talk to a radio. It writes the packets a phone
+    would send into a trace, which a harness then replays into ANCSClient.
+    Traces have no platform dependencies, so the same trace can be stored,
+    recorded on a device, and replayed deterministically.
+
+    Trace format, one record after another:
+
+        [delay ticks, 16-bit little endian][type][length, 16-bit little endian][data ...]
+*/
+namespace simulation
+{
+    typedef enum {
+        RecordNotificationSource = 0,   // HVX on the Notification Source
+        RecordDataSource         = 1,   // HVX on the Data Source
+        RecordRequest            = 2,   // application requests attributes for UID
+        RecordConnect            = 3,   // link established and ANCS discovered
+        RecordDisconnect         = 4,   // link lost
+        RecordAppRequest         = 5,   // application requests the display name of an app
+        RecordSelectPeer         = 6,   // following records belong to peer data[0]
+        RecordReconnect          = 7,   // bonded link established, ANCS not discovered
+        RecordLink               = 8,   // link established, discovery never answered
+        RecordAction             = 9,   // application performs action data[4] on UID
+        RecordRefresh            = 11,  // application refreshes attributes for UID
+        // written by ANCSTraceRecorder, ignored by the simulation
+        RecordWrite              = 12,  // Control Point payload written by the client
+        RecordSecured            = 13   // link encrypted with security mode data[0]
+    } record_type_t;
+
+    typedef struct {
+        uint16_t delay;
+        uint8_t type;
+        uint16_t length;
+        const uint8_t* data;
+    } Record_t;
+
+    typedef struct {
+        uint8_t attributeID;
+        const char* value;
+    } Attribute_t;
+
+    static const uint8_t RECORD_HEADER_LENGTH = 5;
+
+    static const uint8_t MAX_INTERLEAVED_PEERS = 4;
+    static const uint8_t MAX_RESPONSE_LENGTH = 128;
+
+    class TraceReader
+    {
+    public:
+        TraceReader(const uint8_t* _trace, uint16_t _length)
+            :   trace(_trace),
+                length(_length),
+                offset(0)
+        {}
+
+        /*
+            Read next record. Returns false at the end of the trace or if
+            the trace is truncated.
+        */
+        bool next(Record_t& record)
+        {
+            if (offset + RECORD_HEADER_LENGTH > length)
+            {
+                return false;
+            }
+
+            record.delay = trace[offset] | (trace[offset + 1] << 8);
+            record.type = trace[offset + 2];
+            record.length = trace[offset + 3] | (trace[offset + 4] << 8);
+            record.data = &trace[offset + RECORD_HEADER_LENGTH];
+
+            if (offset + RECORD_HEADER_LENGTH + record.length > length)
+            {
+                return false;
+            }
+
+            offset += RECORD_HEADER_LENGTH + record.length;
+
+            return true;
+        }
+
+        void rewind()
+        {
+            offset = 0;
+        }
+
+    private:
+        const uint8_t* trace;
+        uint16_t length;
+        uint16_t offset;
+    };
+
+    class NotificationProvider
+    {
+    public:
+        NotificationProvider(uint8_t* _buffer, uint16_t _maxLength)
+            :   buffer(_buffer),
+                maxLength(_maxLength),
+                length(0),
+                mtu(23),
+                interval(1),
+                disconnectAfter(0),
+                truncateAfter(0),
+                reorder(false),
+                random(0),
+                heldLength(0)
+        {}
+
+        /*
+            ATT MTU of the simulated link. Each HVX carries at most MTU - 3 bytes.
+        */
+        void setMTU(uint16_t _mtu)
+        {
+            mtu = (_mtu > 255 + 3) ? 255 + 3 : _mtu;
+        }
+
+        /*
+            Ticks between consecutive packets, i.e. the connection interval.
+        */
+        void setInterval(uint16_t _interval)
+        {
+            interval = _interval;
+        }
+
+        /*
+            Drop the link after this many Data Source fragments of the next
+            response. Zero disables.
+        */
+        void setDisconnectAfter(uint8_t fragments)
+        {
+            disconnectAfter = fragments;
+        }
+
+        /*
+            Lose the rest of the next response after this many Data Source
+            fragments, keeping the link. Zero disables.
+        */
+        void setTruncateAfter(uint8_t fragments)
+        {
+            truncateAfter = fragments;
+        }
+
+        /*
+            The Notification Source and Data Source are independent streams.
+            With a non-zero seed, the most recent Notification Source packet
+            is held back and released between the fragments of the next
+            response, at a position chosen by a deterministic generator.
+        */
+        void setReorder(uint32_t seed)
+        {
+            reorder = (seed != 0);
+            random = seed;
+        }
+
+        bool notification(uint8_t eventID,
+                          uint8_t eventFlags,
+                          uint8_t categoryID,
+                          uint8_t categoryCount,
+                          uint32_t notificationUID)
+        {
+            uint8_t packet[8];
+
+            packet[0] = eventID;
+            packet[1] = eventFlags;
+            packet[2] = categoryID;
+            packet[3] = categoryCount;
+            packet[4] = notificationUID;
+            packet[5] = notificationUID >> 8;
+            packet[6] = notificationUID >> 16;
+            packet[7] = notificationUID >> 24;
+
+            if (reorder)
+            {
+                // release previously held packet before holding the next one
+                if (heldLength && !flushHeld())
+                {
+                    return false;
+                }
+
+                memcpy(held, packet, sizeof(packet));
+                heldLength = sizeof(packet);
+
+                return true;
+            }
+
+            return append(interval, RecordNotificationSource, packet, sizeof(packet));
+        }
+
+        bool request(uint32_t notificationUID)
+        {
+            uint8_t packet[4];
+
+            packet[0] = notificationUID;
+            packet[1] = notificationUID >> 8;
+            packet[2] = notificationUID >> 16;
+            packet[3] = notificationUID >> 24;
+
+            return append(interval, RecordRequest, packet, sizeof(packet));
+        }
+
+        bool refresh(uint32_t notificationUID)
+        {
+            uint8_t packet[4];
+
+            packet[0] = notificationUID;
+            packet[1] = notificationUID >> 8;
+            packet[2] = notificationUID >> 16;
+            packet[3] = notificationUID >> 24;
+
+            return append(interval, RecordRefresh, packet, sizeof(packet));
+        }
+
+        bool action(uint32_t notificationUID, uint8_t actionID)
+        {
+            uint8_t packet[5];
+
+            packet[0] = notificationUID;
+            packet[1] = notificationUID >> 8;
+            packet[2] = notificationUID >> 16;
+            packet[3] = notificationUID >> 24;
+            packet[4] = actionID;
+
+            return append(interval, RecordAction, packet, sizeof(packet));
+        }
+
+        bool appRequest(const char* appIdentifier)
+        {
+            return append(interval, RecordAppRequest, (const uint8_t*) appIdentifier, strlen(appIdentifier));
+        }
+
+        /*
+            Emit a Get Notification Attributes response, fragmented by MTU.
+        */
+        bool response(uint32_t notificationUID, const Attribute_t* attributes, uint8_t count)
+        {
+            uint8_t header[5];
+            header[0] = 0; // CommandIDGetNotificationAttributes
+            header[1] = notificationUID;
+            header[2] = notificationUID >> 8;
+            header[3] = notificationUID >> 16;
+            header[4] = notificationUID >> 24;
+
+            return respond(header, sizeof(header), attributes, count);
+        }
+
+        /*
+            Emit a Get App Attributes response, fragmented by MTU.
+        */
+        bool appResponse(const char* appIdentifier, const Attribute_t* attributes, uint8_t count)
+        {
+            uint8_t header[255];
+            uint16_t identifierLength = strlen(appIdentifier) + 1;
+
+            if ((size_t) (1 + identifierLength) > sizeof(header))
+            {
+                return false;
+            }
+
+            header[0] = 1; // CommandIDGetAppAttributes
+            memcpy(&header[1], appIdentifier, identifierLength);
+
+            return respond(header, 1 + identifierLength, attributes, count);
+        }
+
+        /*
+            Emit Get Notification Attributes responses from several peers at
+            the same time. Fragments alternate between the peers, each one
+            preceded by a select record; peer n answers notificationUIDs[n].
+        */
+        bool interleavedResponse(const uint32_t* notificationUIDs,
+                                 uint8_t peers,
+                                 const Attribute_t* attributes,
+                                 uint8_t count)
+        {
+            uint8_t responses[MAX_INTERLEAVED_PEERS][MAX_RESPONSE_LENGTH];
+            uint16_t lengths[MAX_INTERLEAVED_PEERS];
+            uint16_t longest = 0;
+            uint8_t fragmentMax = mtu - 3;
+
+            if (peers > MAX_INTERLEAVED_PEERS)
+            {
+                return false;
+            }
+
+            for (uint8_t peer = 0; peer < peers; peer++)
+            {
+                lengths[peer] = serialize(notificationUIDs[peer], attributes, count,
+                                          responses[peer], sizeof(responses[peer]));
+
+                if (lengths[peer] == 0)
+                {
+                    return false;
+                }
+
+                longest = (lengths[peer] > longest) ? lengths[peer] : longest;
+            }
+
+            for (uint16_t offset = 0; offset < longest; offset += fragmentMax)
+            {
+                for (uint8_t peer = 0; peer < peers; peer++)
+                {
+                    if (offset < lengths[peer])
+                    {
+                        uint16_t fragmentLength = lengths[peer] - offset;
+                        fragmentLength = (fragmentLength > fragmentMax) ? fragmentMax : fragmentLength;
+
+                        if (!selectPeer(peer) ||
+                            !append(interval, RecordDataSource, &responses[peer][offset], fragmentLength))
+                        {
+                            return false;
+                        }
+                    }
+                }
+            }
+
+            return true;
+        }
+
+        /*
+            Direct the following records to another simulated peer.
+        */
+        bool selectPeer(uint8_t peer)
+        {
+            return append(interval, RecordSelectPeer, &peer, 1);
+        }
+
+        bool connect()
+        {
+            return append(interval, RecordConnect, NULL, 0);
+        }
+
+        bool reconnect()
+        {
+            return append(interval, RecordReconnect, NULL, 0);
+        }
+
+        /*
+            Phone that connects but never answers service discovery.
+        */
+        bool link()
+        {
+            return append(interval, RecordLink, NULL, 0);
+        }
+
+        bool disconnect()
+        {
+            return append(interval, RecordDisconnect, NULL, 0);
+        }
+
+        const uint8_t* getTrace() const
+        {
+            return buffer;
+        }
+
+        uint16_t getTraceLength() const
+        {
+            return length;
+        }
+
+    private:
+        /*
+            Write a complete Get Notification Attributes response into
+            response. Returns the length, or 0 if it does not fit.
+        */
+        uint16_t serialize(uint32_t notificationUID,
+                           const Attribute_t* attributes,
+                           uint8_t count,
+                           uint8_t* response,
+                           uint16_t maxLength)
+        {
+            uint16_t responseLength = 5;
+
+            if (responseLength > maxLength)
+            {
+                return 0;
+            }
+
+            response[0] = 0; // CommandIDGetNotificationAttributes
+            response[1] = notificationUID;
+            response[2] = notificationUID >> 8;
+            response[3] = notificationUID >> 16;
+            response[4] = notificationUID >> 24;
+
+            for (uint8_t index = 0; index < count; index++)
+            {
+                uint16_t valueLength = strlen(attributes[index].value);
+
+                if (responseLength + 3 + valueLength > maxLength)
+                {
+                    return 0;
+                }
+
+                response[responseLength++] = attributes[index].attributeID;
+                response[responseLength++] = valueLength;
+                response[responseLength++] = valueLength >> 8;
+
+                memcpy(&response[responseLength], attributes[index].value, valueLength);
+                responseLength += valueLength;
+            }
+
+            return responseLength;
+        }
+
+        bool respond(const uint8_t* header, uint16_t headerLength, const Attribute_t* attributes, uint8_t count)
+        {
+            uint8_t fragment[255];
+            uint8_t fragmentLength = 0;
+            uint8_t fragmentMax = mtu - 3;
+            uint8_t fragments = 0;
+
+            // serialize response and cut it into fragments on the fly
+            for (int16_t index = -1; index < count; index++)
+            {
+                const uint8_t* data;
+                uint16_t dataLength;
+                uint8_t tlv[3];
+
+                if (index < 0)
+                {
+                    data = header;
+                    dataLength = headerLength;
+                }
+                else
+                {
+                    uint16_t valueLength = strlen(attributes[index].value);
+
+                    tlv[0] = attributes[index].attributeID;
+                    tlv[1] = valueLength;
+                    tlv[2] = valueLength >> 8;
+
+                    if (!push(fragment, fragmentLength, fragmentMax, fragments, tlv, sizeof(tlv)))
+                    {
+                        return false;
+                    }
+
+                    data = (const uint8_t*) attributes[index].value;
+                    dataLength = valueLength;
+                }
+
+                if (!push(fragment, fragmentLength, fragmentMax, fragments, data, dataLength))
+                {
+                    return false;
+                }
+            }
+
+            if (fragmentLength > 0)
+            {
+                if (!emit(fragment, fragmentLength, fragments))
+                {
+                    return false;
+                }
+            }
+
+            // disconnect and truncation only apply to a single response
+            disconnectAfter = 0;
+            truncateAfter = 0;
+
+            return flushHeld();
+        }
+
+        bool push(uint8_t* fragment,
+                  uint8_t& fragmentLength,
+                  uint8_t fragmentMax,
+                  uint8_t& fragments,
+                  const uint8_t* data,
+                  uint16_t dataLength)
+        {
+            for (uint16_t index = 0; index < dataLength; index++)
+            {
+                fragment[fragmentLength++] = data[index];
+
+                if (fragmentLength == fragmentMax)
+                {
+                    if (!emit(fragment, fragmentLength, fragments))
+                    {
+                        return false;
+                    }
+
+                    fragmentLength = 0;
+                }
+            }
+
+            return true;
+        }
+
+        bool emit(const uint8_t* fragment, uint8_t fragmentLength, uint8_t& fragments)
+        {
+            // stop emitting once the link has been dropped
+            if ((disconnectAfter && (fragments >= disconnectAfter)) ||
+                (truncateAfter && (fragments >= truncateAfter)))
+            {
+                return true;
+            }
+
+            if (!append(interval, RecordDataSource, fragment, fragmentLength))
+            {
+                return false;
+            }
+
+            fragments++;
+
+            if (disconnectAfter && (fragments == disconnectAfter))
+            {
+                if (!flushHeld() || !disconnect())
+                {
+                    return false;
+                }
+            }
+
+            // release held Notification Source packet at a pseudo random fragment
+            if (heldLength)
+            {
+                random = random * 1103515245 + 12345;
+
+                if (((random >> 16) & 0x03) == 0)
+                {
+                    return flushHeld();
+                }
+            }
+
+            return true;
+        }
+
+        bool flushHeld()
+        {
+            if (heldLength == 0)
+            {
+                return true;
+            }
+
+            heldLength = 0;
+
+            return append(interval, RecordNotificationSource, held, sizeof(held));
+        }
+
+        bool append(uint16_t delay, uint8_t type, const uint8_t* data, uint16_t dataLength)
+        {
+            if ((uint32_t) length + RECORD_HEADER_LENGTH + dataLength > maxLength)
+            {
+                return false;
+            }
+
+            buffer[length++] = delay;
+            buffer[length++] = delay >> 8;
+            buffer[length++] = type;
+            buffer[length++] = dataLength;
+            buffer[length++] = dataLength >> 8;
+
+            if (dataLength)
+            {
+                memcpy(&buffer[length], data, dataLength);
+                length += dataLength;
+            }
+
+            return true;
+        }
+
+    private:
+        uint8_t* buffer;
+        uint16_t maxLength;
+        uint16_t length;
+
+        uint16_t mtu;
+        uint16_t interval;
+        uint8_t disconnectAfter;
+        uint8_t truncateAfter;
+        bool reorder;
+        uint32_t random;
+
+        uint8_t held[8];
+        uint8_t heldLength;
+    };
+}
+
+#endif // __ANCS_NOTIFICATION_PROVIDER_H__
@@ -0,0 +1,662 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __ANCS_SIMULATED_CONNECTION_H__
+#define __ANCS_SIMULATED_CONNECTION_H__
+
+#include "ble/BLE.h"
+#include "ble-ancs-client/ANCSClient.h"
+#include "ble-ancs-client/ANCSDispatcher.h"
+
+namespace simulation
+{
+    static const Gap::Handle_t SIM_CONNECTION_HANDLE = 0x1234;
+
+    static const GattAttribute::Handle_t SIM_NOTIFICATION_SOURCE = 0x0010;
+    static const GattAttribute::Handle_t SIM_CONTROL_POINT       = 0x0013;
+    static const GattAttribute::Handle_t SIM_DATA_SOURCE         = 0x0016;
+
+    // the Data Source has a descriptor before its CCCD
+    static const GattAttribute::Handle_t SIM_DATA_SOURCE_CCCD    = SIM_DATA_SOURCE + 2;
+
+    /*
+        Discovered characteristics are normally created by the BLE stack.
+    */
+    class SimulatedCharacteristic : public DiscoveredCharacteristic
+    {
+    public:
+        SimulatedCharacteristic(uint16_t shortUUID,
+                                GattAttribute::Handle_t handle,
+                                Gap::Handle_t connectionHandle,
+                                GattAttribute::Handle_t last = 0)
+        {
+            uuid = UUID(shortUUID);
+            declHandle = handle - 1;
+            valueHandle = handle;
+            lastHandle = (last) ? last : handle + 1;
+            connHandle = connectionHandle;
+        }
+    };
+
+    /*
+        The simulated phones as seen from the BLE stack, shared by all
+        connections: whether a phone serves ANCS and whether its link is
+        encrypted. As in the stack, one service discovery runs at a time.
+        Encrypted phones are bonded unless bonding is turned off.
+    */
+    class SimulatedPeers
+    {
+    public:
+        static void add(Gap::Handle_t handle, bool servesANCS)
+        {
+            Peer_t* peer = find(handle);
+
+            if (peer == NULL)
+            {
+                peer = find(0);
+            }
+
+            if (peer)
+            {
+                peer->handle = handle;
+                peer->servesANCS = servesANCS;
+                peer->encrypted = false;
+            }
+        }
+
+        static void remove(Gap::Handle_t handle)
+        {
+            Peer_t* peer = find(handle);
+
+            if (peer)
+            {
+                peer->handle = 0;
+            }
+        }
+
+        static bool servesANCS(Gap::Handle_t handle)
+        {
+            Peer_t* peer = find(handle);
+
+            return peer && peer->servesANCS;
+        }
+
+        static void setEncrypted(Gap::Handle_t handle)
+        {
+            Peer_t* peer = find(handle);
+
+            if (peer)
+            {
+                peer->encrypted = true;
+            }
+        }
+
+        static bool isEncrypted(Gap::Handle_t handle)
+        {
+            Peer_t* peer = find(handle);
+
+            return peer && peer->encrypted;
+        }
+
+        static bool& discoveryActive()
+        {
+            static bool active = false;
+
+            return active;
+        }
+
+        static bool& bonding()
+        {
+            static bool enabled = true;
+
+            return enabled;
+        }
+
+    private:
+        typedef struct {
+            Gap::Handle_t handle;
+            bool servesANCS;
+            bool encrypted;
+        } Peer_t;
+
+        // handle 0 finds a free entry
+        static Peer_t* find(Gap::Handle_t handle)
+        {
+            static Peer_t peers[ANCS_CLIENT_MAX_CONNECTIONS] = { { 0, false, false } };
+
+            for (uint8_t index = 0; index < ANCS_CLIENT_MAX_CONNECTIONS; index++)
+            {
+                if (peers[index].handle == handle)
+                {
+                    return &peers[index];
+                }
+            }
+
+            return NULL;
+        }
+    };
+
+    /*
+        Client whose Control Point and descriptor writes and connection
+        parameter updates succeed. The write response is delivered from the
+        scheduler, as the BLE stack would. Reads of the characteristic declarations and descriptor
+        discovery are answered the same way; reads of any other handle are
+        never answered. Descriptor discovery finds a User Description
+        followed by the CCCD. Service discovery and encryption are answered
+        from SimulatedPeers, so the client never reaches the BLE stack.
+    */
+    class SimulatedClient : public ANCSClient
+    {
+    public:
+        SimulatedClient()
+            :   ANCSClient(),
+                writes(0),
+                reads(0),
+                descriptorWrites(0),
+                descriptorDiscoveries(0),
+                serviceDiscoveries(0),
+                discoveryHandle(0),
+                discoveryCharacteristics(false),
+                securityRequests(0),
+                parameterUpdates(0),
+                writtenHead(0),
+                writtenCount(0)
+        {
+            descriptorHandles[0] = 0;
+            descriptorHandles[1] = 0;
+        }
+
+        uint32_t getWrites() const
+        {
+            return writes;
+        }
+
+        uint32_t getReads() const
+        {
+            return reads;
+        }
+
+        uint32_t getDescriptorWrites() const
+        {
+            return descriptorWrites;
+        }
+
+        /*
+            Handle of the most recent descriptor writes, newest first.
+        */
+        GattAttribute::Handle_t getDescriptorWrite(uint8_t index) const
+        {
+            return (index < 2) ? descriptorHandles[index] : 0;
+        }
+
+        uint32_t getDescriptorDiscoveries() const
+        {
+            return descriptorDiscoveries;
+        }
+
+        uint32_t getServiceDiscoveries() const
+        {
+            return serviceDiscoveries;
+        }
+
+        uint32_t getSecurityRequests() const
+        {
+            return securityRequests;
+        }
+
+        uint32_t getParameterUpdates() const
+        {
+            return parameterUpdates;
+        }
+
+        const Gap::ConnectionParams_t& getLastParameters() const
+        {
+            return lastParameters;
+        }
+
+        /*
+            Take the notification UID of the oldest Get Notification
+            Attributes command not taken yet, for answering the commands in
+            the order they were written, as the phone does.
+        */
+        bool nextWrittenUID(uint32_t& notificationUID)
+        {
+            if (writtenCount == 0)
+            {
+                return false;
+            }
+
+            notificationUID = writtenUIDs[writtenHead];
+            writtenHead = (writtenHead + 1) % WRITTEN_UIDS;
+            writtenCount--;
+
+            return true;
+        }
+
+    protected:
+        virtual ble_error_t writeControlPoint(const uint8_t* payload, uint8_t length, bool withResponse)
+        {
+            writes++;
+
+            if ((length >= 5) &&
+                (payload[0] == ANCSClient::CommandIDGetNotificationAttributes) &&
+                (writtenCount < WRITTEN_UIDS))
+            {
+                writtenUIDs[(writtenHead + writtenCount) % WRITTEN_UIDS] = payload[1]
+                                                                        | (payload[2] << 8)
+                                                                        | (payload[3] << 16)
+                                                                        | ((uint32_t) payload[4] << 24);
+                writtenCount++;
+            }
+
+            if (withResponse)
+            {
+                postWriteResponse(SIM_CONTROL_POINT);
+            }
+
+            return BLE_ERROR_NONE;
+        }
+
+        virtual ble_error_t writeDescriptor(GattAttribute::Handle_t handle, uint16_t value)
+        {
+            (void) value;
+
+            descriptorWrites++;
+            descriptorHandles[1] = descriptorHandles[0];
+            descriptorHandles[0] = handle;
+            postWriteResponse(handle);
+
+            return BLE_ERROR_NONE;
+        }
+
+        virtual ble_error_t updateConnectionParams(const Gap::ConnectionParams_t* params)
+        {
+            parameterUpdates++;
+            lastParameters = *params;
+
+            return BLE_ERROR_NONE;
+        }
+
+        virtual ble_error_t discoverDescriptors(const DiscoveredCharacteristic& characteristic)
+        {
+            descriptorDiscoveries++;
+            discovering = characteristic;
+            minar::Scheduler::postCallback(this, &SimulatedClient::descriptorResponse);
+
+            return BLE_ERROR_NONE;
+        }
+
+        virtual void terminateDescriptorDiscovery(const DiscoveredCharacteristic& characteristic)
+        {
+            // descriptorResponse delivers all descriptors at once
+            (void) characteristic;
+        }
+
+        virtual ble_error_t launchServiceDiscovery(bool characteristics)
+        {
+            serviceDiscoveries++;
+            SimulatedPeers::discoveryActive() = true;
+            discoveryHandle = getConnectionHandle();
+            discoveryCharacteristics = characteristics;
+            minar::Scheduler::postCallback(this, &SimulatedClient::serviceDiscoveryResponse);
+
+            return BLE_ERROR_NONE;
+        }
+
+        virtual bool isServiceDiscoveryActive()
+        {
+            return SimulatedPeers::discoveryActive();
+        }
+
+        virtual void terminateServiceDiscovery()
+        {
+            if (SimulatedPeers::discoveryActive())
+            {
+                SimulatedPeers::discoveryActive() = false;
+                postDiscoveryTermination(discoveryHandle);
+            }
+        }
+
+        virtual SecurityManager::LinkSecurityStatus_t getLinkSecurity()
+        {
+            return (SimulatedPeers::isEncrypted(getConnectionHandle())) ? SecurityManager::ENCRYPTED
+                                                                        : SecurityManager::NOT_ENCRYPTED;
+        }
+
+        virtual ble_error_t setLinkSecurity(SecurityManager::SecurityMode_t mode)
+        {
+            (void) mode;
+
+            securityRequests++;
+
+            FunctionPointer1<void, Gap::Handle_t> secured(this, &SimulatedClient::linkSecuredResponse);
+            minar::Scheduler::postCallback(secured.bind(getConnectionHandle()));
+
+            return BLE_ERROR_NONE;
+        }
+
+        virtual bool isBonded()
+        {
+            return SimulatedPeers::bonding() && SimulatedPeers::isEncrypted(getConnectionHandle());
+        }
+
+        virtual ble_error_t readAttribute(GattAttribute::Handle_t handle)
+        {
+            reads++;
+
+            if ((handle == SIM_NOTIFICATION_SOURCE - 1) ||
+                (handle == SIM_CONTROL_POINT - 1) ||
+                (handle == SIM_DATA_SOURCE - 1))
+            {
+                FunctionPointer1<void, GattAttribute::Handle_t> response(this, &SimulatedClient::readResponse);
+                minar::Scheduler::postCallback(response.bind(handle));
+            }
+
+            return BLE_ERROR_NONE;
+        }
+
+    private:
+        /*
+            Phones serving ANCS report the service, or its three
+            characteristics, before discovery ends.
+        */
+        void serviceDiscoveryResponse()
+        {
+            // terminated before the phone answered
+            if (!SimulatedPeers::discoveryActive())
+            {
+                return;
+            }
+
+            Gap::Handle_t handle = discoveryHandle;
+
+            if (SimulatedPeers::servesANCS(handle))
+            {
+                if (discoveryCharacteristics)
+                {
+                    SimulatedCharacteristic notificationSource(0x120D, SIM_NOTIFICATION_SOURCE, handle);
+                    SimulatedCharacteristic controlPoint(0xD8F3, SIM_CONTROL_POINT, handle);
+                    SimulatedCharacteristic dataSource(0xC6E9, SIM_DATA_SOURCE, handle, SIM_DATA_SOURCE_CCCD);
+
+                    ANCSDispatcher::characteristicDiscoveryCallback(&notificationSource);
+                    ANCSDispatcher::characteristicDiscoveryCallback(&controlPoint);
+                    ANCSDispatcher::characteristicDiscoveryCallback(&dataSource);
+                }
+                else
+                {
+                    DiscoveredService service;
+                    ANCSDispatcher::serviceDiscoveryCallback(&service);
+                }
+            }
+
+            // the client may have terminated discovery on the way
+            if (SimulatedPeers::discoveryActive())
+            {
+                SimulatedPeers::discoveryActive() = false;
+                ANCSDispatcher::discoveryTerminationCallback(handle);
+            }
+        }
+
+        void postDiscoveryTermination(Gap::Handle_t handle)
+        {
+            FunctionPointer1<void, Gap::Handle_t> termination(&ANCSDispatcher::discoveryTerminationCallback);
+            minar::Scheduler::postCallback(termination.bind(handle));
+        }
+
+        void linkSecuredResponse(Gap::Handle_t handle)
+        {
+            // the phone may be gone by now
+            if (handle == getConnectionHandle())
+            {
+                SimulatedPeers::setEncrypted(handle);
+                ANCSDispatcher::linkSecured(handle, SecurityManager::SECURITY_MODE_ENCRYPTION_NO_MITM);
+            }
+        }
+
+        void readResponse(GattAttribute::Handle_t handle)
+        {
+            // properties, value handle, UUID in little endian order
+            static const uint8_t notificationSource[16] = {
+                0xBD, 0x1D, 0xA2, 0x99, 0xE6, 0x25, 0x58, 0x8C,
+                0xD9, 0x42, 0x01, 0x63, 0x0D, 0x12, 0xBF, 0x9F
+            };
+            static const uint8_t controlPoint[16] = {
+                0xD9, 0xD9, 0xAA, 0xFD, 0xBD, 0x9B, 0x21, 0x98,
+                0xA8, 0x49, 0xE1, 0x45, 0xF3, 0xD8, 0xD1, 0x69
+            };
+            static const uint8_t dataSource[16] = {
+                0xFB, 0x7B, 0x7C, 0xCE, 0x6A, 0xB3, 0x44, 0xBE,
+                0xB5, 0x4B, 0xD6, 0x24, 0xE9, 0xC6, 0xEA, 0x22
+            };
+
+            GattAttribute::Handle_t value = handle + 1;
+            uint8_t declaration[19];
+
+            declaration[0] = (value == SIM_CONTROL_POINT) ? 0x08 : 0x10;
+            declaration[1] = value & 0xFF;
+            declaration[2] = value >> 8;
+            memcpy(&declaration[3],
+                   (value == SIM_NOTIFICATION_SOURCE) ? notificationSource :
+                   (value == SIM_CONTROL_POINT) ? controlPoint : dataSource,
+                   16);
+
+            GattReadCallbackParams params;
+            params.connHandle = getConnectionHandle();
+            params.handle = handle;
+            params.offset = 0;
+            params.len = sizeof(declaration);
+            params.data = declaration;
+
+            ANCSDispatcher::dataRead(&params);
+        }
+
+        void descriptorResponse()
+        {
+            GattAttribute::Handle_t handle = discovering.getValueHandle();
+
+            DiscoveredCharacteristicDescriptor description(NULL, discovering.getConnectionHandle(), handle + 1, UUID(0x2901));
+            DiscoveredCharacteristicDescriptor cccd(NULL, discovering.getConnectionHandle(), handle + 2, UUID(0x2902));
+
+            CharacteristicDescriptorDiscovery::DiscoveryCallbackParams_t first = { discovering, description };
+            CharacteristicDescriptorDiscovery::DiscoveryCallbackParams_t second = { discovering, cccd };
+            CharacteristicDescriptorDiscovery::TerminationCallbackParams_t done = { discovering, BLE_ERROR_NONE };
+
+            descriptorDiscoveryCallback(&first);
+            descriptorDiscoveryCallback(&second);
+            descriptorDiscoveryTermination(&done);
+        }
+
+        void postWriteResponse(GattAttribute::Handle_t handle)
+        {
+            FunctionPointer1<void, GattAttribute::Handle_t> response(this, &SimulatedClient::writeResponse);
+            minar::Scheduler::postCallback(response.bind(handle));
+        }
+
+        void writeResponse(GattAttribute::Handle_t handle)
+        {
+            GattWriteCallbackParams params;
+            params.connHandle = getConnectionHandle();
+            params.handle = handle;
+            params.writeOp = GattWriteCallbackParams::OP_WRITE_REQ;
+            params.offset = 0;
+            params.len = 0;
+            params.data = NULL;
+
+            ANCSDispatcher::dataWritten(&params);
+        }
+
+    private:
+        uint32_t writes;
+        uint32_t reads;
+        uint32_t descriptorWrites;
+        GattAttribute::Handle_t descriptorHandles[2];
+        uint32_t descriptorDiscoveries;
+        DiscoveredCharacteristic discovering;
+        uint32_t serviceDiscoveries;
+        Gap::Handle_t discoveryHandle;
+        bool discoveryCharacteristics;
+        uint32_t securityRequests;
+        uint32_t parameterUpdates;
+        Gap::ConnectionParams_t lastParameters;
+
+        static const uint8_t WRITTEN_UIDS = 8;
+        uint32_t writtenUIDs[WRITTEN_UIDS];
+        uint8_t writtenHead;
+        uint8_t writtenCount;
+    };
+
+    /*
+        Drives the ANCSDispatcher through its GATT event entry points as if
+        an iOS device was connected with the given connection handle. The
+        dispatcher hands the link to an idle ANCSClient. Requests sent by the
+        client are not answered; the Data Source responses come from the
+        trace instead.
+    */
+    class SimulatedConnection
+    {
+    public:
+        SimulatedConnection(Gap::Handle_t _handle = SIM_CONNECTION_HANDLE)
+            :   handle(_handle)
+        {}
+
+        Gap::Handle_t getHandle() const
+        {
+            return handle;
+        }
+
+        /*
+            Client serving this connection, or NULL when not connected.
+        */
+        ANCSClient* getClient() const
+        {
+            return ANCSDispatcher::find(handle);
+        }
+
+        /*
+            Run connection, service discovery, encryption, and characteristic
+            discovery back to back, as for a phone that was never connected.
+        */
+        void connect()
+        {
+            // pairing from scratch; no handles are known
+            ANCSClient::clearHandleCache();
+
+            establish(true);
+
+            ANCSClient* client = getClient();
+
+            if (client == NULL)
+            {
+                return;
+            }
+
+            // discovered services carry no connection handle
+            DiscoveredService service;
+            client->serviceDiscoveryCallback(&service);
+
+            secure();
+
+            SimulatedCharacteristic notificationSource(0x120D, SIM_NOTIFICATION_SOURCE, handle);
+            SimulatedCharacteristic controlPoint(0xD8F3, SIM_CONTROL_POINT, handle);
+            SimulatedCharacteristic dataSource(0xC6E9, SIM_DATA_SOURCE, handle, SIM_DATA_SOURCE_CCCD);
+
+            ANCSDispatcher::characteristicDiscoveryCallback(&notificationSource);
+            ANCSDispatcher::characteristicDiscoveryCallback(&controlPoint);
+            ANCSDispatcher::characteristicDiscoveryCallback(&dataSource);
+        }
+
+        /*
+            Bonded phone coming back. Only the link is established and
+            encrypted; the client has to find the characteristics itself.
+        */
+        void reconnect()
+        {
+            establish(true);
+            secure();
+        }
+
+        /*
+            Only establish the link, to a phone without ANCS; discovery
+            finds nothing.
+        */
+        void link()
+        {
+            establish(false);
+        }
+
+        void disconnect()
+        {
+            SimulatedPeers::remove(handle);
+
+            Gap::DisconnectionCallbackParams_t disconnection(handle,
+                                                             Gap::REMOTE_USER_TERMINATED_CONNECTION);
+            ANCSDispatcher::onDisconnection(&disconnection);
+        }
+
+        void notificationSource(const uint8_t* data, uint8_t length)
+        {
+            hvx(SIM_NOTIFICATION_SOURCE, data, length);
+        }
+
+        void dataSource(const uint8_t* data, uint8_t length)
+        {
+            hvx(SIM_DATA_SOURCE, data, length);
+        }
+
+    private:
+        void establish(bool servesANCS)
+        {
+            SimulatedPeers::add(handle, servesANCS);
+
+            // one address per simulated phone
+            uint8_t address[6] = { 0 };
+            address[0] = handle;
+            address[1] = handle >> 8;
+
+            Gap::ConnectionCallbackParams_t connection(handle,
+                                                       Gap::PERIPHERAL,
+                                                       BLEProtocol::AddressType::RANDOM_STATIC,
+                                                       address,
+                                                       BLEProtocol::AddressType::RANDOM_STATIC,
+                                                       address,
+                                                       NULL);
+            ANCSDispatcher::onConnection(&connection);
+        }
+
+        void secure()
+        {
+            SimulatedPeers::setEncrypted(handle);
+            ANCSDispatcher::linkSecured(handle, SecurityManager::SECURITY_MODE_ENCRYPTION_NO_MITM);
+        }
+
+        void hvx(GattAttribute::Handle_t attribute, const uint8_t* data, uint8_t length)
+        {
+            GattHVXCallbackParams params;
+            params.connHandle = handle;
+            params.handle = attribute;
+            params.type = BLE_HVX_NOTIFICATION;
+            params.len = length;
+            params.data = data;
+
+            ANCSDispatcher::hvxCallback(&params);
+        }
+
+    private:
+        Gap::Handle_t handle;
+    };
+}
+
+#endif // __ANCS_SIMULATED_CONNECTION_H__
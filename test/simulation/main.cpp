@@ -0,0 +1,1748 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2015 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+    Deterministic test harness for ANCSClient.
+
+    Instead of an iPhone, a scripted NotificationProvider writes the packets
+    for each scenario into a trace. The trace is replayed by calling the
+    dispatcher's GATT event handlers directly, one record per scheduler
+    callback. Up to SIM_PEERS phones can be connected at the same time.
+    Every callback the client makes is logged with the index of the record
+    that caused it and compared with the expected log, so both ordering and
+    timing (in records) are checked.
+*/
+
+#include "mbed-drivers/mbed.h"
+#include "mbed-drivers/test_env.h"
+#include "ble/BLE.h"
+
+#include "ble-ancs-client/ANCSClient.h"
+#include "ble-ancs-client/ANCSDispatcher.h"
+
+#include "NotificationProvider.h"
+#include "SimulatedConnection.h"
+
+using namespace simulation;
+
+/*****************************************************************************/
+/* Configuration                                                             */
+/*****************************************************************************/
+
+#define DEBUGOUT(...) { printf(__VA_ARGS__); }
+
+#define MAX_LOG_EVENTS          32
+#define TRACE_BUFFER_SIZE       1024
+#define SETTLE_DELAY_MS         100
+#define SIM_PEERS               3
+
+/*****************************************************************************/
+/* Scenarios                                                                 */
+/*****************************************************************************/
+
+typedef enum {
+    EventNotification = 'N',
+    EventAttribute    = 'A',
+    EventComplete     = 'C', // attributeID holds the status, length the attribute count
+    EventAppAttribute = 'P',
+    EventWrite        = 'W', // length holds the Control Point writes caused by an app request
+    EventBatch        = 'B', // notificationUID holds the batch size, attributeID the events received
+    EventDiscovery    = 'F', // attributeID holds the failed stage, length the attempts made
+    EventAction       = 'X', // attributeID holds the status
+    EventDecoded      = 'D', // length holds the text length, or 1 if a value is valid
+    EventExport       = 'E'  // attributeID holds the chunk state, length the bytes of a complete map
+} event_type_t;
+
+typedef struct {
+    uint8_t step;
+    uint8_t type;
+    uint32_t notificationUID;
+    uint8_t attributeID;
+    uint16_t length;
+} Event_t;
+
+typedef struct {
+    const char* name;
+    void (*build)(NotificationProvider&);
+    const ANCSClient::AttributeRequest_t* request;
+    const Event_t* expected;
+    uint8_t expectedCount;
+    bool (*check)(void);    // optional check of client state after the trace
+    void (*setup)(void);    // optional client configuration before the trace
+} Scenario_t;
+
+#define MESSAGE "The quick brown fox jumps over the lazy dog, twice."
+
+static const Attribute_t shortAttributes[] = {
+    { ANCSClient::NotificationAttributeIDTitle,    "Hello" },
+    { ANCSClient::NotificationAttributeIDSubtitle, "" },
+    { ANCSClient::NotificationAttributeIDMessage,  MESSAGE }
+};
+
+static const Attribute_t longAttributes[] = {
+    { ANCSClient::NotificationAttributeIDTitle,    "Alice" },
+    { ANCSClient::NotificationAttributeIDSubtitle, "Re: lunch" },
+    { ANCSClient::NotificationAttributeIDMessage,  MESSAGE MESSAGE }
+};
+
+/*
+    Only added, non-silent notifications are passed on.
+*/
+static void buildBurst(NotificationProvider& provider)
+{
+    provider.connect();
+    provider.notification(ANCSClient::EventIDNotificationAdded, 0, ANCSClient::CategoryIDSocial, 1, 1);
+    provider.notification(ANCSClient::EventIDNotificationAdded, ANCSClient::EventFlagSilent, ANCSClient::CategoryIDSocial, 2, 2);
+    provider.notification(ANCSClient::EventIDNotificationModified, 0, ANCSClient::CategoryIDSocial, 2, 1);
+    provider.notification(ANCSClient::EventIDNotificationRemoved, 0, ANCSClient::CategoryIDSocial, 1, 1);
+    provider.notification(ANCSClient::EventIDNotificationAdded, ANCSClient::EventFlagImportant, ANCSClient::CategoryIDIncomingCall, 1, 3);
+}
+
+static const Event_t expectedBurst[] = {
+    { 2, EventNotification, 1, 0, 0 },
+    { 6, EventNotification, 3, 0, 0 }
+};
+
+/*
+    Attributes spanning several fragments at the default MTU.
+*/
+static void buildMTU23(NotificationProvider& provider)
+{
+    provider.setMTU(23);
+    provider.connect();
+    provider.notification(ANCSClient::EventIDNotificationAdded, 0, ANCSClient::CategoryIDEmail, 1, 10);
+    provider.request(10);
+    provider.response(10, shortAttributes, 3);
+}
+
+static const Event_t expectedMTU23[] = {
+    { 2, EventNotification, 10, 0, 0 },
+    { 4, EventAttribute,    10, ANCSClient::NotificationAttributeIDTitle,    5 },
+    { 4, EventAttribute,    10, ANCSClient::NotificationAttributeIDSubtitle, 0 },
+    { 7, EventAttribute,    10, ANCSClient::NotificationAttributeIDMessage,  51 },
+    { 7, EventComplete,     10, ANCSClient::RequestStatusSuccess, 3 }
+};
+
+/*
+    Entire response in a single fragment.
+*/
+static void buildMTU185(NotificationProvider& provider)
+{
+    provider.setMTU(185);
+    provider.connect();
+    provider.notification(ANCSClient::EventIDNotificationAdded, 0, ANCSClient::CategoryIDEmail, 1, 10);
+    provider.request(10);
+    provider.response(10, shortAttributes, 3);
+}
+
+static const Event_t expectedMTU185[] = {
+    { 2, EventNotification, 10, 0, 0 },
+    { 4, EventAttribute,    10, ANCSClient::NotificationAttributeIDTitle,    5 },
+    { 4, EventAttribute,    10, ANCSClient::NotificationAttributeIDSubtitle, 0 },
+    { 4, EventAttribute,    10, ANCSClient::NotificationAttributeIDMessage,  51 },
+    { 4, EventComplete,     10, ANCSClient::RequestStatusSuccess, 3 }
+};
+
+/*
+    Notification Source packet arriving between Data Source fragments.
+*/
+static void buildReorder(NotificationProvider& provider)
+{
+    provider.setMTU(23);
+    provider.connect();
+    provider.request(20);
+    provider.setReorder(7);
+    provider.notification(ANCSClient::EventIDNotificationAdded, 0, ANCSClient::CategoryIDSocial, 1, 21);
+    provider.response(20, longAttributes, 3);
+}
+
+static const Event_t expectedReorder[] = {
+    { 3,  EventAttribute,    20, ANCSClient::NotificationAttributeIDTitle,    5 },
+    { 4,  EventNotification, 21, 0, 0 },
+    { 5,  EventAttribute,    20, ANCSClient::NotificationAttributeIDSubtitle, 9 },
+    { 10, EventAttribute,    20, ANCSClient::NotificationAttributeIDMessage,  102 },
+    { 10, EventComplete,     20, ANCSClient::RequestStatusSuccess, 3 }
+};
+
+/*
+    Link lost in the middle of a response. The partial attribute must be
+    dropped and the next connection must start from a clean parser.
+*/
+static void buildDisconnect(NotificationProvider& provider)
+{
+    provider.setMTU(23);
+    provider.connect();
+    provider.request(30);
+    provider.setDisconnectAfter(2);
+    provider.response(30, longAttributes, 3);
+    provider.connect();
+    provider.notification(ANCSClient::EventIDNotificationAdded, 0, ANCSClient::CategoryIDSocial, 1, 31);
+    provider.request(31);
+    provider.response(31, shortAttributes, 3);
+}
+
+static const Event_t expectedDisconnect[] = {
+    { 3,  EventAttribute,    30, ANCSClient::NotificationAttributeIDTitle,    5 },
+    { 4,  EventAttribute,    30, ANCSClient::NotificationAttributeIDSubtitle, 9 },
+    { 5,  EventComplete,     30, ANCSClient::RequestStatusDisconnected, 2 },
+    { 7,  EventNotification, 31, 0, 0 },
+    { 9,  EventAttribute,    31, ANCSClient::NotificationAttributeIDTitle,    5 },
+    { 9,  EventAttribute,    31, ANCSClient::NotificationAttributeIDSubtitle, 0 },
+    { 12, EventAttribute,    31, ANCSClient::NotificationAttributeIDMessage,  51 },
+    { 12, EventComplete,     31, ANCSClient::RequestStatusSuccess, 3 }
+};
+
+#if (ANCS_CLIENT_POOL_BLOCKS == 0) || (ANCS_CLIENT_POOL_BLOCKS >= 6)
+/*
+    Second request written while the first response is outstanding. A
+    smaller pool refuses the second request.
+*/
+static void buildPipeline(NotificationProvider& provider)
+{
+    provider.setMTU(185);
+    provider.connect();
+    provider.request(40);
+    provider.request(41);
+    provider.response(40, shortAttributes, 3);
+    provider.response(41, longAttributes, 3);
+}
+
+static const Event_t expectedPipeline[] = {
+    { 4, EventAttribute,    40, ANCSClient::NotificationAttributeIDTitle,    5 },
+    { 4, EventAttribute,    40, ANCSClient::NotificationAttributeIDSubtitle, 0 },
+    { 4, EventAttribute,    40, ANCSClient::NotificationAttributeIDMessage,  51 },
+    { 4, EventComplete,     40, ANCSClient::RequestStatusSuccess, 3 },
+    { 5, EventAttribute,    41, ANCSClient::NotificationAttributeIDTitle,    5 },
+    { 5, EventAttribute,    41, ANCSClient::NotificationAttributeIDSubtitle, 9 },
+    { 5, EventAttribute,    41, ANCSClient::NotificationAttributeIDMessage,  102 },
+    { 5, EventComplete,     41, ANCSClient::RequestStatusSuccess, 3 }
+};
+
+/*
+    Response for the first request never arrives. The request is failed
+    when the response for the second one is matched.
+*/
+static void buildSkipped(NotificationProvider& provider)
+{
+    provider.setMTU(185);
+    provider.connect();
+    provider.request(50);
+    provider.request(51);
+    provider.response(51, shortAttributes, 3);
+}
+
+static const Event_t expectedSkipped[] = {
+    { 4, EventComplete,     50, ANCSClient::RequestStatusMismatch, 0 },
+    { 4, EventAttribute,    51, ANCSClient::NotificationAttributeIDTitle,    5 },
+    { 4, EventAttribute,    51, ANCSClient::NotificationAttributeIDSubtitle, 0 },
+    { 4, EventAttribute,    51, ANCSClient::NotificationAttributeIDMessage,  51 },
+    { 4, EventComplete,     51, ANCSClient::RequestStatusSuccess, 3 }
+};
+#endif
+
+#if (ANCS_CLIENT_APP_CACHE_SIZE > 0) && ANCS_CLIENT_APP_CACHE_PERSIST
+/*
+    Display names are requested once and then served from the cache, also
+    after the bonded peer reconnects.
+*/
+#define APP_IDENTIFIER "com.example.mail"
+
+static const Attribute_t appAttributes[] = {
+    { ANCSClient::AppAttributeIDDisplayName, "Mail" }
+};
+
+static void buildAppCache(NotificationProvider& provider)
+{
+    provider.setMTU(185);
+    provider.connect();
+    provider.appRequest(APP_IDENTIFIER);
+    provider.appResponse(APP_IDENTIFIER, appAttributes, 1);
+    provider.appRequest(APP_IDENTIFIER);
+    provider.disconnect();
+    provider.connect();
+    provider.appRequest(APP_IDENTIFIER);
+}
+
+static const Event_t expectedAppCache[] = {
+    { 2, EventWrite,        0, 0, 1 },
+    { 3, EventAppAttribute, 0, ANCSClient::AppAttributeIDDisplayName, 4 },
+    { 3, EventComplete,     0, ANCSClient::RequestStatusSuccess, 1 },
+    { 4, EventWrite,        0, 0, 0 },
+    { 4, EventAppAttribute, 0, ANCSClient::AppAttributeIDDisplayName, 4 },
+    { 4, EventComplete,     0, ANCSClient::RequestStatusSuccess, 1 },
+    { 7, EventWrite,        0, 0, 0 },
+    { 7, EventAppAttribute, 0, ANCSClient::AppAttributeIDDisplayName, 4 },
+    { 7, EventComplete,     0, ANCSClient::RequestStatusSuccess, 1 }
+};
+#endif
+
+#if ANCS_CLIENT_STORE_SIZE > 0
+/*
+    The local store follows every event, including silent notifications and
+    the Modified and Removed events that are not passed on.
+*/
+static void buildStore(NotificationProvider& provider)
+{
+    provider.connect();
+    provider.notification(ANCSClient::EventIDNotificationAdded, 0, ANCSClient::CategoryIDSocial, 1, 1);
+    provider.notification(ANCSClient::EventIDNotificationAdded, ANCSClient::EventFlagSilent, ANCSClient::CategoryIDSocial, 2, 2);
+    provider.notification(ANCSClient::EventIDNotificationAdded, 0, ANCSClient::CategoryIDEmail, 1, 3);
+    provider.notification(ANCSClient::EventIDNotificationModified, ANCSClient::EventFlagImportant, ANCSClient::CategoryIDSocial, 2, 2);
+    provider.notification(ANCSClient::EventIDNotificationRemoved, 0, ANCSClient::CategoryIDSocial, 1, 1);
+}
+
+static const Event_t expectedStore[] = {
+    { 2, EventNotification, 1, 0, 0 },
+    { 4, EventNotification, 3, 0, 0 }
+};
+
+extern SimulatedClient ancs;
+
+static bool checkStore()
+{
+    ANCSClient::Notification_t notification;
+    uint16_t iterated = 0;
+
+    for (uint16_t slot = 0; slot < ancs.getNotificationCapacity(); slot++)
+    {
+        if (ancs.getNotificationAt(slot, NULL))
+        {
+            iterated++;
+        }
+    }
+
+    return (ancs.getNotificationCount() == 2)
+        && (iterated == 2)
+        && (ancs.getCategoryCount(ANCSClient::CategoryIDSocial) == 1)
+        && (ancs.getCategoryCount(ANCSClient::CategoryIDEmail) == 1)
+        && !ancs.findNotification(1, &notification)
+        && ancs.findNotification(2, &notification)
+        && (notification.eventID == ANCSClient::EventIDNotificationModified)
+        && (notification.eventFlags == ANCSClient::EventFlagImportant)
+        && (notification.categoryCount == 1);
+}
+#endif
+
+/*
+    Attributes fetched automatically by category and event flags. Email is
+    not covered by the policy and pre-existing notifications are skipped.
+*/
+static const Attribute_t socialAttributes[] = {
+    { ANCSClient::NotificationAttributeIDTitle,   "Alice" }
+};
+
+static const Attribute_t callAttributes[] = {
+    { ANCSClient::NotificationAttributeIDTitle,   "Bob" },
+    { ANCSClient::NotificationAttributeIDMessage, "Incoming Call" },
+    { ANCSClient::NotificationAttributeIDDate,    "20261016T101500" }
+};
+
+static void buildPolicy(NotificationProvider& provider)
+{
+    provider.setMTU(185);
+    provider.connect();
+    provider.notification(ANCSClient::EventIDNotificationAdded, 0, ANCSClient::CategoryIDSocial, 1, 60);
+    provider.response(60, socialAttributes, 1);
+    provider.notification(ANCSClient::EventIDNotificationAdded, ANCSClient::EventFlagImportant, ANCSClient::CategoryIDIncomingCall, 1, 61);
+    provider.response(61, callAttributes, 3);
+    provider.notification(ANCSClient::EventIDNotificationAdded, ANCSClient::EventFlagPreExisting, ANCSClient::CategoryIDSocial, 2, 62);
+    provider.notification(ANCSClient::EventIDNotificationAdded, 0, ANCSClient::CategoryIDEmail, 1, 63);
+}
+
+static const Event_t expectedPolicy[] = {
+    { 2, EventNotification, 60, 0, 0 },
+    { 3, EventAttribute,    60, ANCSClient::NotificationAttributeIDTitle,   5 },
+    { 3, EventComplete,     60, ANCSClient::RequestStatusSuccess, 1 },
+    { 4, EventNotification, 61, 0, 0 },
+    { 5, EventAttribute,    61, ANCSClient::NotificationAttributeIDTitle,   3 },
+    { 5, EventAttribute,    61, ANCSClient::NotificationAttributeIDMessage, 13 },
+    { 5, EventAttribute,    61, ANCSClient::NotificationAttributeIDDate,    15 },
+    { 5, EventComplete,     61, ANCSClient::RequestStatusSuccess, 3 },
+    { 6, EventNotification, 62, 0, 0 },
+    { 7, EventNotification, 63, 0, 0 }
+};
+
+static const ANCSClient::AttributeRequest_t socialRequest[] = {
+    { ANCSClient::NotificationAttributeIDTitle,   32, NULL }
+};
+
+static const ANCSClient::AttributeRequest_t callRequest[] = {
+    { ANCSClient::NotificationAttributeIDTitle,   32, NULL },
+    { ANCSClient::NotificationAttributeIDMessage, 64, NULL },
+    { ANCSClient::NotificationAttributeIDDate,    0,  NULL }
+};
+
+static const ANCSClient::FetchPolicy_t fetchPolicy[] = {
+    { ANCSClient::PolicyCategoryAny,      ANCSClient::EventFlagPreExisting, ANCSClient::EventFlagPreExisting, NULL, 0 },
+    { ANCSClient::CategoryIDSocial,       0, 0, socialRequest, 1 },
+    { ANCSClient::CategoryIDIncomingCall, 0, 0, callRequest,   3 }
+};
+
+extern SimulatedClient ancs;
+
+void onRequestCompleteTask(ANCSClient::RequestComplete_t complete);
+
+static uint32_t writesBefore = 0;
+
+static void setupPolicy()
+{
+    writesBefore = ancs.getWrites();
+    ancs.setFetchPolicy(fetchPolicy, sizeof(fetchPolicy) / sizeof(ANCSClient::FetchPolicy_t), onRequestCompleteTask);
+}
+
+static bool checkPolicy()
+{
+    return (ancs.getWrites() - writesBefore == 2);
+}
+
+/*
+    More prefetches than the request queue holds. The rest are held back and
+    written as responses complete.
+*/
+static void buildBacklog(NotificationProvider& provider)
+{
+    provider.setMTU(185);
+    provider.connect();
+
+    for (uint32_t uid = 70; uid < 76; uid++)
+    {
+        provider.notification(ANCSClient::EventIDNotificationAdded, 0, ANCSClient::CategoryIDSocial, 1, uid);
+    }
+
+    for (uint32_t uid = 70; uid < 76; uid++)
+    {
+        provider.response(uid, socialAttributes, 1);
+    }
+}
+
+static const Event_t expectedBacklog[] = {
+    { 2,  EventNotification, 70, 0, 0 },
+    { 3,  EventNotification, 71, 0, 0 },
+    { 4,  EventNotification, 72, 0, 0 },
+    { 5,  EventNotification, 73, 0, 0 },
+    { 6,  EventNotification, 74, 0, 0 },
+    { 7,  EventNotification, 75, 0, 0 },
+    { 8,  EventAttribute,    70, ANCSClient::NotificationAttributeIDTitle, 5 },
+    { 8,  EventComplete,     70, ANCSClient::RequestStatusSuccess, 1 },
+    { 9,  EventAttribute,    71, ANCSClient::NotificationAttributeIDTitle, 5 },
+    { 9,  EventComplete,     71, ANCSClient::RequestStatusSuccess, 1 },
+    { 10, EventAttribute,    72, ANCSClient::NotificationAttributeIDTitle, 5 },
+    { 10, EventComplete,     72, ANCSClient::RequestStatusSuccess, 1 },
+    { 11, EventAttribute,    73, ANCSClient::NotificationAttributeIDTitle, 5 },
+    { 11, EventComplete,     73, ANCSClient::RequestStatusSuccess, 1 },
+    { 12, EventAttribute,    74, ANCSClient::NotificationAttributeIDTitle, 5 },
+    { 12, EventComplete,     74, ANCSClient::RequestStatusSuccess, 1 },
+    { 13, EventAttribute,    75, ANCSClient::NotificationAttributeIDTitle, 5 },
+    { 13, EventComplete,     75, ANCSClient::RequestStatusSuccess, 1 }
+};
+
+static bool checkBacklog()
+{
+    return (ancs.getWrites() - writesBefore == 6);
+}
+
+/*
+    Reconnection flood: pre-existing notifications, and a notification that
+    is added, modified, and removed again, all within one window. One batch
+    is delivered with the live notification first.
+*/
+#define COALESCE_WINDOW_MS 10
+
+static void buildCoalesce(NotificationProvider& provider)
+{
+    provider.connect();
+    provider.notification(ANCSClient::EventIDNotificationAdded, ANCSClient::EventFlagPreExisting, ANCSClient::CategoryIDEmail, 1, 80);
+    provider.notification(ANCSClient::EventIDNotificationAdded, ANCSClient::EventFlagPreExisting, ANCSClient::CategoryIDEmail, 2, 81);
+    provider.notification(ANCSClient::EventIDNotificationAdded, 0, ANCSClient::CategoryIDSocial, 1, 82);
+    provider.notification(ANCSClient::EventIDNotificationAdded, 0, ANCSClient::CategoryIDSocial, 2, 83);
+    provider.notification(ANCSClient::EventIDNotificationModified, ANCSClient::EventFlagImportant, ANCSClient::CategoryIDSocial, 2, 83);
+    provider.notification(ANCSClient::EventIDNotificationRemoved, 0, ANCSClient::CategoryIDSocial, 1, 82);
+}
+
+static const Event_t expectedCoalesce[] = {
+    { 7, EventBatch,        3,  6, 0 },
+    { 7, EventNotification, 83, 0, 0 },
+    { 7, EventNotification, 80, 0, 0 },
+    { 7, EventNotification, 81, 0, 0 }
+};
+
+static void setupCoalesce()
+{
+    ancs.setCoalescing(COALESCE_WINDOW_MS, ANCS_CLIENT_COALESCE_SIZE, true);
+}
+
+/*
+    Batches limited to two events in a long window. The first batch is
+    delivered when it is full, and the window restarts with the next event
+    instead of cutting the second batch short.
+*/
+static void buildWindow(NotificationProvider& provider)
+{
+    provider.connect();
+    provider.setInterval(10);
+    provider.notification(ANCSClient::EventIDNotificationAdded, 0, ANCSClient::CategoryIDSocial, 1, 84);
+    provider.notification(ANCSClient::EventIDNotificationAdded, 0, ANCSClient::CategoryIDSocial, 1, 85);
+    provider.notification(ANCSClient::EventIDNotificationAdded, 0, ANCSClient::CategoryIDSocial, 1, 86);
+    provider.setInterval(90);
+    provider.notification(ANCSClient::EventIDNotificationAdded, 0, ANCSClient::CategoryIDSocial, 1, 87);
+}
+
+static const Event_t expectedWindow[] = {
+    { 3, EventBatch,        2,  2, 0 },
+    { 3, EventNotification, 84, 0, 0 },
+    { 3, EventNotification, 85, 0, 0 },
+    { 5, EventBatch,        2,  2, 0 },
+    { 5, EventNotification, 86, 0, 0 },
+    { 5, EventNotification, 87, 0, 0 }
+};
+
+static void setupWindow()
+{
+    ancs.setCoalescing(100, 2);
+}
+
+/*
+    Three phones connected at once, each answering its own request. The
+    Data Source fragments of the three responses are interleaved, so every
+    session has to reassemble its response on its own. Notification UIDs
+    are 100 for the first phone, 200 for the second, and 300 for the third.
+*/
+static const uint32_t multipeerUIDs[SIM_PEERS] = { 100, 200, 300 };
+
+static void buildMultipeer(NotificationProvider& provider)
+{
+    provider.setMTU(23);
+
+    for (uint8_t peer = 0; peer < SIM_PEERS; peer++)
+    {
+        provider.selectPeer(peer);
+        provider.connect();
+    }
+
+    for (uint8_t peer = 0; peer < SIM_PEERS; peer++)
+    {
+        provider.selectPeer(peer);
+        provider.notification(ANCSClient::EventIDNotificationAdded, 0, ANCSClient::CategoryIDSocial, 1, multipeerUIDs[peer]);
+    }
+
+    for (uint8_t peer = 0; peer < SIM_PEERS; peer++)
+    {
+        provider.selectPeer(peer);
+        provider.request(multipeerUIDs[peer]);
+    }
+
+    provider.interleavedResponse(multipeerUIDs, SIM_PEERS, shortAttributes, 3);
+}
+
+static const Event_t expectedMultipeer[] = {
+    { 8,  EventNotification, 100, 0, 0 },
+    { 10, EventNotification, 200, 0, 0 },
+    { 12, EventNotification, 300, 0, 0 },
+    { 20, EventAttribute,    100, ANCSClient::NotificationAttributeIDTitle,    5 },
+    { 20, EventAttribute,    100, ANCSClient::NotificationAttributeIDSubtitle, 0 },
+    { 22, EventAttribute,    200, ANCSClient::NotificationAttributeIDTitle,    5 },
+    { 22, EventAttribute,    200, ANCSClient::NotificationAttributeIDSubtitle, 0 },
+    { 24, EventAttribute,    300, ANCSClient::NotificationAttributeIDTitle,    5 },
+    { 24, EventAttribute,    300, ANCSClient::NotificationAttributeIDSubtitle, 0 },
+    { 38, EventAttribute,    100, ANCSClient::NotificationAttributeIDMessage,  51 },
+    { 38, EventComplete,     100, ANCSClient::RequestStatusSuccess, 3 },
+    { 40, EventAttribute,    200, ANCSClient::NotificationAttributeIDMessage,  51 },
+    { 40, EventComplete,     200, ANCSClient::RequestStatusSuccess, 3 },
+    { 42, EventAttribute,    300, ANCSClient::NotificationAttributeIDMessage,  51 },
+    { 42, EventComplete,     300, ANCSClient::RequestStatusSuccess, 3 }
+};
+
+static bool checkMultipeer();
+
+/*
+    First connection. The Data Source CCCD does not follow its value, so it
+    is found with descriptor discovery; the Notification Source CCCD is the
+    only handle in its characteristic and needs no discovery. Both CCCDs are
+    written with response, and the ready signal comes once both writes are
+    confirmed.
+*/
+static void buildSubscribe(NotificationProvider& provider)
+{
+    provider.connect();
+    provider.notification(ANCSClient::EventIDNotificationAdded, 0, ANCSClient::CategoryIDSocial, 1, 95);
+}
+
+static const Event_t expectedSubscribe[] = {
+    { 2, EventNotification, 95, 0, 0 }
+};
+
+static uint8_t servicesFound = 0;
+static uint32_t descriptorWritesBefore = 0;
+static uint32_t descriptorDiscoveriesBefore = 0;
+
+static void setupSubscribe()
+{
+    descriptorWritesBefore = ancs.getDescriptorWrites();
+    descriptorDiscoveriesBefore = ancs.getDescriptorDiscoveries();
+    servicesFound = 0;
+}
+
+static bool checkSubscribe()
+{
+    return ancs.isReady()
+        && (servicesFound == 1)
+        && (ancs.getDescriptorDiscoveries() - descriptorDiscoveriesBefore == 1)
+        && (ancs.getDescriptorWrites() - descriptorWritesBefore == 2)
+        && (ancs.getDescriptorWrite(1) == SIM_DATA_SOURCE_CCCD)
+        && (ancs.getDescriptorWrite(0) == SIM_NOTIFICATION_SOURCE + 1);
+}
+
+/*
+    Connection parameter negotiation: fast parameters while the request is
+    pending, idle parameters once nothing has been requested for a while.
+    The trailing notification only lets the idle delay pass.
+*/
+static void buildLinkParams(NotificationProvider& provider)
+{
+    buildMTU23(provider);
+    provider.setInterval(1000);
+    provider.notification(ANCSClient::EventIDNotificationAdded, 0, ANCSClient::CategoryIDEmail, 1, 11);
+}
+
+static const Event_t expectedLinkParams[] = {
+    { 2, EventNotification, 10, 0, 0 },
+    { 4, EventAttribute,    10, ANCSClient::NotificationAttributeIDTitle,    5 },
+    { 4, EventAttribute,    10, ANCSClient::NotificationAttributeIDSubtitle, 0 },
+    { 7, EventAttribute,    10, ANCSClient::NotificationAttributeIDMessage,  51 },
+    { 7, EventComplete,     10, ANCSClient::RequestStatusSuccess, 3 },
+    { 8, EventNotification, 11, 0, 0 }
+};
+
+static uint32_t parameterUpdatesBefore = 0;
+
+static void setupLinkParams()
+{
+    parameterUpdatesBefore = ancs.getParameterUpdates();
+    ancs.setConnectionParams(&ANCSClient::FastConnectionParams, &ANCSClient::IdleConnectionParams, 500);
+    ancs.resetLinkStatistics();
+}
+
+static bool checkLinkParams()
+{
+    ANCSClient::LinkStatistics_t statistics = ancs.getLinkStatistics();
+
+    return (ancs.getParameterUpdates() - parameterUpdatesBefore == 2)
+        && (ancs.getLastParameters().minConnectionInterval == ANCS_CLIENT_IDLE_INTERVAL_MIN)
+        && (statistics.mode == ANCSClient::LinkModeIdle)
+        && (statistics.updateRequests == 2)
+        && (statistics.updateFailures == 0)
+        && (statistics.transfers == 1)
+        && (statistics.maxPayload == 20)
+        && (statistics.lastTransferTicks > 0)
+        && (statistics.lastTransferTicks == statistics.totalTransferTicks)
+        && (statistics.fastTicks >= statistics.lastTransferTicks);
+}
+
+/*
+    Incoming call accepted, then declined. Actions go through the request
+    queue and complete once written, as the phone's outcome is not known.
+*/
+static void buildAction(NotificationProvider& provider)
+{
+    provider.connect();
+    provider.notification(ANCSClient::EventIDNotificationAdded,
+                          ANCSClient::EventFlagPositiveAction | ANCSClient::EventFlagNegativeAction,
+                          ANCSClient::CategoryIDIncomingCall, 1, 96);
+    provider.action(96, ANCSClient::ActionIDPositive);
+    provider.action(96, ANCSClient::ActionIDNegative);
+}
+
+static const Event_t expectedAction[] = {
+    { 2, EventNotification, 96, 0, 0 },
+    { 3, EventAction,       96, ANCSClient::RequestStatusSent, 0 },
+    { 4, EventAction,       96, ANCSClient::RequestStatusSent, 0 }
+};
+
+static uint32_t actionWritesBefore = 0;
+
+static void setupAction()
+{
+    actionWritesBefore = ancs.getWrites();
+    ancs.resetLinkStatistics();
+}
+
+static bool checkAction()
+{
+    // out of range actions never reach the Control Point
+    return (ancs.performNotificationAction(96, (ANCSClient::action_id_t) 2) == BLE_ERROR_INVALID_PARAM)
+        && (ancs.getWrites() - actionWritesBefore == 2)
+        && (ancs.getLinkStatistics().transfers == 0);
+}
+
+/*
+    Rest of a response lost while the link stays up. The request times out,
+    its partial attribute is dropped, and the next response is parsed from
+    its header instead of as a continuation.
+*/
+static void buildTimeout(NotificationProvider& provider)
+{
+    provider.setMTU(23);
+    provider.connect();
+    provider.request(60);
+    provider.setTruncateAfter(2);
+    provider.response(60, longAttributes, 3);
+    provider.setInterval(1000);
+    provider.request(61);
+    provider.setInterval(10);
+    provider.response(61, shortAttributes, 3);
+}
+
+static const Event_t expectedTimeout[] = {
+    { 3, EventAttribute,    60, ANCSClient::NotificationAttributeIDTitle,    5 },
+    { 4, EventAttribute,    60, ANCSClient::NotificationAttributeIDSubtitle, 9 },
+    { 4, EventComplete,     60, ANCSClient::RequestStatusTimeout, 2 },
+    { 6, EventAttribute,    61, ANCSClient::NotificationAttributeIDTitle,    5 },
+    { 6, EventAttribute,    61, ANCSClient::NotificationAttributeIDSubtitle, 0 },
+    { 9, EventAttribute,    61, ANCSClient::NotificationAttributeIDMessage,  51 },
+    { 9, EventComplete,     61, ANCSClient::RequestStatusSuccess, 3 }
+};
+
+static void setupTimeout()
+{
+    ancs.setRequestTimeout(300);
+}
+
+/*
+    The phone answers a timed out request after it has been sent again. The
+    late response comes first and is skipped whole, by the attribute count
+    of the request, instead of being taken for the new request; the values
+    delivered are those of the second response.
+*/
+static void buildLate(NotificationProvider& provider)
+{
+    provider.setMTU(23);
+    provider.connect();
+    provider.request(62);
+    provider.setInterval(1000);
+    provider.request(62);
+    provider.setInterval(10);
+    provider.response(62, longAttributes, 3);
+    provider.response(62, shortAttributes, 3);
+}
+
+static const Event_t expectedLate[] = {
+    { 2,  EventComplete,    62, ANCSClient::RequestStatusTimeout, 0 },
+    { 11, EventAttribute,   62, ANCSClient::NotificationAttributeIDTitle,    5 },
+    { 11, EventAttribute,   62, ANCSClient::NotificationAttributeIDSubtitle, 0 },
+    { 14, EventAttribute,   62, ANCSClient::NotificationAttributeIDMessage,  51 },
+    { 14, EventComplete,    62, ANCSClient::RequestStatusSuccess, 3 }
+};
+
+// priority of refreshes sent by the scenario
+static ANCSClient::priority_t refreshPriority = ANCSClient::PriorityNormal;
+
+#if ANCS_CLIENT_REFRESH_CACHE_SIZE > 0
+/*
+    Incremental refresh of a notification modified twice. Message Size and
+    Date are probed each time; the attributes are fetched for the unknown
+    notification and after the message has grown, but not in between.
+*/
+static const Attribute_t probeAttributes[] = {
+    { ANCSClient::NotificationAttributeIDMessageSize, "51" },
+    { ANCSClient::NotificationAttributeIDDate,        "20261016T101500" }
+};
+
+static const Attribute_t grownProbeAttributes[] = {
+    { ANCSClient::NotificationAttributeIDMessageSize, "102" },
+    { ANCSClient::NotificationAttributeIDDate,        "20261016T101500" }
+};
+
+static void buildRefresh(NotificationProvider& provider)
+{
+    provider.setMTU(185);
+    provider.connect();
+    provider.notification(ANCSClient::EventIDNotificationAdded, 0, ANCSClient::CategoryIDSocial, 1, 70);
+    provider.refresh(70);
+    provider.response(70, probeAttributes, 2);
+    provider.response(70, shortAttributes, 3);
+    provider.notification(ANCSClient::EventIDNotificationModified, 0, ANCSClient::CategoryIDSocial, 1, 70);
+    provider.refresh(70);
+    provider.response(70, probeAttributes, 2);
+    provider.notification(ANCSClient::EventIDNotificationModified, 0, ANCSClient::CategoryIDSocial, 1, 70);
+    provider.refresh(70);
+    provider.response(70, grownProbeAttributes, 2);
+    provider.response(70, longAttributes, 3);
+}
+
+static const Event_t expectedRefresh[] = {
+    { 2,  EventNotification, 70, 0, 0 },
+    { 5,  EventAttribute,    70, ANCSClient::NotificationAttributeIDTitle,    5 },
+    { 5,  EventAttribute,    70, ANCSClient::NotificationAttributeIDSubtitle, 0 },
+    { 5,  EventAttribute,    70, ANCSClient::NotificationAttributeIDMessage,  51 },
+    { 5,  EventComplete,     70, ANCSClient::RequestStatusSuccess, 3 },
+    { 8,  EventComplete,     70, ANCSClient::RequestStatusUnchanged, 0 },
+    { 12, EventAttribute,    70, ANCSClient::NotificationAttributeIDTitle,    5 },
+    { 12, EventAttribute,    70, ANCSClient::NotificationAttributeIDSubtitle, 9 },
+    { 12, EventAttribute,    70, ANCSClient::NotificationAttributeIDMessage,  102 },
+    { 12, EventComplete,     70, ANCSClient::RequestStatusSuccess, 3 }
+};
+
+static uint32_t refreshWritesBefore = 0;
+static ANCSClient::RefreshStatistics_t refreshBefore;
+
+static void setupRefresh()
+{
+    refreshWritesBefore = ancs.getWrites();
+    refreshBefore = ancs.getRefreshStatistics();
+    ancs.resetLinkStatistics();
+}
+
+static bool checkRefresh()
+{
+    ANCSClient::RefreshStatistics_t statistics = ancs.getRefreshStatistics();
+
+    // Title, Subtitle, and Message against Message Size and Date
+    uint32_t saved = (3 + 5) + (3 + 0) + (3 + 51) - (3 + 2) - (3 + 15);
+
+    // probes are not counted as transfers
+    return (ancs.getWrites() - refreshWritesBefore == 5)
+        && (ancs.getLinkStatistics().transfers == 2)
+        && (statistics.probes - refreshBefore.probes == 3)
+        && (statistics.fetches - refreshBefore.fetches == 2)
+        && (statistics.skipped - refreshBefore.skipped == 1)
+        && (statistics.bytesSaved - refreshBefore.bytesSaved == saved);
+}
+
+#if (ANCS_CLIENT_POOL_BLOCKS == 0) || (ANCS_CLIENT_POOL_BLOCKS >= 12)
+/*
+    Low priority refresh while the queue is full. The probe's slot is the
+    only one a low priority request may take, and the fetch takes it over
+    and is sent after the requests queued behind the probe. A smaller pool
+    refuses some of the requests.
+*/
+static void buildRefreshFull(NotificationProvider& provider)
+{
+    provider.setMTU(185);
+    provider.connect();
+    provider.refresh(71);
+    provider.request(72);
+    provider.request(73);
+    provider.request(74);
+    provider.response(71, probeAttributes, 2);
+    provider.response(72, shortAttributes, 3);
+    provider.response(73, shortAttributes, 3);
+    provider.response(74, shortAttributes, 3);
+    provider.response(71, longAttributes, 3);
+}
+
+static const Event_t expectedRefreshFull[] = {
+    { 7,  EventAttribute,    72, ANCSClient::NotificationAttributeIDTitle,    5 },
+    { 7,  EventAttribute,    72, ANCSClient::NotificationAttributeIDSubtitle, 0 },
+    { 7,  EventAttribute,    72, ANCSClient::NotificationAttributeIDMessage,  51 },
+    { 7,  EventComplete,     72, ANCSClient::RequestStatusSuccess, 3 },
+    { 8,  EventAttribute,    73, ANCSClient::NotificationAttributeIDTitle,    5 },
+    { 8,  EventAttribute,    73, ANCSClient::NotificationAttributeIDSubtitle, 0 },
+    { 8,  EventAttribute,    73, ANCSClient::NotificationAttributeIDMessage,  51 },
+    { 8,  EventComplete,     73, ANCSClient::RequestStatusSuccess, 3 },
+    { 9,  EventAttribute,    74, ANCSClient::NotificationAttributeIDTitle,    5 },
+    { 9,  EventAttribute,    74, ANCSClient::NotificationAttributeIDSubtitle, 0 },
+    { 9,  EventAttribute,    74, ANCSClient::NotificationAttributeIDMessage,  51 },
+    { 9,  EventComplete,     74, ANCSClient::RequestStatusSuccess, 3 },
+    { 10, EventAttribute,    71, ANCSClient::NotificationAttributeIDTitle,    5 },
+    { 10, EventAttribute,    71, ANCSClient::NotificationAttributeIDSubtitle, 9 },
+    { 10, EventAttribute,    71, ANCSClient::NotificationAttributeIDMessage,  102 },
+    { 10, EventComplete,     71, ANCSClient::RequestStatusSuccess, 3 }
+};
+
+static void setupRefreshFull()
+{
+    refreshPriority = ANCSClient::PriorityLow;
+}
+#endif
+#endif
+
+#if (ANCS_CLIENT_LOW_PRIORITY_IN_FLIGHT == 1) && ((ANCS_CLIENT_POOL_BLOCKS == 0) || (ANCS_CLIENT_POOL_BLOCKS >= 6))
+/*
+    Incoming call during the burst of pre-existing notifications after
+    connecting. Only one pre-existing prefetch is written at a time and
+    they leave a queue slot free, so the call is written at once and
+    answered right after the response in progress; the last pre-existing
+    prefetch waits in the backlog. A smaller pool refuses some prefetches.
+*/
+static void buildPriority(NotificationProvider& provider)
+{
+    provider.setMTU(185);
+    provider.connect();
+
+    for (uint32_t uid = 90; uid < 94; uid++)
+    {
+        provider.notification(ANCSClient::EventIDNotificationAdded, ANCSClient::EventFlagPreExisting, ANCSClient::CategoryIDSocial, 1, uid);
+    }
+
+    provider.notification(ANCSClient::EventIDNotificationAdded, 0, ANCSClient::CategoryIDIncomingCall, 1, 94);
+    provider.response(90, socialAttributes, 1);
+    provider.response(94, callAttributes, 3);
+
+    for (uint32_t uid = 91; uid < 94; uid++)
+    {
+        provider.response(uid, socialAttributes, 1);
+    }
+}
+
+static const Event_t expectedPriority[] = {
+    { 2,  EventNotification, 90, 0, 0 },
+    { 3,  EventNotification, 91, 0, 0 },
+    { 4,  EventNotification, 92, 0, 0 },
+    { 5,  EventNotification, 93, 0, 0 },
+    { 6,  EventNotification, 94, 0, 0 },
+    { 7,  EventAttribute,    90, ANCSClient::NotificationAttributeIDTitle,   5 },
+    { 7,  EventComplete,     90, ANCSClient::RequestStatusSuccess, 1 },
+    { 8,  EventAttribute,    94, ANCSClient::NotificationAttributeIDTitle,   3 },
+    { 8,  EventAttribute,    94, ANCSClient::NotificationAttributeIDMessage, 13 },
+    { 8,  EventAttribute,    94, ANCSClient::NotificationAttributeIDDate,    15 },
+    { 8,  EventComplete,     94, ANCSClient::RequestStatusSuccess, 3 },
+    { 9,  EventAttribute,    91, ANCSClient::NotificationAttributeIDTitle,   5 },
+    { 9,  EventComplete,     91, ANCSClient::RequestStatusSuccess, 1 },
+    { 10, EventAttribute,    92, ANCSClient::NotificationAttributeIDTitle,   5 },
+    { 10, EventComplete,     92, ANCSClient::RequestStatusSuccess, 1 },
+    { 11, EventAttribute,    93, ANCSClient::NotificationAttributeIDTitle,   5 },
+    { 11, EventComplete,     93, ANCSClient::RequestStatusSuccess, 1 }
+};
+
+static const ANCSClient::FetchPolicy_t priorityPolicy[] = {
+    { ANCSClient::CategoryIDSocial,       0, 0, socialRequest, 1 },
+    { ANCSClient::CategoryIDIncomingCall, 0, 0, callRequest,   3 }
+};
+
+static void setupPriority()
+{
+    writesBefore = ancs.getWrites();
+    ancs.setFetchPolicy(priorityPolicy, sizeof(priorityPolicy) / sizeof(ANCSClient::FetchPolicy_t), onRequestCompleteTask);
+}
+
+static bool checkPriority()
+{
+    ANCSClient::Notification_t call = { 0, ANCSClient::EventFlagPreExisting, ANCSClient::CategoryIDIncomingCall, 1, 1, 0 };
+    ANCSClient::Notification_t important = { 0, ANCSClient::EventFlagImportant, ANCSClient::CategoryIDSocial, 1, 1, 0 };
+    ANCSClient::Notification_t old = { 0, ANCSClient::EventFlagImportant | ANCSClient::EventFlagPreExisting, ANCSClient::CategoryIDSocial, 1, 1, 0 };
+    ANCSClient::Notification_t email = { 0, 0, ANCSClient::CategoryIDEmail, 1, 1, 0 };
+
+    return (ancs.getWrites() - writesBefore == 5)
+        && (ANCSClient::getPriority(call) == ANCSClient::PriorityHigh)
+        && (ANCSClient::getPriority(important) == ANCSClient::PriorityHigh)
+        && (ANCSClient::getPriority(old) == ANCSClient::PriorityLow)
+        && (ANCSClient::getPriority(email) == ANCSClient::PriorityNormal);
+}
+#endif
+
+/*
+    Typed decoding at the default MTU, where the Date is split between two
+    fragments. The title was cut by the phone inside a two-byte character,
+    which is trimmed off. The second response has a malformed Message Size
+    and a month out of range.
+*/
+static const Attribute_t typedAttributes[] = {
+    { ANCSClient::NotificationAttributeIDTitle,       "Caf\xC3" },
+    { ANCSClient::NotificationAttributeIDMessageSize, "51" },
+    { ANCSClient::NotificationAttributeIDDate,        "20261016T101500" }
+};
+
+static const Attribute_t malformedAttributes[] = {
+    { ANCSClient::NotificationAttributeIDTitle,       "Caf\xC3\xA9" },
+    { ANCSClient::NotificationAttributeIDMessageSize, "5x" },
+    { ANCSClient::NotificationAttributeIDDate,        "20261316T101500" }
+};
+
+static const ANCSClient::AttributeRequest_t typedRequest[] = {
+    { ANCSClient::NotificationAttributeIDTitle,       4, NULL },
+    { ANCSClient::NotificationAttributeIDMessageSize, 0, NULL },
+    { ANCSClient::NotificationAttributeIDDate,        0, NULL }
+};
+
+static void buildDecoded(NotificationProvider& provider)
+{
+    provider.setMTU(23);
+    provider.connect();
+    provider.notification(ANCSClient::EventIDNotificationAdded, 0, ANCSClient::CategoryIDEmail, 1, 80);
+    provider.request(80);
+    provider.response(80, typedAttributes, 3);
+    provider.notification(ANCSClient::EventIDNotificationAdded, 0, ANCSClient::CategoryIDEmail, 1, 81);
+    provider.request(81);
+    provider.response(81, malformedAttributes, 3);
+}
+
+static const Event_t expectedDecoded[] = {
+    { 2, EventNotification, 80, 0, 0 },
+    { 4, EventDecoded,      80, ANCSClient::NotificationAttributeIDTitle,       3 },
+    { 4, EventAttribute,    80, ANCSClient::NotificationAttributeIDTitle,       4 },
+    { 4, EventDecoded,      80, ANCSClient::NotificationAttributeIDMessageSize, 1 },
+    { 4, EventAttribute,    80, ANCSClient::NotificationAttributeIDMessageSize, 2 },
+    { 5, EventDecoded,      80, ANCSClient::NotificationAttributeIDDate,        1 },
+    { 5, EventAttribute,    80, ANCSClient::NotificationAttributeIDDate,        15 },
+    { 5, EventComplete,     80, ANCSClient::RequestStatusSuccess, 3 },
+    { 6, EventNotification, 81, 0, 0 },
+    { 8, EventDecoded,      81, ANCSClient::NotificationAttributeIDTitle,       5 },
+    { 8, EventAttribute,    81, ANCSClient::NotificationAttributeIDTitle,       5 },
+    { 8, EventDecoded,      81, ANCSClient::NotificationAttributeIDMessageSize, 0 },
+    { 8, EventAttribute,    81, ANCSClient::NotificationAttributeIDMessageSize, 2 },
+    { 9, EventDecoded,      81, ANCSClient::NotificationAttributeIDDate,        0 },
+    { 9, EventAttribute,    81, ANCSClient::NotificationAttributeIDDate,        15 },
+    { 9, EventComplete,     81, ANCSClient::RequestStatusSuccess, 3 }
+};
+
+void onDecodedAttributeTask(ANCSClient::DecodedAttribute_t decoded);
+
+// values of the first response, by attribute ID
+static uint32_t decodedValues[ANCSClient::NotificationAttributeIDNegativeActionLabel + 1];
+
+static void setupDecoded()
+{
+    memset(decodedValues, 0, sizeof(decodedValues));
+    ANCSDispatcher::registerDecodedAttributeHandlerTask(onDecodedAttributeTask);
+}
+
+static bool checkDecoded()
+{
+    // 2026-10-16 10:15:00
+    return (decodedValues[ANCSClient::NotificationAttributeIDMessageSize] == 51)
+        && (decodedValues[ANCSClient::NotificationAttributeIDDate] == 1792145700UL);
+}
+
+/*
+    CBOR export at the default MTU. The prefetched email is exported with
+    its category, and the euro sign in its title is split between two
+    fragments. The response to the direct request has an attribute that
+    was not asked for, so its map is aborted.
+*/
+static const Attribute_t exportAttributes[] = {
+    { ANCSClient::NotificationAttributeIDTitle,       "Price: 120 \xE2\x82\xAC" },
+    { ANCSClient::NotificationAttributeIDMessageSize, "51" },
+    { ANCSClient::NotificationAttributeIDDate,        "20261016T101500" }
+};
+
+static const ANCSClient::AttributeRequest_t exportRequest[] = {
+    { ANCSClient::NotificationAttributeIDTitle,       32, NULL },
+    { ANCSClient::NotificationAttributeIDMessageSize, 0, NULL },
+    { ANCSClient::NotificationAttributeIDDate,        0, NULL }
+};
+
+static const ANCSClient::FetchPolicy_t exportPolicy[] = {
+    { ANCSClient::CategoryIDEmail, 0, 0, exportRequest, 3 }
+};
+
+static void buildExport(NotificationProvider& provider)
+{
+    provider.setMTU(23);
+    provider.connect();
+    provider.notification(ANCSClient::EventIDNotificationAdded, 0, ANCSClient::CategoryIDEmail, 1, 85);
+    provider.response(85, exportAttributes, 3);
+    provider.notification(ANCSClient::EventIDNotificationAdded, 0, ANCSClient::CategoryIDSocial, 1, 86);
+    provider.request(86);
+    provider.response(86, shortAttributes, 3);
+}
+
+static const Event_t expectedExport[] = {
+    { 2, EventNotification, 85, 0, 0 },
+    { 5, EventExport,       85, ANCSCborExport::ChunkEnd, 38 },
+    { 5, EventComplete,     85, ANCSClient::RequestStatusSuccess, 3 },
+    { 6, EventNotification, 86, 0, 0 },
+    { 8, EventExport,       86, ANCSCborExport::ChunkAborted, 0 },
+    { 8, EventComplete,     86, ANCSClient::RequestStatusMismatch, 1 }
+};
+
+// {0: 85, 1: Email, 2: 0, 3: {1: "Price: 120 " "\xE2\x82\xAC", 4: 51, 5: 1792145700}}
+static const uint8_t expectedExportMap[] = {
+    0xA4, 0x00, 0x18, 0x55, 0x01, 0x06, 0x02, 0x00, 0x03, 0xA3,
+    0x01, 0x7F, 0x6B, 'P', 'r', 'i', 'c', 'e', ':', ' ', '1', '2', '0', ' ',
+    0x63, 0xE2, 0x82, 0xAC, 0xFF,
+    0x04, 0x18, 0x33,
+    0x05, 0x1A, 0x6A, 0xD1, 0xF9, 0x24
+};
+
+void onExportChunk(const ANCSClient::ExportChunk_t* chunk);
+
+static uint8_t exportBuffer[64];
+static uint16_t exportLength = 0;
+static bool exportMatched = false;
+
+static void setupExport()
+{
+    exportLength = 0;
+    exportMatched = false;
+    ancs.registerExportSink(onExportChunk);
+    ancs.setFetchPolicy(exportPolicy, sizeof(exportPolicy) / sizeof(ANCSClient::FetchPolicy_t), onRequestCompleteTask);
+}
+
+static bool checkExport()
+{
+    return exportMatched;
+}
+
+/*
+    Instrumentation of a connection, a silent event, and a response over
+    several fragments.
+*/
+static void buildStatistics(NotificationProvider& provider)
+{
+    provider.setMTU(23);
+    provider.connect();
+    provider.notification(ANCSClient::EventIDNotificationAdded, ANCSClient::EventFlagSilent, ANCSClient::CategoryIDNews, 1, 12);
+    provider.notification(ANCSClient::EventIDNotificationAdded, 0, ANCSClient::CategoryIDEmail, 1, 10);
+    provider.request(10);
+    provider.response(10, shortAttributes, 3);
+}
+
+static const Event_t expectedStatistics[] = {
+    { 3, EventNotification, 10, 0, 0 },
+    { 5, EventAttribute,    10, ANCSClient::NotificationAttributeIDTitle,    5 },
+    { 5, EventAttribute,    10, ANCSClient::NotificationAttributeIDSubtitle, 0 },
+    { 8, EventAttribute,    10, ANCSClient::NotificationAttributeIDMessage,  51 },
+    { 8, EventComplete,     10, ANCSClient::RequestStatusSuccess, 3 }
+};
+
+static void setupStatistics()
+{
+    ancs.resetStatistics();
+    ancs.resetLinkStatistics();
+}
+
+static bool checkStatistics()
+{
+#if ANCS_CLIENT_INSTRUMENTATION
+    ANCSClient::Statistics_t statistics = ancs.getStatistics();
+    const ANCSClient::StageTiming_t& firstFragment = statistics.requestStages[ANCSClient::RequestStageFirstFragment];
+    const ANCSClient::StageTiming_t& lastFragment = statistics.requestStages[ANCSClient::RequestStageLastFragment];
+    uint8_t snapshot[ANCSClient::StatisticsSnapshotLength];
+    uint32_t snapshotLength = ancs.getStatisticsSnapshot(snapshot, sizeof(snapshot));
+
+    return (statistics.setupReached == (1 << ANCSClient::SetupStageCount) - 1)
+        && (statistics.setupTicks[ANCSClient::SetupStageSubscribed] >= statistics.setupTicks[ANCSClient::SetupStageLinkSecured])
+        && (statistics.notifications == 2)
+        && (statistics.silentEvents == 1)
+        && (statistics.fragments == 4)
+        && (statistics.bytesReceived == 2 * 8 + ancs.getLinkStatistics().transferBytes)
+        && (statistics.droppedEvents == 0)
+        && (statistics.droppedResponses == 0)
+        && (statistics.allocationFailures == 0)
+        && (firstFragment.count == 1)
+        && (firstFragment.lastTicks > 0)
+        && (lastFragment.lastTicks > 0)
+        && (firstFragment.lastTicks + lastFragment.lastTicks <= ancs.getLinkStatistics().lastTransferTicks)
+        && (snapshotLength > 0)
+        && (snapshotLength <= sizeof(snapshot))
+        && (snapshot[0] == 0xAC)    // map of 12
+        && (ancs.getStatisticsSnapshot(snapshot, sizeof(snapshot) - 1) == 0);
+#else
+    return (ancs.getStatistics().notifications == 0)
+        && (ancs.getStatisticsSnapshot(NULL, 0) == 0);
+#endif
+}
+
+#if ANCS_CLIENT_HANDLE_CACHE_SIZE > 0
+/*
+    Bonded phone reconnecting. Its GATT handles come from the cache and are
+    confirmed by reading back the three characteristic declarations
+    instead of a new discovery.
+*/
+static void buildBonded(NotificationProvider& provider)
+{
+    provider.setMTU(185);
+    provider.connect();
+    provider.notification(ANCSClient::EventIDNotificationAdded, 0, ANCSClient::CategoryIDSocial, 1, 90);
+    provider.disconnect();
+    provider.reconnect();
+    provider.notification(ANCSClient::EventIDNotificationAdded, 0, ANCSClient::CategoryIDSocial, 1, 91);
+    provider.request(91);
+    provider.response(91, shortAttributes, 3);
+}
+
+static const Event_t expectedBonded[] = {
+    { 2, EventNotification, 90, 0, 0 },
+    { 5, EventNotification, 91, 0, 0 },
+    { 7, EventAttribute,    91, ANCSClient::NotificationAttributeIDTitle,    5 },
+    { 7, EventAttribute,    91, ANCSClient::NotificationAttributeIDSubtitle, 0 },
+    { 7, EventAttribute,    91, ANCSClient::NotificationAttributeIDMessage,  51 },
+    { 7, EventComplete,     91, ANCSClient::RequestStatusSuccess, 3 }
+};
+
+static uint32_t readsBefore = 0;
+
+static void setupBonded()
+{
+    readsBefore = ancs.getReads();
+    servicesFound = 0;
+}
+
+static bool checkBonded()
+{
+    return (ancs.getReads() - readsBefore == 3) && (servicesFound == 2);
+}
+
+/*
+    Phone paired without bonding. The link is encrypted, but the handles
+    are not cached, so the reconnection discovers them again.
+*/
+static uint32_t unbondedDiscoveriesBefore = 0;
+
+static void setupUnbonded()
+{
+    ancs.clearHandleCache();
+    SimulatedPeers::bonding() = false;
+    readsBefore = ancs.getReads();
+    unbondedDiscoveriesBefore = ancs.getServiceDiscoveries();
+    servicesFound = 0;
+}
+
+static bool checkUnbonded()
+{
+    return (ancs.getReads() == readsBefore)
+        && (ancs.getServiceDiscoveries() - unbondedDiscoveriesBefore == 2)
+        && (servicesFound == 2);
+}
+#endif
+
+/*
+    Phone without the ANCS service. Every discovery ends without a result;
+    the client retries with backoff and reports the failure once the budget
+    is spent, well before disconnection.
+*/
+static void buildDiscoveryFail(NotificationProvider& provider)
+{
+    provider.link();
+    provider.setInterval(2000);
+    provider.disconnect();
+}
+
+static const Event_t expectedDiscoveryFail[] = {
+    { 1, EventDiscovery, 0, ANCSClient::DiscoveryStageService, ANCS_CLIENT_DISCOVERY_RETRIES + 1 }
+};
+
+static uint32_t serviceDiscoveriesBefore = 0;
+
+static void setupDiscoveryFail()
+{
+    serviceDiscoveriesBefore = ancs.getServiceDiscoveries();
+}
+
+static bool checkDiscoveryFail()
+{
+    return (ancs.getServiceDiscoveries() - serviceDiscoveriesBefore == ANCS_CLIENT_DISCOVERY_RETRIES + 1);
+}
+
+/*
+    Attributes written straight into caller buffers. The message buffer is
+    shorter than the message, which is truncated. A buffer without room is
+    refused when requested, and so is a request for more attributes than
+    the pool has blocks.
+*/
+static const Event_t expectedCallerBuffer[] = {
+    { 2, EventNotification, 10, 0, 0 },
+    { 4, EventAttribute,    10, ANCSClient::NotificationAttributeIDTitle,    5 },
+    { 4, EventAttribute,    10, ANCSClient::NotificationAttributeIDSubtitle, 0 },
+    { 7, EventAttribute,    10, ANCSClient::NotificationAttributeIDMessage,  16 },
+    { 7, EventComplete,     10, ANCSClient::RequestStatusSuccess, 3 }
+};
+
+static uint8_t titleBuffer[32];
+static uint8_t subtitleBuffer[32];
+static uint8_t messageBuffer[16];
+
+static const ANCSClient::AttributeRequest_t zeroCapacityRequest[] = {
+    { ANCSClient::NotificationAttributeIDTitle, 0, titleBuffer }
+};
+
+#if (ANCS_CLIENT_POOL_BLOCKS > 0) && (ANCS_CLIENT_POOL_BLOCKS < 5)
+static const ANCSClient::AttributeRequest_t poolRequest[] = {
+    { ANCSClient::NotificationAttributeIDTitle,       32, NULL },
+    { ANCSClient::NotificationAttributeIDSubtitle,    32, NULL },
+    { ANCSClient::NotificationAttributeIDMessage,     32, NULL },
+    { ANCSClient::NotificationAttributeIDMessageSize, 0,  NULL },
+    { ANCSClient::NotificationAttributeIDDate,        0,  NULL }
+};
+#endif
+
+static bool checkCallerBuffer()
+{
+#if (ANCS_CLIENT_POOL_BLOCKS > 0) && (ANCS_CLIENT_POOL_BLOCKS < 5)
+    if (ancs.getNotificationAttributes(10, poolRequest, 5) != BLE_ERROR_PARAM_OUT_OF_RANGE)
+    {
+        return false;
+    }
+#endif
+
+    return (ancs.getNotificationAttributes(10, zeroCapacityRequest, 1) == BLE_ERROR_INVALID_PARAM);
+}
+
+static const ANCSClient::AttributeRequest_t defaultRequest[] = {
+    { ANCSClient::NotificationAttributeIDTitle,    255, NULL },
+    { ANCSClient::NotificationAttributeIDSubtitle, 255, NULL },
+    { ANCSClient::NotificationAttributeIDMessage,  255, NULL }
+};
+
+static const ANCSClient::AttributeRequest_t callerBufferRequest[] = {
+    { ANCSClient::NotificationAttributeIDTitle,    sizeof(titleBuffer),    titleBuffer },
+    { ANCSClient::NotificationAttributeIDSubtitle, sizeof(subtitleBuffer), subtitleBuffer },
+    { ANCSClient::NotificationAttributeIDMessage,  sizeof(messageBuffer),  messageBuffer }
+};
+
+#define EVENTS(x) x, sizeof(x) / sizeof(Event_t)
+
+static const Scenario_t scenarios[] = {
+    { "burst",        buildBurst,      defaultRequest,      EVENTS(expectedBurst), NULL, NULL },
+    { "mtu23",        buildMTU23,      defaultRequest,      EVENTS(expectedMTU23), NULL, NULL },
+    { "mtu185",       buildMTU185,     defaultRequest,      EVENTS(expectedMTU185), NULL, NULL },
+    { "reorder",      buildReorder,    defaultRequest,      EVENTS(expectedReorder), NULL, NULL },
+    { "disconnect",   buildDisconnect, defaultRequest,      EVENTS(expectedDisconnect), NULL, NULL },
+    { "callerbuffer", buildMTU23,      callerBufferRequest, EVENTS(expectedCallerBuffer), checkCallerBuffer, NULL },
+#if (ANCS_CLIENT_POOL_BLOCKS == 0) || (ANCS_CLIENT_POOL_BLOCKS >= 6)
+    { "pipeline",     buildPipeline,   defaultRequest,      EVENTS(expectedPipeline), NULL, NULL },
+    { "skipped",      buildSkipped,    defaultRequest,      EVENTS(expectedSkipped), NULL, NULL },
+#endif
+#if (ANCS_CLIENT_APP_CACHE_SIZE > 0) && ANCS_CLIENT_APP_CACHE_PERSIST
+    { "appcache",     buildAppCache,   defaultRequest,      EVENTS(expectedAppCache), NULL, NULL },
+#endif
+    { "policy",       buildPolicy,     defaultRequest,      EVENTS(expectedPolicy), checkPolicy, setupPolicy },
+    { "backlog",      buildBacklog,    defaultRequest,      EVENTS(expectedBacklog), checkBacklog, setupPolicy },
+    { "coalesce",     buildCoalesce,   defaultRequest,      EVENTS(expectedCoalesce), NULL, setupCoalesce },
+    { "window",       buildWindow,     defaultRequest,      EVENTS(expectedWindow), NULL, setupWindow },
+    { "multipeer",    buildMultipeer,  defaultRequest,      EVENTS(expectedMultipeer), checkMultipeer, NULL },
+    { "discoveryfail", buildDiscoveryFail, defaultRequest,  EVENTS(expectedDiscoveryFail), checkDiscoveryFail, setupDiscoveryFail },
+    { "linkparams",   buildLinkParams, defaultRequest,      EVENTS(expectedLinkParams), checkLinkParams, setupLinkParams },
+    { "subscribe",    buildSubscribe,  defaultRequest,      EVENTS(expectedSubscribe), checkSubscribe, setupSubscribe },
+    { "timeout",      buildTimeout,    defaultRequest,      EVENTS(expectedTimeout), NULL, setupTimeout },
+    { "late",         buildLate,       defaultRequest,      EVENTS(expectedLate), NULL, setupTimeout },
+    { "action",       buildAction,     defaultRequest,      EVENTS(expectedAction), checkAction, setupAction },
+#if (ANCS_CLIENT_LOW_PRIORITY_IN_FLIGHT == 1) && ((ANCS_CLIENT_POOL_BLOCKS == 0) || (ANCS_CLIENT_POOL_BLOCKS >= 6))
+    { "priority",     buildPriority,   defaultRequest,      EVENTS(expectedPriority), checkPriority, setupPriority },
+#endif
+    { "decoded",      buildDecoded,    typedRequest,        EVENTS(expectedDecoded), checkDecoded, setupDecoded },
+    { "export",       buildExport,     typedRequest,        EVENTS(expectedExport), checkExport, setupExport },
+    { "statistics",   buildStatistics, defaultRequest,      EVENTS(expectedStatistics), checkStatistics, setupStatistics },
+#if ANCS_CLIENT_HANDLE_CACHE_SIZE > 0
+    { "bonded",       buildBonded,     defaultRequest,      EVENTS(expectedBonded), checkBonded, setupBonded },
+    { "unbonded",     buildBonded,     defaultRequest,      EVENTS(expectedBonded), checkUnbonded, setupUnbonded },
+#endif
+#if ANCS_CLIENT_REFRESH_CACHE_SIZE > 0
+    { "refresh",      buildRefresh,    defaultRequest,      EVENTS(expectedRefresh), checkRefresh, setupRefresh },
+#if (ANCS_CLIENT_POOL_BLOCKS == 0) || (ANCS_CLIENT_POOL_BLOCKS >= 12)
+    { "refreshfull",  buildRefreshFull, defaultRequest,     EVENTS(expectedRefreshFull), NULL, setupRefreshFull },
+#endif
+#endif
+#if ANCS_CLIENT_STORE_SIZE > 0
+    { "store",        buildStore,      defaultRequest,      EVENTS(expectedStore), checkStore, NULL },
+#endif
+};
+
+/*****************************************************************************/
+/* Variables used by the harness                                             */
+/*****************************************************************************/
+
+BLE ble;
+
+// one session per simulated phone; the first one serves single phone scenarios
+SimulatedClient ancs;
+SimulatedClient extraSessions[SIM_PEERS - 1];
+
+static SimulatedConnection connections[SIM_PEERS] = {
+    SimulatedConnection(SIM_CONNECTION_HANDLE),
+    SimulatedConnection(SIM_CONNECTION_HANDLE + 1),
+    SimulatedConnection(SIM_CONNECTION_HANDLE + 2)
+};
+
+static uint8_t currentPeer = 0;
+
+static uint8_t traceBuffer[TRACE_BUFFER_SIZE];
+static TraceReader reader(NULL, 0);
+static Record_t pending;
+
+static uint8_t scenarioIndex = 0;
+static uint8_t step = 0;
+static bool passed = true;
+
+static Event_t eventLog[MAX_LOG_EVENTS];
+static uint8_t logPeers[MAX_LOG_EVENTS];
+static uint8_t logCount = 0;
+
+/*****************************************************************************/
+/* Client callbacks                                                          */
+/*****************************************************************************/
+
+static uint8_t findPeer(Gap::Handle_t connectionHandle)
+{
+    for (uint8_t peer = 0; peer < SIM_PEERS; peer++)
+    {
+        if (connections[peer].getHandle() == connectionHandle)
+        {
+            return peer;
+        }
+    }
+
+    return 0xFF;
+}
+
+static void logEvent(Gap::Handle_t connectionHandle, uint8_t type, uint32_t notificationUID, uint8_t attributeID, uint16_t length)
+{
+    DEBUGOUT("sim: %3u %c %lu %u %u @ %lu\r\n", step, type, (unsigned long) notificationUID, attributeID, length,
+                                                (unsigned long) minar::platform::getTime());
+
+    if (logCount < MAX_LOG_EVENTS)
+    {
+        logPeers[logCount] = findPeer(connectionHandle);
+        eventLog[logCount].step = step;
+        eventLog[logCount].type = type;
+        eventLog[logCount].notificationUID = notificationUID;
+        eventLog[logCount].attributeID = attributeID;
+        eventLog[logCount].length = length;
+        logCount++;
+    }
+}
+
+void onNotificationTask(ANCSClient::Notification_t event)
+{
+    logEvent(event.connectionHandle, EventNotification, event.notificationUID, 0, 0);
+}
+
+void onAttributeTask(ANCSClient::Attribute_t attribute)
+{
+    logEvent(attribute.connectionHandle, EventAttribute, attribute.notificationUID, attribute.attributeID, attribute.data->getLength());
+}
+
+void onDecodedAttributeTask(ANCSClient::DecodedAttribute_t decoded)
+{
+    uint16_t length = (decoded.type == ANCSAttributeDecoder::TypeText) ? decoded.length : decoded.valid;
+
+    logEvent(decoded.connectionHandle, EventDecoded, decoded.notificationUID, decoded.attributeID, length);
+
+    if (decoded.valid && (decoded.notificationUID == 80) && (decoded.attributeID < sizeof(decodedValues) / sizeof(uint32_t)))
+    {
+        decodedValues[decoded.attributeID] = decoded.value;
+    }
+}
+
+/*
+    Called from the GATT event; the chunks of a map are collected and the
+    map is compared once complete.
+*/
+void onExportChunk(const ANCSClient::ExportChunk_t* chunk)
+{
+    if ((chunk->length > 0) && (exportLength + chunk->length <= sizeof(exportBuffer)))
+    {
+        memcpy(&exportBuffer[exportLength], chunk->data, chunk->length);
+    }
+
+    exportLength += chunk->length;
+
+    if (chunk->state == ANCSCborExport::ChunkData)
+    {
+        return;
+    }
+
+    if (chunk->state == ANCSCborExport::ChunkEnd)
+    {
+        exportMatched = (exportLength == sizeof(expectedExportMap))
+                     && (memcmp(exportBuffer, expectedExportMap, sizeof(expectedExportMap)) == 0);
+    }
+    else
+    {
+        exportLength = 0;
+    }
+
+    logEvent(SIM_CONNECTION_HANDLE, EventExport, chunk->notificationUID, chunk->state, exportLength);
+    exportLength = 0;
+}
+
+void onAppAttributeTask(ANCSClient::AppAttribute_t attribute)
+{
+    logEvent(attribute.connectionHandle, EventAppAttribute, 0, attribute.attributeID, attribute.data->getLength());
+}
+
+void onNotificationBatch(const ANCSClient::NotificationBatch_t* batch)
+{
+    logEvent(batch->connectionHandle, EventBatch, batch->count, batch->received, 0);
+}
+
+void onServiceFoundTask()
+{
+    servicesFound++;
+}
+
+void onDiscoveryFailedTask(ANCSClient::DiscoveryFailure_t failure)
+{
+    logEvent(failure.connectionHandle, EventDiscovery, 0, failure.stage, failure.attempts);
+}
+
+void onActionCompleteTask(ANCSClient::RequestComplete_t complete)
+{
+    logEvent(complete.connectionHandle, EventAction, complete.notificationUID, complete.status, 0);
+}
+
+void onRequestCompleteTask(ANCSClient::RequestComplete_t complete)
+{
+    logEvent(complete.connectionHandle, EventComplete, complete.notificationUID, complete.status, complete.attributesReceived);
+}
+
+/*
+    Every event must come from the session serving the phone that owns the UID.
+*/
+static bool checkMultipeer()
+{
+    for (uint8_t index = 0; index < logCount; index++)
+    {
+        if ((logPeers[index] >= SIM_PEERS) ||
+            (eventLog[index].notificationUID != multipeerUIDs[logPeers[index]]))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*****************************************************************************/
+/* Replay                                                                    */
+/*****************************************************************************/
+
+static void verifyScenario();
+static void runScenario();
+
+static void scheduleRecord();
+
+static void replayRecord()
+{
+    step++;
+
+    switch (pending.type)
+    {
+        case RecordNotificationSource:
+            connections[currentPeer].notificationSource(pending.data, pending.length);
+            break;
+
+        case RecordDataSource:
+            connections[currentPeer].dataSource(pending.data, pending.length);
+            break;
+
+        case RecordRequest:
+        {
+            uint32_t uid = pending.data[0]
+                         | (pending.data[1] << 8)
+                         | (pending.data[2] << 16)
+                         | ((uint32_t) pending.data[3] << 24);
+
+            ANCSClient* client = connections[currentPeer].getClient();
+
+            if (client)
+            {
+                client->getNotificationAttributes(uid, scenarios[scenarioIndex].request, 3, onRequestCompleteTask);
+            }
+        }
+            break;
+
+        case RecordRefresh:
+        {
+            uint32_t uid = pending.data[0]
+                         | (pending.data[1] << 8)
+                         | (pending.data[2] << 16)
+                         | ((uint32_t) pending.data[3] << 24);
+
+            ANCSClient* client = connections[currentPeer].getClient();
+
+            if (client)
+            {
+                client->refreshNotificationAttributes(uid, scenarios[scenarioIndex].request, 3, onRequestCompleteTask, refreshPriority);
+            }
+        }
+            break;
+
+        case RecordAppRequest:
+        {
+            char identifier[ANCS_CLIENT_APP_IDENTIFIER_LENGTH + 1] = { 0 };
+            SimulatedClient* client = static_cast<SimulatedClient*>(connections[currentPeer].getClient());
+
+            if (client == NULL)
+            {
+                break;
+            }
+
+            uint32_t writes = client->getWrites();
+
+            if (pending.length <= ANCS_CLIENT_APP_IDENTIFIER_LENGTH)
+            {
+                memcpy(identifier, pending.data, pending.length);
+            }
+
+            client->getAppDisplayName(identifier, onRequestCompleteTask);
+
+            logEvent(client->getConnectionHandle(), EventWrite, 0, 0, client->getWrites() - writes);
+        }
+            break;
+
+        case RecordAction:
+        {
+            uint32_t uid = pending.data[0]
+                         | (pending.data[1] << 8)
+                         | (pending.data[2] << 16)
+                         | ((uint32_t) pending.data[3] << 24);
+
+            ANCSClient* client = connections[currentPeer].getClient();
+
+            if (client)
+            {
+                client->performNotificationAction(uid, (ANCSClient::action_id_t) pending.data[4], onActionCompleteTask);
+            }
+        }
+            break;
+
+        case RecordConnect:
+            connections[currentPeer].connect();
+            break;
+
+        case RecordReconnect:
+            connections[currentPeer].reconnect();
+            break;
+
+        case RecordLink:
+            connections[currentPeer].link();
+            break;
+
+        case RecordDisconnect:
+            connections[currentPeer].disconnect();
+            break;
+
+        case RecordSelectPeer:
+            currentPeer = (pending.data[0] < SIM_PEERS) ? pending.data[0] : 0;
+            break;
+
+        default:
+            break;
+    }
+
+    scheduleRecord();
+}
+
+static void scheduleRecord()
+{
+    if (reader.next(pending))
+    {
+        minar::Scheduler::postCallback(replayRecord)
+            .delay(minar::milliseconds(pending.delay));
+    }
+    else
+    {
+        // let the client finish posting its callbacks
+        minar::Scheduler::postCallback(verifyScenario)
+            .delay(minar::milliseconds(SETTLE_DELAY_MS));
+    }
+}
+
+static void verifyScenario()
+{
+    const Scenario_t& scenario = scenarios[scenarioIndex];
+    bool result = (logCount == scenario.expectedCount);
+
+    for (uint8_t index = 0; result && (index < logCount); index++)
+    {
+        const Event_t& expected = scenario.expected[index];
+
+        result = (eventLog[index].step == expected.step)
+              && (eventLog[index].type == expected.type)
+              && (eventLog[index].notificationUID == expected.notificationUID)
+              && (eventLog[index].attributeID == expected.attributeID)
+              && (eventLog[index].length == expected.length);
+    }
+
+    if (result && scenario.check)
+    {
+        result = scenario.check();
+    }
+
+    DEBUGOUT("sim: %s: %s\r\n", scenario.name, (result) ? "pass" : "FAIL");
+
+    passed = passed && result;
+
+    // leave every client disconnected between scenarios
+    for (uint8_t peer = 0; peer < SIM_PEERS; peer++)
+    {
+        connections[peer].disconnect();
+    }
+
+    ANCSDispatcher::setFetchPolicy(NULL, 0);
+    ANCSDispatcher::registerDecodedAttributeHandlerTask(FunctionPointer1<void, ANCSClient::DecodedAttribute_t>());
+    ancs.registerExportSink(FunctionPointer1<void, const ANCSClient::ExportChunk_t*>());
+    ancs.setCoalescing(0);
+    ancs.setConnectionParams(NULL, NULL);
+    ancs.setRequestTimeout(ANCS_CLIENT_REQUEST_TIMEOUT_MS);
+    refreshPriority = ANCSClient::PriorityNormal;
+    SimulatedPeers::bonding() = true;
+
+    scenarioIndex++;
+    minar::Scheduler::postCallback(runScenario);
+}
+
+static void runScenario()
+{
+    if (scenarioIndex >= sizeof(scenarios) / sizeof(Scenario_t))
+    {
+        MBED_HOSTTEST_RESULT(passed);
+        return;
+    }
+
+    NotificationProvider provider(traceBuffer, sizeof(traceBuffer));
+    scenarios[scenarioIndex].build(provider);
+
+    if (scenarios[scenarioIndex].setup)
+    {
+        scenarios[scenarioIndex].setup();
+    }
+
+    reader = TraceReader(provider.getTrace(), provider.getTraceLength());
+    step = 0;
+    logCount = 0;
+    currentPeer = 0;
+
+    scheduleRecord();
+}
+
+/*****************************************************************************/
+/* main                                                                      */
+/*****************************************************************************/
+
+void bleInitDone(BLE::InitializationCompleteCallbackContext* context)
+{
+    (void) context;
+
+    passed = (ancs.init() == BLE_ERROR_NONE);
+
+    ANCSDispatcher::registerNotificationHandlerTask(onNotificationTask);
+    ANCSDispatcher::registerAttributeHandlerTask(onAttributeTask);
+    ANCSDispatcher::registerAppAttributeHandlerTask(onAppAttributeTask);
+    ANCSDispatcher::registerNotificationBatchHandler(onNotificationBatch);
+
+    for (uint8_t index = 0; index < ANCS_CLIENT_MAX_CONNECTIONS; index++)
+    {
+        if (ANCSDispatcher::getSession(index))
+        {
+            ANCSDispatcher::getSession(index)->registerServiceFoundHandlerTask(onServiceFoundTask);
+            ANCSDispatcher::getSession(index)->registerDiscoveryFailedHandlerTask(onDiscoveryFailedTask);
+        }
+    }
+
+    minar::Scheduler::postCallback(runScenario);
+}
+
+void app_start(int, char *[])
+{
+    MBED_HOSTTEST_TIMEOUT(20);
+    MBED_HOSTTEST_SELECT(default_auto);
+    MBED_HOSTTEST_DESCRIPTION(ANCS client simulation);
+    MBED_HOSTTEST_START("ANCS_SIMULATION");
+
+    ble.init(bleInitDone);
+}